@@ -0,0 +1,614 @@
+// 进程内引擎微基准：engine x allocator x key 数 x key 长度
+//   每个组合 fork 一个子进程运行（mypool 无法整体回收，RSS 也需要干净的起点），
+//   结果经管道交给父进程，按 JSON lines 或 CSV 输出，便于长期跟踪回归
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "allocator/kvs_alloc.h"
+#include "engine/kvs_array.h"
+#include "engine/kvs_hash.h"
+#include "engine/kvs_intkey.h"
+#include "engine/kvs_mhash.h"
+#include "engine/kvs_rbtree.h"
+#include "engine/kvs_skiplist.h"
+
+#define MAX_LIST 16
+
+enum
+{
+    OP_SET = 0,
+    OP_GET,
+    OP_MGET,
+    OP_EXIST,
+    OP_MOD,
+    OP_DEL,
+    OP_COUNT,
+};
+
+static const char *op_name[OP_COUNT] = {"set", "get", "mget", "exist", "mod", "del"};
+
+typedef struct engine_ops_s
+{
+    const char *name;
+    long capacity; // <=0 表示不限
+    void *(*create)(void);
+    void (*destory)(void *inst);
+    int (*set)(void *inst, char *key, char *value);
+    char *(*get)(void *inst, char *key);
+    int (*mget)(void *inst, char **keys, int n, char **values);
+    int (*exist)(void *inst, char *key);
+    int (*mod)(void *inst, char *key, char *value);
+    int (*del)(void *inst, char *key);
+} engine_ops_t;
+
+// ---------- 引擎适配 ----------
+static kvs_array_t bench_array;
+static kvs_rbtree_t bench_rbtree;
+static kvs_hash_t bench_hash;
+static kvs_mhash_t bench_mhash;
+static kvs_u64hash_t bench_u64hash;
+static kvs_u64tree_t bench_u64tree;
+static kvs_skiplist_t bench_skiplist;
+
+static void *array_create(void) { return kvs_array_create(&bench_array) == 0 ? &bench_array : NULL; }
+static void array_destory(void *i) { kvs_array_destory(i); }
+static int array_set(void *i, char *k, char *v) { return kvs_array_set(i, k, v); }
+static char *array_get(void *i, char *k) { return kvs_array_get(i, k); }
+static int array_mget(void *i, char **k, int n, char **v)
+{
+    for (int j = 0; j < n; j++)
+        v[j] = kvs_array_get(i, k[j]);
+    return 0;
+}
+static int array_exist(void *i, char *k) { return kvs_array_exist(i, k); }
+static int array_mod(void *i, char *k, char *v) { return kvs_array_mod(i, k, v); }
+static int array_del(void *i, char *k) { return kvs_array_del(i, k); }
+
+static void *rbtree_create(void) { return kvs_rbtree_create(&bench_rbtree) == 0 ? &bench_rbtree : NULL; }
+static void rbtree_destory(void *i) { kvs_rbtree_destory(i); }
+static int rbtree_set(void *i, char *k, char *v) { return kvs_rbtree_set(i, k, v); }
+static char *rbtree_get(void *i, char *k) { return kvs_rbtree_get(i, k); }
+static int rbtree_mget(void *i, char **k, int n, char **v) { return kvs_rbtree_mget(i, k, n, v); }
+static int rbtree_exist(void *i, char *k) { return kvs_rbtree_exist(i, k); }
+static int rbtree_mod(void *i, char *k, char *v) { return kvs_rbtree_mod(i, k, v); }
+static int rbtree_del(void *i, char *k) { return kvs_rbtree_del(i, k); }
+
+static void *hash_create(void) { return kvs_hash_create(&bench_hash) == 0 ? &bench_hash : NULL; }
+static void hash_destory(void *i) { kvs_hash_destory(i); }
+static int hash_set(void *i, char *k, char *v) { return kvs_hash_set(i, k, v); }
+static char *hash_get(void *i, char *k) { return kvs_hash_get(i, k); }
+static int hash_mget(void *i, char **k, int n, char **v) { return kvs_hash_mget(i, k, n, v); }
+static int hash_exist(void *i, char *k) { return kvs_hash_exist(i, k); }
+static int hash_mod(void *i, char *k, char *v) { return kvs_hash_mod(i, k, v); }
+static int hash_del(void *i, char *k) { return kvs_hash_del(i, k); }
+
+// mhash 不经过分配器：每个组合都从空文件开始，结束后删除
+#define BENCH_MHASH_PATH "/tmp/kvs-bench-engine.mhash"
+static void *mhash_create(void)
+{
+    unlink(BENCH_MHASH_PATH);
+    return kvs_mhash_create(&bench_mhash, BENCH_MHASH_PATH) == 0 ? &bench_mhash : NULL;
+}
+static void mhash_destory(void *i)
+{
+    kvs_mhash_destory(i);
+    unlink(BENCH_MHASH_PATH);
+}
+static int mhash_set(void *i, char *k, char *v) { return kvs_mhash_set(i, k, v); }
+static char *mhash_get(void *i, char *k) { return kvs_mhash_get(i, k); }
+static int mhash_mget(void *i, char **k, int n, char **v)
+{
+    for (int j = 0; j < n; j++)
+        v[j] = kvs_mhash_get(i, k[j]);
+    return 0;
+}
+static int mhash_exist(void *i, char *k) { return kvs_mhash_exist(i, k); }
+static int mhash_mod(void *i, char *k, char *v) { return kvs_mhash_mod(i, k, v); }
+static int mhash_del(void *i, char *k) { return kvs_mhash_del(i, k); }
+
+static void *skiplist_create(void) { return kvs_skiplist_create(&bench_skiplist) == 0 ? &bench_skiplist : NULL; }
+static void skiplist_destory(void *i) { kvs_skiplist_destory(i); }
+static int skiplist_set(void *i, char *k, char *v) { return kvs_skiplist_set(i, k, v); }
+static char *skiplist_get(void *i, char *k) { return kvs_skiplist_get(i, k); }
+static int skiplist_mget(void *i, char **k, int n, char **v)
+{
+    for (int j = 0; j < n; j++)
+        v[j] = kvs_skiplist_get(i, k[j]);
+    return 0;
+}
+static int skiplist_exist(void *i, char *k) { return kvs_skiplist_exist(i, k); }
+static int skiplist_mod(void *i, char *k, char *v) { return kvs_skiplist_mod(i, k, v); }
+static int skiplist_del(void *i, char *k) { return kvs_skiplist_del(i, k); }
+
+// 整数 key 引擎：取 key 末尾的十进制编号作为 uint64 key，解析开销计入每次操作
+static inline uint64_t key_u64(const char *k)
+{
+    const char *p = k + strlen(k);
+    while (p > k && p[-1] >= '0' && p[-1] <= '9')
+        p--;
+    uint64_t n = 0;
+    for (; *p; p++)
+        n = n * 10 + (uint64_t)(*p - '0');
+    return n;
+}
+
+static void *u64hash_create(void) { return kvs_u64hash_create(&bench_u64hash) == 0 ? &bench_u64hash : NULL; }
+static void u64hash_destory(void *i) { kvs_u64hash_destory(i); }
+static int u64hash_set(void *i, char *k, char *v) { return kvs_u64hash_set(i, key_u64(k), v); }
+static char *u64hash_get(void *i, char *k) { return kvs_u64hash_get(i, key_u64(k)); }
+static int u64hash_mget(void *i, char **k, int n, char **v)
+{
+    for (int j = 0; j < n; j++)
+        v[j] = kvs_u64hash_get(i, key_u64(k[j]));
+    return 0;
+}
+static int u64hash_exist(void *i, char *k) { return kvs_u64hash_exist(i, key_u64(k)); }
+static int u64hash_mod(void *i, char *k, char *v) { return kvs_u64hash_mod(i, key_u64(k), v); }
+static int u64hash_del(void *i, char *k) { return kvs_u64hash_del(i, key_u64(k)); }
+
+static void *u64tree_create(void) { return kvs_u64tree_create(&bench_u64tree) == 0 ? &bench_u64tree : NULL; }
+static void u64tree_destory(void *i) { kvs_u64tree_destory(i); }
+static int u64tree_set(void *i, char *k, char *v) { return kvs_u64tree_set(i, key_u64(k), v); }
+static char *u64tree_get(void *i, char *k) { return kvs_u64tree_get(i, key_u64(k)); }
+static int u64tree_mget(void *i, char **k, int n, char **v)
+{
+    for (int j = 0; j < n; j++)
+        v[j] = kvs_u64tree_get(i, key_u64(k[j]));
+    return 0;
+}
+static int u64tree_exist(void *i, char *k) { return kvs_u64tree_exist(i, key_u64(k)); }
+static int u64tree_mod(void *i, char *k, char *v) { return kvs_u64tree_mod(i, key_u64(k), v); }
+static int u64tree_del(void *i, char *k) { return kvs_u64tree_del(i, key_u64(k)); }
+
+static const engine_ops_t engines[] = {
+    {"array", KVS_ARRAY_SIZE, array_create, array_destory, array_set, array_get, array_mget, array_exist, array_mod, array_del},
+    {"rbtree", 0, rbtree_create, rbtree_destory, rbtree_set, rbtree_get, rbtree_mget, rbtree_exist, rbtree_mod, rbtree_del},
+    {"hash", 0, hash_create, hash_destory, hash_set, hash_get, hash_mget, hash_exist, hash_mod, hash_del},
+    {"mhash", 0, mhash_create, mhash_destory, mhash_set, mhash_get, mhash_mget, mhash_exist, mhash_mod, mhash_del},
+    {"skiplist", 0, skiplist_create, skiplist_destory, skiplist_set, skiplist_get, skiplist_mget, skiplist_exist, skiplist_mod, skiplist_del},
+    {"u64hash", 0, u64hash_create, u64hash_destory, u64hash_set, u64hash_get, u64hash_mget, u64hash_exist, u64hash_mod, u64hash_del},
+    {"u64tree", 0, u64tree_create, u64tree_destory, u64tree_set, u64tree_get, u64tree_mget, u64tree_exist, u64tree_mod, u64tree_del},
+};
+#define ENGINE_COUNT (int)(sizeof(engines) / sizeof(engines[0]))
+
+static const struct
+{
+    const char *name;
+    kvs_alloc_type_t type;
+    int hugepages;
+} allocators[] = {
+    {"system", KVS_ALLOC_SYSTEM, 0},
+    {"jemalloc", KVS_ALLOC_JEMALLOC, 0},
+    {"mypool", KVS_ALLOC_MYPOOL, 0},
+    {"mypool-huge", KVS_ALLOC_MYPOOL, 1},
+};
+#define ALLOC_COUNT (int)(sizeof(allocators) / sizeof(allocators[0]))
+
+// ---------- 选项 ----------
+static long key_counts[MAX_LIST] = {1000, 10000, 100000};
+static int nkey_counts = 3;
+static long key_sizes[MAX_LIST] = {8, 16, 64, 256};
+static int nkey_sizes = 4;
+static int value_size = 32;
+static int batch_size = 16; // mget 每批的 key 数
+static int timeout_sec = 120;
+static int csv = 0;
+static unsigned engine_mask = (1u << ENGINE_COUNT) - 1;
+static unsigned alloc_mask = (1u << ALLOC_COUNT) - 1;
+
+typedef struct result_s
+{
+    int status; // 0: ok, 1: 引擎容量不足, 2: key 长度放不下编号
+    double ns[OP_COUNT];
+    double mallocs[OP_COUNT];
+    double frees[OP_COUNT];
+    double rss_per_key;
+} result_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static long rss_bytes(void)
+{
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+    if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(fp);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// key = 'k' + 'x' 填充 + 定宽十进制编号，长度固定为 klen
+static inline void make_key(char *buf, int klen, int width, long idx)
+{
+    char *p = buf + klen;
+    *p = '\0';
+    for (int i = 0; i < width; i++)
+    {
+        *--p = (char)('0' + idx % 10);
+        idx /= 10;
+    }
+}
+
+static int digits(long n)
+{
+    int d = 1;
+    while (n >= 10)
+    {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static long gcd(long a, long b)
+{
+    while (b)
+    {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// 以固定步长遍历 [0, n) 的一个排列，避免按插入顺序访问
+static long permute_step(long n)
+{
+    long step = 1000003;
+    while (gcd(step, n) != 1)
+        step += 2;
+    return step;
+}
+
+static void run_combo(const engine_ops_t *e, int ai, long n, int klen, result_t *res)
+{
+    memset(res, 0, sizeof(*res));
+    if (e->capacity > 0 && n > e->capacity)
+    {
+        res->status = 1;
+        return;
+    }
+
+    int width = digits(n - 1);
+    if (width > klen)
+    {
+        res->status = 2;
+        return;
+    }
+
+    kvs_alloc_set_hugepages(allocators[ai].hugepages);
+    kvs_set_allocator(allocators[ai].type);
+
+    char *key = malloc((size_t)klen + 1);
+    char *value = malloc((size_t)value_size + 1);
+    char *value2 = malloc((size_t)value_size + 1);
+    memset(key, 'x', (size_t)klen);
+    key[0] = 'k';
+    memset(value, 'v', (size_t)value_size);
+    value[value_size] = '\0';
+    memset(value2, 'w', (size_t)value_size);
+    value2[value_size] = '\0';
+
+    // mget 的一批 key：每个槽位一份 key 缓冲区
+    char *batch_buf = malloc((size_t)batch_size * ((size_t)klen + 1));
+    char **batch_keys = malloc(sizeof(char *) * (size_t)batch_size);
+    char **batch_values = malloc(sizeof(char *) * (size_t)batch_size);
+    for (int i = 0; i < batch_size; i++)
+    {
+        batch_keys[i] = batch_buf + (size_t)i * ((size_t)klen + 1);
+        memcpy(batch_keys[i], key, (size_t)klen);
+    }
+
+    long step = permute_step(n);
+
+    // 生成 key 本身的开销，从每个阶段里扣除
+    uint64_t t0 = now_ns();
+    volatile char sink = 0;
+    for (long i = 0, idx = 0; i < n; i++, idx = (idx + step) % n)
+    {
+        make_key(key, klen, width, idx);
+        sink ^= key[klen - 1];
+    }
+    double keygen_ns = (double)(now_ns() - t0) / (double)n;
+
+    void *inst = e->create();
+    if (!inst)
+    {
+        fprintf(stderr, "%s: create failed\n", e->name);
+        exit(1);
+    }
+
+    long rss0 = rss_bytes();
+
+    for (int op = 0; op < OP_COUNT; op++)
+    {
+        kvs_alloc_counters_t c0, c1;
+        kvs_alloc_counters(&c0);
+        t0 = now_ns();
+
+        if (op == OP_MGET)
+        {
+            // 同样的访问顺序，每 batch_size 个 key 调一次批量接口；ns 仍按单个 key 计
+            long i = 0, idx = 0;
+            while (i < n)
+            {
+                int m = 0;
+                for (; m < batch_size && i < n; m++, i++, idx = (idx + step) % n)
+                    make_key(batch_keys[m], klen, width, idx);
+                e->mget(inst, batch_keys, m, batch_values);
+                for (int j = 0; j < m; j++)
+                {
+                    if (!batch_values[j])
+                    {
+                        fprintf(stderr, "%s mget key %s failed\n", e->name, batch_keys[j]);
+                        exit(1);
+                    }
+                }
+            }
+        }
+
+        for (long i = 0, idx = 0; op != OP_MGET && i < n; i++, idx = (idx + step) % n)
+        {
+            make_key(key, klen, width, idx);
+            int ret = 0;
+            switch (op)
+            {
+            case OP_SET:
+                ret = e->set(inst, key, value);
+                break;
+            case OP_GET:
+                ret = e->get(inst, key) ? 0 : 1;
+                break;
+            case OP_EXIST:
+                ret = e->exist(inst, key);
+                break;
+            case OP_MOD:
+                ret = e->mod(inst, key, value2);
+                break;
+            case OP_DEL:
+                ret = e->del(inst, key);
+                break;
+            }
+            if (ret != 0)
+            {
+                fprintf(stderr, "%s %s key %ld failed: %d\n", e->name, op_name[op], idx, ret);
+                exit(1);
+            }
+        }
+
+        double ns = (double)(now_ns() - t0) / (double)n - keygen_ns;
+        kvs_alloc_counters(&c1);
+        res->ns[op] = ns > 0 ? ns : 0;
+        res->mallocs[op] = (double)(c1.malloc_calls - c0.malloc_calls) / (double)n;
+        res->frees[op] = (double)(c1.free_calls - c0.free_calls) / (double)n;
+
+        if (op == OP_SET)
+            res->rss_per_key = (double)(rss_bytes() - rss0) / (double)n;
+    }
+
+    e->destory(inst);
+    free(batch_buf);
+    free(batch_keys);
+    free(batch_values);
+    free(key);
+    free(value);
+    free(value2);
+}
+
+static void print_header(void)
+{
+    if (csv)
+        printf("engine,allocator,keys,key_size,value_size,op,status,ns_per_op,mallocs_per_op,frees_per_op,rss_per_key\n");
+}
+
+static void print_result(const char *engine, const char *alloc, long n, int klen, const char *status, const result_t *r)
+{
+    for (int op = 0; op < OP_COUNT; op++)
+    {
+        double ns = r ? r->ns[op] : 0, m = r ? r->mallocs[op] : 0, f = r ? r->frees[op] : 0;
+        double rss = r ? r->rss_per_key : 0;
+
+        if (csv)
+            printf("%s,%s,%ld,%d,%d,%s,%s,%.1f,%.3f,%.3f,%.1f\n",
+                   engine, alloc, n, klen, value_size, op_name[op], status, ns, m, f, rss);
+        else
+            printf("{\"engine\":\"%s\",\"allocator\":\"%s\",\"keys\":%ld,\"key_size\":%d,\"value_size\":%d,"
+                   "\"op\":\"%s\",\"status\":\"%s\",\"ns_per_op\":%.1f,\"mallocs_per_op\":%.3f,"
+                   "\"frees_per_op\":%.3f,\"rss_per_key\":%.1f}\n",
+                   engine, alloc, n, klen, value_size, op_name[op], status, ns, m, f, rss);
+    }
+    fflush(stdout);
+}
+
+static void run_isolated(int ei, int ai, long n, int klen)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        // kvs_set_allocator 会往 stdout 打日志，子进程的 stdout 丢掉，结果走管道
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        alarm((unsigned)timeout_sec);
+
+        result_t res;
+        run_combo(&engines[ei], ai, n, klen, &res);
+        ssize_t w = write(fds[1], &res, sizeof(res));
+        _exit(w == (ssize_t)sizeof(res) ? 0 : 1);
+    }
+    close(fds[1]);
+
+    result_t res;
+    ssize_t got = read(fds[0], &res, sizeof(res));
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    const char *e = engines[ei].name, *a = allocators[ai].name;
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM)
+        print_result(e, a, n, klen, "timeout", NULL);
+    else if (got != (ssize_t)sizeof(res) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        print_result(e, a, n, klen, "failed", NULL);
+    else if (res.status == 1)
+        print_result(e, a, n, klen, "over_capacity", NULL);
+    else if (res.status == 2)
+        print_result(e, a, n, klen, "key_too_short", NULL);
+    else
+        print_result(e, a, n, klen, "ok", &res);
+}
+
+static int parse_list(const char *v, long *out)
+{
+    int n = 0;
+    char *dup = strdup(v), *save = NULL;
+    for (char *tok = strtok_r(dup, ",", &save); tok && n < MAX_LIST; tok = strtok_r(NULL, ",", &save))
+    {
+        out[n] = atol(tok);
+        if (out[n] <= 0)
+        {
+            free(dup);
+            return -1;
+        }
+        n++;
+    }
+    free(dup);
+    return n;
+}
+
+static int parse_mask(const char *v, const char *const *names, int count, unsigned *mask)
+{
+    *mask = 0;
+    char *dup = strdup(v), *save = NULL;
+    for (char *tok = strtok_r(dup, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+    {
+        int found = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (strcmp(tok, names[i]) == 0)
+            {
+                *mask |= 1u << i;
+                found = 1;
+            }
+        }
+        if (!found)
+        {
+            free(dup);
+            return -1;
+        }
+    }
+    free(dup);
+    return *mask ? 0 : -1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -n, --keys N,N,...        key counts (1000,10000,100000)\n"
+            "  -k, --key-sizes N,N,...   key lengths in bytes (8,16,64,256)\n"
+            "  -V, --value-size N        value length (32)\n"
+            "  -b, --batch N             keys per mget call (16)\n"
+            "  -e, --engines LIST        array,rbtree,hash,mhash,skiplist,u64hash,u64tree (all)\n"
+            "  -a, --allocators LIST     system,jemalloc,mypool,mypool-huge (all)\n"
+            "  -t, --timeout SEC         per-combination time limit (120)\n"
+            "      --csv                 CSV instead of JSON lines\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option longopts[] = {
+        {"keys", required_argument, NULL, 'n'},
+        {"key-sizes", required_argument, NULL, 'k'},
+        {"value-size", required_argument, NULL, 'V'},
+        {"batch", required_argument, NULL, 'b'},
+        {"engines", required_argument, NULL, 'e'},
+        {"allocators", required_argument, NULL, 'a'},
+        {"timeout", required_argument, NULL, 't'},
+        {"csv", no_argument, NULL, 'C'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    static const char *const engine_names[] = {"array", "rbtree", "hash", "mhash", "skiplist", "u64hash", "u64tree"};
+    static const char *const alloc_names[] = {"system", "jemalloc", "mypool", "mypool-huge"};
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "n:k:V:b:e:a:t:h", longopts, NULL)) != -1)
+    {
+        int bad = 0;
+        switch (ch)
+        {
+        case 'n': bad = (nkey_counts = parse_list(optarg, key_counts)) <= 0; break;
+        case 'k': bad = (nkey_sizes = parse_list(optarg, key_sizes)) <= 0; break;
+        case 'V': bad = (value_size = atoi(optarg)) <= 0; break;
+        case 'b': bad = (batch_size = atoi(optarg)) <= 0; break;
+        case 'e': bad = parse_mask(optarg, engine_names, ENGINE_COUNT, &engine_mask) != 0; break;
+        case 'a': bad = parse_mask(optarg, alloc_names, ALLOC_COUNT, &alloc_mask) != 0; break;
+        case 't': bad = (timeout_sec = atoi(optarg)) <= 0; break;
+        case 'C': csv = 1; break;
+        default: bad = 1; break;
+        }
+        if (bad)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < nkey_sizes; i++)
+    {
+        if (key_sizes[i] < 8 || key_sizes[i] > 4096)
+        {
+            fprintf(stderr, "key size must be in [8, 4096]\n");
+            return 1;
+        }
+    }
+
+    print_header();
+
+    for (int ai = 0; ai < ALLOC_COUNT; ai++)
+    {
+        if (!(alloc_mask & (1u << ai)))
+            continue;
+#ifndef USE_JEMALLOC
+        if (allocators[ai].type == KVS_ALLOC_JEMALLOC)
+        {
+            fprintf(stderr, "jemalloc not compiled in (build with USE_JEMALLOC=1), skipped\n");
+            continue;
+        }
+#endif
+        for (int ei = 0; ei < ENGINE_COUNT; ei++)
+        {
+            if (!(engine_mask & (1u << ei)))
+                continue;
+            for (int ni = 0; ni < nkey_counts; ni++)
+                for (int ki = 0; ki < nkey_sizes; ki++)
+                    run_isolated(ei, ai, key_counts[ni], (int)key_sizes[ki]);
+        }
+    }
+    return 0;
+}
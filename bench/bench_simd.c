@@ -0,0 +1,217 @@
+// 字符串内核微基准：kernel x 实现 x 字符串长度
+//   baseline 是改用 kvs_simd 之前的写法（逐字节 djb 哈希、逐字节找分隔符），
+//   其余为 kvs_simd 各档；结果为 JSON lines（--csv 可切换），与 bench_engine 一致
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine/kvs_simd.h"
+
+#define MAX_LIST 16
+#define NSTR 1024 // 轮流使用的字符串个数，避免只测到同一地址
+
+enum
+{
+    K_HASH = 0,
+    K_DELIM,
+    K_COUNT_DELIM,
+    K_COUNT,
+};
+
+static const char *kernel_name[K_COUNT] = {"hash", "delim", "count_delim"};
+
+static long lens[MAX_LIST] = {8, 16, 32, 64, 256, 1024};
+static int nlens = 6;
+static long iters = 2000000;
+static int csv = 0;
+
+static volatile uint64_t sink;
+
+// ---------- baseline ----------
+
+static uint32_t base_hash(const char *key)
+{
+    uint32_t h = 5381;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++)
+        h = h * 33 + *p;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h;
+}
+
+static char *base_delim(const char *p)
+{
+    while (*p && *p != ' ' && *p != '\t' && *p != '\r')
+        p++;
+    return (char *)p;
+}
+
+static size_t base_count_delim(const char *line)
+{
+    size_t n = 0;
+    for (const char *p = line; *p; p++)
+    {
+        if (*p == ' ' || *p == '\t' || *p == '\r')
+            n++;
+    }
+    return n;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// 每个字符串单独分配，起始地址对齐各不相同
+static char **make_strings(long len, int kernel)
+{
+    char **s = malloc(sizeof(char *) * NSTR);
+    if (!s)
+        exit(1);
+    srand(1);
+    for (int i = 0; i < NSTR; i++)
+    {
+        int skew = (i * 7) % 32;
+        char *p = malloc((size_t)len + 1 + 32);
+        if (!p)
+            exit(1);
+        p += skew;
+        for (long j = 0; j < len; j++)
+            p[j] = (char)('a' + rand() % 26);
+        // count_delim：类似 "SET key value" 的一行，隔几个字节一个空格
+        if (kernel == K_COUNT_DELIM)
+            for (long j = 7; j < len; j += 8)
+                p[j] = ' ';
+        p[len] = '\0';
+        s[i] = p;
+    }
+    return s;
+}
+
+static void free_strings(char **s)
+{
+    for (int i = 0; i < NSTR; i++)
+        free(s[i] - (i * 7) % 32);
+    free(s);
+}
+
+// impl < 0 为 baseline
+static double run(int kernel, int impl, long len)
+{
+    char **a = make_strings(len, kernel);
+    if (impl >= 0)
+        kvs_simd_select((kvs_simd_level_t)impl);
+
+    uint64_t acc = 0;
+    uint64_t t0 = now_ns();
+    for (long i = 0; i < iters; i++)
+    {
+        const char *s = a[i & (NSTR - 1)];
+        switch (kernel)
+        {
+        case K_HASH:
+            acc += impl < 0 ? base_hash(s) : kvs_simd_hash(s);
+            break;
+        case K_DELIM:
+            acc += (uint64_t)((impl < 0 ? base_delim(s) : kvs_simd_delim(s)) - s);
+            break;
+        case K_COUNT_DELIM:
+            acc += impl < 0 ? base_count_delim(s) : kvs_simd_count_delim(s);
+            break;
+        }
+    }
+    double ns = (double)(now_ns() - t0) / (double)iters;
+    sink = acc;
+
+    free_strings(a);
+    return ns;
+}
+
+static int parse_list(const char *arg, long *out)
+{
+    int n = 0;
+    char *dup = strdup(arg), *save = NULL;
+    for (char *tok = strtok_r(dup, ",", &save); tok && n < MAX_LIST; tok = strtok_r(NULL, ",", &save))
+    {
+        long v = strtol(tok, NULL, 10);
+        if (v <= 0)
+        {
+            n = -1;
+            break;
+        }
+        out[n++] = v;
+    }
+    free(dup);
+    return n;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -l, --lens N,N,...        string lengths in bytes (8,16,32,64,256,1024)\n"
+            "  -i, --iters N             calls per combination (2000000)\n"
+            "      --csv                 CSV instead of JSON lines\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option longopts[] = {
+        {"lens", required_argument, NULL, 'l'},
+        {"iters", required_argument, NULL, 'i'},
+        {"csv", no_argument, NULL, 'C'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "l:i:h", longopts, NULL)) != -1)
+    {
+        int bad = 0;
+        switch (ch)
+        {
+        case 'l': bad = (nlens = parse_list(optarg, lens)) <= 0; break;
+        case 'i': bad = (iters = atol(optarg)) <= 0; break;
+        case 'C': csv = 1; break;
+        default: bad = 1; break;
+        }
+        if (bad)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    kvs_simd_level_t best = kvs_simd_best();
+    if (csv)
+        printf("kernel,impl,len,ns_per_op,speedup\n");
+
+    for (int k = 0; k < K_COUNT; k++)
+    {
+        for (int li = 0; li < nlens; li++)
+        {
+            double base = run(k, -1, lens[li]);
+            for (int impl = -1; impl <= (int)best; impl++)
+            {
+                double ns = impl < 0 ? base : run(k, impl, lens[li]);
+                const char *name = impl < 0 ? "baseline" : kvs_simd_name((kvs_simd_level_t)impl);
+                if (csv)
+                    printf("%s,%s,%ld,%.2f,%.2f\n", kernel_name[k], name, lens[li], ns, base / ns);
+                else
+                    printf("{\"kernel\":\"%s\",\"impl\":\"%s\",\"len\":%ld,\"ns_per_op\":%.2f,\"speedup\":%.2f}\n",
+                           kernel_name[k], name, lens[li], ns, base / ns);
+                fflush(stdout);
+            }
+        }
+    }
+    kvs_simd_select(best);
+    return 0;
+}
@@ -0,0 +1,662 @@
+// kvs-bench：多线程压测客户端
+//   N 个连接分布在 M 个线程上，每个连接保持 P 个流水线请求在途
+//   key 分布 uniform / zipfian，key/value 长度可配为定长或区间均匀分布
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "stats/kvs_stats.h"
+
+#define BENCH_RBUF_SIZE 65536
+
+typedef struct bench_range_s
+{
+    int min;
+    int max;
+} bench_range_t;
+
+typedef struct bench_opts_s
+{
+    const char *host;
+    int port;
+    int conns;
+    int threads;
+    int pipeline;
+    int duration;   // 秒
+    long requests;  // >0 时按请求数结束
+    long keyspace;
+    int zipf;       // 0: uniform, 1: zipfian
+    double theta;   // zipf 参数
+    double read_ratio;
+    bench_range_t key_size;
+    bench_range_t value_size;
+    const char *prefix; // 命令前缀：""=array, "R"=rbtree, "H"=hash
+    int preload;
+} bench_opts_t;
+
+typedef struct bench_conn_s
+{
+    int fd;
+    char *wbuf;
+    size_t wlen;
+    size_t wcap;
+    char rbuf[BENCH_RBUF_SIZE];
+    size_t rlen;
+
+    uint64_t *sent; // 在途请求的发送时间（FIFO）
+    int head;
+    int inflight;
+    int want_out;
+} bench_conn_t;
+
+typedef struct bench_thread_s
+{
+    int id;
+    pthread_t tid;
+    int nconns;
+    bench_conn_t *conns;
+    uint64_t rng;
+
+    kvs_hist_t hist; // 单位 ns
+    uint64_t done;
+    uint64_t errors;
+} bench_thread_t;
+
+static bench_opts_t opts = {
+    .host = "127.0.0.1",
+    .port = 2000,
+    .conns = 50,
+    .threads = 4,
+    .pipeline = 1,
+    .duration = 10,
+    .requests = 0,
+    .keyspace = 100000,
+    .zipf = 0,
+    .theta = 0.99,
+    .read_ratio = 0.9,
+    .key_size = {16, 16},
+    .value_size = {32, 32},
+    .prefix = "H",
+    .preload = 0,
+};
+
+static _Atomic uint64_t g_done = 0;
+static _Atomic uint64_t g_issued = 0;
+static _Atomic int g_stop = 0;
+
+static char *value_fill;
+
+// zipfian（Gray et al. / YCSB）预计算参数
+static double zipf_zetan, zipf_alpha, zipf_eta;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t rng_next(uint64_t *s)
+{
+    // xorshift64*
+    uint64_t x = *s;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *s = x;
+    return x * 2685821657736338717ull;
+}
+
+static inline double rng_double(uint64_t *s)
+{
+    return (double)(rng_next(s) >> 11) / (double)(1ull << 53);
+}
+
+static inline uint64_t fnv64(uint64_t v)
+{
+    uint64_t h = 1469598103934665603ull;
+    for (int i = 0; i < 8; i++)
+    {
+        h ^= v & 0xff;
+        h *= 1099511628211ull;
+        v >>= 8;
+    }
+    return h;
+}
+
+static int range_pick(bench_range_t r, uint64_t *s)
+{
+    if (r.max <= r.min)
+        return r.min;
+    return r.min + (int)(rng_next(s) % (uint64_t)(r.max - r.min + 1));
+}
+
+static int parse_range(const char *v, bench_range_t *r)
+{
+    char *end;
+    r->min = (int)strtol(v, &end, 10);
+    r->max = r->min;
+    if (*end == '-')
+        r->max = (int)strtol(end + 1, &end, 10);
+    return (*end == '\0' && r->min > 0 && r->max >= r->min) ? 0 : -1;
+}
+
+static void zipf_init(long n, double theta)
+{
+    double zeta2 = 1.0 + pow(0.5, theta);
+    zipf_zetan = 0;
+    for (long i = 1; i <= n; i++)
+        zipf_zetan += 1.0 / pow((double)i, theta);
+
+    zipf_alpha = 1.0 / (1.0 - theta);
+    zipf_eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta2 / zipf_zetan);
+}
+
+static long zipf_next(uint64_t *s)
+{
+    double u = rng_double(s);
+    double uz = u * zipf_zetan;
+    long rank;
+
+    if (uz < 1.0)
+        rank = 0;
+    else if (uz < 1.0 + pow(0.5, opts.theta))
+        rank = 1;
+    else
+        rank = (long)((double)opts.keyspace * pow(zipf_eta * u - zipf_eta + 1.0, zipf_alpha));
+    if (rank >= opts.keyspace)
+        rank = opts.keyspace - 1;
+
+    // 打散：热点 key 不集中在相邻编号上
+    return (long)(fnv64((uint64_t)rank) % (uint64_t)opts.keyspace);
+}
+
+// key 长度只由编号决定，保证同一个 key 每次生成都一样
+static int make_key(char *buf, long idx)
+{
+    uint64_t seed = fnv64((uint64_t)idx) | 1;
+    int len = range_pick(opts.key_size, &seed);
+
+    char digits[24];
+    int dlen = snprintf(digits, sizeof(digits), "%ld", idx);
+    int pad = len - 1 - dlen;
+    if (pad < 0)
+        pad = 0;
+
+    buf[0] = 'k';
+    memset(buf + 1, 'x', (size_t)pad);
+    memcpy(buf + 1 + pad, digits, (size_t)dlen);
+    return 1 + pad + dlen;
+}
+
+static void wbuf_append(bench_conn_t *c, const char *data, size_t len)
+{
+    if (c->wlen + len > c->wcap)
+    {
+        size_t cap = c->wcap ? c->wcap : 4096;
+        while (cap < c->wlen + len)
+            cap <<= 1;
+        c->wbuf = realloc(c->wbuf, cap);
+        if (!c->wbuf)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        c->wcap = cap;
+    }
+    memcpy(c->wbuf + c->wlen, data, len);
+    c->wlen += len;
+}
+
+// 压测阶段的写命令：SET 只在 key 不存在时写入，预热之后就只剩存在性检查，所以用覆盖写
+#define BENCH_WRITE_CMD "UPSERT"
+
+// write_cmd 为 NULL 时发 GET，否则发 "<write_cmd> key value"
+static void append_request(bench_thread_t *t, bench_conn_t *c, long idx, const char *write_cmd)
+{
+    char key[1024];
+    int klen = make_key(key, idx);
+
+    wbuf_append(c, opts.prefix, strlen(opts.prefix));
+    if (write_cmd)
+    {
+        int vlen = range_pick(opts.value_size, &t->rng);
+        wbuf_append(c, write_cmd, strlen(write_cmd));
+        wbuf_append(c, " ", 1);
+        wbuf_append(c, key, (size_t)klen);
+        wbuf_append(c, " ", 1);
+        wbuf_append(c, value_fill, (size_t)vlen);
+    }
+    else
+    {
+        wbuf_append(c, "GET ", 4);
+        wbuf_append(c, key, (size_t)klen);
+    }
+    wbuf_append(c, "\n", 1);
+
+    int tail = (c->head + c->inflight) % opts.pipeline;
+    c->sent[tail] = now_ns();
+    c->inflight++;
+}
+
+static int conn_flush(bench_conn_t *c)
+{
+    size_t off = 0;
+    while (off < c->wlen)
+    {
+        ssize_t n = send(c->fd, c->wbuf + off, c->wlen - off, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            off += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        return -1;
+    }
+    memmove(c->wbuf, c->wbuf + off, c->wlen - off);
+    c->wlen -= off;
+    return 0;
+}
+
+// 按需补齐流水线
+static void conn_refill(bench_thread_t *t, bench_conn_t *c)
+{
+    while (c->inflight < opts.pipeline && !atomic_load_explicit(&g_stop, memory_order_relaxed))
+    {
+        if (opts.requests > 0 && atomic_fetch_add_explicit(&g_issued, 1, memory_order_relaxed) >= (uint64_t)opts.requests)
+            break;
+
+        long idx = opts.zipf ? zipf_next(&t->rng) : (long)(rng_next(&t->rng) % (uint64_t)opts.keyspace);
+        int is_write = rng_double(&t->rng) >= opts.read_ratio;
+        append_request(t, c, idx, is_write ? BENCH_WRITE_CMD : NULL);
+    }
+}
+
+static int conn_on_read(bench_thread_t *t, bench_conn_t *c)
+{
+    for (;;)
+    {
+        ssize_t n = recv(c->fd, c->rbuf + c->rlen, sizeof(c->rbuf) - c->rlen, 0);
+        if (n == 0)
+            return -1;
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        c->rlen += (size_t)n;
+
+        uint64_t ts = now_ns();
+        size_t off = 0;
+        char *nl;
+        while ((nl = memchr(c->rbuf + off, '\n', c->rlen - off)) != NULL)
+        {
+            if (c->inflight == 0)
+                return -1; // 多出来的回复：协议错乱
+
+            if (nl - (c->rbuf + off) >= 5 && memcmp(c->rbuf + off, "ERROR", 5) == 0)
+                t->errors++;
+
+            kvs_hist_add(&t->hist, ts - c->sent[c->head]);
+            c->head = (c->head + 1) % opts.pipeline;
+            c->inflight--;
+            t->done++;
+            off = (size_t)(nl - c->rbuf) + 1;
+        }
+
+        if (off == 0 && c->rlen == sizeof(c->rbuf))
+            return -1; // 单条回复超过缓冲区
+        memmove(c->rbuf, c->rbuf + off, c->rlen - off);
+        c->rlen -= off;
+    }
+    return 0;
+}
+
+static int connect_server(void)
+{
+    struct addrinfo hints, *res;
+    char port[16];
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port, sizeof(port), "%d", opts.port);
+    if (getaddrinfo(opts.host, port, &hints, &res) != 0)
+        return -1;
+
+    int fd = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        freeaddrinfo(res);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+static void *bench_thread(void *arg)
+{
+    bench_thread_t *t = (bench_thread_t *)arg;
+    struct epoll_event events[256];
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    for (int i = 0; i < t->nconns; i++)
+    {
+        bench_conn_t *c = &t->conns[i];
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+
+        conn_refill(t, c);
+        if (conn_flush(c) != 0)
+        {
+            fprintf(stderr, "thread %d: send failed\n", t->id);
+            return NULL;
+        }
+    }
+
+    int active = t->nconns;
+    while (active > 0)
+    {
+        int n = epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < n; i++)
+        {
+            bench_conn_t *c = (bench_conn_t *)events[i].data.ptr;
+            uint64_t before = t->done;
+
+            if ((events[i].events & EPOLLIN) && conn_on_read(t, c) != 0)
+            {
+                fprintf(stderr, "thread %d: connection lost\n", t->id);
+                epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                c->inflight = 0;
+                active--;
+                continue;
+            }
+            atomic_fetch_add_explicit(&g_done, t->done - before, memory_order_relaxed);
+
+            conn_refill(t, c);
+            conn_flush(c);
+
+            int want_out = c->wlen > 0;
+            if (want_out != c->want_out)
+            {
+                struct epoll_event ev = {.events = EPOLLIN | (want_out ? EPOLLOUT : 0), .data.ptr = c};
+                epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+                c->want_out = want_out;
+            }
+        }
+
+        // 停止后等在途请求全部返回
+        if (atomic_load_explicit(&g_stop, memory_order_relaxed) || opts.requests > 0)
+        {
+            int busy = 0;
+            for (int i = 0; i < t->nconns; i++)
+                busy |= t->conns[i].inflight > 0;
+            if (!busy)
+                break;
+        }
+    }
+
+    close(epfd);
+    return NULL;
+}
+
+static void preload(void)
+{
+    bench_thread_t t;
+    memset(&t, 0, sizeof(t));
+    t.rng = 0x9E3779B97F4A7C15ull;
+
+    bench_conn_t c;
+    memset(&c, 0, sizeof(c));
+    c.fd = connect_server();
+    if (c.fd < 0)
+    {
+        fprintf(stderr, "preload: connect failed\n");
+        exit(1);
+    }
+
+    int saved = opts.pipeline;
+    opts.pipeline = 256;
+    c.sent = calloc((size_t)opts.pipeline, sizeof(uint64_t));
+
+    for (long idx = 0; idx < opts.keyspace;)
+    {
+        // 一批写完再读完
+        while (c.inflight < opts.pipeline && idx < opts.keyspace)
+            append_request(&t, &c, idx++, "SET");
+
+        while (c.wlen > 0 || c.inflight > 0)
+        {
+            struct pollfd pfd = {.fd = c.fd, .events = POLLIN | (c.wlen ? POLLOUT : 0)};
+            poll(&pfd, 1, 1000);
+            if (conn_flush(&c) != 0 || ((pfd.revents & POLLIN) && conn_on_read(&t, &c) != 0))
+            {
+                fprintf(stderr, "preload: connection lost\n");
+                exit(1);
+            }
+        }
+    }
+
+    printf("preloaded %ld keys\n", opts.keyspace);
+    opts.pipeline = saved;
+    free(c.sent);
+    free(c.wbuf);
+    close(c.fd);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -h, --host HOST         server host (127.0.0.1)\n"
+            "  -p, --port PORT         server port (2000)\n"
+            "  -c, --conns N           total connections (50)\n"
+            "  -t, --threads M         client threads (4)\n"
+            "  -P, --pipeline D        requests in flight per connection (1)\n"
+            "  -T, --time SEC          run duration in seconds (10)\n"
+            "  -n, --requests N        stop after N requests instead of -T\n"
+            "  -k, --keyspace N        number of distinct keys (100000)\n"
+            "  -d, --dist uniform|zipf key distribution (uniform)\n"
+            "  -z, --theta F           zipf skew (0.99)\n"
+            "  -r, --read-ratio F      fraction of GETs, rest are UPSERTs (0.9)\n"
+            "  -K, --key-size N[-M]    key length, fixed or uniform range (16)\n"
+            "  -V, --value-size N[-M]  value length, fixed or uniform range (32)\n"
+            "  -e, --engine E          array|rbtree|hash (hash)\n"
+            "  -L, --preload           SET every key once before the run\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option longopts[] = {
+        {"host", required_argument, NULL, 'h'},
+        {"port", required_argument, NULL, 'p'},
+        {"conns", required_argument, NULL, 'c'},
+        {"threads", required_argument, NULL, 't'},
+        {"pipeline", required_argument, NULL, 'P'},
+        {"time", required_argument, NULL, 'T'},
+        {"requests", required_argument, NULL, 'n'},
+        {"keyspace", required_argument, NULL, 'k'},
+        {"dist", required_argument, NULL, 'd'},
+        {"theta", required_argument, NULL, 'z'},
+        {"read-ratio", required_argument, NULL, 'r'},
+        {"key-size", required_argument, NULL, 'K'},
+        {"value-size", required_argument, NULL, 'V'},
+        {"engine", required_argument, NULL, 'e'},
+        {"preload", no_argument, NULL, 'L'},
+        {"help", no_argument, NULL, 'H'},
+        {NULL, 0, NULL, 0}};
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "h:p:c:t:P:T:n:k:d:z:r:K:V:e:LH", longopts, NULL)) != -1)
+    {
+        switch (ch)
+        {
+        case 'h': opts.host = optarg; break;
+        case 'p': opts.port = atoi(optarg); break;
+        case 'c': opts.conns = atoi(optarg); break;
+        case 't': opts.threads = atoi(optarg); break;
+        case 'P': opts.pipeline = atoi(optarg); break;
+        case 'T': opts.duration = atoi(optarg); break;
+        case 'n': opts.requests = atol(optarg); break;
+        case 'k': opts.keyspace = atol(optarg); break;
+        case 'z': opts.theta = atof(optarg); break;
+        case 'r': opts.read_ratio = atof(optarg); break;
+        case 'L': opts.preload = 1; break;
+        case 'd':
+            if (strcmp(optarg, "zipf") == 0)
+                opts.zipf = 1;
+            else if (strcmp(optarg, "uniform") == 0)
+                opts.zipf = 0;
+            else
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'K':
+        case 'V':
+            if (parse_range(optarg, ch == 'K' ? &opts.key_size : &opts.value_size) != 0)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'e':
+            if (strcmp(optarg, "array") == 0)
+                opts.prefix = "";
+            else if (strcmp(optarg, "rbtree") == 0)
+                opts.prefix = "R";
+            else if (strcmp(optarg, "hash") == 0)
+                opts.prefix = "H";
+            else
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.conns < 1 || opts.threads < 1 || opts.pipeline < 1 || opts.keyspace < 1 ||
+        opts.key_size.max > 1000 || (opts.zipf && (opts.theta <= 0 || opts.theta >= 1)))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (opts.threads > opts.conns)
+        opts.threads = opts.conns;
+
+    value_fill = malloc((size_t)opts.value_size.max);
+    memset(value_fill, 'v', (size_t)opts.value_size.max);
+
+    if (opts.zipf)
+        zipf_init(opts.keyspace, opts.theta);
+    if (opts.preload)
+        preload();
+
+    bench_thread_t *threads = calloc((size_t)opts.threads, sizeof(bench_thread_t));
+    for (int i = 0; i < opts.threads; i++)
+    {
+        bench_thread_t *t = &threads[i];
+        t->id = i;
+        t->rng = fnv64((uint64_t)i + 1) | 1;
+        t->nconns = opts.conns / opts.threads + (i < opts.conns % opts.threads);
+        t->conns = calloc((size_t)t->nconns, sizeof(bench_conn_t));
+
+        for (int j = 0; j < t->nconns; j++)
+        {
+            bench_conn_t *c = &t->conns[j];
+            c->fd = connect_server();
+            if (c->fd < 0)
+            {
+                fprintf(stderr, "connect %s:%d failed: %s\n", opts.host, opts.port, strerror(errno));
+                return 1;
+            }
+            c->sent = calloc((size_t)opts.pipeline, sizeof(uint64_t));
+        }
+    }
+
+    printf("kvs-bench: %s:%d, %d conns, %d threads, pipeline %d, %s keys (%ld), read %.0f%%, writes %s%s\n",
+           opts.host, opts.port, opts.conns, opts.threads, opts.pipeline,
+           opts.zipf ? "zipf" : "uniform", opts.keyspace, opts.read_ratio * 100, opts.prefix, BENCH_WRITE_CMD);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < opts.threads; i++)
+        pthread_create(&threads[i].tid, NULL, bench_thread, &threads[i]);
+
+    // 每秒输出一次进度；按请求数结束时 100ms 检查一次是否已完成
+    uint64_t last = 0;
+    for (int tick = 1; opts.requests > 0 || tick <= opts.duration * 10; tick++)
+    {
+        struct timespec req = {0, 100 * 1000 * 1000};
+        nanosleep(&req, NULL);
+
+        uint64_t done = atomic_load(&g_done);
+        if (opts.requests > 0 && done >= (uint64_t)opts.requests)
+            break;
+        if (tick % 10 == 0)
+        {
+            printf("  [%3ds] %10.0f ops/sec\n", tick / 10, (double)(done - last));
+            fflush(stdout);
+            last = done;
+        }
+    }
+    atomic_store(&g_stop, 1);
+
+    static kvs_hist_t total;
+    uint64_t done = 0, errors = 0;
+    for (int i = 0; i < opts.threads; i++)
+    {
+        pthread_join(threads[i].tid, NULL);
+        done += threads[i].done;
+        errors += threads[i].errors;
+
+        total.count += threads[i].hist.count;
+        if (threads[i].hist.max > total.max)
+            total.max = threads[i].hist.max;
+        for (int b = 0; b < KVS_HIST_BUCKETS; b++)
+            total.buckets[b] += threads[i].hist.buckets[b];
+    }
+    double elapsed = (double)(now_ns() - start) / 1e9;
+
+    printf("requests:   %" PRIu64 " (%" PRIu64 " errors) in %.2f s\n", done, errors, elapsed);
+    printf("throughput: %.0f ops/sec\n", (double)done / elapsed);
+    printf("latency us: p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n",
+           kvs_hist_percentile(&total, 50.0) / 1e3, kvs_hist_percentile(&total, 99.0) / 1e3,
+           kvs_hist_percentile(&total, 99.9) / 1e3, total.max / 1e3);
+
+    return errors ? 2 : 0;
+}
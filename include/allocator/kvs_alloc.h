@@ -1,5 +1,6 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "config/kvs_config.h" 
@@ -24,19 +25,91 @@ struct mp_pool_s
 
     struct mp_node_s *current; // 当前node
     struct mp_large_s *large;  // 大块链表
+    int huge;                  // node 切自大页区域：随区域存活，不单独 free
+    size_t nodes;              // node 个数（含 head）
+    size_t nlarge;             // large 链表长度
 
     struct mp_node_s head[0];
 };
 
 struct mp_pool_s *mp_create_pool(size_t size);
+struct mp_pool_s *mp_create_huge_pool(size_t size); // node 从本线程的大页区域切分
 void mp_destory_pool(struct mp_pool_s *pool);
 void *mp_alloc(struct mp_pool_s *pool, size_t size);  // 对齐，不清零
 void *mp_nalloc(struct mp_pool_s *pool, size_t size); // 不对齐，不清零
 void *mp_calloc(struct mp_pool_s *pool, size_t size); // 对齐，清零
-void mp_free(struct mp_pool_s *pool, void *p);
+int mp_free(struct mp_pool_s *pool, void *p); // 0: 已释放 large; 1: 小块，不回收
+void mp_reset_pool(struct mp_pool_s *pool); // 归还全部大块，小块游标回到起点；node 保留复用
+
+// kvs_malloc/kvs_free 调用次数，按线程计数（无原子操作）
+typedef struct kvs_alloc_counters_s
+{
+    uint64_t malloc_calls;
+    uint64_t free_calls;
+} kvs_alloc_counters_t;
+
+#define KVS_ALLOC_CLASSES 24 // 申请大小按 2 的幂分级：<=8, <=16, ...，最后一级收纳更大的
+
+// 所有线程汇总后的内存统计
+typedef struct kvs_alloc_stats_s
+{
+    uint64_t malloc_calls;
+    uint64_t free_calls;
+
+    int64_t requested;               // 存活对象申请的字节数
+    int64_t reserved;                // 为其实际占用的字节：system/jemalloc 取 usable size，mypool 为 node + large
+    int64_t live[KVS_ALLOC_CLASSES]; // 各级存活对象个数
+
+    uint64_t pool_nodes;    // mypool node 个数
+    uint64_t pool_large;    // mypool mp_large_s 链表长度
+    int64_t pool_abandoned; // 已释放但 mp_free 无法回收的小块字节数
+
+    double fragmentation; // reserved / requested，无存活对象时为 0
+} kvs_alloc_stats_t;
+
+// 大页区域：优先 MAP_HUGETLB，失败退回普通 mmap + MADV_HUGEPAGE（THP）
+typedef enum
+{
+    KVS_HUGEPAGE_OFF = 0,
+    KVS_HUGEPAGE_HUGETLB,
+    KVS_HUGEPAGE_THP,
+} kvs_hugepage_mode_t;
 
 void kvs_set_allocator(kvs_alloc_type_t type);
+kvs_hugepage_mode_t kvs_alloc_set_hugepages(int enabled); // 须在首次分配前调用；返回实际生效的方式
+void kvs_alloc_counters(kvs_alloc_counters_t *out); // 当前线程的计数
+void kvs_alloc_stats(kvs_alloc_stats_t *out);       // 汇总所有线程
+void kvs_alloc_thread_stats(kvs_alloc_stats_t *out); // 只含当前线程（各 loop 据此决定是否整理自己的内存）
+size_t kvs_alloc_class_size(int cls);               // 第 cls 级的大小上限
+const char *kvs_alloc_name(void);                   // 当前分配器
+int kvs_alloc_is_pool(void);                        // 当前分配器是否为 mypool
+long kvs_alloc_rss(void);                           // 进程常驻内存（字节）
 
 void *kvs_malloc(size_t size);
 
-void kvs_free(void *ptr);
+// size 为申请时的大小，用于字节统计
+void kvs_free(void *ptr, size_t size);
+
+static inline void kvs_free_str(char *s)
+{
+    if (s)
+        kvs_free(s, strlen(s) + 1);
+}
+
+// 与 kvs_free_str 配对；失败返回 NULL
+static inline char *kvs_strdup(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *p = (char *)kvs_malloc(len);
+    if (p)
+        memcpy(p, s, len);
+    return p;
+}
+
+// 碎片整理（只作用于当前线程）：
+//   begin 之后新分配落到新的内存上；调用方用 kvs_alloc_move 把所有存活对象搬一遍，
+//   再 end：mypool 整个释放旧 pool，jemalloc 把空闲页还给系统
+// system malloc 按 best-fit 复用原有空洞，搬迁压不实，begin 直接 malloc_trim 并返回 1
+int kvs_alloc_defrag_begin(void); // 0: 需要搬迁; 1: 已就地处理; <0: 不支持（如大页 pool）
+void kvs_alloc_defrag_end(void);
+void *kvs_alloc_move(void *ptr, size_t size); // 新分配 + 拷贝 + 释放旧块；失败时原样返回 ptr
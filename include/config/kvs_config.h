@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 typedef enum
 {
     KVS_ALLOC_SYSTEM = 0,
@@ -22,6 +24,31 @@ typedef struct
     kvs_alloc_type_t allocator;
     kvs_net_type_t network;
 
+    int shards;     // shard-per-core：事件循环/引擎实例个数，<=1 为单 loop
+    int io_threads; // >0 时 K 个 I/O 线程读写解析，单个执行线程跑命令（shards>1 时忽略）
+
+    int latency_stats; // 是否记录命令/引擎延迟直方图（STATS 命令）
+    int hugepages;     // mypool 的 node 从大页区域切分（MAP_HUGETLB，退回 THP）
+
+    int defrag;              // 主动碎片整理
+    double defrag_threshold; // 本线程 reserved/requested 超过该值时开始一轮
+
+    int lazyfree; // DEL/MOD 掉的大 value 与 FLUSH 默认惰性释放
+
+    char replicaof_ip[64];    // 非空时作为从连接该主
+    int replicaof_port;
+    size_t repl_backlog_size; // 主的复制积压缓冲区字节数，断线重连时从这里补发
+
+    int cluster;            // 集群模式：按 slot 检查 key 归属，支持在线迁移 slot
+    int cluster_slot_lo;    // 启动时负责的 slot 区间，lo < 0 为不负责任何 slot
+    int cluster_slot_hi;
+
+    char vlog_dir[256];    // 非空时大 value 写入该目录下的 value log，引擎只保存位置
+    size_t vlog_threshold; // 不小于该字节数的 value 才写入 value log
+
+    size_t compress_threshold; // 不小于该字节数的 value 压缩保存，0 为不压缩
+
 } kvs_config_t;
 
-int kvs_config_load_file(kvs_config_t *cfg, const char *path);
\ No newline at end of file
+void kvs_config_default(kvs_config_t *cfg);
+int kvs_config_load_file(kvs_config_t *cfg, const char *path);
@@ -5,13 +5,14 @@
 #include <string.h>
 
 #include "allocator/kvs_alloc.h"
+#include "engine/kvs_value.h"
 
 #define KVS_ARRAY_SIZE 1024
 
 typedef struct kvs_array_item_s
 {
     char *key;
-    char *value;
+    kvs_value_t value; // 短值、整数内嵌；单独分配的值 MOD 放得下时原地覆盖
 } kvs_array_item_t;
 
 typedef struct kvs_array_s
@@ -31,3 +32,34 @@ char *kvs_array_get(kvs_array_t *inst, char *key);
 int kvs_array_del(kvs_array_t *inst, char *key);
 int kvs_array_mod(kvs_array_t *inst, char *key, char *value);
 int kvs_array_exist(kvs_array_t *inst, char *key);
+
+// 一次定位完成的写入（set 本身即 set-if-absent）：
+//   upsert 不存在则插入、存在则覆盖；getset 同 upsert，旧值整体移到 *old 交给调用方
+//   （不存在时为 KVS_ENC_NONE），用完以 kvs_value_lazyfree 释放；cas 仅当当前值等于 expect 时替换
+//   mod/upsert/cas 的新值放得下时原地覆盖，不调用分配器
+//   incr 把值当作 int64 加上 delta（不存在时以 delta 插入），结果经 *result 返回
+// @return: <0, error. upsert/getset =0, 新插入; =1, 已覆盖. cas =0, 已替换; =1, 不存在; =2, 值不等
+//          incr =0, success; =1, 值不是整数; =2, 溢出
+int kvs_array_upsert(kvs_array_t *inst, char *key, char *value);
+int kvs_array_getset(kvs_array_t *inst, char *key, char *value, kvs_value_t *old);
+int kvs_array_cas(kvs_array_t *inst, char *key, char *expect, char *value);
+int kvs_array_incr(kvs_array_t *inst, char *key, int64_t delta, int64_t *result);
+
+// 碎片整理：从槽位 *cursor 开始搬迁 key/value，最多 budget 个
+// @return: 1, 未完成; 0, 本轮完成（cursor 归零）
+int kvs_array_defrag(kvs_array_t *inst, int *cursor, int budget);
+
+// 按槽位顺序访问每个条目（value 原样交给 fn）；不分配内存，期间不能增删条目
+void kvs_array_foreach(kvs_array_t *inst, kvs_value_fn fn, void *arg);
+
+// 增量遍历：从槽位 *cursor 开始访问至多 budget 个槽位，fn 可以原地替换 value；两次调用之间可以修改数组
+// @return: 1, 未完成; 0, 已遍历完（cursor 归零）
+int kvs_array_values(kvs_array_t *inst, int *cursor, int budget, kvs_value_fn fn, void *arg);
+
+// 惰性释放：detach 把 table O(1) 移到 out 并换上空表；release 从尾部释放已摘下的 out，最多 budget 个
+// @return: detach <0, error; =0, success. release 1, 未完成; 0, 已全部释放
+int kvs_array_detach(kvs_array_t *inst, kvs_array_t *out);
+int kvs_array_release(kvs_array_t *inst, int budget);
+
+// 单实例（单 loop 模式下使用）
+extern kvs_array_t global_array;
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "engine/kvs_array.h"
+#include "engine/kvs_rbtree.h"
+#include "engine/kvs_hash.h"
+
+// 主动碎片整理：由持有引擎的线程分多次推进，每次只搬迁有限个条目
+// 一轮 = kvs_alloc_defrag_begin -> 依次搬迁 array/rbtree/hash -> kvs_alloc_defrag_end
+typedef struct kvs_defrag_s
+{
+    int active;
+    int phase;       // 当前处理的引擎：0 array, 1 rbtree, 2 hash
+    int cursor;      // array 槽位 / hash 桶
+    char *rb_cursor; // rbtree 上次处理到的 key
+    uint64_t passes; // 已完成的轮数
+    int64_t floor;   // 上一轮结束时的浪费字节：整理不掉的部分不反复触发
+} kvs_defrag_t;
+
+// 碎片率超过 threshold，且浪费比上一轮结束时多出 min_waste 字节
+// mypool 看当前线程的 reserved/requested，system/jemalloc 看进程 RSS/requested
+int kvs_defrag_needed(kvs_defrag_t *d, double threshold, int64_t min_waste);
+
+int kvs_defrag_start(kvs_defrag_t *d); // 0: 已开始; 1: 分配器已就地处理完; <0: 不支持
+
+// 推进一步，约搬迁 budget 个条目
+// @return: 1, 本轮未完成; 0, 本轮完成或未开始
+int kvs_defrag_step(kvs_defrag_t *d, kvs_array_t *array, kvs_rbtree_t *rbtree, kvs_hash_t *hash, int budget);
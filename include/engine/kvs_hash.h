@@ -1,29 +1,42 @@
 #pragma once
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "allocator/kvs_alloc.h"
+#include "engine/kvs_value.h"
 
-#define MAX_TABLE_SIZE 1024
+#define MAX_TABLE_SIZE 1024           // 初始桶数，也是缩表的下限
+#define KVS_HASH_MAX_SLOTS (1 << 30) // 桶数上限；桶数始终是 2 的幂
+#define KVS_HASH_BATCH 16            // 批量操作每组预取的 key 数
+#define KVS_HASH_COMPACT_COUNT 128   // 紧凑编码最多容纳的条目数
+#define KVS_HASH_COMPACT_LEN 64      // 紧凑编码里 key / value 的最大长度
 
 typedef struct hashnode_s
 {
     char *key;
-    char *value;
+    kvs_value_t value; // 短值、整数内嵌；单独分配的值 MOD 放得下时原地覆盖
     struct hashnode_s *next;
 
 } hashnode_t;
 
+// 条目少时用紧凑编码（nodes 为 NULL）：全部条目依次排在一块连续内存里，[klen][key\0][vlen][value\0]，
+// 长度各占 1 字节，按 kvs_array 的方式线性查找；条目数或 key / value 长度超过上限时整体转为哈希表，
+// 之后不再转回。刚创建的表不分配内存，空表也不占内存
 typedef struct hashtable_s
 {
 
     hashnode_t **nodes; //* change **,
 
-    int max_slots;
+    int max_slots; // 桶数：count 超过它时翻倍，低于 1/8 时减半
     int count;
 
+    char *lp;        // 紧凑编码的缓冲区
+    uint32_t lp_len; // 已用字节数
+    uint32_t lp_cap;
+
 } hashtable_t;
 
 typedef struct hashtable_s kvs_hash_t;
@@ -33,8 +46,53 @@ int kvs_hash_count(kvs_hash_t *hash);
 int kvs_hash_create(kvs_hash_t *hash);
 void kvs_hash_destory(kvs_hash_t *hash);
 
+// 把紧凑编码转为哈希表（已是哈希表时什么都不做）；写入超出紧凑编码的上限时自动调用
+// @return: <0, error（内容不变）; =0, success
+int kvs_hash_convert(kvs_hash_t *hash);
+
 int kvs_hash_set(hashtable_t *hash, char *key, char *value);
 char *kvs_hash_get(kvs_hash_t *hash, char *key);
 int kvs_hash_mod(kvs_hash_t *hash, char *key, char *value);
 int kvs_hash_del(kvs_hash_t *hash, char *key);
-int kvs_hash_exist(kvs_hash_t *hash, char *key);
\ No newline at end of file
+int kvs_hash_exist(kvs_hash_t *hash, char *key);
+
+// 一次定位完成的写入（set 本身即 set-if-absent）：
+//   upsert 不存在则插入、存在则覆盖；getset 同 upsert，旧值整体移到 *old 交给调用方
+//   （不存在时为 KVS_ENC_NONE），用完以 kvs_value_lazyfree 释放；cas 仅当当前值等于 expect 时替换
+//   mod/upsert/cas 的新值放得下时原地覆盖，不调用分配器
+//   incr 把值当作 int64 加上 delta（不存在时以 delta 插入），结果经 *result 返回
+// @return: <0, error. upsert/getset =0, 新插入; =1, 已覆盖. cas =0, 已替换; =1, 不存在; =2, 值不等
+//          incr =0, success; =1, 值不是整数; =2, 溢出
+int kvs_hash_upsert(kvs_hash_t *hash, char *key, char *value);
+int kvs_hash_getset(kvs_hash_t *hash, char *key, char *value, kvs_value_t *old);
+int kvs_hash_cas(kvs_hash_t *hash, char *key, char *expect, char *value);
+int kvs_hash_incr(kvs_hash_t *hash, char *key, int64_t delta, int64_t *result);
+
+// 批量接口：values[i] / results[i] 与逐个调用 get / set 的结果相同（values 指向表内，不拷贝）
+// @return: <0, error; 否则 mget 返回找到的个数，mset 返回新写入的个数
+int kvs_hash_mget(kvs_hash_t *hash, char **keys, int n, char **values);
+int kvs_hash_mset(kvs_hash_t *hash, char **keys, char **values, int n, int *results);
+
+// 碎片整理：从游标 *cursor（与 SCAN 相同的反向二进制顺序）开始用 kvs_alloc_move 搬迁节点及 key/value，
+// 约 budget 个节点后返回
+// @return: 1, 未完成（cursor 已更新）; 0, 本轮完成（cursor 归零）
+int kvs_hash_defrag(kvs_hash_t *hash, int *cursor, int budget);
+
+// 增量遍历：访问游标所在的一个桶，对其中每个节点调用 fn，返回下一个游标（0 表示遍历结束）
+// 游标按反向二进制递增，两次调用之间表扩缩也不会漏掉一直存在的 key（可能重复）
+// 紧凑编码时一次访问全部条目并返回 0；value 读不出来时为 NULL
+typedef void (*kvs_hash_scan_fn)(void *arg, const char *key, const char *value);
+unsigned long kvs_hash_scan(kvs_hash_t *hash, unsigned long cursor, kvs_hash_scan_fn fn, void *arg);
+
+// 同 kvs_hash_scan，但把 value 本身交给 fn，可以原地替换（快照、迁移、value log 回收用）
+// 紧凑编码的条目都是原样的字符串，以只读的 KVS_ENC_RAW 视图交给 fn
+unsigned long kvs_hash_values(kvs_hash_t *hash, unsigned long cursor, kvs_value_fn fn, void *arg);
+
+// 惰性释放：detach 把全部内容 O(1) 移到 out，hash 变为空表；
+// release 从桶 *cursor（初始为 0）开始逐个释放已摘下的 out，约 budget 个节点后返回
+// @return: detach <0, error; =0, success. release 1, 未完成; 0, 已全部释放
+int kvs_hash_detach(kvs_hash_t *hash, kvs_hash_t *out);
+int kvs_hash_release(kvs_hash_t *hash, int *cursor, int budget);
+
+// 单实例（单 loop 模式下使用）
+extern kvs_hash_t global_hash;
@@ -0,0 +1,507 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "allocator/kvs_alloc.h"
+#include "engine/kvs_value.h"
+
+// 定宽整数 key 的引擎模板：字符串引擎（kvs_hash / kvs_rbtree）不变，整数 key 另由宏按 key 类型生成
+//   KVS_INTHASH_DECLARE / DEFINE(name, key_t)：开放寻址哈希表，条目 {key, value} 直接排在槽位数组里，
+//     乘法散列取高位定位，线性探测；删除时后移填补空位，不留墓碑
+//   KVS_INTTREE_DECLARE / DEFINE(name, key_t)：红黑树，key 内嵌在节点里按整数比较；
+//     平衡调整与 key 无关，只实现一次（kvs_itree_*），颜色放在父指针的最低位
+// key 不再单独分配，比较是一次整数比较；value 与字符串引擎相同（kvs_value_t），返回值语义也相同
+// DECLARE 放在头文件里，DEFINE 在一个 .c 里展开一次；本文件末尾实例化了 uint64_t 的两种引擎
+
+#define KVS_INTHASH_MIN_BITS 6 // 最少 64 个槽位，缩表不低于它
+
+// 乘法散列（Fibonacci hashing）：乘黄金分割常数后取高 bits 位
+static inline uint32_t kvs_int_hash(uint64_t key, uint32_t bits)
+{
+    return (uint32_t)((key * 0x9e3779b97f4a7c15ull) >> (64 - bits));
+}
+
+// ---------- 红黑树的公共部分（src/engine/kvs_intkey.c） ----------
+
+typedef struct kvs_itree_link_s
+{
+    uintptr_t parent_color; // 父节点地址 | 颜色（0 红，1 黑）
+    struct kvs_itree_link_s *left;
+    struct kvs_itree_link_s *right;
+} kvs_itree_link_t;
+
+static inline kvs_itree_link_t *kvs_itree_parent(const kvs_itree_link_t *n)
+{
+    return (kvs_itree_link_t *)(n->parent_color & ~(uintptr_t)1);
+}
+
+// 新节点挂到 parent 的 *link 上（红色），再恢复平衡
+void kvs_itree_insert(kvs_itree_link_t **root, kvs_itree_link_t *parent, kvs_itree_link_t **link, kvs_itree_link_t *node);
+void kvs_itree_erase(kvs_itree_link_t **root, kvs_itree_link_t *node);
+kvs_itree_link_t *kvs_itree_first(kvs_itree_link_t *root);
+kvs_itree_link_t *kvs_itree_next(kvs_itree_link_t *node);
+
+// ---------- 哈希表模板 ----------
+
+// create 不分配，第一次写入时才建表
+// @return: 同 kvs_hash：set =0, success; =1, 已存在. mod/del =1, 不存在. exist =0, 存在; =1, 不存在
+//          upsert =0, 新插入; =1, 已覆盖. incr =0, success; =1, 值不是整数; =2, 溢出. <0, error
+#define KVS_INTHASH_DECLARE(name, key_t)                                                  \
+    typedef struct name##_entry_s                                                         \
+    {                                                                                     \
+        key_t key;                                                                        \
+        kvs_value_t value; /* KVS_ENC_NONE 为空槽位 */                                    \
+    } name##_entry_t;                                                                     \
+                                                                                          \
+    typedef struct name##_s                                                               \
+    {                                                                                     \
+        name##_entry_t *slots;                                                            \
+        uint32_t bits; /* 槽位数 = 1 << bits，0 表示还没建表 */                           \
+        int count;                                                                        \
+    } name##_t;                                                                           \
+                                                                                          \
+    typedef void (*name##_fn)(void *arg, key_t key, kvs_value_t *v);                      \
+                                                                                          \
+    int name##_create(name##_t *h);                                                       \
+    void name##_destory(name##_t *h);                                                     \
+    int name##_set(name##_t *h, key_t key, const char *value);                            \
+    char *name##_get(name##_t *h, key_t key);                                             \
+    int name##_mod(name##_t *h, key_t key, const char *value);                            \
+    int name##_del(name##_t *h, key_t key);                                               \
+    int name##_exist(name##_t *h, key_t key);                                             \
+    int name##_upsert(name##_t *h, key_t key, const char *value);                         \
+    int name##_incr(name##_t *h, key_t key, int64_t delta, int64_t *result);              \
+    int name##_count(name##_t *h);                                                        \
+    void name##_foreach(name##_t *h, name##_fn fn, void *arg); /* 槽位顺序，不能增删 */
+
+#define KVS_INTHASH_DEFINE(name, key_t)                                                   \
+    static inline int name##_empty(const name##_entry_t *e)                               \
+    {                                                                                     \
+        return e->value.in.enc == KVS_ENC_NONE;                                           \
+    }                                                                                     \
+                                                                                          \
+    static name##_entry_t *name##_find(name##_t *h, key_t key)                            \
+    {                                                                                     \
+        if (!h->slots)                                                                    \
+            return NULL;                                                                  \
+        uint32_t mask = (1u << h->bits) - 1;                                              \
+        for (uint32_t i = kvs_int_hash((uint64_t)key, h->bits);; i = (i + 1) & mask)      \
+        {                                                                                 \
+            name##_entry_t *e = &h->slots[i];                                             \
+            if (name##_empty(e))                                                          \
+                return NULL;                                                              \
+            if (e->key == key)                                                            \
+                return e;                                                                 \
+        }                                                                                 \
+    }                                                                                     \
+                                                                                          \
+    /* 整表重建为 1 << bits 个槽位，条目按值搬过去，value 不重新分配 */                   \
+    static int name##_resize(name##_t *h, uint32_t bits)                                  \
+    {                                                                                     \
+        size_t size = sizeof(name##_entry_t) << bits;                                     \
+        name##_entry_t *slots = (name##_entry_t *)kvs_malloc(size);                       \
+        if (!slots)                                                                       \
+            return -2;                                                                    \
+        memset(slots, 0, size);                                                           \
+        uint32_t mask = (1u << bits) - 1;                                                 \
+        for (uint32_t j = 0; h->slots && j < (1u << h->bits); j++)                        \
+        {                                                                                 \
+            name##_entry_t *e = &h->slots[j];                                             \
+            if (name##_empty(e))                                                          \
+                continue;                                                                 \
+            uint32_t i = kvs_int_hash((uint64_t)e->key, bits);                            \
+            while (!name##_empty(&slots[i]))                                              \
+                i = (i + 1) & mask;                                                       \
+            slots[i] = *e;                                                                \
+        }                                                                                 \
+        if (h->slots)                                                                     \
+            kvs_free(h->slots, sizeof(name##_entry_t) << h->bits);                        \
+        h->slots = slots;                                                                 \
+        h->bits = bits;                                                                   \
+        return 0;                                                                         \
+    }                                                                                     \
+                                                                                          \
+    /* 插入已确认不存在的 key；负载因子超过 3/4 时先翻倍，保证总有空槽位结束探测 */       \
+    static int name##_add(name##_t *h, key_t key, const char *value)                      \
+    {                                                                                     \
+        if (!h->slots || (uint64_t)(h->count + 1) * 4 > (uint64_t)3 << h->bits)           \
+        {                                                                                 \
+            if (h->bits >= 30 && h->slots)                                                \
+                return -2;                                                                \
+            if (name##_resize(h, h->slots ? h->bits + 1 : KVS_INTHASH_MIN_BITS) != 0)     \
+                return -2;                                                                \
+        }                                                                                 \
+        uint32_t mask = (1u << h->bits) - 1;                                              \
+        uint32_t i = kvs_int_hash((uint64_t)key, h->bits);                                \
+        while (!name##_empty(&h->slots[i]))                                               \
+            i = (i + 1) & mask;                                                           \
+        if (kvs_value_init(&h->slots[i].value, value) != 0)                               \
+            return -2;                                                                    \
+        h->slots[i].key = key;                                                            \
+        h->count++;                                                                       \
+        return 0;                                                                         \
+    }                                                                                     \
+                                                                                          \
+    int name##_create(name##_t *h)                                                        \
+    {                                                                                     \
+        if (!h || h->slots)                                                               \
+            return -1;                                                                    \
+        h->bits = 0;                                                                      \
+        h->count = 0;                                                                     \
+        return 0;                                                                         \
+    }                                                                                     \
+                                                                                          \
+    void name##_destory(name##_t *h)                                                      \
+    {                                                                                     \
+        if (!h || !h->slots)                                                              \
+            return;                                                                       \
+        for (uint32_t i = 0; i < (1u << h->bits); i++)                                    \
+            if (!name##_empty(&h->slots[i]))                                              \
+                kvs_value_free(&h->slots[i].value);                                       \
+        kvs_free(h->slots, sizeof(name##_entry_t) << h->bits);                            \
+        h->slots = NULL;                                                                  \
+        h->bits = 0;                                                                      \
+        h->count = 0;                                                                     \
+    }                                                                                     \
+                                                                                          \
+    int name##_set(name##_t *h, key_t key, const char *value)                             \
+    {                                                                                     \
+        if (!h || !value)                                                                 \
+            return -1;                                                                    \
+        if (name##_find(h, key))                                                          \
+            return 1;                                                                     \
+        return name##_add(h, key, value);                                                 \
+    }                                                                                     \
+                                                                                          \
+    char *name##_get(name##_t *h, key_t key)                                              \
+    {                                                                                     \
+        name##_entry_t *e = h ? name##_find(h, key) : NULL;                               \
+        return e ? kvs_value_str(&e->value) : NULL;                                       \
+    }                                                                                     \
+                                                                                          \
+    int name##_mod(name##_t *h, key_t key, const char *value)                             \
+    {                                                                                     \
+        if (!h || !value)                                                                 \
+            return -1;                                                                    \
+        name##_entry_t *e = name##_find(h, key);                                          \
+        if (!e)                                                                           \
+            return 1;                                                                     \
+        return kvs_value_assign(&e->value, value);                                        \
+    }                                                                                     \
+                                                                                          \
+    int name##_del(name##_t *h, key_t key)                                                \
+    {                                                                                     \
+        if (!h)                                                                           \
+            return -1;                                                                    \
+        name##_entry_t *e = name##_find(h, key);                                          \
+        if (!e)                                                                           \
+            return 1;                                                                     \
+        kvs_value_lazyfree(&e->value);                                                    \
+        h->count--;                                                                       \
+                                                                                          \
+        /* 后移填补：空位之后同一探测链上的条目，若本该落在空位或更前面，就挪进空位 */    \
+        uint32_t mask = (1u << h->bits) - 1;                                              \
+        uint32_t hole = (uint32_t)(e - h->slots);                                         \
+        for (uint32_t j = (hole + 1) & mask; !name##_empty(&h->slots[j]); j = (j + 1) & mask) \
+        {                                                                                 \
+            uint32_t home = kvs_int_hash((uint64_t)h->slots[j].key, h->bits);             \
+            if (((j - home) & mask) >= ((j - hole) & mask))                               \
+            {                                                                             \
+                h->slots[hole] = h->slots[j];                                             \
+                h->slots[j].value.in.enc = KVS_ENC_NONE;                                  \
+                hole = j;                                                                 \
+            }                                                                             \
+        }                                                                                 \
+                                                                                          \
+        /* 负载因子低于 1/8 时减半；失败不影响删除 */                                      \
+        if (h->bits > KVS_INTHASH_MIN_BITS && (uint64_t)h->count * 8 < (uint64_t)1 << h->bits) \
+            name##_resize(h, h->bits - 1);                                                \
+        return 0;                                                                         \
+    }                                                                                     \
+                                                                                          \
+    int name##_exist(name##_t *h, key_t key)                                              \
+    {                                                                                     \
+        if (!h)                                                                           \
+            return -1;                                                                    \
+        return name##_find(h, key) ? 0 : 1;                                               \
+    }                                                                                     \
+                                                                                          \
+    int name##_upsert(name##_t *h, key_t key, const char *value)                          \
+    {                                                                                     \
+        if (!h || !value)                                                                 \
+            return -1;                                                                    \
+        name##_entry_t *e = name##_find(h, key);                                          \
+        if (!e)                                                                           \
+            return name##_add(h, key, value);                                             \
+        return kvs_value_assign(&e->value, value) < 0 ? -2 : 1;                           \
+    }                                                                                     \
+                                                                                          \
+    int name##_incr(name##_t *h, key_t key, int64_t delta, int64_t *result)               \
+    {                                                                                     \
+        if (!h)                                                                           \
+            return -1;                                                                    \
+        name##_entry_t *e = name##_find(h, key);                                          \
+        if (e)                                                                            \
+            return kvs_value_incr(&e->value, delta, result);                              \
+        char buf[21];                                                                     \
+        kvs_value_format_int(delta, buf);                                                 \
+        int ret = name##_add(h, key, buf);                                                \
+        if (ret == 0 && result)                                                           \
+            *result = delta;                                                              \
+        return ret;                                                                       \
+    }                                                                                     \
+                                                                                          \
+    int name##_count(name##_t *h)                                                         \
+    {                                                                                     \
+        return h ? h->count : 0;                                                          \
+    }                                                                                     \
+                                                                                          \
+    void name##_foreach(name##_t *h, name##_fn fn, void *arg)                             \
+    {                                                                                     \
+        if (!h || !h->slots || !fn)                                                       \
+            return;                                                                       \
+        for (uint32_t i = 0; i < (1u << h->bits); i++)                                    \
+            if (!name##_empty(&h->slots[i]))                                              \
+                fn(arg, h->slots[i].key, &h->slots[i].value);                             \
+    }
+
+// ---------- 红黑树模板 ----------
+
+// 返回值同哈希表模板；foreach / range 按 key 升序，range 访问 [lo, hi]，期间不能增删节点
+#define KVS_INTTREE_DECLARE(name, key_t)                                                  \
+    typedef struct name##_node_s                                                          \
+    {                                                                                     \
+        kvs_itree_link_t link; /* 必须在最前面，与节点互相转换 */                         \
+        key_t key;                                                                        \
+        kvs_value_t value;                                                                \
+    } name##_node_t;                                                                      \
+                                                                                          \
+    typedef struct name##_s                                                               \
+    {                                                                                     \
+        kvs_itree_link_t *root;                                                           \
+        int count;                                                                        \
+    } name##_t;                                                                           \
+                                                                                          \
+    typedef void (*name##_fn)(void *arg, key_t key, kvs_value_t *v);                      \
+                                                                                          \
+    int name##_create(name##_t *t);                                                       \
+    void name##_destory(name##_t *t);                                                     \
+    int name##_set(name##_t *t, key_t key, const char *value);                            \
+    char *name##_get(name##_t *t, key_t key);                                             \
+    int name##_mod(name##_t *t, key_t key, const char *value);                            \
+    int name##_del(name##_t *t, key_t key);                                               \
+    int name##_exist(name##_t *t, key_t key);                                             \
+    int name##_upsert(name##_t *t, key_t key, const char *value);                         \
+    int name##_incr(name##_t *t, key_t key, int64_t delta, int64_t *result);              \
+    int name##_count(name##_t *t);                                                        \
+    void name##_foreach(name##_t *t, name##_fn fn, void *arg);                            \
+    void name##_range(name##_t *t, key_t lo, key_t hi, name##_fn fn, void *arg);
+
+#define KVS_INTTREE_DEFINE(name, key_t)                                                   \
+    static name##_node_t *name##_find(name##_t *t, key_t key)                             \
+    {                                                                                     \
+        kvs_itree_link_t *n = t->root;                                                    \
+        while (n)                                                                         \
+        {                                                                                 \
+            name##_node_t *node = (name##_node_t *)n;                                     \
+            if (key < node->key)                                                          \
+                n = n->left;                                                              \
+            else if (key > node->key)                                                     \
+                n = n->right;                                                             \
+            else                                                                          \
+                return node;                                                              \
+        }                                                                                 \
+        return NULL;                                                                      \
+    }                                                                                     \
+                                                                                          \
+    /* 一次下降：找到返回节点；找不到时经 *parent / *link 带回插入位置 */                 \
+    static name##_node_t *name##_locate(name##_t *t, key_t key, kvs_itree_link_t **parent, \
+                                        kvs_itree_link_t ***link)                         \
+    {                                                                                     \
+        *parent = NULL;                                                                   \
+        *link = &t->root;                                                                 \
+        while (**link)                                                                    \
+        {                                                                                 \
+            name##_node_t *node = (name##_node_t *)**link;                                \
+            *parent = **link;                                                             \
+            if (key < node->key)                                                          \
+                *link = &(**link)->left;                                                  \
+            else if (key > node->key)                                                     \
+                *link = &(**link)->right;                                                 \
+            else                                                                          \
+                return node;                                                              \
+        }                                                                                 \
+        return NULL;                                                                      \
+    }                                                                                     \
+                                                                                          \
+    static int name##_add(name##_t *t, key_t key, const char *value, kvs_itree_link_t *parent, \
+                          kvs_itree_link_t **link)                                        \
+    {                                                                                     \
+        name##_node_t *node = (name##_node_t *)kvs_malloc(sizeof(name##_node_t));         \
+        if (!node)                                                                        \
+            return -2;                                                                    \
+        node->key = key;                                                                  \
+        node->value.in.enc = KVS_ENC_NONE;                                                \
+        if (kvs_value_init(&node->value, value) != 0)                                     \
+        {                                                                                 \
+            kvs_free(node, sizeof(name##_node_t));                                        \
+            return -2;                                                                    \
+        }                                                                                 \
+        kvs_itree_insert(&t->root, parent, link, &node->link);                            \
+        t->count++;                                                                       \
+        return 0;                                                                         \
+    }                                                                                     \
+                                                                                          \
+    int name##_create(name##_t *t)                                                        \
+    {                                                                                     \
+        if (!t || t->root)                                                                \
+            return -1;                                                                    \
+        t->count = 0;                                                                     \
+        return 0;                                                                         \
+    }                                                                                     \
+                                                                                          \
+    /* 自底向上拆树：不需要栈，也不维护平衡 */                                            \
+    void name##_destory(name##_t *t)                                                      \
+    {                                                                                     \
+        if (!t)                                                                           \
+            return;                                                                       \
+        kvs_itree_link_t *n = t->root;                                                    \
+        while (n)                                                                         \
+        {                                                                                 \
+            if (n->left)                                                                  \
+            {                                                                             \
+                n = n->left;                                                              \
+                continue;                                                                 \
+            }                                                                             \
+            if (n->right)                                                                 \
+            {                                                                             \
+                n = n->right;                                                             \
+                continue;                                                                 \
+            }                                                                             \
+            kvs_itree_link_t *p = kvs_itree_parent(n);                                    \
+            if (p)                                                                        \
+            {                                                                             \
+                if (p->left == n)                                                         \
+                    p->left = NULL;                                                       \
+                else                                                                      \
+                    p->right = NULL;                                                      \
+            }                                                                             \
+            kvs_value_free(&((name##_node_t *)n)->value);                                 \
+            kvs_free(n, sizeof(name##_node_t));                                           \
+            n = p;                                                                        \
+        }                                                                                 \
+        t->root = NULL;                                                                   \
+        t->count = 0;                                                                     \
+    }                                                                                     \
+                                                                                          \
+    int name##_set(name##_t *t, key_t key, const char *value)                             \
+    {                                                                                     \
+        if (!t || !value)                                                                 \
+            return -1;                                                                    \
+        kvs_itree_link_t *parent, **link;                                                 \
+        if (name##_locate(t, key, &parent, &link))                                        \
+            return 1;                                                                     \
+        return name##_add(t, key, value, parent, link);                                   \
+    }                                                                                     \
+                                                                                          \
+    char *name##_get(name##_t *t, key_t key)                                              \
+    {                                                                                     \
+        name##_node_t *node = t ? name##_find(t, key) : NULL;                             \
+        return node ? kvs_value_str(&node->value) : NULL;                                 \
+    }                                                                                     \
+                                                                                          \
+    int name##_mod(name##_t *t, key_t key, const char *value)                             \
+    {                                                                                     \
+        if (!t || !value)                                                                 \
+            return -1;                                                                    \
+        name##_node_t *node = name##_find(t, key);                                        \
+        if (!node)                                                                        \
+            return 1;                                                                     \
+        return kvs_value_assign(&node->value, value);                                     \
+    }                                                                                     \
+                                                                                          \
+    int name##_del(name##_t *t, key_t key)                                                \
+    {                                                                                     \
+        if (!t)                                                                           \
+            return -1;                                                                    \
+        name##_node_t *node = name##_find(t, key);                                        \
+        if (!node)                                                                        \
+            return 1;                                                                     \
+        kvs_itree_erase(&t->root, &node->link);                                           \
+        kvs_value_lazyfree(&node->value);                                                 \
+        kvs_free(node, sizeof(name##_node_t));                                            \
+        t->count--;                                                                       \
+        return 0;                                                                         \
+    }                                                                                     \
+                                                                                          \
+    int name##_exist(name##_t *t, key_t key)                                              \
+    {                                                                                     \
+        if (!t)                                                                           \
+            return -1;                                                                    \
+        return name##_find(t, key) ? 0 : 1;                                               \
+    }                                                                                     \
+                                                                                          \
+    int name##_upsert(name##_t *t, key_t key, const char *value)                          \
+    {                                                                                     \
+        if (!t || !value)                                                                 \
+            return -1;                                                                    \
+        kvs_itree_link_t *parent, **link;                                                 \
+        name##_node_t *node = name##_locate(t, key, &parent, &link);                      \
+        if (!node)                                                                        \
+            return name##_add(t, key, value, parent, link);                               \
+        return kvs_value_assign(&node->value, value) < 0 ? -2 : 1;                        \
+    }                                                                                     \
+                                                                                          \
+    int name##_incr(name##_t *t, key_t key, int64_t delta, int64_t *result)               \
+    {                                                                                     \
+        if (!t)                                                                           \
+            return -1;                                                                    \
+        kvs_itree_link_t *parent, **link;                                                 \
+        name##_node_t *node = name##_locate(t, key, &parent, &link);                      \
+        if (node)                                                                         \
+            return kvs_value_incr(&node->value, delta, result);                           \
+        char buf[21];                                                                     \
+        kvs_value_format_int(delta, buf);                                                 \
+        int ret = name##_add(t, key, buf, parent, link);                                  \
+        if (ret == 0 && result)                                                           \
+            *result = delta;                                                              \
+        return ret;                                                                       \
+    }                                                                                     \
+                                                                                          \
+    int name##_count(name##_t *t)                                                         \
+    {                                                                                     \
+        return t ? t->count : 0;                                                          \
+    }                                                                                     \
+                                                                                          \
+    void name##_foreach(name##_t *t, name##_fn fn, void *arg)                             \
+    {                                                                                     \
+        if (!t || !fn)                                                                    \
+            return;                                                                       \
+        for (kvs_itree_link_t *n = kvs_itree_first(t->root); n; n = kvs_itree_next(n))    \
+            fn(arg, ((name##_node_t *)n)->key, &((name##_node_t *)n)->value);             \
+    }                                                                                     \
+                                                                                          \
+    void name##_range(name##_t *t, key_t lo, key_t hi, name##_fn fn, void *arg)           \
+    {                                                                                     \
+        if (!t || !fn)                                                                    \
+            return;                                                                       \
+        /* 第一个不小于 lo 的节点 */                                                      \
+        kvs_itree_link_t *n = t->root, *start = NULL;                                     \
+        while (n)                                                                         \
+        {                                                                                 \
+            if (((name##_node_t *)n)->key < lo)                                           \
+                n = n->right;                                                             \
+            else                                                                          \
+            {                                                                             \
+                start = n;                                                                \
+                n = n->left;                                                              \
+            }                                                                             \
+        }                                                                                 \
+        for (n = start; n && ((name##_node_t *)n)->key <= hi; n = kvs_itree_next(n))      \
+            fn(arg, ((name##_node_t *)n)->key, &((name##_node_t *)n)->value);             \
+    }
+
+// uint64_t key 的实例
+KVS_INTHASH_DECLARE(kvs_u64hash, uint64_t)
+KVS_INTTREE_DECLARE(kvs_u64tree, uint64_t)
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "engine/kvs_array.h"
+#include "engine/kvs_rbtree.h"
+#include "engine/kvs_hash.h"
+
+#define KVS_LAZYFREE_MIN_VALUE (64 * 1024) // 不小于该字节数的 value 被 DEL/MOD 掉时才延后释放
+#define KVS_LAZYFREE_BATCH 1024            // 后台线程每次 release 的条目数
+
+// 惰性释放：把整个引擎或大 value 在 O(1) 内摘下，立即返回，之后再慢慢 kvs_free
+//   system/jemalloc 可跨线程释放：交给后台线程
+//   mypool 的 pool 是线程私有的：挂在本线程队列上，由事件循环每轮 kvs_lazyfree_step 分批释放
+
+void kvs_lazyfree_enable(int on); // 是否对 DEL/MOD 掉的大 value 惰性释放，也是 FLUSH 的默认方式
+int kvs_lazyfree_enabled(void);
+
+// 摘下引擎全部内容交给惰性释放，引擎立即变为空；无法摘下时退回同步清空
+// @return: <0, error; =0, success
+int kvs_lazyfree_array(kvs_array_t *inst);
+int kvs_lazyfree_rbtree(kvs_rbtree_t *inst);
+int kvs_lazyfree_hash(kvs_hash_t *hash);
+
+// 引擎丢弃 value 时调用：开启惰性释放且 value 足够大时延后释放，否则立即 kvs_free
+// size 为 value 的容量（分配时的字节数）
+void kvs_lazyfree_value(char *value, size_t size);
+
+// 推进本线程队列的队首任务约 budget 个条目；budget 为 0 时只查询
+// @return: 1, 本线程还有未释放的任务; 0, 队列已空
+int kvs_lazyfree_step(int budget);
+int64_t kvs_lazyfree_pending(void); // 所有线程尚未释放完的任务数
+void kvs_lazyfree_wait(void);       // 同步释放本线程队列，并等后台线程清空
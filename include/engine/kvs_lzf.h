@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+
+// 内置的 LZF 格式压缩（LZ77 一族，无熵编码）：控制字节 < 32 为其后 n+1 字节原样输出，
+// 否则高 3 位为匹配长度 - 2（7 表示再读一个字节累加），低 5 位与下一字节为回溯距离 - 1（不超过 8KB）
+// 两个函数都不分配内存
+
+// @return: 压缩后的字节数; 0, 输出放不下（即不值得压缩）
+size_t kvs_lzf_compress(const void *in, size_t in_len, void *out, size_t out_cap);
+
+// @return: 解压后的字节数; 0, 数据损坏或输出放不下
+size_t kvs_lzf_decompress(const void *in, size_t in_len, void *out, size_t out_cap);
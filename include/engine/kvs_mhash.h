@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 文件映射的持久化 hash：桶数组和条目都放在 MAP_SHARED 映射的文件里，互相用文件内偏移引用
+//   重启时只需映射文件，页面按访问缺页载入，不必重建节点
+//   空间从文件尾部按 2 的幂大小分块，释放的块按大小挂到各自的空闲链表；文件不够时翻倍扩展并 mremap
+// 崩溃一致性：条目先写完内容，最后才把状态置为 LIVE，并带全局递增的写入序号
+//   MOD 不原地改写，而是写一个新条目替换链表里的旧条目，再把旧条目置为 FREE
+//   正常关闭（destory）时 msync 并标记 clean；打开时发现不是 clean，就顺序扫描所有块重建桶数组、
+//   空闲链表和计数：LIVE 的条目都保留，同一个 key 只留序号最大的那个
+//   进程在任意位置崩溃都能恢复到每个 key 要么是旧值要么是新值；掉电要靠 kvs_mhash_sync 落盘
+
+#define KVS_MHASH_MAGIC 0x48534148534d564bULL // "KVSMHASH"
+#define KVS_MHASH_INIT_BUCKETS 1024
+#define KVS_MHASH_INIT_SIZE (1 << 20) // 新文件的初始大小
+#define KVS_MHASH_CLASSES 32          // 块大小 2^k，k < 32
+
+// 文件头，位于偏移 0
+typedef struct kvs_mhash_header_s
+{
+    uint64_t magic;
+    uint64_t clean;    // 1: 上次正常关闭，元数据可信
+    uint64_t size;     // 文件大小
+    uint64_t top;      // 已分块区域的末尾，之后是未用空间
+    uint64_t table;    // 桶数组所在块的偏移
+    uint64_t nbuckets; // 2 的幂
+    uint64_t count;
+    uint64_t seq; // 下一个写入序号
+    uint64_t free[KVS_MHASH_CLASSES];
+} kvs_mhash_header_t;
+
+typedef struct kvs_mhash_s
+{
+    int fd;
+    char *base; // 映射起始地址，扩展文件后可能变化
+    kvs_mhash_header_t *hdr;
+} kvs_mhash_t;
+
+// 5+2：create 打开（不存在则创建）path；get 返回的指针指向映射区，下一次写操作后失效
+int kvs_mhash_create(kvs_mhash_t *mh, const char *path);
+void kvs_mhash_destory(kvs_mhash_t *mh);
+
+int kvs_mhash_set(kvs_mhash_t *mh, char *key, char *value);
+char *kvs_mhash_get(kvs_mhash_t *mh, char *key);
+int kvs_mhash_mod(kvs_mhash_t *mh, char *key, char *value);
+int kvs_mhash_del(kvs_mhash_t *mh, char *key);
+int kvs_mhash_exist(kvs_mhash_t *mh, char *key);
+
+int kvs_mhash_count(kvs_mhash_t *mh);
+int kvs_mhash_sync(kvs_mhash_t *mh); // msync 整个映射，@return: <0, error; =0, success
@@ -5,10 +5,14 @@
 #include <string.h>
 
 #include "allocator/kvs_alloc.h" 
+#include "engine/kvs_value.h"
 
 #define RED 1
 #define BLACK 2
 
+#define KVS_RBTREE_BATCH 64     // 批量操作不超过这个数时排序用栈上空间
+#define KVS_RBTREE_MAX_DEPTH 64 // 批量查找复用路径的最大层数
+
 #define ENABLE_KEY_CHAR 1
 typedef char *KEY_TYPE;
 
@@ -19,13 +23,14 @@ typedef struct _rbtree_node
     struct _rbtree_node *left;
     struct _rbtree_node *parent;
     KEY_TYPE key;
-    void *value;
+    kvs_value_t value; // 短值、整数内嵌；单独分配的值 MOD 放得下时原地覆盖
 } rbtree_node;
 
 typedef struct _rbtree
 {
     rbtree_node *root;
     rbtree_node *nil;
+    rbtree_node nil_node; // nil 哨兵内嵌在树里：所有叶子都指向它，不能随碎片整理搬走
 } rbtree;
 
 typedef struct _rbtree kvs_rbtree_t;
@@ -40,3 +45,40 @@ int kvs_rbtree_del(kvs_rbtree_t *inst, char *key);
 int kvs_rbtree_mod(kvs_rbtree_t *inst, char *key, char *value);
 int kvs_rbtree_exist(kvs_rbtree_t *inst, char *key);
 
+// 一次定位完成的写入（set 本身即 set-if-absent）：
+//   upsert 不存在则插入、存在则覆盖；getset 同 upsert，旧值整体移到 *old 交给调用方
+//   （不存在时为 KVS_ENC_NONE），用完以 kvs_value_lazyfree 释放；cas 仅当当前值等于 expect 时替换
+//   mod/upsert/cas 的新值放得下时原地覆盖，不调用分配器
+//   incr 把值当作 int64 加上 delta（不存在时以 delta 插入），结果经 *result 返回
+// @return: <0, error. upsert/getset =0, 新插入; =1, 已覆盖. cas =0, 已替换; =1, 不存在; =2, 值不等
+//          incr =0, success; =1, 值不是整数; =2, 溢出
+int kvs_rbtree_upsert(kvs_rbtree_t *inst, char *key, char *value);
+int kvs_rbtree_getset(kvs_rbtree_t *inst, char *key, char *value, kvs_value_t *old);
+int kvs_rbtree_cas(kvs_rbtree_t *inst, char *key, char *expect, char *value);
+int kvs_rbtree_incr(kvs_rbtree_t *inst, char *key, int64_t delta, int64_t *result);
+
+// 批量接口：values[i] / results[i] 与逐个调用 get / set 的结果相同（values 指向树内，不拷贝）
+// @return: <0, error; 否则 mget 返回找到的个数，mset 返回新写入的个数
+int kvs_rbtree_mget(kvs_rbtree_t *inst, char **keys, int n, char **values);
+int kvs_rbtree_mset(kvs_rbtree_t *inst, char **keys, char **values, int n, int *results);
+
+// 碎片整理：按 key 顺序从 *cursor（上次处理到的 key，NULL 为从头）之后开始搬迁节点，
+// 约 budget 个后返回；cursor 由本函数用系统 malloc 维护，树在两次调用之间可以被修改
+// @return: 1, 未完成; 0, 本轮完成（cursor 已释放并置 NULL）
+int kvs_rbtree_defrag(kvs_rbtree_t *inst, char **cursor, int budget);
+
+// 按 key 顺序访问每个节点（value 原样交给 fn）；不分配内存，期间不能增删节点
+void kvs_rbtree_foreach(kvs_rbtree_t *inst, kvs_value_fn fn, void *arg);
+
+// 增量遍历：cursor 语义同 kvs_rbtree_defrag，每次访问约 budget 个节点；fn 可以原地替换 value，但不能增删节点
+// @return: 1, 未完成; 0, 已遍历完（cursor 已释放并置 NULL）
+int kvs_rbtree_values(kvs_rbtree_t *inst, char **cursor, int budget, kvs_value_fn fn, void *arg);
+
+// 惰性释放：detach 把整棵树 O(1) 移到 out，inst 变为空树；out->nil 仍指向 inst 的哨兵，只做地址比较
+// release 不再维护平衡，右旋拆树逐个释放，约 budget 个节点后返回
+// @return: detach <0, error; =0, success. release 1, 未完成; 0, 已全部释放
+int kvs_rbtree_detach(kvs_rbtree_t *inst, kvs_rbtree_t *out);
+int kvs_rbtree_release(kvs_rbtree_t *inst, int budget);
+
+// 单实例（单 loop 模式下使用）
+extern kvs_rbtree_t global_rbtree;
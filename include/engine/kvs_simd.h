@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 热路径上的字符串内核：key 哈希、协议分隔符查找，各有 scalar / SSE2 / AVX2 实现
+// 进程启动时按 CPUID 选出当前 CPU 支持的最高档，之后经函数指针调用；各档结果完全一致，
+// 运行中切换不影响已建好的哈希表
+// 向量实现会读到字符串结尾之后、但不越过所在的页（对齐读或先检查页内余量），不会访问未映射内存
+// key 比较仍用 libc 的 strcmp：glibc 已按 CPU 选用向量实现，实测比自写的内核快
+
+typedef enum
+{
+    KVS_SIMD_SCALAR = 0,
+    KVS_SIMD_SSE2,
+    KVS_SIMD_AVX2,
+    KVS_SIMD_COUNT,
+} kvs_simd_level_t;
+
+// key 的 32 位哈希：按 8 字节分组混合，末组补零，最后混入长度
+extern uint32_t (*kvs_simd_hash)(const char *key);
+// 第一个分隔符（' ' / '\t' / '\r'）或结尾 '\0' 的位置
+extern char *(*kvs_simd_delim)(const char *s);
+// 分隔符个数
+extern size_t (*kvs_simd_count_delim)(const char *s);
+
+kvs_simd_level_t kvs_simd_best(void);           // CPU 支持的最高档
+int kvs_simd_select(kvs_simd_level_t level);    // =0, success; <0, 不支持
+kvs_simd_level_t kvs_simd_level(void);          // 当前使用的档位
+const char *kvs_simd_name(kvs_simd_level_t level);
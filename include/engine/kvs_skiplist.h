@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "allocator/kvs_alloc.h"
+#include "engine/kvs_value.h"
+
+#define KVS_SKIPLIST_MAX_LEVEL 24     // 层数上限，p = 1/4 时足够上亿个 key
+#define KVS_SKIPLIST_READERS 32       // 同时注册的读者线程上限
+#define KVS_SKIPLIST_RETIRE_BATCH 64  // 待回收节点攒到这么多时尝试回收
+
+// 有序引擎的另一种实现：一个写者、多个不加锁的读者
+//   节点一次分配：[头部][next[level]][key\0]，塔高随机（p = 1/4），next 指针为原子变量
+//   写入不改已发布的节点：SET 先把新节点填好再自底向上接入；MOD 复制出新节点逐层替换旧节点；
+//   DEL 逐层摘除。被摘下的节点保持原有 next 指针不变，正在其上的读者可以照常走下去
+//   回收按 epoch：读者进入读区时登记当前 epoch，写者摘下节点后推进 epoch，
+//   只有登记的 epoch 都大于节点摘下时的 epoch，节点才真正释放
+// 写操作（set / del / mod / reclaim / destory）须由调用方串行化；get / exist / range 可在
+// 任意线程调用，非写者线程须在 read_begin / read_end 之间调用，返回的 value 在 read_end 前有效
+
+typedef struct kvs_skiplist_node_s
+{
+    kvs_value_t value;
+    uint8_t level;
+    _Atomic(struct kvs_skiplist_node_s *) next[]; // 之后紧跟 key
+} kvs_skiplist_node_t;
+
+typedef struct kvs_skiplist_retired_s
+{
+    kvs_skiplist_node_t *node;
+    uint64_t epoch; // 摘下时的 epoch
+} kvs_skiplist_retired_t;
+
+typedef struct kvs_skiplist_reader_s
+{
+    _Atomic uint64_t epoch; // 0 表示不在读区
+    atomic_int used;
+    char pad[64 - sizeof(uint64_t) - sizeof(int)]; // 各读者独占一条 cache line
+} kvs_skiplist_reader_t;
+
+typedef struct kvs_skiplist_s
+{
+    _Atomic(kvs_skiplist_node_t *) head[KVS_SKIPLIST_MAX_LEVEL];
+    atomic_int level; // 当前最高层
+    atomic_int count;
+    _Atomic uint64_t epoch;
+    uint64_t seed; // 塔高随机数，只有写者使用
+
+    kvs_skiplist_retired_t *retired; // 已摘下、等读者离开的节点
+    int nretired;
+    int cap_retired;
+    int reclaim_at;
+
+    kvs_skiplist_reader_t readers[KVS_SKIPLIST_READERS];
+} kvs_skiplist_t;
+
+// 5+2，返回值同 kvs_rbtree
+int kvs_skiplist_create(kvs_skiplist_t *inst);
+void kvs_skiplist_destory(kvs_skiplist_t *inst); // 调用时不能有读者在读区内
+
+int kvs_skiplist_set(kvs_skiplist_t *inst, char *key, char *value);
+char *kvs_skiplist_get(kvs_skiplist_t *inst, char *key);
+int kvs_skiplist_del(kvs_skiplist_t *inst, char *key);
+int kvs_skiplist_mod(kvs_skiplist_t *inst, char *key, char *value);
+int kvs_skiplist_exist(kvs_skiplist_t *inst, char *key);
+
+int kvs_skiplist_count(kvs_skiplist_t *inst);
+
+// 按 key 顺序访问 [lo, hi] 内的节点（lo / hi 为 NULL 表示不限），返回访问的个数
+// 从 lo 定位一次后沿第 0 层前进；fn 只能读 value。与写者并发时，看到的是遍历过程中各时刻的状态
+int kvs_skiplist_range(kvs_skiplist_t *inst, const char *lo, const char *hi, kvs_value_fn fn, void *arg);
+void kvs_skiplist_foreach(kvs_skiplist_t *inst, kvs_value_fn fn, void *arg);
+
+// 读者：每个线程注册一次拿到槽位，之后每次读前后调用 read_begin / read_end（不加锁）
+// @return: register >=0, 槽位; <0, 槽位已满
+int kvs_skiplist_reader_register(kvs_skiplist_t *inst);
+void kvs_skiplist_reader_unregister(kvs_skiplist_t *inst, int id);
+void kvs_skiplist_read_begin(kvs_skiplist_t *inst, int id);
+void kvs_skiplist_read_end(kvs_skiplist_t *inst, int id);
+
+// 释放读者都已离开的待回收节点，返回仍在等待的个数（写者调用；写操作内部也会按批触发）
+int kvs_skiplist_reclaim(kvs_skiplist_t *inst);
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 引擎条目里的 value：短字符串和整数内嵌在条目里，不单独分配；更长的单独分配并记下容量
+//   覆盖时新值放得下就原地写入，只有变大才重新分配；释放、搬迁都按容量而不是 strlen
+
+#define KVS_VALUE_EMBED 22 // 不超过该长度的字符串内嵌（int64 的十进制最长 20 个字符，总能内嵌）
+#define KVS_VALUE_SLACK 64 // 容量不超过它的单独分配的 value 变小时也原地写；更大的缩到一半以下才重新分配
+
+enum
+{
+    KVS_ENC_NONE = 0, // 没有值（全零初始化即为此状态）
+    KVS_ENC_RAW,      // 单独分配
+    KVS_ENC_EMBSTR,   // 内嵌字符串
+    KVS_ENC_INT,      // 内嵌的规范十进制 int64（无前导 0、无 +、不是 -0），INCR 不必再校验
+    KVS_ENC_VLOG,     // 大 value 写在 value log 里，这里只留位置（见 kvs_vlog.h）
+    KVS_ENC_LZF,      // 压缩后单独分配：raw.ptr 指向 4 字节原长 + LZF 数据，raw.cap 为其字节数
+};
+
+// 24 字节：raw 只占前 16 字节，编码放在内嵌缓冲区之后的最后一个字节，两种布局共用
+typedef union kvs_value_u
+{
+    struct
+    {
+        char *ptr;
+        size_t cap; // 分配的字节数（含结尾 \0）
+    } raw;
+    struct
+    {
+        char str[KVS_VALUE_EMBED + 1];
+        uint8_t enc;
+    } in;
+    struct
+    {
+        uint64_t off;
+        uint32_t len;
+        uint16_t seg; // 日志里的段
+        uint8_t log;  // 所属日志（每个执行命令的线程一个）
+        uint8_t lz;   // 日志里存的是压缩后的数据（格式同 KVS_ENC_LZF）
+    } vlog;
+} kvs_value_t;
+
+// 本线程的临时区：展开后的值都放在这里，到下一次 reset 前有效
+// 直接 mmap，不经过 malloc（快照子进程里也要读 value）；每条命令开始时 reset
+char *kvs_value_scratch(size_t n); // NULL: 内存不足
+void kvs_value_scratch_reset(void);
+
+// 读出 value log 里的值 / 解压 KVS_ENC_LZF，结果放在临时区
+// unpack 解压 "4 字节原长 + LZF 数据" 格式的 payload
+// @return: NULL 表示读不出来（读盘失败、数据损坏或内存不足），同时置位 kvs_value_unreadable
+char *kvs_vlog_value(kvs_value_t *v);
+char *kvs_value_inflate(kvs_value_t *v);
+char *kvs_value_unpack(const char *payload, size_t len);
+
+// 本线程有值读不出来时置位，kvs_value_scratch_reset 清零
+// get 类接口返回 NULL 时据此区分"不存在"和"读不出来"
+extern __thread int kvs_value_unreadable;
+
+// 值的字符串形式，KVS_ENC_NONE 或读不出来（见 kvs_value_unreadable）时为 NULL
+static inline char *kvs_value_str(kvs_value_t *v)
+{
+    switch (v->in.enc)
+    {
+    case KVS_ENC_RAW:
+        return v->raw.ptr;
+    case KVS_ENC_EMBSTR:
+    case KVS_ENC_INT:
+        return v->in.str;
+    case KVS_ENC_VLOG:
+        return kvs_vlog_value(v);
+    case KVS_ENC_LZF:
+        return kvs_value_inflate(v);
+    }
+    return NULL;
+}
+
+static inline int kvs_value_fits(size_t cap, size_t need)
+{
+    return need <= cap && (cap <= KVS_VALUE_SLACK || need * 2 >= cap);
+}
+
+// 把 s 解析为 int64，只接受规范写法（与 kvs_value_format_int 的输出一致）
+// @return: 0, 是整数; <0, 不是
+int kvs_value_parse_int(const char *s, int64_t *out);
+int kvs_value_format_int(int64_t n, char *buf); // buf 至少 21 字节，返回长度
+
+// 不小于 threshold 字节、且能省下至少 1/8 的 value 压缩保存，0 为不压缩（进程内全局）
+void kvs_value_compress_threshold(size_t threshold);
+
+// 长为 len 的字符串经 kvs_value_init 保存后是否仍是原样的内存字符串（不压缩、不进 value log）
+int kvs_value_plain(size_t len);
+
+// v 须为 KVS_ENC_NONE：按内容选择编码写入
+// 本线程的 kvs_value_packed_input 置位时，s 是 kvs_value_packed 的输出，直接保存其中的压缩数据
+// @return: <0, error; =0, success
+int kvs_value_init(kvs_value_t *v, const char *s);
+
+// 压缩过的值的传输形式 "原长:base64(LZF 数据)"，快照和迁移据此原样搬运，不解压再压缩
+// @return: kvs_value_packed 为 NULL 表示没有压缩（结果在临时区）; kvs_value_packed_check <0 表示格式不对或数据损坏
+char *kvs_value_packed(kvs_value_t *v);
+int kvs_value_packed_check(const char *s);
+extern __thread int kvs_value_packed_input;
+
+// 覆盖已有的值：放得下就原地写，否则换新的并释放旧的（大 value 惰性释放）
+// @return: <0, error（旧值不变）; =0, success
+int kvs_value_assign(kvs_value_t *v, const char *s);
+
+// 加上 delta 并原地写回（结果总能内嵌）
+// @return: <0, error（含当前值读不出来）; =0, success; =1, 当前值不是整数; =2, 溢出
+int kvs_value_incr(kvs_value_t *v, int64_t delta, int64_t *result);
+
+void kvs_value_free(kvs_value_t *v);     // 立即释放，v 回到 KVS_ENC_NONE
+void kvs_value_lazyfree(kvs_value_t *v); // 交给 kvs_lazyfree_value，v 回到 KVS_ENC_NONE
+void kvs_value_move(kvs_value_t *v);     // 碎片整理：单独分配的部分用 kvs_alloc_move 搬迁
+
+// 逐个访问引擎里的条目（value 可以原地修改）：value log 回收、快照、迁移用
+typedef void (*kvs_value_fn)(void *arg, const char *key, kvs_value_t *v);
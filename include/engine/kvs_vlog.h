@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine/kvs_value.h"
+#include "engine/kvs_array.h"
+#include "engine/kvs_rbtree.h"
+#include "engine/kvs_hash.h"
+
+// value log：key/value 分离，超过阈值的大 value 追加写到日志文件里，引擎只保存位置（KVS_ENC_VLOG）
+//   日志由若干段文件组成，只在最新的段上追加，写满后封存；每段记录仍被引用的字节数（live）
+//   value 被覆盖 / 删除时只减 live，封存段的 live 归零就关闭并删除文件
+//   GC：选 live 占比最低的封存段，分批遍历引擎，把仍指向它的 value 重新追加到最新段
+//   读取用 pread 放进本线程的临时区；日志随进程存在，重启后不保留（数据靠复制 / 快照重建）
+// 每个执行命令的线程各有一个日志，通过 kvs_vlog_current 绑定；释放可以发生在惰性释放的后台线程
+
+#define KVS_VLOG_SEG_SIZE (64u << 20) // 段文件的大小上限；单个 value 超过时独占一段
+#define KVS_VLOG_MAX_SEGS 1024        // 同时存在的段数
+#define KVS_VLOG_MAX 64               // 同时存在的日志数
+#define KVS_VLOG_GC_RATIO 0.5         // 封存段的 live 占比低于该值才回收
+#define KVS_VLOG_THRESHOLD 4096       // 默认阈值（字节）
+
+typedef struct kvs_vlog_seg_s
+{
+    _Atomic int fd;        // -1: 槽位空闲
+    _Atomic int sealed;    // 已封存，不再追加
+    _Atomic int dropping;  // 已开始删除，保证只删一次
+    _Atomic int64_t live;  // 仍被引用的字节数
+    uint64_t size;         // 已写入的字节数
+    uint32_t gen;          // 槽位每次启用加一，GC 据此判断目标段是否已被删除
+} kvs_vlog_seg_t;
+
+typedef struct kvs_vlog_s
+{
+    int id;
+    char dir[256];
+    size_t threshold; // 不小于该长度的 value 写入日志
+    uint64_t seg_size;
+    int active; // 正在追加的段，-1 表示还没有
+    kvs_vlog_seg_t segs[KVS_VLOG_MAX_SEGS];
+
+    // GC 进度
+    int gc_active;
+    int gc_seg;
+    uint32_t gc_gen;
+    int gc_phase; // 0 array, 1 rbtree, 2 hash
+    int gc_cursor;
+    char *gc_rb_cursor;
+    unsigned long gc_hash_cursor;
+    uint64_t gc_moved; // 累计搬迁的 value 数
+} kvs_vlog_t;
+
+extern __thread kvs_vlog_t *kvs_vlog_current; // 本线程新写入的大 value 放到这个日志，NULL 表示不分离
+
+// create 在 dir 下建立日志，seg_size 为 0 时用 KVS_VLOG_SEG_SIZE；destory 关闭并删除全部段文件
+// 日志结构较大，用系统 malloc 分配，由 destory 释放
+// @return: create NULL, error
+kvs_vlog_t *kvs_vlog_create(const char *dir, size_t threshold, uint64_t seg_size);
+void kvs_vlog_destory(kvs_vlog_t *log);
+
+// append 把 s[0..len) 写入日志，成功时 v 变为 KVS_ENC_VLOG；release 放弃 v 的引用（线程安全）
+// @return: append <0, error（v 不变）; =0, success
+int kvs_vlog_append(kvs_vlog_t *log, const char *s, size_t len, kvs_value_t *v);
+void kvs_vlog_release(kvs_value_t *v);
+
+// 读出日志里保存的原始字节（压缩过的不解压），放在临时区；长度为 v->vlog.len
+// @return: NULL, 读取失败
+char *kvs_vlog_payload(kvs_value_t *v);
+
+// GC：start 选出回收目标，step 推进约 budget 个条目
+// @return: start 0, 已开始; 1, 没有值得回收的段. step 1, 未完成; 0, 本轮完成或未开始
+int kvs_vlog_gc_start(kvs_vlog_t *log);
+int kvs_vlog_gc_step(kvs_vlog_t *log, kvs_array_t *array, kvs_rbtree_t *rbtree, kvs_hash_t *hash, int budget);
+
+typedef struct kvs_vlog_stats_s
+{
+    uint64_t disk; // 段文件的总字节数
+    int64_t live;  // 仍被引用的字节数
+    int segments;
+} kvs_vlog_stats_t;
+
+void kvs_vlog_stats(kvs_vlog_t *log, kvs_vlog_stats_t *st);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "protocol/kvs_protocol.h"
+
+// 集群模式（单 loop 模式下可用）：key 按 kvs_cluster_keyslot 分到 16384 个 slot，每个实例记录每个 slot 的归属
+//   OWNED     本实例负责
+//   REMOTE    归 node 所有：回复 MOVED slot host:port，客户端应更新自己的路由
+//   MIGRATING 正在迁往 node：key 还在本地就本地执行，否则回复 ASK slot host:port（只把这一条请求改发到 node）
+//   IMPORTING 正在从 node 迁入：照常执行（只有收到 ASK 的请求会发到这里）
+//   NONE      没有实例负责：回复 ERROR slot n not served
+// 迁移：源端取至多 KVS_MIGRATE_BATCH 个 key，以 UPSERT/RUPSERT/HUPSERT 发给目标，回复收齐才在本地删除；
+//   事件循环不等回复，批次在途时涉及其中 key 的请求回复 ERROR TRYAGAIN，key 任何时刻只在一边可写
+//   一批失败（超时、断线）时保留 key 列表，重连后先按本地现状重发：还在的重新 UPSERT，
+//   已被删掉的发 DEL，清掉目标上可能已写入的旧副本，之后才继续遍历
+//   遍历完后发 CLUSTER SETSLOT lo hi OWNED 让目标接管，本地改为 REMOTE
+
+#define KVS_CLUSTER_SLOTS 16384
+#define KVS_CLUSTER_MAX_NODES 64    // 一个实例最多记录的其他实例地址数
+#define KVS_MIGRATE_BATCH 128       // 每轮最多搬迁的 key 数
+#define KVS_MIGRATE_SCAN 1024       // 每轮最多访问的数组槽位 / 树节点 / hash 桶数
+#define KVS_MIGRATE_TIMEOUT_MS 1000 // 等目标确认一批的上限，超时断开并稍后重发
+#define KVS_MIGRATE_RETRY_MS 1000
+
+enum
+{
+    KVS_SLOT_NONE = 0,
+    KVS_SLOT_OWNED,
+    KVS_SLOT_REMOTE,
+    KVS_SLOT_MIGRATING,
+    KVS_SLOT_IMPORTING,
+};
+
+enum
+{
+    KVS_MIGRATE_ARRAY = 0,
+    KVS_MIGRATE_RBTREE,
+    KVS_MIGRATE_HASH,
+    KVS_MIGRATE_DONE,
+};
+
+// 正在进行的迁移（同一时间只有一个）
+typedef struct kvs_migrate_s
+{
+    int active;
+    int lo, hi; // slot 区间
+    int node;   // 目标
+    uint64_t retry_ms;
+
+    int stage;            // KVS_MIGRATE_*：依次遍历三个引擎
+    int array_cursor;
+    char *rbtree_cursor;
+    unsigned long hash_cursor;
+
+    kvs_buf_t out;  // 本批发给目标的命令
+    kvs_buf_t keys; // 本批的 key：引擎编号 1 字节 + key + \0，确认后逐个删除
+    int nkeys;      // >0 且 acks 为 0：上一批失败，等待重发
+    int acks;       // 已发出、还没收到的回复数
+    long moved; // 已搬迁的 key 数
+} kvs_migrate_t;
+
+typedef struct kvs_cluster_s
+{
+    int enabled;
+    uint8_t state[KVS_CLUSTER_SLOTS];
+    uint8_t node[KVS_CLUSTER_SLOTS]; // REMOTE / MIGRATING / IMPORTING 时对方在 nodes 里的下标
+    char nodes[KVS_CLUSTER_MAX_NODES][64];
+    int nnodes;
+    kvs_migrate_t migrate;
+} kvs_cluster_t;
+
+// key 的 slot：含非空的 {tag} 时只对 tag 求值，带同一 tag 的 key 落在同一个 slot
+int kvs_cluster_keyslot(const char *key);
+
+void kvs_cluster_init(kvs_cluster_t *cl, int lo, int hi); // 启用并认领 [lo, hi]
+void kvs_cluster_destory(kvs_cluster_t *cl);
+int kvs_cluster_node(kvs_cluster_t *cl, const char *addr); // 登记 host:port，返回下标；<0, 已满或格式不对
+void kvs_cluster_set(kvs_cluster_t *cl, int lo, int hi, int state, int node);
+
+// 请求的路由检查：key 都由本地执行时返回 0；否则把 MOVED / ASK / 错误回复追加到 out，返回 1
+int kvs_cluster_check(kvs_cluster_t *cl, kvs_store_t *store, char **tokens, int count, kvs_buf_t *out);
+
+// CLUSTER 子命令（KEYSLOT / SETSLOT / INFO），回复追加到 out；SETSLOT ... MIGRATING 开始迁移
+// @return: <0, error; =0, success
+int kvs_cluster_execute(kvs_cluster_t *cl, char **tokens, int count, kvs_buf_t *out);
+
+// 迁移的一步：从 slot 区间里收集下一批 key 到 migrate.out / keys；hash 一次取整个桶，可能略超 max_keys
+// @return: 本批 key 数（0 且 stage 为 DONE 表示遍历完）；-1, 有值读不出来; -2, 内存不足
+int kvs_migrate_collect(kvs_cluster_t *cl, kvs_store_t *store, int max_keys, int budget);
+
+// 目标确认后删除本批 key；on_del 收到每条等价的 DEL/RDEL/HDEL（用于传播给从），可以为 NULL
+typedef void (*kvs_migrate_del_fn)(void *arg, char **tokens, int count);
+void kvs_migrate_commit(kvs_cluster_t *cl, kvs_store_t *store, kvs_migrate_del_fn on_del, void *arg);
+
+// 本批没有确认：保留 key 列表，遍历位置不变，下次用 kvs_migrate_resend 重发
+void kvs_migrate_abort(kvs_cluster_t *cl);
+
+// 按本地现状重建失败批次的 migrate.out：还在的 key 发 UPSERT，已不在的发 DEL（确认后不再删除）
+// @return: 本批 key 数; -1, 有值读不出来; -2, 内存不足
+int kvs_migrate_resend(kvs_cluster_t *cl, kvs_store_t *store);
+
+// 消费 in 里完整的回复行，每行抵掉一个 migrate.acks（OK，或 DEL 的 NO EXIST）
+// @return: 还在等的回复数; <0, 有别的回复或多出来的回复
+int kvs_migrate_ack(kvs_cluster_t *cl, kvs_buf_t *in);
+
+// 发起到 host:port 的非阻塞连接，不等连上；返回 fd，失败返回 -1
+int kvs_migrate_connect(const char *addr);
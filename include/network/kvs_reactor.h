@@ -0,0 +1,22 @@
+#pragma once
+
+#include "config/kvs_config.h"
+
+#define KVS_MAX_EVENTS 1024
+#define KVS_READ_CHUNK 16384
+#define KVS_MAX_REQUEST (64 * 1024 * 1024) // 单个请求行上限，超过直接断开
+#define KVS_ARENA_SIZE 16384              // 每个 loop 的请求级 arena 初始大小
+#define KVS_MSG_CACHE 1024                // 每个 loop 缓存的空闲跨 shard 消息数
+#define KVS_MSG_CACHE_BUF (64 * 1024)     // 超过该容量的消息缓冲不缓存，避免大请求长期占内存
+
+#define KVS_DEFRAG_BUDGET 128                // 碎片整理每轮事件循环最多搬迁的条目数
+#define KVS_DEFRAG_CHECK_MS 1000             // 未在整理时，检查碎片率的间隔
+#define KVS_DEFRAG_MIN_WASTE (4 * 1024 * 1024) // 浪费不到这么多不值得整理
+#define KVS_LAZYFREE_BUDGET 1024             // mypool 下每轮事件循环惰性释放的条目数
+#define KVS_VLOG_GC_BUDGET 128               // value log 回收每轮事件循环最多检查的条目数
+#define KVS_VLOG_GC_CHECK_MS 1000            // 未在回收时，检查是否有可回收段的间隔
+
+// 按配置启动 reactor：shards<=1 时在当前线程跑单个 loop，
+// 否则起 N 个线程，每个 loop 绑定一个核、各自持有引擎实例（shared-nothing）
+// 正常情况下不返回；启动失败返回 <0
+int kvs_reactor_start(const kvs_config_t *cfg);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "protocol/kvs_protocol.h"
+
+// 主从复制（单 loop 模式）：
+//   从连接后发送 PSYNC replid offset（首次为 PSYNC ? -1）
+//   主的积压缓冲区里还有 offset 之后的全部命令流时回复 +CONTINUE replid，随后补发缺失部分（部分重同步）；
+//   否则 fork 子进程把内存里的数据直接写到 socket（全量同步）：
+//     +FULLRESYNC replid offset / FLUSH SYNC / UPSERT|RUPSERT|HUPSERT key value... / +SYNCED
+//   之后主把每条写命令原样（token 以单个空格连接，\n 结尾）发给从；offset 只按这条命令流的字节计
+
+#define KVS_REPL_ID_LEN 40                  // replid：40 个十六进制字符，主每次启动重新生成
+#define KVS_REPL_MAX_REPLICAS 16            // 一个主最多挂的从
+#define KVS_REPL_CHUNK (64 * 1024)          // 全量同步子进程每次写出的字节数
+#define KVS_REPL_TIMEOUT_MS 60000           // 全量同步时从长时间不读，放弃该从
+#define KVS_REPL_OUTBUF_MAX (256 * 1024 * 1024) // 从的待发送命令流超过该值就断开，让它稍后重同步
+#define KVS_REPL_RETRY_MS 1000              // 从与主断开后的重连间隔
+
+// 复制积压缓冲区：环形保存命令流最近 size 字节；offset 为流的总字节数
+typedef struct kvs_repl_backlog_s
+{
+    char *buf;
+    size_t size;
+    size_t len;      // 已保存的字节数（<= size）
+    size_t head;     // 下一个字节写入的位置
+    uint64_t offset;
+} kvs_repl_backlog_t;
+
+int kvs_repl_backlog_create(kvs_repl_backlog_t *backlog, size_t size);
+void kvs_repl_backlog_destory(kvs_repl_backlog_t *backlog);
+void kvs_repl_backlog_feed(kvs_repl_backlog_t *backlog, const char *data, size_t len);
+uint64_t kvs_repl_backlog_first(kvs_repl_backlog_t *backlog); // 积压里最早一个字节的偏移
+
+// 部分重同步：replid 相同且 [offset, 当前偏移] 仍在积压里时，把 +CONTINUE 和缺失的命令流追加到 out
+// @return: <0, 只能全量同步; =0, success
+int kvs_repl_backlog_continue(kvs_repl_backlog_t *backlog, const char *id, const char *want_id, uint64_t offset,
+                              kvs_buf_t *out);
+
+void kvs_repl_new_id(char id[KVS_REPL_ID_LEN + 1]);
+
+// 按传播格式把一条请求追加到 out
+// @return: <0, error; =0, success
+int kvs_repl_format(kvs_buf_t *out, char **tokens, int count);
+
+// 全量同步：把 store 的全部内容按上面的格式依次写给 fds（非阻塞 fd，内部用 poll 等待）
+// 运行在 fork 出的子进程里，不调用分配器；写失败的 fd 会被 shutdown（有值读不出来时全部 shutdown），主进程随后发现连接断开
+// @return: 写完整的 fd 个数
+int kvs_repl_snapshot(kvs_store_t *store, const char *id, uint64_t offset, const int *fds, int nfds);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define KVS_CACHELINE 64
+
+// 单生产者单消费者无锁环形队列（元素为指针）
+// head 只由生产者写，tail 只由消费者写，分开放在不同 cache line 避免伪共享
+typedef struct kvs_ring_s
+{
+    _Alignas(KVS_CACHELINE) _Atomic size_t head; // 下一个写入位置
+    _Alignas(KVS_CACHELINE) _Atomic size_t tail; // 下一个读取位置
+
+    _Alignas(KVS_CACHELINE) size_t mask; // 容量 - 1（容量为 2 的幂）
+    void **slots;
+} kvs_ring_t;
+
+int kvs_ring_create(kvs_ring_t *ring, size_t size); // size 向上取整为 2 的幂
+void kvs_ring_destory(kvs_ring_t *ring);
+
+int kvs_ring_push(kvs_ring_t *ring, void *item); // 0: 成功, 1: 已满
+void *kvs_ring_pop(kvs_ring_t *ring);            // NULL: 空
+int kvs_ring_empty(kvs_ring_t *ring);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "network/kvs_ring.h"
+#include "protocol/kvs_protocol.h"
+
+#define KVS_MAX_SHARDS 64
+#define KVS_SHARD_RING_SIZE 4096
+
+enum
+{
+    KVS_SHARD_REQ = 0, // 转发给属主 shard 的请求
+    KVS_SHARD_REP,     // 属主 shard 返回的回复
+};
+
+// 跨 shard 消息：由发起方分配，沿 请求->回复 往返一次后回到发起方
+// 发起方缓存用过的消息（连同 args/reply 的容量）复用，稳态下转发不再 malloc/free
+typedef struct kvs_shard_msg_s
+{
+    int type;
+    int from;   // 发起方 shard
+    void *conn; // 发起方连接，只有发起方解引用
+
+    char *args;      // REQ：已切分的请求，token 之间以 \0 分隔（接收方无需再解析）
+    size_t args_cap;
+    int argc;
+    kvs_buf_t reply; // REP：回复内容
+    int broadcast;   // 广播副本（FLUSH）：所有副本都回到发起方后，只写回最后一份回复
+
+    struct kvs_shard_msg_s *next; // 队列满时挂在发送方本地的溢出链表
+} kvs_shard_msg_t;
+
+// N 个成员两两之间各一条 SPSC 队列：rings[from * count + to]
+// 成员既可以是 shard（按 key 分属），也可以是 I/O 线程 + 执行线程
+typedef struct kvs_shard_group_s
+{
+    int count;
+    kvs_ring_t *rings;
+    int *efds; // 每个成员一个 eventfd，用于唤醒其 epoll
+} kvs_shard_group_t;
+
+int kvs_shard_group_create(kvs_shard_group_t *group, int count);
+void kvs_shard_group_destory(kvs_shard_group_t *group);
+
+int kvs_shard_owner(kvs_shard_group_t *group, const char *key);
+
+int kvs_shard_send(kvs_shard_group_t *group, int from, int to, kvs_shard_msg_t *msg); // 0: 成功, 1: 队列满
+kvs_shard_msg_t *kvs_shard_recv(kvs_shard_group_t *group, int self, int from);
+void kvs_shard_notify(kvs_shard_group_t *group, int to);
+void kvs_shard_drain_notify(kvs_shard_group_t *group, int self);
+
+// 把请求打包进 msg（沿用 msg 已有的 args 容量），reply 清空，broadcast 置 0
+// @return: <0, error; =0, success
+int kvs_shard_msg_request(kvs_shard_msg_t *msg, int from, void *conn, char **tokens, int count);
+int kvs_shard_msg_tokens(kvs_shard_msg_t *msg, char **tokens, int max); // 还原 token 数组
+void kvs_shard_msg_free(kvs_shard_msg_t *msg);
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "engine/kvs_array.h"
+#include "engine/kvs_rbtree.h"
+#include "engine/kvs_hash.h"
+
+#define KVS_MAX_TOKENS 128
+
+// 文本协议：一行一个请求（\n 结尾，兼容 \r\n），token 以空格分隔
+//   SET/GET/DEL/MOD/EXIST/UPSERT/GETSET/CAS/INCR/DECR/INCRBY/RESTORE                 -> array
+//   RSET/RGET/RDEL/RMOD/REXIST/RUPSERT/RGETSET/RCAS/RINCR/RDECR/RINCRBY/RRESTORE     -> rbtree
+//   HSET/HGET/HDEL/HMOD/HEXIST/HUPSERT/HGETSET/HCAS/HINCR/HDECR/HINCRBY/HRESTORE     -> hash
+//     SET 只在不存在时写入；UPSERT key value 不存在则插入、存在则覆盖
+//     GETSET key value 同 UPSERT，回复旧值（原先不存在为 NO EXIST）
+//     CAS key expect value 当前值等于 expect 时替换，回复 OK / NO EXIST / MISMATCH
+//     INCR/DECR key、INCRBY key delta 把值当作 int64 加减（不存在视为 0），回复新值，
+//       值不是整数回复 ERROR not an integer，越界回复 ERROR overflow
+//     RESTORE key packed 同 UPSERT，但值是压缩数据的传输形式（见 kvs_value_packed），快照和迁移用
+//   STATS [RESET]                -> 各命令/引擎的延迟分位数（ns），RESET 清零
+//   MEMORY                       -> 分配器统计：申请/占用字节、碎片率、各级存活对象数
+//   FLUSH [SYNC|ASYNC]           -> 清空全部引擎；默认按 lazyfree 配置，ASYNC 摘下后立即回复
+//   SCAN cursor [MATCH glob] [COUNT n] -> 增量遍历 hash 的 key，回复 "SCAN 下一个游标 key..."，游标 0 表示结束
+//   MGET/RMGET/HMGET key...      -> 批量 GET，每个 key 一行回复，依次与 GET 相同
+//   MSET/RMSET/HMSET key value...-> 批量 SET，每个 key 一行回复，依次与 SET 相同
+//   PSYNC replid offset          -> 复制握手，由网络层处理（见 kvs_repl.h）
+//   ROLE                         -> 复制角色与偏移，由网络层处理
+//   CLUSTER KEYSLOT|SETSLOT|INFO -> slot 归属与迁移，由网络层处理（见 kvs_cluster.h）
+//     集群模式下 key 不归本实例时回复 MOVED slot host:port / ASK slot host:port
+// 回复同样是一行，以 \r\n 结尾（批量命令为 key 数行）
+
+#define KVS_CMD_ENGINE_LAST KVS_CMD_HRESTORE
+
+enum
+{
+    KVS_CMD_START = 0,
+    // array
+    KVS_CMD_SET = KVS_CMD_START,
+    KVS_CMD_GET,
+    KVS_CMD_DEL,
+    KVS_CMD_MOD,
+    KVS_CMD_EXIST,
+    KVS_CMD_UPSERT,
+    KVS_CMD_GETSET,
+    KVS_CMD_CAS,
+    KVS_CMD_INCR,
+    KVS_CMD_DECR,
+    KVS_CMD_INCRBY,
+    KVS_CMD_RESTORE,
+    // rbtree
+    KVS_CMD_RSET,
+    KVS_CMD_RGET,
+    KVS_CMD_RDEL,
+    KVS_CMD_RMOD,
+    KVS_CMD_REXIST,
+    KVS_CMD_RUPSERT,
+    KVS_CMD_RGETSET,
+    KVS_CMD_RCAS,
+    KVS_CMD_RINCR,
+    KVS_CMD_RDECR,
+    KVS_CMD_RINCRBY,
+    KVS_CMD_RRESTORE,
+    // hash
+    KVS_CMD_HSET,
+    KVS_CMD_HGET,
+    KVS_CMD_HDEL,
+    KVS_CMD_HMOD,
+    KVS_CMD_HEXIST,
+    KVS_CMD_HUPSERT,
+    KVS_CMD_HGETSET,
+    KVS_CMD_HCAS,
+    KVS_CMD_HINCR,
+    KVS_CMD_HDECR,
+    KVS_CMD_HINCRBY,
+    KVS_CMD_HRESTORE,
+
+    // 以下命令不属于 引擎 x 操作 矩阵，也不带 key
+    KVS_CMD_STATS,
+    KVS_CMD_MEMORY,
+    KVS_CMD_FLUSH,
+    KVS_CMD_SCAN,
+    KVS_CMD_PSYNC,
+    KVS_CMD_ROLE,
+    KVS_CMD_CLUSTER,
+
+    // 批量命令：每个引擎一对 MGET/MSET，可能涉及多个 shard
+    KVS_CMD_MGET,
+    KVS_CMD_MSET,
+    KVS_CMD_RMGET,
+    KVS_CMD_RMSET,
+    KVS_CMD_HMGET,
+    KVS_CMD_HMSET,
+
+    KVS_CMD_COUNT,
+};
+
+// 可增长的字节缓冲区；跨线程传递，使用系统 malloc
+typedef struct kvs_buf_s
+{
+    char *data;
+    size_t len;
+    size_t cap;
+} kvs_buf_t;
+
+int kvs_buf_reserve(kvs_buf_t *buf, size_t extra); // 保证尾部至少还有 extra 字节空闲
+int kvs_buf_append(kvs_buf_t *buf, const char *data, size_t len);
+void kvs_buf_consume(kvs_buf_t *buf, size_t n); // 丢弃头部 n 字节
+void kvs_buf_free(kvs_buf_t *buf);
+
+// 一组引擎实例：单 loop 时指向 global_*，shard 模式下每个 shard 各持一份
+typedef struct kvs_store_s
+{
+    kvs_array_t *array;
+    kvs_rbtree_t *rbtree;
+    kvs_hash_t *hash;
+
+    int shard;   // 在 shard 组里的编号：SCAN 游标里带着它，走完一个 shard 再走下一个
+    int nshards; // <=1 为不分 shard
+} kvs_store_t;
+
+int kvs_store_create(kvs_store_t *store);
+void kvs_store_destory(kvs_store_t *store);
+int kvs_store_flush(kvs_store_t *store, int lazy); // 清空全部引擎；lazy 时交给惰性释放
+
+int kvs_protocol_split(char *line, char **tokens, int max); // 原地切分，返回 token 个数
+// 同 split，但 token 数组从 arena 按需分配，不受 KVS_MAX_TOKENS 限制；失败返回 NULL
+char **kvs_protocol_tokenize(struct mp_pool_s *arena, char *line, int *count);
+void kvs_protocol_join(char *begin, char *end);             // 撤销 split：把 [begin, end) 内的 \0 还原为空格
+int kvs_protocol_command(const char *name);                 // <0: 未知命令
+const char *kvs_protocol_key(char **tokens, int count);     // 请求涉及的 key，无则 NULL
+int kvs_protocol_broadcast(char **tokens, int count);       // 请求是否要在每个 shard 上都执行（FLUSH）
+int kvs_protocol_cursor_owner(char **tokens, int count, int nshards); // SCAN 游标所属的 shard，其他请求返回 -1
+int kvs_protocol_batch(char **tokens, int count);           // 批量命令每个 key 占的 token 数（MGET 1，MSET 2），其他请求返回 0
+int kvs_protocol_write(char **tokens, int count);           // 请求是否修改数据（主要把它传播给从，从拒绝客户端执行）
+
+// 执行一条已切分的请求，回复追加到 out
+// @return: <0, error; =0, success
+int kvs_protocol_execute(kvs_store_t *store, char **tokens, int count, kvs_buf_t *out);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 一致性哈希环：每个节点按名字生成 vnodes 个虚拟节点，key 落到顺时针方向第一个虚拟节点所属的节点
+//   虚拟节点的位置只取决于节点名，增删一个节点时只有约 1/N 的 key 换属主
+
+#define KVS_CHASH_VNODES 160   // 默认每个节点的虚拟节点数
+#define KVS_CHASH_MAX_NODES 64
+
+typedef struct kvs_chash_point_s
+{
+    uint32_t hash;
+    int node;
+} kvs_chash_point_t;
+
+typedef struct kvs_chash_s
+{
+    kvs_chash_point_t *points; // 按 hash 升序
+    int npoints;
+    int nnodes;
+} kvs_chash_t;
+
+uint32_t kvs_chash_hash(const char *data, size_t len);
+
+// names[i] 为第 i 个节点的名字（如 "127.0.0.1:2001"），不同节点的名字须不同
+// @return: <0, error; =0, success
+int kvs_chash_create(kvs_chash_t *ring, const char **names, int nnodes, int vnodes);
+void kvs_chash_destory(kvs_chash_t *ring);
+
+int kvs_chash_owner(const kvs_chash_t *ring, const char *key); // key 所属节点的下标
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// HDR 风格的对数-线性直方图：每个 2 的幂区间再均分 16 个子桶，相对误差约 6%
+#define KVS_HIST_SUB_BITS 4
+#define KVS_HIST_SUB_COUNT (1 << KVS_HIST_SUB_BITS)
+#define KVS_HIST_MAX_BITS 40 // 超过 2^40 ticks 的样本计入最后一个桶
+#define KVS_HIST_BUCKETS ((KVS_HIST_MAX_BITS - KVS_HIST_SUB_BITS + 2) * KVS_HIST_SUB_COUNT)
+
+#define KVS_STATS_SLOTS 64 // 直方图个数，由调用方分配含义（命令、引擎……）
+
+typedef struct kvs_hist_s
+{
+    uint64_t count;
+    uint64_t max; // ticks
+    uint64_t buckets[KVS_HIST_BUCKETS];
+} kvs_hist_t;
+
+typedef struct kvs_hist_summary_s
+{
+    uint64_t count;
+    uint64_t p50; // 以下单位均为 ns
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} kvs_hist_summary_t;
+
+extern int kvs_stats_enabled;
+
+void kvs_stats_init(int enabled); // 标定 TSC 频率
+
+// 低开销时间戳：x86 上直接读 TSC，其它平台退化为 clock_gettime
+static inline uint64_t kvs_stats_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// 记录到当前线程的直方图：单写者，无锁无原子 RMW
+void kvs_stats_record(int slot, uint64_t ticks);
+
+void kvs_stats_merge(int slot, kvs_hist_t *out); // 汇总所有线程，累加到 out（调用方先清零）
+void kvs_stats_summary(const kvs_hist_t *hist, kvs_hist_summary_t *out);
+void kvs_stats_reset(void); // 各线程在下次记录时自行清零
+
+void kvs_hist_add(kvs_hist_t *hist, uint64_t ticks);
+uint64_t kvs_hist_percentile(const kvs_hist_t *hist, double p); // 返回 ticks
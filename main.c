@@ -3,15 +3,38 @@
 #include <stdlib.h>
 
 #include "include/config/kvs_config.h"
-#include "include/allocator/kvs_alloc.h"   
+#include "include/allocator/kvs_alloc.h"
+#include "include/network/kvs_reactor.h"
+#include "include/stats/kvs_stats.h"
+#include "include/engine/kvs_lazyfree.h"
+#include "include/engine/kvs_value.h"
+#include "include/engine/kvs_simd.h"
 
-int main()
+int main(int argc, char *argv[])
 {
     kvs_config_t config;
+    const char *path = argc > 1 ? argv[1] : "conf/kvs.conf";
 
-    kvs_config_load_file(&config, "conf/kvs.conf");
-    printf("config: bind_ip=%s, port=%d, allocator=%d, network=%d\n",
-           config.bind_ip, config.port, config.allocator, config.network);
-   kvs_set_allocator(config.allocator);
-    return 0;
-}
\ No newline at end of file
+    kvs_config_default(&config);
+    if (kvs_config_load_file(&config, path) != 0)
+        printf("load %s failed, using defaults\n", path);
+
+    printf("config: bind_ip=%s, port=%d, allocator=%d, network=%d, shards=%d, io_threads=%d\n",
+           config.bind_ip, config.port, config.allocator, config.network, config.shards, config.io_threads);
+    if (config.hugepages)
+    {
+        if (config.allocator != KVS_ALLOC_MYPOOL)
+            printf("hugepages only applies to mypool, ignored\n");
+        else if (kvs_alloc_set_hugepages(1) == KVS_HUGEPAGE_HUGETLB)
+            printf("hugepages: MAP_HUGETLB\n");
+        else
+            printf("hugepages: no hugetlb pages reserved, fallback to THP madvise\n");
+    }
+    printf("simd: %s\n", kvs_simd_name(kvs_simd_level()));
+    kvs_set_allocator(config.allocator);
+    kvs_stats_init(config.latency_stats);
+    kvs_lazyfree_enable(config.lazyfree);
+    kvs_value_compress_threshold(config.compress_threshold);
+
+    return kvs_reactor_start(&config) == 0 ? 0 : 1;
+}
@@ -0,0 +1,1000 @@
+// kvs-proxy：按一致性哈希把请求分发到多个 kvstore 实例，对客户端仍是同一套文本协议
+//   单线程 epoll；每个后端维持一个连接池，同一客户端发往同一后端的请求固定走池里同一条连接，
+//   保证同一 key 上的先后顺序；不同客户端的请求在后端连接上流水线化，每轮事件循环末尾合并写出
+//   MGET/MSET 按属主拆成子请求，回复按 key 收齐后按原顺序写回；FLUSH 发给所有后端；
+//   SCAN 游标 = 后端游标 * 后端数 + 后端下标（与 server 分 shard 时的编码相同）
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "allocator/kvs_alloc.h"
+#include "protocol/kvs_protocol.h"
+#include "proxy/kvs_chash.h"
+
+#define PROXY_MAX_EVENTS 1024
+#define PROXY_READ_CHUNK 16384
+#define PROXY_MAX_REQUEST (64 * 1024 * 1024) // 单个请求行上限，超过直接断开
+#define PROXY_MAX_PENDING 1024               // 单个客户端在途请求上限，超过后暂停解析
+#define PROXY_RETRY_MS 1000                  // 后端连接失败后，这段时间内发往它的请求直接回复错误
+#define PROXY_ARENA_SIZE 16384
+
+#define PROXY_ERR_BACKEND "ERROR backend unavailable"
+
+enum
+{
+    PROXY_IO_LISTEN = 0,
+    PROXY_IO_CLIENT,
+    PROXY_IO_BACKEND,
+};
+
+// 回复的合成方式
+enum
+{
+    PROXY_REQ_FORWARD = 0, // 各行按 key 顺序原样写回
+    PROXY_REQ_BROADCAST,   // 每个后端一行：全部 OK 才回复 OK，否则回复第一条错误
+    PROXY_REQ_SCAN,        // 改写回复里的游标
+};
+
+// 客户端与后端连接共用的部分，epoll 的 data.ptr 指向它
+typedef struct proxy_io_s
+{
+    int fd;
+    int kind;
+    int want_out;
+    int closed; // 客户端：已关闭，等 flush_dirty 释放
+    int dirty;  // 已在本轮待发送列表里
+    kvs_buf_t rbuf;
+    kvs_buf_t wbuf;
+} proxy_io_t;
+
+struct proxy_client_s;
+
+typedef struct proxy_req_s
+{
+    struct proxy_client_s *client; // 客户端已断开时为 NULL，最后一个子请求的回复到达后释放
+    struct proxy_req_s *next;
+    int kind;
+    int pending; // 尚未收齐回复的子请求数
+    int node;    // SCAN：执行它的后端
+    int nlines;
+    int *owner;  // 拆分时每行回复所属的后端，否则为 NULL（各行依次对应）
+    char **line; // 每行回复（不含 \r\n），未收到时为 NULL
+    char *line1; // nlines == 1 时 line 指向它
+} proxy_req_t;
+
+// 后端连接上一个在途的子请求：还差 remaining 行回复，cursor 为下一行在 req->line 里的位置
+typedef struct proxy_wait_s
+{
+    proxy_req_t *req;
+    int remaining;
+    int cursor;
+} proxy_wait_t;
+
+typedef struct proxy_backend_s
+{
+    proxy_io_t io;
+    int node;
+    int connecting;
+    uint64_t retry_ms;
+
+    proxy_wait_t *waits; // 环形 FIFO
+    size_t head;
+    size_t count;
+    size_t cap;
+} proxy_backend_t;
+
+typedef struct proxy_node_s
+{
+    const char *name; // host:port
+    struct sockaddr_in addr;
+    proxy_backend_t *pool;
+} proxy_node_t;
+
+typedef struct proxy_client_s
+{
+    proxy_io_t io;
+    unsigned id;     // 决定使用各后端连接池里的哪一条
+    int blocked;     // 在途请求达到上限而暂停了解析
+    proxy_req_t *head;
+    proxy_req_t *tail;
+    int nreqs;
+} proxy_client_t;
+
+typedef struct proxy_opts_s
+{
+    const char *bind_ip;
+    int port;
+    int vnodes;
+    int pool;
+} proxy_opts_t;
+
+static proxy_opts_t opts = {
+    .bind_ip = "0.0.0.0",
+    .port = 2100,
+    .vnodes = KVS_CHASH_VNODES,
+    .pool = 4,
+};
+
+static int epfd = -1;
+static proxy_io_t listener = {.fd = -1, .kind = PROXY_IO_LISTEN};
+static proxy_node_t nodes[KVS_CHASH_MAX_NODES];
+static int nnodes;
+static kvs_chash_t ring;
+static struct mp_pool_s *arena;
+static unsigned next_client_id;
+
+// 本轮有数据要发的连接，事件处理完后统一发送
+static proxy_io_t **dirty;
+static int ndirty, dirty_cap;
+
+static void client_process(proxy_client_t *c);
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void io_update_events(proxy_io_t *io)
+{
+    int want_out = io->wbuf.len > 0;
+    if (want_out == io->want_out)
+        return;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (want_out ? EPOLLOUT : 0);
+    ev.data.ptr = io;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, io->fd, &ev);
+    io->want_out = want_out;
+}
+
+// @return: <0, 连接出错（由调用方关闭）; =0, 正常
+static int io_flush(proxy_io_t *io)
+{
+    size_t off = 0;
+    while (off < io->wbuf.len)
+    {
+        ssize_t n = send(io->fd, io->wbuf.data + off, io->wbuf.len - off, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            off += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        return -1;
+    }
+
+    kvs_buf_consume(&io->wbuf, off);
+    io_update_events(io);
+    return 0;
+}
+
+// 读空 socket
+// @return: <0, 对端关闭或出错; =0, 正常
+static int io_read(proxy_io_t *io)
+{
+    for (;;)
+    {
+        if (io->rbuf.cap - io->rbuf.len < PROXY_READ_CHUNK && kvs_buf_reserve(&io->rbuf, PROXY_READ_CHUNK) != 0)
+            return -1;
+
+        ssize_t n = recv(io->fd, io->rbuf.data + io->rbuf.len, io->rbuf.cap - io->rbuf.len, 0);
+        if (n > 0)
+        {
+            io->rbuf.len += (size_t)n;
+            if (io->rbuf.len > PROXY_MAX_REQUEST)
+                return -1;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        return -1;
+    }
+}
+
+static void mark_dirty(proxy_io_t *io)
+{
+    if (io->dirty)
+        return;
+    if (ndirty == dirty_cap)
+    {
+        int cap = dirty_cap ? dirty_cap * 2 : 64;
+        proxy_io_t **p = (proxy_io_t **)realloc(dirty, sizeof(proxy_io_t *) * (size_t)cap);
+        if (!p)
+            return; // 留给 EPOLLOUT 或下次写入时再发
+        dirty = p;
+        dirty_cap = cap;
+    }
+    dirty[ndirty++] = io;
+    io->dirty = 1;
+}
+
+static int append_tokens(kvs_buf_t *out, char **tokens, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (i > 0 && kvs_buf_append(out, " ", 1) != 0)
+            return -2;
+        if (kvs_buf_append(out, tokens[i], strlen(tokens[i])) != 0)
+            return -2;
+    }
+    return kvs_buf_append(out, "\n", 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// 请求
+
+static proxy_req_t *req_new(proxy_client_t *c, int kind, int nlines)
+{
+    proxy_req_t *req = (proxy_req_t *)calloc(1, sizeof(*req));
+    if (!req)
+        return NULL;
+    req->kind = kind;
+    req->nlines = nlines;
+    req->line = nlines == 1 ? &req->line1 : (char **)calloc((size_t)nlines, sizeof(char *));
+    if (!req->line)
+    {
+        free(req);
+        return NULL;
+    }
+
+    req->client = c;
+    if (c->tail)
+        c->tail->next = req;
+    else
+        c->head = req;
+    c->tail = req;
+    c->nreqs++;
+    return req;
+}
+
+static void req_free(proxy_req_t *req)
+{
+    for (int i = 0; i < req->nlines; i++)
+        free(req->line[i]);
+    if (req->line != &req->line1)
+        free(req->line);
+    free(req->owner);
+    free(req);
+}
+
+// SCAN 回复 "SCAN 后端游标 key..."：把后端游标换成带后端下标的游标
+static void render_scan(proxy_req_t *req, const char *line, kvs_buf_t *out)
+{
+    char *end = NULL;
+    if (strncmp(line, "SCAN ", 5) != 0)
+    {
+        kvs_buf_append(out, line, strlen(line));
+        return;
+    }
+    unsigned long v = strtoul(line + 5, &end, 10);
+    unsigned long n = (unsigned long)nnodes;
+    unsigned long node = (unsigned long)req->node;
+    unsigned long next = v != 0 ? v * n + node : (node + 1 < n ? node + 1 : 0);
+
+    char head[32];
+    int len = snprintf(head, sizeof(head), "SCAN %lu", next);
+    kvs_buf_append(out, head, (size_t)len);
+    kvs_buf_append(out, end, strlen(end));
+}
+
+static void req_render(proxy_req_t *req, kvs_buf_t *out)
+{
+    if (req->kind == PROXY_REQ_BROADCAST)
+    {
+        const char *line = "OK";
+        for (int i = 0; i < req->nlines; i++)
+        {
+            if (!req->line[i] || strcmp(req->line[i], "OK") != 0)
+            {
+                line = req->line[i] ? req->line[i] : PROXY_ERR_BACKEND;
+                break;
+            }
+        }
+        kvs_buf_append(out, line, strlen(line));
+        kvs_buf_append(out, "\r\n", 2);
+        return;
+    }
+
+    for (int i = 0; i < req->nlines; i++)
+    {
+        const char *line = req->line[i] ? req->line[i] : PROXY_ERR_BACKEND;
+        if (req->kind == PROXY_REQ_SCAN && req->line[i])
+            render_scan(req, line, out);
+        else
+            kvs_buf_append(out, line, strlen(line));
+        kvs_buf_append(out, "\r\n", 2);
+    }
+}
+
+// 队首起已收齐的请求按顺序写回；解析因在途请求过多而暂停的，腾出位置后继续
+static void client_deliver(proxy_client_t *c)
+{
+    int any = 0;
+    while (c->head && c->head->pending == 0)
+    {
+        proxy_req_t *req = c->head;
+        c->head = req->next;
+        if (!c->head)
+            c->tail = NULL;
+        c->nreqs--;
+        req_render(req, &c->io.wbuf);
+        req_free(req);
+        any = 1;
+    }
+    if (any)
+        mark_dirty(&c->io);
+
+    if (c->blocked && c->nreqs < PROXY_MAX_PENDING)
+    {
+        c->blocked = 0;
+        client_process(c);
+    }
+}
+
+// 一个子请求结束（收齐或后端断开）
+static void req_done(proxy_req_t *req)
+{
+    if (--req->pending > 0)
+        return;
+    if (req->client)
+        client_deliver(req->client);
+    else
+        req_free(req);
+}
+
+static void local_reply(proxy_client_t *c, const char *line)
+{
+    proxy_req_t *req = req_new(c, PROXY_REQ_FORWARD, 1);
+    if (req)
+        req->line1 = strdup(line);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// 后端
+
+static void backend_fail(proxy_backend_t *b)
+{
+    proxy_node_t *node = &nodes[b->node];
+    if (b->io.fd >= 0)
+    {
+        printf("proxy: %s backend %s\n", b->connecting ? "failed to connect to" : "lost", node->name);
+        epoll_ctl(epfd, EPOLL_CTL_DEL, b->io.fd, NULL);
+        close(b->io.fd);
+    }
+    b->io.fd = -1;
+    b->io.want_out = 0;
+    b->io.rbuf.len = 0;
+    b->io.wbuf.len = 0;
+    b->connecting = 0;
+    b->retry_ms = now_ms() + PROXY_RETRY_MS;
+
+    // 在途子请求缺的行保持 NULL，回复 PROXY_ERR_BACKEND
+    while (b->count > 0)
+    {
+        proxy_req_t *req = b->waits[b->head].req;
+        b->head = (b->head + 1) % b->cap;
+        b->count--;
+        req_done(req);
+    }
+}
+
+static int backend_connect(proxy_backend_t *b)
+{
+    proxy_node_t *node = &nodes[b->node];
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&node->addr, sizeof(node->addr)) != 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    // 连上之前的请求先攒在 wbuf，EPOLLOUT 表示连接完成
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = &b->io;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    b->io.fd = fd;
+    b->io.want_out = 1;
+    b->connecting = 1;
+    return 0;
+}
+
+// 客户端 c 发往 node 的请求走的连接；不可用时返回 NULL
+static proxy_backend_t *backend_get(proxy_client_t *c, int node)
+{
+    proxy_backend_t *b = &nodes[node].pool[c->id % (unsigned)opts.pool];
+    if (b->io.fd >= 0)
+        return b;
+    if (now_ms() < b->retry_ms)
+        return NULL;
+    if (backend_connect(b) != 0)
+    {
+        printf("proxy: failed to connect to backend %s\n", nodes[node].name);
+        b->retry_ms = now_ms() + PROXY_RETRY_MS;
+        return NULL;
+    }
+    return b;
+}
+
+static int backend_push(proxy_backend_t *b, proxy_req_t *req, int nlines)
+{
+    if (b->count == b->cap)
+    {
+        size_t cap = b->cap ? b->cap * 2 : 64;
+        proxy_wait_t *w = (proxy_wait_t *)malloc(sizeof(proxy_wait_t) * cap);
+        if (!w)
+            return -2;
+        for (size_t i = 0; i < b->count; i++)
+            w[i] = b->waits[(b->head + i) % b->cap];
+        free(b->waits);
+        b->waits = w;
+        b->head = 0;
+        b->cap = cap;
+    }
+
+    proxy_wait_t *w = &b->waits[(b->head + b->count) % b->cap];
+    w->req = req;
+    w->remaining = nlines;
+    w->cursor = 0;
+    b->count++;
+    return 0;
+}
+
+// 把子请求发往 node，期待 nlines 行回复；失败时对应的行保持 NULL
+static void backend_send(proxy_client_t *c, int node, proxy_req_t *req, char **tokens, int count, int nlines)
+{
+    proxy_backend_t *b = backend_get(c, node);
+    if (!b)
+        return;
+
+    size_t len = b->io.wbuf.len;
+    if (append_tokens(&b->io.wbuf, tokens, count) != 0 || backend_push(b, req, nlines) != 0)
+    {
+        b->io.wbuf.len = len;
+        return;
+    }
+    req->pending++;
+    mark_dirty(&b->io);
+}
+
+static int backend_on_line(proxy_backend_t *b, char *line, size_t len)
+{
+    if (b->count == 0)
+        return -1; // 没有在途请求却收到回复：连接状态已乱
+
+    proxy_wait_t *w = &b->waits[b->head];
+    proxy_req_t *req = w->req;
+
+    int slot = w->cursor;
+    if (req->owner)
+    {
+        while (slot < req->nlines && req->owner[slot] != b->node)
+            slot++;
+    }
+    if (slot >= req->nlines)
+        return -1;
+    w->cursor = slot + 1;
+
+    if (len > 0 && line[len - 1] == '\r')
+        len--;
+    req->line[slot] = strndup(line, len);
+
+    if (--w->remaining > 0)
+        return 0;
+
+    // 先出队再结束：结束时可能恢复客户端解析，继续往这条连接追加请求
+    b->head = (b->head + 1) % b->cap;
+    b->count--;
+    req_done(req);
+    return 0;
+}
+
+static void backend_on_event(proxy_backend_t *b, uint32_t events)
+{
+    if (b->connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(b->io.fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+        {
+            backend_fail(b);
+            return;
+        }
+        b->connecting = 0;
+    }
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        backend_fail(b);
+        return;
+    }
+    if ((events & EPOLLOUT) && io_flush(&b->io) != 0)
+    {
+        backend_fail(b);
+        return;
+    }
+    if (!(events & EPOLLIN))
+        return;
+
+    int rc = io_read(&b->io);
+
+    size_t off = 0;
+    while (off < b->io.rbuf.len)
+    {
+        char *line = b->io.rbuf.data + off;
+        char *nl = memchr(line, '\n', b->io.rbuf.len - off);
+        if (!nl)
+            break;
+        off = (size_t)(nl - b->io.rbuf.data) + 1;
+        if (backend_on_line(b, line, (size_t)(nl - line)) != 0)
+        {
+            rc = -1;
+            break;
+        }
+    }
+    kvs_buf_consume(&b->io.rbuf, off);
+
+    if (rc != 0)
+        backend_fail(b);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// 客户端
+
+static void client_free(proxy_client_t *c)
+{
+    kvs_buf_free(&c->io.rbuf);
+    kvs_buf_free(&c->io.wbuf);
+    free(c);
+}
+
+static void client_close(proxy_client_t *c)
+{
+    if (c->io.closed)
+        return;
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->io.fd, NULL);
+    close(c->io.fd);
+    c->io.fd = -1;
+    c->io.closed = 1;
+
+    // 还在等后端回复的请求留给最后一个回复释放
+    for (proxy_req_t *req = c->head, *next; req; req = next)
+    {
+        next = req->next;
+        if (req->pending > 0)
+            req->client = NULL;
+        else
+            req_free(req);
+    }
+    c->head = c->tail = NULL;
+    c->nreqs = 0;
+
+    // 在本轮待发送列表里的由 flush_dirty 释放
+    if (!c->io.dirty)
+        client_free(c);
+}
+
+// MGET/MSET：key 全在同一后端时原样转发，否则按属主拆开，每个后端一个子请求
+static void dispatch_batch(proxy_client_t *c, char **tokens, int count, int stride)
+{
+    int n = (count - 1) / stride;
+    int *owner = (int *)malloc(sizeof(int) * (size_t)n);
+    char **sub = (char **)mp_alloc(arena, sizeof(char *) * (size_t)count);
+    proxy_req_t *req = req_new(c, PROXY_REQ_FORWARD, n);
+    if (!owner || !sub || !req)
+    {
+        free(owner);
+        if (!req)
+            local_reply(c, "ERROR");
+        return; // 各行为 NULL，回复错误
+    }
+
+    int split = 0;
+    for (int i = 0; i < n; i++)
+    {
+        owner[i] = kvs_chash_owner(&ring, tokens[1 + i * stride]);
+        split |= owner[i] != owner[0];
+    }
+    if (!split)
+    {
+        int node = owner[0];
+        free(owner);
+        backend_send(c, node, req, tokens, count, n);
+        return;
+    }
+
+    req->owner = owner;
+    for (int node = 0; node < nnodes; node++)
+    {
+        int subcount = 1, keys = 0;
+        sub[0] = tokens[0];
+        for (int i = 0; i < n; i++)
+        {
+            if (owner[i] != node)
+                continue;
+            for (int j = 0; j < stride; j++)
+                sub[subcount++] = tokens[1 + i * stride + j];
+            keys++;
+        }
+        if (keys > 0)
+            backend_send(c, node, req, sub, subcount, keys);
+    }
+}
+
+static void dispatch(proxy_client_t *c, char **tokens, int count)
+{
+    int cmd = kvs_protocol_command(tokens[0]);
+    proxy_req_t *req;
+
+    switch (cmd)
+    {
+    case KVS_CMD_STATS:
+    case KVS_CMD_MEMORY:
+    case KVS_CMD_PSYNC:
+    case KVS_CMD_ROLE:
+    case KVS_CMD_CLUSTER:
+        local_reply(c, "ERROR not supported by proxy");
+        return;
+
+    case KVS_CMD_FLUSH:
+        req = req_new(c, PROXY_REQ_BROADCAST, nnodes);
+        if (!req)
+        {
+            local_reply(c, "ERROR");
+            return;
+        }
+        if (nnodes > 1 && !(req->owner = (int *)malloc(sizeof(int) * (size_t)nnodes)))
+            return; // 各行为 NULL，回复错误
+        for (int node = 0; node < nnodes; node++)
+        {
+            if (req->owner)
+                req->owner[node] = node;
+            backend_send(c, node, req, tokens, count, 1);
+        }
+        return;
+
+    case KVS_CMD_SCAN:
+    {
+        int node = kvs_protocol_cursor_owner(tokens, count, nnodes);
+        if (node < 0)
+            break; // 单个后端或游标不合法：原样转发给第一个后端
+        char *cursor = (char *)mp_alloc(arena, 32);
+        if (!cursor || !(req = req_new(c, PROXY_REQ_SCAN, 1)))
+        {
+            local_reply(c, "ERROR");
+            return;
+        }
+        req->node = node;
+        snprintf(cursor, 32, "%lu", strtoul(tokens[1], NULL, 10) / (unsigned long)nnodes);
+        tokens[1] = cursor;
+        backend_send(c, node, req, tokens, count, 1);
+        return;
+    }
+    }
+
+    int stride = kvs_protocol_batch(tokens, count);
+    if (stride > 0 && count >= 1 + stride && (count - 1) % stride == 0)
+    {
+        dispatch_batch(c, tokens, count, stride);
+        return;
+    }
+
+    // 单 key 请求按 key 路由；不带 key 的（参数不对、未知命令）交给第一个后端回复错误
+    const char *key = kvs_protocol_key(tokens, count);
+    req = req_new(c, PROXY_REQ_FORWARD, 1);
+    if (!req)
+    {
+        local_reply(c, "ERROR");
+        return;
+    }
+    backend_send(c, key ? kvs_chash_owner(&ring, key) : 0, req, tokens, count, 1);
+}
+
+static void client_process(proxy_client_t *c)
+{
+    size_t off = 0;
+
+    while (off < c->io.rbuf.len)
+    {
+        if (c->nreqs >= PROXY_MAX_PENDING)
+        {
+            c->blocked = 1;
+            break;
+        }
+
+        char *line = c->io.rbuf.data + off;
+        char *nl = memchr(line, '\n', c->io.rbuf.len - off);
+        if (!nl)
+            break;
+
+        *nl = '\0';
+        int count = 0;
+        char **tokens = kvs_protocol_tokenize(arena, line, &count);
+        if (!tokens)
+        {
+            kvs_protocol_join(line, nl);
+            *nl = '\n';
+            break; // arena 分配失败：留到下次再处理
+        }
+        off = (size_t)(nl - c->io.rbuf.data) + 1;
+
+        if (count > 0)
+            dispatch(c, tokens, count);
+        mp_reset_pool(arena);
+    }
+    mp_reset_pool(arena);
+
+    kvs_buf_consume(&c->io.rbuf, off);
+    client_deliver(c); // 本地直接回复的请求
+}
+
+static void client_on_event(proxy_client_t *c, uint32_t events)
+{
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        client_close(c);
+        return;
+    }
+    if ((events & EPOLLOUT) && io_flush(&c->io) != 0)
+    {
+        client_close(c);
+        return;
+    }
+    if (!(events & EPOLLIN))
+        return;
+
+    if (io_read(&c->io) != 0)
+    {
+        client_close(c);
+        return;
+    }
+    client_process(c);
+}
+
+static void on_accept(void)
+{
+    for (;;)
+    {
+        int fd = accept4(listener.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        proxy_client_t *c = (proxy_client_t *)calloc(1, sizeof(*c));
+        if (!c)
+        {
+            close(fd);
+            continue;
+        }
+        c->io.fd = fd;
+        c->io.kind = PROXY_IO_CLIENT;
+        c->id = next_client_id++;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &c->io;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            close(fd);
+            client_free(c);
+        }
+    }
+}
+
+// 发送过程中可能有后端断开、回复错误给客户端，列表会继续增长
+static void flush_dirty(void)
+{
+    for (int i = 0; i < ndirty; i++)
+    {
+        proxy_io_t *io = dirty[i];
+        io->dirty = 0;
+
+        if (io->kind == PROXY_IO_CLIENT)
+        {
+            proxy_client_t *c = (proxy_client_t *)io;
+            if (io->closed)
+                client_free(c);
+            else if (io_flush(io) != 0)
+                client_close(c);
+        }
+        else
+        {
+            proxy_backend_t *b = (proxy_backend_t *)io;
+            if (io->fd >= 0 && !b->connecting && io_flush(io) != 0)
+                backend_fail(b);
+        }
+    }
+    ndirty = 0;
+}
+
+static int proxy_listen(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)opts.port);
+    if (inet_pton(AF_INET, opts.bind_ip, &addr.sin_addr) != 1)
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1024) != 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// host:port
+static int parse_node(proxy_node_t *node, const char *spec)
+{
+    char host[64];
+    const char *colon = strrchr(spec, ':');
+    if (!colon || colon == spec || (size_t)(colon - spec) >= sizeof(host))
+        return -1;
+    memcpy(host, spec, (size_t)(colon - spec));
+    host[colon - spec] = '\0';
+
+    int port = atoi(colon + 1);
+    if (port <= 0 || port > 65535)
+        return -1;
+
+    memset(&node->addr, 0, sizeof(node->addr));
+    node->addr.sin_family = AF_INET;
+    node->addr.sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, host, &node->addr.sin_addr) != 1)
+        return -1;
+    node->name = spec;
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options] host:port...\n"
+            "  -h, --bind IP           listen address (0.0.0.0)\n"
+            "  -p, --port PORT         listen port (2100)\n"
+            "  -v, --vnodes N          virtual nodes per backend (%d)\n"
+            "  -c, --pool N            connections per backend (4)\n",
+            prog, KVS_CHASH_VNODES);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option longopts[] = {
+        {"bind", required_argument, NULL, 'h'},
+        {"port", required_argument, NULL, 'p'},
+        {"vnodes", required_argument, NULL, 'v'},
+        {"pool", required_argument, NULL, 'c'},
+        {"help", no_argument, NULL, 'H'},
+        {NULL, 0, NULL, 0}};
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "h:p:v:c:H", longopts, NULL)) != -1)
+    {
+        switch (ch)
+        {
+        case 'h': opts.bind_ip = optarg; break;
+        case 'p': opts.port = atoi(optarg); break;
+        case 'v': opts.vnodes = atoi(optarg); break;
+        case 'c': opts.pool = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    nnodes = argc - optind;
+    if (nnodes < 1 || nnodes > KVS_CHASH_MAX_NODES || opts.vnodes < 1 || opts.pool < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *names[KVS_CHASH_MAX_NODES];
+    for (int i = 0; i < nnodes; i++)
+    {
+        if (parse_node(&nodes[i], argv[optind + i]) != 0)
+        {
+            fprintf(stderr, "invalid backend %s\n", argv[optind + i]);
+            return 1;
+        }
+        names[i] = nodes[i].name;
+
+        nodes[i].pool = (proxy_backend_t *)calloc((size_t)opts.pool, sizeof(proxy_backend_t));
+        if (!nodes[i].pool)
+            return 1;
+        for (int j = 0; j < opts.pool; j++)
+        {
+            nodes[i].pool[j].io.fd = -1;
+            nodes[i].pool[j].io.kind = PROXY_IO_BACKEND;
+            nodes[i].pool[j].node = i;
+        }
+    }
+    if (kvs_chash_create(&ring, names, nnodes, opts.vnodes) != 0)
+    {
+        fprintf(stderr, "build hash ring failed\n");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    arena = mp_create_pool(PROXY_ARENA_SIZE);
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    listener.fd = proxy_listen();
+    if (!arena || epfd < 0 || listener.fd < 0)
+    {
+        fprintf(stderr, "proxy: listen on %s:%d failed: %s\n", opts.bind_ip, opts.port, strerror(errno));
+        return 1;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listener;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listener.fd, &ev);
+
+    printf("proxy: listening on %s:%d, %d backend(s), %d vnodes, pool %d\n", opts.bind_ip, opts.port, nnodes,
+           opts.vnodes, opts.pool);
+    fflush(stdout);
+
+    struct epoll_event events[PROXY_MAX_EVENTS];
+    for (;;)
+    {
+        int n = epoll_wait(epfd, events, PROXY_MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < n; i++)
+        {
+            proxy_io_t *io = (proxy_io_t *)events[i].data.ptr;
+            if (io->kind == PROXY_IO_LISTEN)
+                on_accept();
+            else if (io->kind == PROXY_IO_CLIENT)
+                client_on_event((proxy_client_t *)io, events[i].events);
+            else
+                backend_on_event((proxy_backend_t *)io, events[i].events);
+        }
+        flush_dirty();
+    }
+    return 1;
+}
@@ -1,15 +1,102 @@
 #include "allocator/kvs_alloc.h"
+#include <malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #ifdef USE_JEMALLOC
 #include <jemalloc/jemalloc.h>
 #endif
 
+// 每个线程一份，只有所属线程写；汇总时容忍读到正在更新的计数
+// 跨线程释放记在释放方名下，单线程的值可能为负，汇总后正确
+typedef struct kvs_alloc_thread_s
+{
+    _Atomic uint64_t malloc_calls;
+    _Atomic uint64_t free_calls;
+    _Atomic int64_t requested;
+    _Atomic int64_t reserved;
+    _Atomic int64_t live[KVS_ALLOC_CLASSES];
+
+    _Atomic int64_t pool_bytes; // mypool node 占用，随 node 增长覆盖写
+    _Atomic uint64_t pool_nodes;
+    _Atomic uint64_t pool_large;
+    _Atomic int64_t pool_abandoned;
+
+    struct kvs_alloc_thread_s *next;
+} kvs_alloc_thread_t;
+
+static kvs_alloc_thread_t *g_threads = NULL;
+static pthread_mutex_t g_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread kvs_alloc_thread_t *t_stats = NULL;
+
+static void *system_malloc_wrap(size_t size);
+static void system_free_wrap(void *ptr, size_t size);
+
 // 默认：system malloc/free
-static void *(*g_malloc_fn)(size_t) = malloc;
-static void (*g_free_fn)(void *) = free;
+static void *(*g_malloc_fn)(size_t) = system_malloc_wrap;
+static void (*g_free_fn)(void *, size_t) = system_free_wrap;
+static const char *g_alloc_name = "system";
+
+static kvs_alloc_thread_t *alloc_register(void)
+{
+    kvs_alloc_thread_t *t = (kvs_alloc_thread_t *)calloc(1, sizeof(*t));
+    if (!t)
+        abort();
+
+    pthread_mutex_lock(&g_threads_lock);
+    t->next = g_threads;
+    g_threads = t;
+    pthread_mutex_unlock(&g_threads_lock);
+
+    t_stats = t;
+    return t;
+}
+
+static inline kvs_alloc_thread_t *local_stats(void)
+{
+    kvs_alloc_thread_t *t = t_stats;
+    return t ? t : alloc_register();
+}
+
+// 单写者：load + store 即可，不需要 lock 前缀
+static inline void stat_add(_Atomic int64_t *c, int64_t v)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+static inline void stat_inc(_Atomic uint64_t *c)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+static inline int size_class(size_t size)
+{
+    if (size <= 8)
+        return 0;
+    int cls = 64 - __builtin_clzll((unsigned long long)(size - 1)) - 3;
+    return cls < KVS_ALLOC_CLASSES ? cls : KVS_ALLOC_CLASSES - 1;
+}
+
+static void *system_malloc_wrap(size_t size)
+{
+    void *p = malloc(size);
+    if (p)
+        stat_add(&t_stats->reserved, (int64_t)malloc_usable_size(p));
+    return p;
+}
+
+static void system_free_wrap(void *ptr, size_t size)
+{
+    (void)size;
+    stat_add(&t_stats->reserved, -(int64_t)malloc_usable_size(ptr));
+    free(ptr);
+}
 
 #define MP_ALIGNMENT 32
 #define MP_PAGE_SIZE 4096
@@ -18,39 +105,142 @@ static void (*g_free_fn)(void *) = free;
 #define mp_align(n, alignment) (((n) + (alignment - 1)) & ~(alignment - 1))
 #define mp_align_ptr(p, alignment) (void *)((((size_t)p) + (alignment - 1)) & ~(alignment - 1))
 
-struct mp_pool_s *global_pool = NULL;
+#define KVS_HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define KVS_HUGE_REGION_SIZE (64UL * 1024 * 1024) // 每次向内核要一段，按需缺页
+
+// 每个线程独立一个 pool：shard-per-core 下各 shard 只访问自己的 pool，无需加锁
+static __thread struct mp_pool_s *global_pool = NULL;
+static __thread struct mp_pool_s *old_pool = NULL; // 碎片整理期间被换下的 pool，搬空后整体释放
+
+static kvs_hugepage_mode_t g_hugepage_mode = KVS_HUGEPAGE_OFF;
+
+// 本线程当前的大页区域，pool node 从这里顺序切出，区域不回收
+static __thread unsigned char *t_region_cur = NULL;
+static __thread unsigned char *t_region_end = NULL;
+
+static void *region_map(size_t len, kvs_hugepage_mode_t mode)
+{
+#ifdef MAP_HUGETLB
+    if (mode == KVS_HUGEPAGE_HUGETLB)
+    {
+        void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+            return p;
+        // 预留的大页用完了，后续区域退回 THP
+    }
+#endif
+
+    // 多映射一个大页再对齐，THP 才能整页折叠
+    unsigned char *raw = mmap(NULL, len + KVS_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+
+    unsigned char *p = (unsigned char *)mp_align((size_t)raw, KVS_HUGE_PAGE_SIZE);
+    if (p > raw)
+        munmap(raw, (size_t)(p - raw));
+    munmap(p + len, (size_t)(raw + KVS_HUGE_PAGE_SIZE - p));
+#ifdef MADV_HUGEPAGE
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+static void *region_alloc(size_t size)
+{
+    size = mp_align(size, MP_ALIGNMENT);
+    if (!t_region_cur || (size_t)(t_region_end - t_region_cur) < size)
+    {
+        size_t len = size > KVS_HUGE_REGION_SIZE ? mp_align(size, KVS_HUGE_PAGE_SIZE) : KVS_HUGE_REGION_SIZE;
+        unsigned char *p = region_map(len, g_hugepage_mode);
+        if (!p)
+            return NULL;
+        // 旧区域剩下的尾巴直接丢弃
+        t_region_cur = p;
+        t_region_end = p + len;
+    }
+
+    void *m = t_region_cur;
+    t_region_cur += size;
+    return m;
+}
+
+static void *mp_node_alloc(struct mp_pool_s *pool, size_t size)
+{
+    if (pool && pool->huge)
+        return region_alloc(size);
+
+    void *m;
+    return posix_memalign(&m, MP_ALIGNMENT, size) == 0 ? m : NULL;
+}
+
+static int64_t mypool_bytes(struct mp_pool_s *pool)
+{
+    size_t psize = (size_t)(pool->head->end - (unsigned char *)pool->head);
+    return (int64_t)(pool->nodes * psize + sizeof(struct mp_pool_s));
+}
+
+// 把本线程 pool 的 node/large 规模同步到统计（只在变化时调用）
+static void mypool_publish(kvs_alloc_thread_t *t, struct mp_pool_s *pool)
+{
+    atomic_store_explicit(&t->pool_nodes, pool->nodes, memory_order_relaxed);
+    atomic_store_explicit(&t->pool_bytes, mypool_bytes(pool), memory_order_relaxed);
+    atomic_store_explicit(&t->pool_large, pool->nlarge, memory_order_relaxed);
+}
 
 static void *mypool_malloc_wrap(size_t size)
 {
+    kvs_alloc_thread_t *t = t_stats;
+
     if (!global_pool)
     {
-        global_pool = mp_create_pool(MP_PAGE_SIZE);
+        global_pool = g_hugepage_mode != KVS_HUGEPAGE_OFF ? mp_create_huge_pool(MP_PAGE_SIZE) : mp_create_pool(MP_PAGE_SIZE);
         if (!global_pool)
             return NULL;
+        mypool_publish(t, global_pool);
     }
-    return mp_nalloc(global_pool, size);
+
+    struct mp_pool_s *pool = global_pool;
+    size_t nodes = pool->nodes, nlarge = pool->nlarge;
+
+    // 引擎节点含指针，必须对齐
+    void *p = mp_alloc(pool, size);
+    if (!p)
+        return NULL;
+
+    if (size > pool->max)
+        stat_add(&t->reserved, (int64_t)malloc_usable_size(p));
+    if (pool->nodes != nodes || pool->nlarge != nlarge)
+        mypool_publish(t, pool);
+    return p;
 }
 
-static void mypool_free_wrap(void *ptr)
+static void mypool_free_wrap(void *ptr, size_t size)
 {
     if (!ptr || !global_pool)
         return;
-    mp_free(global_pool, ptr);
-}
 
-struct mp_pool_s *mp_create_pool(size_t size)
-{
-    struct mp_pool_s *p;
-
-    int ret = posix_memalign((void **)&p, MP_ALIGNMENT, size + sizeof(struct mp_pool_s) + sizeof(struct mp_node_s));
-    if (ret)
+    kvs_alloc_thread_t *t = t_stats;
+    if (size > global_pool->max)
     {
-        return NULL;
+        size_t usable = malloc_usable_size(ptr);
+        if (mp_free(global_pool, ptr) == 0 || (old_pool && mp_free(old_pool, ptr) == 0))
+        {
+            stat_add(&t->reserved, -(int64_t)usable);
+            return;
+        }
     }
+    // 小块留在 node 里，直到整个 pool 销毁
+    stat_add(&t->pool_abandoned, (int64_t)size);
+}
 
+static struct mp_pool_s *mp_init_pool(struct mp_pool_s *p, size_t size, int huge)
+{
     p->max = (size < MP_MAX_ALLOC_FROM_POOL) ? size : MP_MAX_ALLOC_FROM_POOL;
     p->current = p->head;
     p->large = NULL;
+    p->huge = huge;
+    p->nodes = 1;
+    p->nlarge = 0;
 
     p->head->last = (unsigned char *)p + sizeof(struct mp_pool_s) + sizeof(struct mp_node_s);
     p->head->end = p->head->last + size;
@@ -60,6 +250,21 @@ struct mp_pool_s *mp_create_pool(size_t size)
     return p;
 }
 
+struct mp_pool_s *mp_create_pool(size_t size)
+{
+    struct mp_pool_s *p = mp_node_alloc(NULL, size + sizeof(struct mp_pool_s) + sizeof(struct mp_node_s));
+    return p ? mp_init_pool(p, size, 0) : NULL;
+}
+
+struct mp_pool_s *mp_create_huge_pool(size_t size)
+{
+    if (g_hugepage_mode == KVS_HUGEPAGE_OFF)
+        return mp_create_pool(size);
+
+    struct mp_pool_s *p = region_alloc(size + sizeof(struct mp_pool_s) + sizeof(struct mp_node_s));
+    return p ? mp_init_pool(p, size, 1) : NULL;
+}
+
 void mp_destory_pool(struct mp_pool_s *pool)
 {
     struct mp_node_s *h, *n;
@@ -73,6 +278,10 @@ void mp_destory_pool(struct mp_pool_s *pool)
         }
     }
 
+    // 大页 pool 的 node 随区域存活
+    if (pool->huge)
+        return;
+
     h = pool->head->next;
 
     while (h)
@@ -98,6 +307,7 @@ void mp_reset_pool(struct mp_pool_s *pool)
         }
     }
     pool->large = NULL;
+    pool->nlarge = 0;
 
     for (h = pool->head; h; h = h->next)
     {
@@ -139,6 +349,7 @@ static void *mp_alloc_large(struct mp_pool_s *pool, size_t size)
     large->alloc = p;
     large->next = pool->large;
     pool->large = large;
+    pool->nlarge++;
 
     return p;
 }
@@ -156,8 +367,8 @@ static void *mp_alloc_block(struct mp_pool_s *pool, size_t size)
         return NULL;
     }
 
-    int ret = posix_memalign((void **)&m, MP_ALIGNMENT, psize);
-    if (ret)
+    m = mp_node_alloc(pool, psize);
+    if (!m)
         return NULL;
 
     struct mp_node_s *p, *new_node, *current;
@@ -181,6 +392,7 @@ static void *mp_alloc_block(struct mp_pool_s *pool, size_t size)
         }
     }
     p->next = new_node;
+    pool->nodes++;
 
     pool->current = current ? current : new_node;
 
@@ -199,7 +411,8 @@ void *mp_alloc(struct mp_pool_s *pool, size_t size)
         do
         {
             m = mp_align_ptr(p->last, MP_ALIGNMENT);
-            if ((size_t)(p->end - m) >= size)
+            // 对齐后可能越过 end，先比较指针再算剩余空间
+            if (m <= p->end && (size_t)(p->end - m) >= size)
             {
                 p->last = m + size;
                 return m;
@@ -251,7 +464,7 @@ void *mp_calloc(struct mp_pool_s *pool, size_t size)
     return p;
 }
 
-void mp_free(struct mp_pool_s *pool, void *p)
+int mp_free(struct mp_pool_s *pool, void *p)
 {
     struct mp_large_s *l;
     for (l = pool->large; l; l = l->next)
@@ -260,14 +473,27 @@ void mp_free(struct mp_pool_s *pool, void *p)
         {
             free(l->alloc);
             l->alloc = NULL;
-            return;
+            return 0;
         }
     }
+    return 1;
 }
 
 #ifdef USE_JEMALLOC
-static void *je_malloc_wrap(size_t size) { return je_malloc(size); }
-static void je_free_wrap(void *ptr) { je_free(ptr); }
+static void *je_malloc_wrap(size_t size)
+{
+    void *p = je_malloc(size);
+    if (p)
+        stat_add(&t_stats->reserved, (int64_t)je_malloc_usable_size(p));
+    return p;
+}
+
+static void je_free_wrap(void *ptr, size_t size)
+{
+    (void)size;
+    stat_add(&t_stats->reserved, -(int64_t)je_malloc_usable_size(ptr));
+    je_free(ptr);
+}
 #endif
 
 void kvs_set_allocator(kvs_alloc_type_t type)
@@ -275,8 +501,9 @@ void kvs_set_allocator(kvs_alloc_type_t type)
     switch (type)
     {
     case KVS_ALLOC_SYSTEM:
-        g_malloc_fn = malloc;
-        g_free_fn = free;
+        g_malloc_fn = system_malloc_wrap;
+        g_free_fn = system_free_wrap;
+        g_alloc_name = "system";
         printf("Using system malloc/free\n");
         break;
 
@@ -284,35 +511,219 @@ void kvs_set_allocator(kvs_alloc_type_t type)
 #ifdef USE_JEMALLOC
         g_malloc_fn = je_malloc_wrap;
         g_free_fn = je_free_wrap;
+        g_alloc_name = "jemalloc";
         printf("Using jemalloc malloc/free\n");
         break;
 #else
         // 没启用 jemalloc 就降级 system
-        g_malloc_fn = malloc;
-        g_free_fn = free;
+        g_malloc_fn = system_malloc_wrap;
+        g_free_fn = system_free_wrap;
+        g_alloc_name = "system";
         printf("jemalloc requested but not compiled in, fallback to system malloc/free\n");
         break;
 #endif
     case KVS_ALLOC_MYPOOL:
         g_malloc_fn = mypool_malloc_wrap;
         g_free_fn = mypool_free_wrap;
+        g_alloc_name = "mypool";
         printf("Using mypool malloc/free\n");
         break;
     default:
         // 默认 system
-        g_malloc_fn = malloc;
-        g_free_fn = free;
+        g_malloc_fn = system_malloc_wrap;
+        g_free_fn = system_free_wrap;
+        g_alloc_name = "system";
         printf("Unknown allocator type, fallback to system malloc/free\n");
     }
 }
 
+kvs_hugepage_mode_t kvs_alloc_set_hugepages(int enabled)
+{
+    g_hugepage_mode = KVS_HUGEPAGE_OFF;
+    if (!enabled)
+        return g_hugepage_mode;
+
+    g_hugepage_mode = KVS_HUGEPAGE_THP;
+#ifdef MAP_HUGETLB
+    // 试映射一个大页，看系统是否预留了 hugetlb 页
+    void *p = mmap(NULL, KVS_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+    {
+        munmap(p, KVS_HUGE_PAGE_SIZE);
+        g_hugepage_mode = KVS_HUGEPAGE_HUGETLB;
+    }
+#endif
+    return g_hugepage_mode;
+}
+
 void *kvs_malloc(size_t size)
 {
-    return g_malloc_fn(size);
+    kvs_alloc_thread_t *t = local_stats();
+    stat_inc(&t->malloc_calls);
+
+    void *p = g_malloc_fn(size);
+    if (p)
+    {
+        stat_add(&t->requested, (int64_t)size);
+        stat_add(&t->live[size_class(size)], 1);
+    }
+    return p;
 }
 
-void kvs_free(void *ptr)
+void kvs_free(void *ptr, size_t size)
 {
     if (ptr)
-        g_free_fn(ptr);
-}
\ No newline at end of file
+    {
+        kvs_alloc_thread_t *t = local_stats();
+        stat_inc(&t->free_calls);
+        stat_add(&t->requested, -(int64_t)size);
+        stat_add(&t->live[size_class(size)], -1);
+        g_free_fn(ptr, size);
+    }
+}
+
+void kvs_alloc_counters(kvs_alloc_counters_t *out)
+{
+    if (!out)
+        return;
+    kvs_alloc_thread_t *t = local_stats();
+    out->malloc_calls = atomic_load_explicit(&t->malloc_calls, memory_order_relaxed);
+    out->free_calls = atomic_load_explicit(&t->free_calls, memory_order_relaxed);
+}
+
+static void thread_stats_add(kvs_alloc_stats_t *out, kvs_alloc_thread_t *t)
+{
+    out->malloc_calls += atomic_load_explicit(&t->malloc_calls, memory_order_relaxed);
+    out->free_calls += atomic_load_explicit(&t->free_calls, memory_order_relaxed);
+    out->requested += atomic_load_explicit(&t->requested, memory_order_relaxed);
+    out->reserved += atomic_load_explicit(&t->reserved, memory_order_relaxed) +
+                     atomic_load_explicit(&t->pool_bytes, memory_order_relaxed);
+    for (int i = 0; i < KVS_ALLOC_CLASSES; i++)
+        out->live[i] += atomic_load_explicit(&t->live[i], memory_order_relaxed);
+    out->pool_nodes += atomic_load_explicit(&t->pool_nodes, memory_order_relaxed);
+    out->pool_large += atomic_load_explicit(&t->pool_large, memory_order_relaxed);
+    out->pool_abandoned += atomic_load_explicit(&t->pool_abandoned, memory_order_relaxed);
+}
+
+void kvs_alloc_stats(kvs_alloc_stats_t *out)
+{
+    if (!out)
+        return;
+    memset(out, 0, sizeof(*out));
+
+    pthread_mutex_lock(&g_threads_lock);
+    for (kvs_alloc_thread_t *t = g_threads; t; t = t->next)
+        thread_stats_add(out, t);
+    pthread_mutex_unlock(&g_threads_lock);
+
+    if (out->requested > 0)
+        out->fragmentation = (double)out->reserved / (double)out->requested;
+}
+
+void kvs_alloc_thread_stats(kvs_alloc_stats_t *out)
+{
+    if (!out)
+        return;
+    memset(out, 0, sizeof(*out));
+    thread_stats_add(out, local_stats());
+    if (out->requested > 0)
+        out->fragmentation = (double)out->reserved / (double)out->requested;
+}
+
+int kvs_alloc_defrag_begin(void)
+{
+    kvs_alloc_thread_t *t = local_stats();
+
+    if (g_malloc_fn == system_malloc_wrap)
+    {
+        malloc_trim(0);
+        return 1;
+    }
+    if (g_malloc_fn != mypool_malloc_wrap)
+        return 0;
+    if (old_pool)
+        return -1; // 上一轮还没结束
+    if (!global_pool)
+        return 0;
+    if (global_pool->huge)
+        return -1; // 大页区域不单独归还，搬了也省不下内存
+
+    struct mp_pool_s *fresh = mp_create_pool(MP_PAGE_SIZE);
+    if (!fresh)
+        return -2;
+
+    // 旧 pool 的占用转入 reserved，直到 end 时整体释放
+    old_pool = global_pool;
+    global_pool = fresh;
+    stat_add(&t->reserved, mypool_bytes(old_pool));
+    mypool_publish(t, global_pool);
+    return 0;
+}
+
+void kvs_alloc_defrag_end(void)
+{
+    kvs_alloc_thread_t *t = local_stats();
+
+    if (old_pool)
+    {
+        stat_add(&t->reserved, -mypool_bytes(old_pool));
+        mp_destory_pool(old_pool);
+        old_pool = NULL;
+        // 废弃的小块随旧 pool 一起归还；整理期间新 pool 上的少量废弃不再单独统计
+        atomic_store_explicit(&t->pool_abandoned, 0, memory_order_relaxed);
+        // pool 的 node 来自 glibc，还需要 trim 才会真正还给系统
+        malloc_trim(0);
+        return;
+    }
+
+#ifdef USE_JEMALLOC
+    if (g_malloc_fn == je_malloc_wrap)
+    {
+        // MALLCTL_ARENAS_ALL：清理所有 arena 的脏页
+        je_mallctl("arena.4096.purge", NULL, NULL, NULL, 0);
+        return;
+    }
+#endif
+}
+
+void *kvs_alloc_move(void *ptr, size_t size)
+{
+    if (!ptr)
+        return NULL;
+
+    void *p = kvs_malloc(size);
+    if (!p)
+        return ptr;
+    memcpy(p, ptr, size);
+    kvs_free(ptr, size);
+    return p;
+}
+
+size_t kvs_alloc_class_size(int cls)
+{
+    if (cls < 0 || cls >= KVS_ALLOC_CLASSES)
+        return 0;
+    return (size_t)8 << cls;
+}
+
+int kvs_alloc_is_pool(void)
+{
+    return g_malloc_fn == mypool_malloc_wrap;
+}
+
+long kvs_alloc_rss(void)
+{
+    long pages = 0, resident = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (!fp)
+        return 0;
+    if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        resident = 0;
+    fclose(fp);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+const char *kvs_alloc_name(void)
+{
+    return g_alloc_name;
+}
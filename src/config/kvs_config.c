@@ -32,6 +32,15 @@ static int parse_allocator(kvs_config_t *cfg, const char *v)
     return 0;
 }
 
+static int parse_bool(const char *v)
+{
+    if (streq(v, "yes") || streq(v, "on") || streq(v, "1"))
+        return 1;
+    if (streq(v, "no") || streq(v, "off") || streq(v, "0"))
+        return 0;
+    return -1;
+}
+
 static int parse_network(kvs_config_t *cfg, const char *v)
 {
     if (streq(v, "reactor"))
@@ -45,6 +54,33 @@ static int parse_network(kvs_config_t *cfg, const char *v)
     return 0;
 }
 
+void kvs_config_default(kvs_config_t *cfg)
+{
+    if (!cfg)
+        return;
+    memset(cfg, 0, sizeof(*cfg));
+    snprintf(cfg->bind_ip, sizeof(cfg->bind_ip), "%s", "0.0.0.0");
+    cfg->port = 2000;
+    cfg->allocator = KVS_ALLOC_MYPOOL;
+    cfg->network = KVS_NET_REACTOR;
+    cfg->shards = 1;
+    cfg->io_threads = 0;
+    cfg->latency_stats = 1;
+    cfg->hugepages = 0;
+    cfg->defrag = 0;
+    cfg->defrag_threshold = 1.5;
+    cfg->lazyfree = 0;
+    cfg->replicaof_ip[0] = '\0';
+    cfg->replicaof_port = 0;
+    cfg->repl_backlog_size = 1024 * 1024;
+    cfg->cluster = 0;
+    cfg->cluster_slot_lo = 0;
+    cfg->cluster_slot_hi = 16383;
+    cfg->vlog_dir[0] = '\0';
+    cfg->vlog_threshold = 4096;
+    cfg->compress_threshold = 0;
+}
+
 int kvs_config_load_file(kvs_config_t *cfg, const char *path)
 {
     FILE *fp = fopen(path, "r");
@@ -103,6 +139,135 @@ int kvs_config_load_file(kvs_config_t *cfg, const char *path)
                 return -3;
             }
         }
+        else if (streq(key, "shards"))
+        {
+            cfg->shards = atoi(val);
+            if (cfg->shards < 1)
+                cfg->shards = 1;
+        }
+        else if (streq(key, "io_threads"))
+        {
+            cfg->io_threads = atoi(val);
+            if (cfg->io_threads < 0)
+                cfg->io_threads = 0;
+        }
+        else if (streq(key, "latency_stats"))
+        {
+            cfg->latency_stats = parse_bool(val);
+            if (cfg->latency_stats < 0)
+            {
+                fclose(fp);
+                return -4;
+            }
+        }
+        else if (streq(key, "hugepages"))
+        {
+            cfg->hugepages = parse_bool(val);
+            if (cfg->hugepages < 0)
+            {
+                fclose(fp);
+                return -5;
+            }
+        }
+        else if (streq(key, "defrag"))
+        {
+            cfg->defrag = parse_bool(val);
+            if (cfg->defrag < 0)
+            {
+                fclose(fp);
+                return -6;
+            }
+        }
+        else if (streq(key, "defrag_threshold"))
+        {
+            cfg->defrag_threshold = atof(val);
+            if (cfg->defrag_threshold < 1.0)
+                cfg->defrag_threshold = 1.0;
+        }
+        else if (streq(key, "lazyfree"))
+        {
+            cfg->lazyfree = parse_bool(val);
+            if (cfg->lazyfree < 0)
+            {
+                fclose(fp);
+                return -7;
+            }
+        }
+        else if (streq(key, "replicaof"))
+        {
+            // replicaof <ip> <port>；replicaof no 为不做从
+            int port = 0;
+            char ip[64];
+            if (streq(val, "no"))
+            {
+                cfg->replicaof_ip[0] = '\0';
+                cfg->replicaof_port = 0;
+            }
+            else if (sscanf(val, "%63s %d", ip, &port) == 2 && port > 0 && port < 65536)
+            {
+                snprintf(cfg->replicaof_ip, sizeof(cfg->replicaof_ip), "%s", ip);
+                cfg->replicaof_port = port;
+            }
+            else
+            {
+                fclose(fp);
+                return -8;
+            }
+        }
+        else if (streq(key, "repl_backlog_size"))
+        {
+            long long size = atoll(val);
+            cfg->repl_backlog_size = size < 16 * 1024 ? 16 * 1024 : (size_t)size;
+        }
+        else if (streq(key, "cluster"))
+        {
+            cfg->cluster = parse_bool(val);
+            if (cfg->cluster < 0)
+            {
+                fclose(fp);
+                return -9;
+            }
+        }
+        else if (streq(key, "cluster_slots"))
+        {
+            // cluster_slots <lo>-<hi>；none 为启动时不负责任何 slot（等待迁入）
+            int lo, hi;
+            if (streq(val, "none"))
+            {
+                cfg->cluster_slot_lo = -1;
+                cfg->cluster_slot_hi = -1;
+            }
+            else if (sscanf(val, "%d-%d", &lo, &hi) == 2 && lo >= 0 && lo <= hi && hi < 16384)
+            {
+                cfg->cluster_slot_lo = lo;
+                cfg->cluster_slot_hi = hi;
+            }
+            else
+            {
+                fclose(fp);
+                return -10;
+            }
+        }
+        else if (streq(key, "vlog_dir"))
+        {
+            // vlog_dir no 为不分离
+            if (streq(val, "no"))
+                cfg->vlog_dir[0] = '\0';
+            else
+                snprintf(cfg->vlog_dir, sizeof(cfg->vlog_dir), "%s", val);
+        }
+        else if (streq(key, "vlog_threshold"))
+        {
+            // 能内嵌的短 value 不会写入日志
+            long long size = atoll(val);
+            cfg->vlog_threshold = size < 24 ? 24 : (size_t)size;
+        }
+        else if (streq(key, "compress_threshold"))
+        {
+            // compress_threshold no 为不压缩
+            long long size = streq(val, "no") ? 0 : atoll(val);
+            cfg->compress_threshold = size < 0 ? 0 : (size_t)size;
+        }
         else
         {
             // 未识别 key：建议“忽略但可日志提示”，这里先忽略
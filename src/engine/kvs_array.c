@@ -1,4 +1,6 @@
 #include "engine/kvs_array.h"
+#include "engine/kvs_lazyfree.h"
+#include "engine/kvs_value.h"
 
 // singleton
 
@@ -44,18 +46,14 @@ void kvs_array_destory(kvs_array_t *inst)
 
             if (inst->table[i].key)
             {
-                kvs_free(inst->table[i].key);
+                kvs_free_str(inst->table[i].key);
                 inst->table[i].key = NULL;
             }
 
-            if (inst->table[i].value)
-            {
-                kvs_free(inst->table[i].value);
-                inst->table[i].value = NULL;
-            }
+            kvs_value_free(&inst->table[i].value);
         }
 
-        kvs_free(inst->table);
+        kvs_free(inst->table, KVS_ARRAY_SIZE * sizeof(kvs_array_item_t));
         inst->table = NULL;
     }
 
@@ -64,65 +62,143 @@ void kvs_array_destory(kvs_array_t *inst)
 }
 
 /*
- * @return: <0, error; =0, success; >0, exist
+ * 一次扫描定位 key：找到返回下标；否则返回 -1，*hole 为可写入的槽位
+ * （第一个空洞，没有空洞时为 total；已满时为 -1）
  */
-
-int kvs_array_set(kvs_array_t *inst, char *key, char *value)
+static int kvs_array_locate(kvs_array_t *inst, const char *key, int *hole)
 {
+    *hole = -1;
 
-    if (inst == NULL || inst->table == NULL || key == NULL || value == NULL)
-        return -1;
-
-    char *str = kvs_array_get(inst, key);
-    if (str)
+    int i = 0;
+    for (i = 0; i < inst->total; i++)
     {
-        return 1; //
+        if (inst->table[i].key == NULL)
+        {
+            if (*hole < 0)
+                *hole = i;
+            continue;
+        }
+
+        if (strcmp(inst->table[i].key, key) == 0)
+            return i;
     }
 
-    char *kcopy = kvs_malloc(strlen(key) + 1);
+    if (*hole < 0 && inst->total < KVS_ARRAY_SIZE)
+        *hole = inst->total;
+    return -1;
+}
+
+/*
+ * 写入 kvs_array_locate 给出的槽位：填补空洞时 total 不变，追加到末尾时 total++
+ */
+static int kvs_array_fill(kvs_array_t *inst, int slot, char *key, char *value)
+{
+    if (slot < 0)
+        return -1; // 已满
+
+    char *kcopy = kvs_strdup(key);
     if (kcopy == NULL)
         return -2;
-    memset(kcopy, 0, strlen(key) + 1);
-    strncpy(kcopy, key, strlen(key));
 
-    char *kvalue = kvs_malloc(strlen(value) + 1);
-    if (kvalue == NULL)
+    if (kvs_value_init(&inst->table[slot].value, value) != 0)
     {
-        kvs_free(kcopy);
+        kvs_free_str(kcopy);
         return -2;
     }
 
-    memset(kvalue, 0, strlen(value) + 1);
-    strncpy(kvalue, value, strlen(value));
+    inst->table[slot].key = kcopy;
+    if (slot == inst->total)
+        inst->total++;
 
-    /* 1) 先找空洞填补：注意填补空洞时 total 不应 ++ */
-    int i = 0;
-    for (i = 0; i < inst->total; i++)
-    {
-        if (inst->table[i].key == NULL)
-        {
+    return 0;
+}
 
-            inst->table[i].key = kcopy;
-            inst->table[i].value = kvalue;
+/*
+ * @return: <0, error; =0, success; >0, exist
+ */
 
-            return 0;
-        }
-    }
+int kvs_array_set(kvs_array_t *inst, char *key, char *value)
+{
 
-    /* 2) 没空洞：追加到末尾；这里才需要 total++ */
-    if (inst->total >= KVS_ARRAY_SIZE)
-    {
-        /* 修复：避免越界；并释放刚申请的内存 */
-        kvs_free(kcopy);
-        kvs_free(kvalue);
+    if (inst == NULL || inst->table == NULL || key == NULL || value == NULL)
         return -1;
-    }
 
-    inst->table[inst->total].key = kcopy;
-    inst->table[inst->total].value = kvalue;
-    inst->total++;
+    int hole;
+    if (kvs_array_locate(inst, key, &hole) >= 0)
+        return 1;
 
-    return 0;
+    return kvs_array_fill(inst, hole, key, value);
+}
+
+int kvs_array_upsert(kvs_array_t *inst, char *key, char *value)
+{
+    if (inst == NULL || inst->table == NULL || key == NULL || value == NULL)
+        return -1;
+
+    int hole;
+    int i = kvs_array_locate(inst, key, &hole);
+    if (i < 0)
+        return kvs_array_fill(inst, hole, key, value);
+
+    kvs_array_item_t *item = &inst->table[i];
+    return kvs_value_assign(&item->value, value) < 0 ? -2 : 1;
+}
+
+int kvs_array_getset(kvs_array_t *inst, char *key, char *value, kvs_value_t *old)
+{
+    if (inst == NULL || inst->table == NULL || key == NULL || value == NULL || old == NULL)
+        return -1;
+
+    old->in.enc = KVS_ENC_NONE;
+    int hole;
+    int i = kvs_array_locate(inst, key, &hole);
+    if (i < 0)
+        return kvs_array_fill(inst, hole, key, value);
+
+    // 旧值要交给调用方，不能原地覆盖
+    kvs_value_t nv;
+    nv.in.enc = KVS_ENC_NONE;
+    if (kvs_value_init(&nv, value) != 0)
+        return -2;
+    *old = inst->table[i].value;
+    inst->table[i].value = nv;
+    return 1;
+}
+
+int kvs_array_cas(kvs_array_t *inst, char *key, char *expect, char *value)
+{
+    if (inst == NULL || inst->table == NULL || key == NULL || expect == NULL || value == NULL)
+        return -1;
+
+    int hole;
+    int i = kvs_array_locate(inst, key, &hole);
+    if (i < 0)
+        return 1;
+    const char *cur = kvs_value_str(&inst->table[i].value);
+    if (!cur)
+        return -1; // 读不出来，不能拿来比较
+    if (strcmp(cur, expect) != 0)
+        return 2;
+
+    return kvs_value_assign(&inst->table[i].value, value);
+}
+
+int kvs_array_incr(kvs_array_t *inst, char *key, int64_t delta, int64_t *result)
+{
+    if (inst == NULL || inst->table == NULL || key == NULL)
+        return -1;
+
+    int hole;
+    int i = kvs_array_locate(inst, key, &hole);
+    if (i >= 0)
+        return kvs_value_incr(&inst->table[i].value, delta, result);
+
+    char buf[21];
+    kvs_value_format_int(delta, buf);
+    int ret = kvs_array_fill(inst, hole, key, buf);
+    if (ret == 0 && result)
+        *result = delta;
+    return ret;
 }
 
 char *kvs_array_get(kvs_array_t *inst, char *key)
@@ -141,7 +217,7 @@ char *kvs_array_get(kvs_array_t *inst, char *key)
 
         if (strcmp(inst->table[i].key, key) == 0)
         {
-            return inst->table[i].value;
+            return kvs_value_str(&inst->table[i].value);
         }
     }
 
@@ -170,11 +246,10 @@ int kvs_array_del(kvs_array_t *inst, char *key)
         if (strcmp(inst->table[i].key, key) == 0)
         {
 
-            kvs_free(inst->table[i].key);
+            kvs_free_str(inst->table[i].key);
             inst->table[i].key = NULL;
 
-            kvs_free(inst->table[i].value);
-            inst->table[i].value = NULL;
+            kvs_value_lazyfree(&inst->table[i].value);
 
             /*
              * 修复：删除后回收尾部空洞，避免 total 长期不减导致“>1024/逻辑越界”
@@ -219,16 +294,8 @@ int kvs_array_mod(kvs_array_t *inst, char *key, char *value)
         if (strcmp(inst->table[i].key, key) == 0)
         {
 
-            char *kvalue = kvs_malloc(strlen(value) + 1);
-            if (kvalue == NULL)
-                return -2;
-            memset(kvalue, 0, strlen(value) + 1);
-            strncpy(kvalue, value, strlen(value));
-
-            kvs_free(inst->table[i].value); // 释放旧值
-            inst->table[i].value = kvalue;
-
-            return 0;
+            // 放得下时原地覆盖，否则换新值并释放旧值
+            return kvs_value_assign(&inst->table[i].value, value);
         }
     }
 
@@ -253,3 +320,88 @@ int kvs_array_exist(kvs_array_t *inst, char *key)
     }
     return 1; // no exist
 }
+
+int kvs_array_defrag(kvs_array_t *inst, int *cursor, int budget)
+{
+    if (!inst || !inst->table || !cursor)
+        return 0;
+
+    for (; *cursor < inst->total && budget > 0; (*cursor)++, budget--)
+    {
+        kvs_array_item_t *item = &inst->table[*cursor];
+        if (item->key == NULL)
+            continue;
+        item->key = (char *)kvs_alloc_move(item->key, strlen(item->key) + 1);
+        kvs_value_move(&item->value);
+    }
+    if (*cursor < inst->total)
+        return 1;
+
+    inst->table = (kvs_array_item_t *)kvs_alloc_move(inst->table, KVS_ARRAY_SIZE * sizeof(kvs_array_item_t));
+    *cursor = 0;
+    return 0;
+}
+
+void kvs_array_foreach(kvs_array_t *inst, kvs_value_fn fn, void *arg)
+{
+    if (!inst || !inst->table || !fn)
+        return;
+
+    for (int i = 0; i < inst->total; i++)
+    {
+        if (inst->table[i].key == NULL)
+            continue;
+        fn(arg, inst->table[i].key, &inst->table[i].value);
+    }
+}
+
+int kvs_array_values(kvs_array_t *inst, int *cursor, int budget, kvs_value_fn fn, void *arg)
+{
+    if (!inst || !inst->table || !cursor || !fn)
+        return 0;
+
+    for (; *cursor < inst->total && budget > 0; (*cursor)++, budget--)
+    {
+        kvs_array_item_t *item = &inst->table[*cursor];
+        if (item->key != NULL)
+            fn(arg, item->key, &item->value);
+    }
+    if (*cursor < inst->total)
+        return 1;
+
+    *cursor = 0;
+    return 0;
+}
+
+int kvs_array_detach(kvs_array_t *inst, kvs_array_t *out)
+{
+    if (!inst || !out || !inst->table)
+        return -1;
+
+    kvs_array_t fresh = {0};
+    if (kvs_array_create(&fresh) != 0)
+        return -2;
+
+    *out = *inst;
+    *inst = fresh;
+    return 0;
+}
+
+int kvs_array_release(kvs_array_t *inst, int budget)
+{
+    if (!inst || !inst->table)
+        return 0;
+
+    for (; inst->total > 0 && budget > 0; budget--)
+    {
+        kvs_array_item_t *item = &inst->table[--inst->total];
+        kvs_free_str(item->key);
+        kvs_value_free(&item->value);
+    }
+    if (inst->total > 0)
+        return 1;
+
+    kvs_free(inst->table, KVS_ARRAY_SIZE * sizeof(kvs_array_item_t));
+    inst->table = NULL;
+    return 0;
+}
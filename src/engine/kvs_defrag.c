@@ -0,0 +1,98 @@
+#include "engine/kvs_defrag.h"
+#include "engine/kvs_lazyfree.h"
+
+// @return: 浪费的字节数，ratio 为碎片率
+static int64_t defrag_waste(double *ratio)
+{
+    kvs_alloc_stats_t st;
+    int64_t used;
+
+    if (kvs_alloc_is_pool())
+    {
+        kvs_alloc_thread_stats(&st);
+        used = st.reserved;
+    }
+    else
+    {
+        // system/jemalloc：usable size 看不到空闲但未归还的页，用 RSS 衡量
+        kvs_alloc_stats(&st);
+        used = kvs_alloc_rss();
+    }
+
+    *ratio = st.requested > 0 ? (double)used / (double)st.requested : 0.0;
+    return used - st.requested;
+}
+
+int kvs_defrag_needed(kvs_defrag_t *d, double threshold, int64_t min_waste)
+{
+    double ratio;
+    int64_t waste = defrag_waste(&ratio);
+
+    // 数据被删掉之后浪费可能低于上一轮的底线，底线随之下调
+    if (waste < d->floor)
+        d->floor = waste;
+    return ratio > threshold && waste - d->floor > min_waste;
+}
+
+static void defrag_done(kvs_defrag_t *d)
+{
+    double ratio;
+    d->active = 0;
+    d->passes++;
+    d->floor = defrag_waste(&ratio);
+}
+
+int kvs_defrag_start(kvs_defrag_t *d)
+{
+    if (!d || d->active)
+        return -1;
+    int ret = kvs_alloc_defrag_begin();
+    if (ret < 0)
+        return -1;
+    if (ret > 0)
+    {
+        defrag_done(d);
+        return 1;
+    }
+
+    d->active = 1;
+    d->phase = 0;
+    d->cursor = 0;
+    free(d->rb_cursor);
+    d->rb_cursor = NULL;
+    return 0;
+}
+
+int kvs_defrag_step(kvs_defrag_t *d, kvs_array_t *array, kvs_rbtree_t *rbtree, kvs_hash_t *hash, int budget)
+{
+    if (!d || !d->active)
+        return 0;
+
+    int more = 0;
+    switch (d->phase)
+    {
+    case 0:
+        more = kvs_array_defrag(array, &d->cursor, budget);
+        break;
+    case 1:
+        more = kvs_rbtree_defrag(rbtree, &d->rb_cursor, budget);
+        break;
+    case 2:
+        more = kvs_hash_defrag(hash, &d->cursor, budget);
+        break;
+    }
+    if (more)
+        return 1;
+
+    if (++d->phase <= 2)
+        return 1;
+
+    // 本线程待惰性释放的条目可能还在旧 pool 里，放完才能整体归还
+    if (kvs_lazyfree_step(0))
+        return 1;
+
+    // 所有存活对象都已搬到新内存，旧内存整体归还
+    kvs_alloc_defrag_end();
+    defrag_done(d);
+    return 0;
+}
@@ -1,23 +1,75 @@
 #include "engine/kvs_hash.h"
+#include "engine/kvs_lazyfree.h"
+#include "engine/kvs_simd.h"
+#include "engine/kvs_value.h"
 
 kvs_hash_t global_hash;
 
-static int _hash(char *key, int size)
+// 表大小是 2 的幂，桶号取低位：kvs_simd_hash 按 8 字节一组混合，最后再整体混合一次，低位受所有字节影响
+static inline uint32_t _hash(const char *key)
 {
+    return kvs_simd_hash(key);
+}
 
-    if (!key)
-        return -1;
+static inline int _bucket(kvs_hash_t *hash, const char *key)
+{
+    return (int)(_hash(key) & (uint32_t)(hash->max_slots - 1));
+}
 
-    int sum = 0;
-    int i = 0;
+// 整表重建为 slots 个桶，节点本身不动
+static int _resize(kvs_hash_t *hash, int slots)
+{
+    hashnode_t **nodes = (hashnode_t **)kvs_malloc(sizeof(hashnode_t *) * slots);
+    if (!nodes)
+        return -2;
+    memset(nodes, 0, sizeof(hashnode_t *) * slots);
+
+    for (int i = 0; i < hash->max_slots; i++)
+    {
+        hashnode_t *node = hash->nodes[i];
+        while (node)
+        {
+            hashnode_t *next = node->next;
+            uint32_t idx = _hash(node->key) & (uint32_t)(slots - 1);
+            node->next = nodes[idx];
+            nodes[idx] = node;
+            node = next;
+        }
+    }
+
+    kvs_free(hash->nodes, sizeof(hashnode_t *) * hash->max_slots);
+    hash->nodes = nodes;
+    hash->max_slots = slots;
+    return 0;
+}
+
+// 负载因子低于 1/8 时减半，不小于初始大小
+static void _shrink(kvs_hash_t *hash)
+{
+    if (hash->max_slots > MAX_TABLE_SIZE && hash->count < hash->max_slots / 8)
+        _resize(hash, hash->max_slots / 2);
+}
 
-    while (key[i] != 0)
+// 反向二进制加一：在游标的高位上加一再进位到低位。表按 2 倍扩缩时，
+// 同一个桶拆出/合并的桶在这个顺序里相邻，已访问过的桶在新表里仍然排在游标之前
+static unsigned long _rev(unsigned long v)
+{
+    unsigned long s = 8 * sizeof(v);
+    unsigned long mask = ~0UL;
+    while ((s >>= 1) > 0)
     {
-        sum += key[i];
-        i++;
+        mask ^= (mask << s);
+        v = ((v >> s) & mask) | ((v << s) & ~mask);
     }
+    return v;
+}
 
-    return sum % size;
+static unsigned long _scan_next(unsigned long v, unsigned long mask)
+{
+    v |= ~mask; // 高于 mask 的位置 1，加一时进位直接穿过
+    v = _rev(v);
+    v++;
+    return _rev(v);
 }
 
 static hashnode_t *_create_node(const char *key, const char *value)
@@ -30,110 +82,305 @@ static hashnode_t *_create_node(const char *key, const char *value)
     node->key = (char *)kvs_malloc(klen + 1);
     if (!node->key)
     {
-        kvs_free(node);
+        kvs_free(node, sizeof(hashnode_t));
         return NULL;
     }
     memcpy(node->key, key, klen + 1);
 
-    size_t vlen = strlen(value);
-    node->value = (char *)kvs_malloc(vlen + 1);
-    if (!node->value)
+    node->value.in.enc = KVS_ENC_NONE;
+    if (kvs_value_init(&node->value, value) != 0)
     {
-        kvs_free(node->key);
-        kvs_free(node);
+        kvs_free_str(node->key);
+        kvs_free(node, sizeof(hashnode_t));
         return NULL;
     }
-    memcpy(node->value, value, vlen + 1);
 
     node->next = NULL;
     return node;
 }
 
-//
-int kvs_hash_create(kvs_hash_t *hash)
+// 紧凑编码的条目：[klen][key\0][vlen][value\0]
+static inline char *_lp_key(char *e) { return e + 1; }
+static inline char *_lp_val(char *e) { return e + (uint8_t)e[0] + 3; }
+static inline uint32_t _lp_size(char *e) { return (uint32_t)(uint8_t)e[0] + (uint8_t)e[(uint8_t)e[0] + 2] + 4; }
+
+static char *_lp_find(kvs_hash_t *hash, const char *key)
 {
+    size_t klen = strlen(key);
+    if (klen > KVS_HASH_COMPACT_LEN)
+        return NULL;
+    for (uint32_t off = 0; off < hash->lp_len; off += _lp_size(hash->lp + off))
+    {
+        char *e = hash->lp + off;
+        if ((uint8_t)e[0] == klen && memcmp(_lp_key(e), key, klen) == 0)
+            return e;
+    }
+    return NULL;
+}
 
-    if (!hash)
-        return -1;
+// 写入后仍能留在紧凑编码里：key / value 不超长、value 原样保存，新增时条目数不超上限
+static int _lp_fits(kvs_hash_t *hash, const char *key, const char *value, int adding)
+{
+    size_t vlen = strlen(value);
+    return strlen(key) <= KVS_HASH_COMPACT_LEN && vlen <= KVS_HASH_COMPACT_LEN && kvs_value_plain(vlen) &&
+           (!adding || hash->count < KVS_HASH_COMPACT_COUNT);
+}
 
-    if (hash->nodes)
-        return -1;
+// 缓冲区换成 cap 字节（不小于已用字节数）
+static int _lp_resize(kvs_hash_t *hash, uint32_t cap)
+{
+    char *lp = (char *)kvs_malloc(cap);
+    if (!lp)
+        return -2;
+    if (hash->lp)
+    {
+        memcpy(lp, hash->lp, hash->lp_len);
+        kvs_free(hash->lp, hash->lp_cap);
+    }
+    hash->lp = lp;
+    hash->lp_cap = cap;
+    return 0;
+}
 
-    hash->nodes = (hashnode_t **)kvs_malloc(sizeof(hashnode_t *) * MAX_TABLE_SIZE);
-    if (!hash->nodes)
-        return -1;
-    memset(hash->nodes, 0, sizeof(hashnode_t *) * MAX_TABLE_SIZE);
+static int _lp_reserve(kvs_hash_t *hash, uint32_t need)
+{
+    if (need <= hash->lp_cap)
+        return 0;
+    return _lp_resize(hash, need < 64 ? 64 : need + need / 2);
+}
 
-    hash->max_slots = MAX_TABLE_SIZE;
-    hash->count = 0;
+static int _lp_add(kvs_hash_t *hash, const char *key, const char *value)
+{
+    size_t klen = strlen(key), vlen = strlen(value);
+    if (_lp_reserve(hash, hash->lp_len + (uint32_t)(klen + vlen) + 4) != 0)
+        return -2;
 
+    char *e = hash->lp + hash->lp_len;
+    e[0] = (char)klen;
+    memcpy(e + 1, key, klen + 1);
+    e[klen + 2] = (char)vlen;
+    memcpy(e + klen + 3, value, vlen + 1);
+    hash->lp_len += (uint32_t)(klen + vlen) + 4;
+    hash->count++;
     return 0;
 }
 
-//
-void kvs_hash_destory(kvs_hash_t *hash)
+// 原地改写 value，后面的条目整体挪动；等长或变短时不分配
+static int _lp_assign(kvs_hash_t *hash, char *e, const char *value)
 {
-    if (!hash)
-        return;
+    uint32_t off = (uint32_t)(e - hash->lp);
+    uint32_t klen = (uint8_t)e[0];
+    uint32_t olen = (uint8_t)e[klen + 2];
+    uint32_t vlen = (uint32_t)strlen(value);
+    if (vlen > olen && _lp_reserve(hash, hash->lp_len + vlen - olen) != 0)
+        return -2;
 
-    for (int i = 0; i < hash->max_slots; i++)
+    e = hash->lp + off;
+    uint32_t tail = off + klen + olen + 4;
+    memmove(e + klen + vlen + 4, hash->lp + tail, hash->lp_len - tail);
+    e[klen + 2] = (char)vlen;
+    memcpy(e + klen + 3, value, vlen + 1);
+    hash->lp_len = hash->lp_len + vlen - olen;
+    return 0;
+}
+
+static void _lp_del(kvs_hash_t *hash, char *e)
+{
+    uint32_t size = _lp_size(e);
+    uint32_t off = (uint32_t)(e - hash->lp);
+    memmove(e, e + size, hash->lp_len - off - size);
+    hash->lp_len -= size;
+    hash->count--;
+
+    // 空表不占内存；用得很少时缩小，失败不影响删除
+    if (hash->count == 0)
     {
-        hashnode_t *node = hash->nodes[i];
+        kvs_free(hash->lp, hash->lp_cap);
+        hash->lp = NULL;
+        hash->lp_len = hash->lp_cap = 0;
+    }
+    else if (hash->lp_cap > 64 && hash->lp_len < hash->lp_cap / 4)
+    {
+        _lp_resize(hash, hash->lp_len * 2);
+    }
+}
+
+// 紧凑编码的条目交给 kvs_value_fn 时用的视图，不拥有内存
+static kvs_value_t _lp_view(char *e)
+{
+    kvs_value_t v;
+    v.raw.ptr = _lp_val(e);
+    v.raw.cap = (size_t)(uint8_t)e[(uint8_t)e[0] + 2] + 1;
+    v.in.enc = KVS_ENC_RAW;
+    return v;
+}
+
+static void _free_nodes(hashnode_t **nodes, int slots)
+{
+    for (int i = 0; i < slots; i++)
+    {
+        hashnode_t *node = nodes[i];
         while (node)
         {
             hashnode_t *next = node->next;
-            kvs_free(node->key);
-            kvs_free(node->value);
-            kvs_free(node);
+            kvs_free_str(node->key);
+            kvs_value_free(&node->value);
+            kvs_free(node, sizeof(hashnode_t));
             node = next;
         }
-        hash->nodes[i] = NULL;
     }
+    kvs_free(nodes, sizeof(hashnode_t *) * slots);
+}
 
-    kvs_free(hash->nodes);
-    hash->nodes = NULL;
-    hash->max_slots = 0;
-    hash->count = 0;
+int kvs_hash_convert(kvs_hash_t *hash)
+{
+    if (!hash)
+        return -1;
+    if (hash->nodes)
+        return 0;
+
+    hashnode_t **nodes = (hashnode_t **)kvs_malloc(sizeof(hashnode_t *) * MAX_TABLE_SIZE);
+    if (!nodes)
+        return -2;
+    memset(nodes, 0, sizeof(hashnode_t *) * MAX_TABLE_SIZE);
+
+    // 已有的值都是原样的字符串，不能当成 RESTORE 的压缩形式解析
+    int packed = kvs_value_packed_input;
+    kvs_value_packed_input = 0;
+    int ret = 0;
+    for (uint32_t off = 0; off < hash->lp_len; off += _lp_size(hash->lp + off))
+    {
+        char *e = hash->lp + off;
+        hashnode_t *node = _create_node(_lp_key(e), _lp_val(e));
+        if (!node)
+        {
+            ret = -2;
+            break;
+        }
+        uint32_t idx = _hash(node->key) & (MAX_TABLE_SIZE - 1);
+        node->next = nodes[idx];
+        nodes[idx] = node;
+    }
+    kvs_value_packed_input = packed;
+
+    if (ret != 0)
+    {
+        _free_nodes(nodes, MAX_TABLE_SIZE);
+        return ret;
+    }
+
+    if (hash->lp)
+        kvs_free(hash->lp, hash->lp_cap);
+    hash->lp = NULL;
+    hash->lp_len = hash->lp_cap = 0;
+    hash->nodes = nodes;
+    hash->max_slots = MAX_TABLE_SIZE;
+    return 0;
 }
 
-// mp
-int kvs_hash_set(kvs_hash_t *hash, char *key, char *value)
+//
+int kvs_hash_create(kvs_hash_t *hash)
 {
 
-    if (!hash || !key || !value)
+    if (!hash)
         return -1;
 
-    int idx = _hash(key, hash->max_slots);
+    if (hash->nodes || hash->lp)
+        return -1;
 
-    hashnode_t *node = hash->nodes[idx];
+    // 从紧凑编码开始，第一次写入时才分配
+    hash->max_slots = 0;
+    hash->count = 0;
+    hash->lp_len = hash->lp_cap = 0;
 
-    while (node != NULL)
-    {
-        if (strcmp(node->key, key) == 0)
-        { // exist
-            return 1;
-        }
+    return 0;
+}
+
+//
+void kvs_hash_destory(kvs_hash_t *hash)
+{
+    if (!hash)
+        return;
+
+    if (hash->nodes)
+        _free_nodes(hash->nodes, hash->max_slots);
+    if (hash->lp)
+        kvs_free(hash->lp, hash->lp_cap);
+    hash->nodes = NULL;
+    hash->max_slots = 0;
+    hash->count = 0;
+    hash->lp = NULL;
+    hash->lp_len = hash->lp_cap = 0;
+}
+
+// h 为 key 的 _hash 值，桶号按当前表大小现取（批量写入时 h 预先算好，批内可能扩表）
+static hashnode_t *_find(kvs_hash_t *hash, const char *key, uint32_t h)
+{
+    hashnode_t *node = hash->nodes[h & (uint32_t)(hash->max_slots - 1)];
+    while (node && strcmp(node->key, key) != 0)
         node = node->next;
-    }
+    return node;
+}
 
+// 插入已确认不存在的 key
+static int _add(kvs_hash_t *hash, char *key, char *value, uint32_t h)
+{
     hashnode_t *new_node = _create_node(key, value);
     if (!new_node)
         return -2;
+
+    int idx = (int)(h & (uint32_t)(hash->max_slots - 1));
     new_node->next = hash->nodes[idx];
     hash->nodes[idx] = new_node;
 
     hash->count++;
 
+    // 负载因子超过 1 时翻倍；失败不影响本次写入
+    if (hash->count > hash->max_slots && hash->max_slots < KVS_HASH_MAX_SLOTS)
+        _resize(hash, hash->max_slots * 2);
+
     return 0;
 }
 
+static int _insert(kvs_hash_t *hash, char *key, char *value, uint32_t h)
+{
+    if (_find(hash, key, h))
+        return 1; // exist
+    return _add(hash, key, value, h);
+}
+
+// mp
+int kvs_hash_set(kvs_hash_t *hash, char *key, char *value)
+{
+
+    if (!hash || !key || !value)
+        return -1;
+
+    if (!hash->nodes)
+    {
+        if (_lp_find(hash, key))
+            return 1;
+        if (_lp_fits(hash, key, value, 1))
+            return _lp_add(hash, key, value);
+        if (kvs_hash_convert(hash) != 0)
+            return -2;
+    }
+    return _insert(hash, key, value, _hash(key));
+}
+
 char *kvs_hash_get(kvs_hash_t *hash, char *key)
 {
 
     if (!hash || !key)
         return NULL;
 
-    int idx = _hash(key, hash->max_slots);
+    if (!hash->nodes)
+    {
+        char *e = _lp_find(hash, key);
+        return e ? _lp_val(e) : NULL;
+    }
+
+    int idx = _bucket(hash, key);
 
     hashnode_t *node = hash->nodes[idx];
 
@@ -142,7 +389,7 @@ char *kvs_hash_get(kvs_hash_t *hash, char *key)
 
         if (strcmp(node->key, key) == 0)
         {
-            return node->value;
+            return kvs_value_str(&node->value);
         }
 
         node = node->next;
@@ -156,22 +403,254 @@ int kvs_hash_mod(kvs_hash_t *hash, char *key, char *value)
     if (!hash || !key || !value)
         return -1;
 
-    int idx = _hash(key, hash->max_slots);
+    if (!hash->nodes)
+    {
+        char *e = _lp_find(hash, key);
+        if (!e)
+            return 1;
+        if (_lp_fits(hash, key, value, 0))
+            return _lp_assign(hash, e, value);
+        if (kvs_hash_convert(hash) != 0)
+            return -2;
+    }
+
+    int idx = _bucket(hash, key);
     hashnode_t *node = hash->nodes[idx];
     while (node && strcmp(node->key, key) != 0)
         node = node->next;
     if (!node)
         return 1;
 
-    size_t vlen = strlen(value);
-    char *newv = kvs_malloc(vlen + 1);
-    if (!newv)
+    return kvs_value_assign(&node->value, value);
+}
+
+// 批量查找：每组先算完全部 hash 并预取桶，再预取链表头节点和头节点的 key，最后逐个比较；
+// 各 key 的 cache miss 在前几轮里并发展开，而不是按 key 串行等待
+int kvs_hash_mget(kvs_hash_t *hash, char **keys, int n, char **values)
+{
+    if (!hash || !keys || !values || n < 0)
+        return -1;
+
+    int found = 0;
+    if (!hash->nodes)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            values[i] = kvs_hash_get(hash, keys[i]);
+            found += values[i] != NULL;
+        }
+        return found;
+    }
+
+    uint32_t mask = (uint32_t)(hash->max_slots - 1);
+    for (int base = 0; base < n; base += KVS_HASH_BATCH)
+    {
+        int m = n - base < KVS_HASH_BATCH ? n - base : KVS_HASH_BATCH;
+        uint32_t idx[KVS_HASH_BATCH];
+        hashnode_t *head[KVS_HASH_BATCH];
+
+        for (int i = 0; i < m; i++)
+        {
+            idx[i] = _hash(keys[base + i]) & mask;
+            __builtin_prefetch(&hash->nodes[idx[i]]);
+        }
+        for (int i = 0; i < m; i++)
+        {
+            head[i] = hash->nodes[idx[i]];
+            if (head[i])
+                __builtin_prefetch(head[i]);
+        }
+        for (int i = 0; i < m; i++)
+            if (head[i])
+                __builtin_prefetch(head[i]->key);
+
+        for (int i = 0; i < m; i++)
+        {
+            hashnode_t *node = head[i];
+            while (node && strcmp(node->key, keys[base + i]) != 0)
+                node = node->next;
+            values[base + i] = node ? kvs_value_str(&node->value) : NULL;
+            found += node != NULL;
+        }
+    }
+    return found;
+}
+
+// 批量写入：同样先算 hash 并预取桶，再按顺序插入；结果与逐个 kvs_hash_set 相同
+int kvs_hash_mset(kvs_hash_t *hash, char **keys, char **values, int n, int *results)
+{
+    if (!hash || !keys || !values || !results || n < 0)
+        return -1;
+
+    // 紧凑编码逐个写入，中途转为哈希表后剩下的按批处理
+    int ok = 0, start = 0;
+    for (; start < n && !hash->nodes; start++)
+    {
+        results[start] = kvs_hash_set(hash, keys[start], values[start]);
+        ok += results[start] == 0;
+    }
+
+    for (int base = start; base < n; base += KVS_HASH_BATCH)
+    {
+        int m = n - base < KVS_HASH_BATCH ? n - base : KVS_HASH_BATCH;
+        uint32_t h[KVS_HASH_BATCH];
+        uint32_t mask = (uint32_t)(hash->max_slots - 1);
+
+        for (int i = 0; i < m; i++)
+        {
+            h[i] = keys[base + i] ? _hash(keys[base + i]) : 0;
+            __builtin_prefetch(&hash->nodes[h[i] & mask]);
+        }
+        for (int i = 0; i < m; i++)
+        {
+            if (!keys[base + i] || !values[base + i])
+                results[base + i] = -1;
+            else
+                results[base + i] = _insert(hash, keys[base + i], values[base + i], h[i]);
+            ok += results[base + i] == 0;
+        }
+    }
+    return ok;
+}
+
+int kvs_hash_upsert(kvs_hash_t *hash, char *key, char *value)
+{
+    if (!hash || !key || !value)
+        return -1;
+
+    if (!hash->nodes)
+    {
+        char *e = _lp_find(hash, key);
+        if (_lp_fits(hash, key, value, !e))
+            return e ? (_lp_assign(hash, e, value) < 0 ? -2 : 1) : _lp_add(hash, key, value);
+        if (kvs_hash_convert(hash) != 0)
+            return -2;
+    }
+
+    uint32_t h = _hash(key);
+    hashnode_t *node = _find(hash, key, h);
+    if (!node)
+        return _add(hash, key, value, h);
+
+    return kvs_value_assign(&node->value, value) < 0 ? -2 : 1;
+}
+
+int kvs_hash_getset(kvs_hash_t *hash, char *key, char *value, kvs_value_t *old)
+{
+    if (!hash || !key || !value || !old)
+        return -1;
+
+    old->in.enc = KVS_ENC_NONE;
+    if (!hash->nodes)
+    {
+        char *e = _lp_find(hash, key);
+        if (_lp_fits(hash, key, value, !e))
+        {
+            if (!e)
+                return _lp_add(hash, key, value);
+            // 旧值拷贝一份交给调用方
+            if (kvs_value_init(old, _lp_val(e)) != 0)
+                return -2;
+            if (_lp_assign(hash, e, value) != 0)
+            {
+                kvs_value_free(old);
+                return -2;
+            }
+            return 1;
+        }
+        if (kvs_hash_convert(hash) != 0)
+            return -2;
+    }
+
+    uint32_t h = _hash(key);
+    hashnode_t *node = _find(hash, key, h);
+    if (!node)
+        return _add(hash, key, value, h);
+
+    // 旧值要交给调用方，不能原地覆盖
+    kvs_value_t nv;
+    nv.in.enc = KVS_ENC_NONE;
+    if (kvs_value_init(&nv, value) != 0)
         return -2;
-    memcpy(newv, value, vlen + 1);
+    *old = node->value;
+    node->value = nv;
+    return 1;
+}
 
-    kvs_free(node->value);
-    node->value = newv;
-    return 0;
+int kvs_hash_cas(kvs_hash_t *hash, char *key, char *expect, char *value)
+{
+    if (!hash || !key || !expect || !value)
+        return -1;
+
+    if (!hash->nodes)
+    {
+        char *e = _lp_find(hash, key);
+        if (!e)
+            return 1;
+        if (strcmp(_lp_val(e), expect) != 0)
+            return 2;
+        if (_lp_fits(hash, key, value, 0))
+            return _lp_assign(hash, e, value);
+        if (kvs_hash_convert(hash) != 0)
+            return -2;
+    }
+
+    hashnode_t *node = _find(hash, key, _hash(key));
+    if (!node)
+        return 1;
+    const char *cur = kvs_value_str(&node->value);
+    if (!cur)
+        return -1; // 读不出来，不能拿来比较
+    if (strcmp(cur, expect) != 0)
+        return 2;
+
+    return kvs_value_assign(&node->value, value);
+}
+
+int kvs_hash_incr(kvs_hash_t *hash, char *key, int64_t delta, int64_t *result)
+{
+    if (!hash || !key)
+        return -1;
+
+    char buf[21];
+    if (!hash->nodes)
+    {
+        char *e = _lp_find(hash, key);
+        if (e)
+        {
+            // 借 kvs_value 做解析和溢出检查，结果写回原处（整数总能留在紧凑编码里）
+            kvs_value_t v = {0};
+            if (kvs_value_init(&v, _lp_val(e)) != 0)
+                return -2;
+            int ret = kvs_value_incr(&v, delta, result);
+            const char *s = ret == 0 ? kvs_value_str(&v) : NULL;
+            if (ret == 0 && (!s || _lp_assign(hash, e, s) != 0))
+                ret = -2;
+            kvs_value_free(&v);
+            return ret;
+        }
+        kvs_value_format_int(delta, buf);
+        if (_lp_fits(hash, key, buf, 1))
+        {
+            int ret = _lp_add(hash, key, buf);
+            if (ret == 0 && result)
+                *result = delta;
+            return ret;
+        }
+        if (kvs_hash_convert(hash) != 0)
+            return -2;
+    }
+
+    uint32_t h = _hash(key);
+    hashnode_t *node = _find(hash, key, h);
+    if (node)
+        return kvs_value_incr(&node->value, delta, result);
+
+    kvs_value_format_int(delta, buf);
+    int ret = _add(hash, key, buf, h);
+    if (ret == 0 && result)
+        *result = delta;
+    return ret;
 }
 
 int kvs_hash_count(kvs_hash_t *hash)
@@ -184,7 +663,16 @@ int kvs_hash_del(kvs_hash_t *hash, char *key)
     if (!hash || !key)
         return -1;
 
-    int idx = _hash(key, hash->max_slots);
+    if (!hash->nodes)
+    {
+        char *e = _lp_find(hash, key);
+        if (!e)
+            return 1;
+        _lp_del(hash, e);
+        return 0;
+    }
+
+    int idx = _bucket(hash, key);
 
     hashnode_t *head = hash->nodes[idx];
     if (head == NULL)
@@ -195,11 +683,12 @@ int kvs_hash_del(kvs_hash_t *hash, char *key)
         hashnode_t *tmp = head->next;
         hash->nodes[idx] = tmp;
 
-        kvs_free(head->key);
-        kvs_free(head->value);
-        kvs_free(head);
+        kvs_free_str(head->key);
+        kvs_value_lazyfree(&head->value);
+        kvs_free(head, sizeof(hashnode_t));
 
         hash->count--;
+        _shrink(hash);
 
         return 0;
     }
@@ -221,23 +710,155 @@ int kvs_hash_del(kvs_hash_t *hash, char *key)
 
     hashnode_t *tmp = cur->next;
     cur->next = tmp->next;
-    kvs_free(tmp->key);
-    kvs_free(tmp->value);
+    kvs_free_str(tmp->key);
+    kvs_value_lazyfree(&tmp->value);
 
-    kvs_free(tmp);
+    kvs_free(tmp, sizeof(hashnode_t));
 
     hash->count--;
+    _shrink(hash);
 
     return 0;
 }
 
+int kvs_hash_defrag(kvs_hash_t *hash, int *cursor, int budget)
+{
+    if (!hash || !cursor)
+        return 0;
+    if (!hash->nodes)
+    {
+        if (hash->lp)
+            hash->lp = (char *)kvs_alloc_move(hash->lp, hash->lp_cap);
+        *cursor = 0;
+        return 0;
+    }
+
+    // 与 SCAN 同样按反向二进制顺序走桶：两次调用之间表扩缩了也不会漏掉节点
+    unsigned long v = (unsigned long)*cursor;
+    unsigned long mask = (unsigned long)hash->max_slots - 1;
+    do
+    {
+        // 一个桶内的链表一次搬完
+        hashnode_t **pp = &hash->nodes[v & mask];
+        while (*pp)
+        {
+            hashnode_t *node = (hashnode_t *)kvs_alloc_move(*pp, sizeof(hashnode_t));
+            node->key = (char *)kvs_alloc_move(node->key, strlen(node->key) + 1);
+            kvs_value_move(&node->value);
+            *pp = node;
+            pp = &node->next;
+            budget--;
+        }
+        v = _scan_next(v, mask);
+    } while (v != 0 && budget > 0);
+
+    *cursor = (int)v;
+    if (v != 0)
+        return 1;
+
+    hash->nodes = (hashnode_t **)kvs_alloc_move(hash->nodes, sizeof(hashnode_t *) * hash->max_slots);
+    return 0;
+}
+
+unsigned long kvs_hash_scan(kvs_hash_t *hash, unsigned long cursor, kvs_hash_scan_fn fn, void *arg)
+{
+    if (!hash || !fn)
+        return 0;
+    if (!hash->nodes)
+    {
+        for (uint32_t off = 0; off < hash->lp_len; off += _lp_size(hash->lp + off))
+            fn(arg, _lp_key(hash->lp + off), _lp_val(hash->lp + off));
+        return 0;
+    }
+
+    unsigned long mask = (unsigned long)hash->max_slots - 1;
+    for (hashnode_t *node = hash->nodes[cursor & mask]; node; node = node->next)
+        fn(arg, node->key, kvs_value_str(&node->value));
+
+    return _scan_next(cursor, mask);
+}
+
+unsigned long kvs_hash_values(kvs_hash_t *hash, unsigned long cursor, kvs_value_fn fn, void *arg)
+{
+    if (!hash || !fn)
+        return 0;
+    if (!hash->nodes)
+    {
+        for (uint32_t off = 0; off < hash->lp_len; off += _lp_size(hash->lp + off))
+        {
+            kvs_value_t v = _lp_view(hash->lp + off);
+            fn(arg, _lp_key(hash->lp + off), &v);
+        }
+        return 0;
+    }
+
+    unsigned long mask = (unsigned long)hash->max_slots - 1;
+    for (hashnode_t *node = hash->nodes[cursor & mask]; node; node = node->next)
+        fn(arg, node->key, &node->value);
+
+    return _scan_next(cursor, mask);
+}
+
 int kvs_hash_exist(kvs_hash_t *hash, char *key)
 {
     if (!hash || !key)
         return -1;
-    int idx = _hash(key, hash->max_slots);
+    if (!hash->nodes)
+        return _lp_find(hash, key) ? 0 : 1;
+    int idx = _bucket(hash, key);
     for (hashnode_t *n = hash->nodes[idx]; n; n = n->next)
         if (strcmp(n->key, key) == 0)
             return 0;
     return 1;
 }
+
+int kvs_hash_detach(kvs_hash_t *hash, kvs_hash_t *out)
+{
+    if (!hash || !out)
+        return -1;
+
+    kvs_hash_t fresh = {0};
+    if (kvs_hash_create(&fresh) != 0)
+        return -2;
+
+    *out = *hash;
+    *hash = fresh;
+    return 0;
+}
+
+int kvs_hash_release(kvs_hash_t *hash, int *cursor, int budget)
+{
+    if (!hash || !cursor)
+        return 0;
+    if (!hash->nodes)
+    {
+        kvs_hash_destory(hash);
+        return 0;
+    }
+
+    // 摘下的表不会再扩缩，按下标顺序释放
+    while (*cursor < hash->max_slots && budget > 0)
+    {
+        hashnode_t **head = &hash->nodes[*cursor];
+        while (*head && budget > 0)
+        {
+            hashnode_t *node = *head;
+            *head = node->next;
+            kvs_free_str(node->key);
+            kvs_value_free(&node->value);
+            kvs_free(node, sizeof(hashnode_t));
+            hash->count--;
+            budget--;
+        }
+        if (!*head)
+            (*cursor)++;
+    }
+    if (*cursor < hash->max_slots)
+        return 1;
+
+    kvs_free(hash->nodes, sizeof(hashnode_t *) * hash->max_slots);
+    hash->nodes = NULL;
+    hash->max_slots = 0;
+    hash->count = 0;
+    return 0;
+}
@@ -0,0 +1,269 @@
+#include "engine/kvs_intkey.h"
+
+// 红黑树的平衡调整：空叶子用 NULL 表示，NULL 视为黑色
+
+#define BLACK_BIT ((uintptr_t)1)
+
+static inline int is_red(const kvs_itree_link_t *n)
+{
+    return n && !(n->parent_color & BLACK_BIT);
+}
+
+static inline void set_black(kvs_itree_link_t *n)
+{
+    n->parent_color |= BLACK_BIT;
+}
+
+static inline void set_red(kvs_itree_link_t *n)
+{
+    n->parent_color &= ~BLACK_BIT;
+}
+
+static inline void set_parent(kvs_itree_link_t *n, kvs_itree_link_t *p)
+{
+    n->parent_color = (uintptr_t)p | (n->parent_color & BLACK_BIT);
+}
+
+// 让 p 原来指向 old 的位置改为指向 new（p 为 NULL 时改根）
+static inline void replace_child(kvs_itree_link_t **root, kvs_itree_link_t *p, kvs_itree_link_t *old, kvs_itree_link_t *new)
+{
+    if (!p)
+        *root = new;
+    else if (p->left == old)
+        p->left = new;
+    else
+        p->right = new;
+}
+
+static void rotate_left(kvs_itree_link_t **root, kvs_itree_link_t *x)
+{
+    kvs_itree_link_t *y = x->right;
+    kvs_itree_link_t *p = kvs_itree_parent(x);
+
+    x->right = y->left;
+    if (y->left)
+        set_parent(y->left, x);
+    set_parent(y, p);
+    replace_child(root, p, x, y);
+    y->left = x;
+    set_parent(x, y);
+}
+
+static void rotate_right(kvs_itree_link_t **root, kvs_itree_link_t *x)
+{
+    kvs_itree_link_t *y = x->left;
+    kvs_itree_link_t *p = kvs_itree_parent(x);
+
+    x->left = y->right;
+    if (y->right)
+        set_parent(y->right, x);
+    set_parent(y, p);
+    replace_child(root, p, x, y);
+    y->right = x;
+    set_parent(x, y);
+}
+
+void kvs_itree_insert(kvs_itree_link_t **root, kvs_itree_link_t *parent, kvs_itree_link_t **link, kvs_itree_link_t *node)
+{
+    node->parent_color = (uintptr_t)parent; // 红色
+    node->left = node->right = NULL;
+    *link = node;
+
+    kvs_itree_link_t *z = node, *p;
+    while ((p = kvs_itree_parent(z)) && is_red(p))
+    {
+        kvs_itree_link_t *g = kvs_itree_parent(p); // p 是红的，不会是根
+        if (p == g->left)
+        {
+            kvs_itree_link_t *u = g->right;
+            if (is_red(u))
+            {
+                set_black(p);
+                set_black(u);
+                set_red(g);
+                z = g;
+                continue;
+            }
+            if (z == p->right)
+            {
+                rotate_left(root, p);
+                z = p;
+                p = kvs_itree_parent(z);
+            }
+            set_black(p);
+            set_red(g);
+            rotate_right(root, g);
+        }
+        else
+        {
+            kvs_itree_link_t *u = g->left;
+            if (is_red(u))
+            {
+                set_black(p);
+                set_black(u);
+                set_red(g);
+                z = g;
+                continue;
+            }
+            if (z == p->left)
+            {
+                rotate_right(root, p);
+                z = p;
+                p = kvs_itree_parent(z);
+            }
+            set_black(p);
+            set_red(g);
+            rotate_left(root, g);
+        }
+    }
+    set_black(*root);
+}
+
+// u 所在的位置换成 v（v 可以为 NULL）
+static void transplant(kvs_itree_link_t **root, kvs_itree_link_t *u, kvs_itree_link_t *v)
+{
+    kvs_itree_link_t *p = kvs_itree_parent(u);
+    replace_child(root, p, u, v);
+    if (v)
+        set_parent(v, p);
+}
+
+// x 所在子树少了一个黑色；x 可能是 NULL，所以父节点单独带进来
+static void erase_fixup(kvs_itree_link_t **root, kvs_itree_link_t *x, kvs_itree_link_t *xp)
+{
+    while (x != *root && !is_red(x))
+    {
+        if (x == xp->left)
+        {
+            kvs_itree_link_t *w = xp->right;
+            if (is_red(w))
+            {
+                set_black(w);
+                set_red(xp);
+                rotate_left(root, xp);
+                w = xp->right;
+            }
+            if (!is_red(w->left) && !is_red(w->right))
+            {
+                set_red(w);
+                x = xp;
+                xp = kvs_itree_parent(x);
+            }
+            else
+            {
+                if (!is_red(w->right))
+                {
+                    set_black(w->left);
+                    set_red(w);
+                    rotate_right(root, w);
+                    w = xp->right;
+                }
+                w->parent_color = (w->parent_color & ~BLACK_BIT) | (xp->parent_color & BLACK_BIT);
+                set_black(xp);
+                set_black(w->right);
+                rotate_left(root, xp);
+                x = *root;
+            }
+        }
+        else
+        {
+            kvs_itree_link_t *w = xp->left;
+            if (is_red(w))
+            {
+                set_black(w);
+                set_red(xp);
+                rotate_right(root, xp);
+                w = xp->left;
+            }
+            if (!is_red(w->left) && !is_red(w->right))
+            {
+                set_red(w);
+                x = xp;
+                xp = kvs_itree_parent(x);
+            }
+            else
+            {
+                if (!is_red(w->left))
+                {
+                    set_black(w->right);
+                    set_red(w);
+                    rotate_left(root, w);
+                    w = xp->left;
+                }
+                w->parent_color = (w->parent_color & ~BLACK_BIT) | (xp->parent_color & BLACK_BIT);
+                set_black(xp);
+                set_black(w->left);
+                rotate_right(root, xp);
+                x = *root;
+            }
+        }
+    }
+    if (x)
+        set_black(x);
+}
+
+void kvs_itree_erase(kvs_itree_link_t **root, kvs_itree_link_t *z)
+{
+    kvs_itree_link_t *x, *xp;
+    int black = !is_red(z);
+
+    if (!z->left || !z->right)
+    {
+        x = z->left ? z->left : z->right;
+        xp = kvs_itree_parent(z);
+        transplant(root, z, x);
+    }
+    else
+    {
+        // 两个孩子：用后继 y 顶替 z 的位置和颜色，实际少掉的是 y 原来的颜色
+        kvs_itree_link_t *y = z->right;
+        while (y->left)
+            y = y->left;
+        black = !is_red(y);
+        x = y->right;
+        if (kvs_itree_parent(y) == z)
+        {
+            xp = y;
+        }
+        else
+        {
+            xp = kvs_itree_parent(y);
+            transplant(root, y, y->right);
+            y->right = z->right;
+            set_parent(y->right, y);
+        }
+        transplant(root, z, y);
+        y->left = z->left;
+        set_parent(y->left, y);
+        y->parent_color = (y->parent_color & ~BLACK_BIT) | (z->parent_color & BLACK_BIT);
+    }
+
+    if (black)
+        erase_fixup(root, x, xp);
+}
+
+kvs_itree_link_t *kvs_itree_first(kvs_itree_link_t *root)
+{
+    if (!root)
+        return NULL;
+    while (root->left)
+        root = root->left;
+    return root;
+}
+
+kvs_itree_link_t *kvs_itree_next(kvs_itree_link_t *node)
+{
+    if (node->right)
+        return kvs_itree_first(node->right);
+
+    kvs_itree_link_t *p = kvs_itree_parent(node);
+    while (p && node == p->right)
+    {
+        node = p;
+        p = kvs_itree_parent(p);
+    }
+    return p;
+}
+
+KVS_INTHASH_DEFINE(kvs_u64hash, uint64_t)
+KVS_INTTREE_DEFINE(kvs_u64tree, uint64_t)
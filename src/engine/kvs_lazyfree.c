@@ -0,0 +1,258 @@
+#include "engine/kvs_lazyfree.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+enum
+{
+    LAZY_ARRAY = 0,
+    LAZY_RBTREE,
+    LAZY_HASH,
+    LAZY_VALUE,
+};
+
+// 任务在线程间传递，用系统 malloc，不计入分配器统计
+typedef struct kvs_lazy_job_s
+{
+    int type;
+    int cursor; // hash 已释放到的桶
+    union
+    {
+        kvs_array_t array;
+        kvs_rbtree_t rbtree;
+        kvs_hash_t hash;
+        struct
+        {
+            char *ptr;
+            size_t size;
+        } value;
+    } u;
+    struct kvs_lazy_job_s *next;
+} kvs_lazy_job_t;
+
+static int g_enabled = 0;
+static _Atomic int64_t g_pending = 0;
+
+// 后台线程的队列
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static int g_started = 0;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER; // 有新任务
+static pthread_cond_t g_idle = PTHREAD_COND_INITIALIZER; // 队列已清空
+static kvs_lazy_job_t *g_head = NULL;
+static kvs_lazy_job_t *g_tail = NULL;
+static int g_busy = 0; // 已入队或正在释放的任务数
+
+// mypool：本线程的队列
+static __thread kvs_lazy_job_t *t_head = NULL;
+static __thread kvs_lazy_job_t *t_tail = NULL;
+
+// @return: 1, 未完成; 0, 已全部释放
+static int job_release(kvs_lazy_job_t *job, int budget)
+{
+    switch (job->type)
+    {
+    case LAZY_ARRAY:
+        return kvs_array_release(&job->u.array, budget);
+    case LAZY_RBTREE:
+        return kvs_rbtree_release(&job->u.rbtree, budget);
+    case LAZY_HASH:
+        return kvs_hash_release(&job->u.hash, &job->cursor, budget);
+    case LAZY_VALUE:
+        kvs_free(job->u.value.ptr, job->u.value.size);
+        return 0;
+    }
+    return 0;
+}
+
+static void job_done(kvs_lazy_job_t *job)
+{
+    free(job);
+    atomic_fetch_sub_explicit(&g_pending, 1, memory_order_relaxed);
+}
+
+static void *lazyfree_thread(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&g_lock);
+        while (!g_head)
+            pthread_cond_wait(&g_cond, &g_lock);
+        kvs_lazy_job_t *job = g_head;
+        g_head = job->next;
+        if (!g_head)
+            g_tail = NULL;
+        pthread_mutex_unlock(&g_lock);
+
+        while (job_release(job, KVS_LAZYFREE_BATCH))
+            ;
+        job_done(job);
+
+        pthread_mutex_lock(&g_lock);
+        if (--g_busy == 0)
+            pthread_cond_broadcast(&g_idle);
+        pthread_mutex_unlock(&g_lock);
+    }
+    return NULL;
+}
+
+static void lazyfree_start(void)
+{
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, lazyfree_thread, NULL) == 0)
+    {
+        pthread_detach(tid);
+        g_started = 1;
+    }
+}
+
+static void submit(kvs_lazy_job_t *job)
+{
+    job->next = NULL;
+    atomic_fetch_add_explicit(&g_pending, 1, memory_order_relaxed);
+
+    if (kvs_alloc_is_pool())
+    {
+        if (t_tail)
+            t_tail->next = job;
+        else
+            t_head = job;
+        t_tail = job;
+        return;
+    }
+
+    pthread_once(&g_once, lazyfree_start);
+    if (!g_started)
+    {
+        // 起不了后台线程：就地释放
+        while (job_release(job, KVS_LAZYFREE_BATCH))
+            ;
+        job_done(job);
+        return;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    if (g_tail)
+        g_tail->next = job;
+    else
+        g_head = job;
+    g_tail = job;
+    g_busy++;
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_lock);
+}
+
+void kvs_lazyfree_enable(int on)
+{
+    g_enabled = on ? 1 : 0;
+}
+
+int kvs_lazyfree_enabled(void)
+{
+    return g_enabled;
+}
+
+int kvs_lazyfree_array(kvs_array_t *inst)
+{
+    if (!inst)
+        return -1;
+
+    kvs_lazy_job_t *job = (kvs_lazy_job_t *)malloc(sizeof(*job));
+    if (!job || kvs_array_detach(inst, &job->u.array) != 0)
+    {
+        free(job);
+        kvs_array_destory(inst);
+        return kvs_array_create(inst);
+    }
+    job->type = LAZY_ARRAY;
+    submit(job);
+    return 0;
+}
+
+int kvs_lazyfree_rbtree(kvs_rbtree_t *inst)
+{
+    if (!inst)
+        return -1;
+
+    kvs_lazy_job_t *job = (kvs_lazy_job_t *)malloc(sizeof(*job));
+    if (!job || kvs_rbtree_detach(inst, &job->u.rbtree) != 0)
+    {
+        free(job);
+        kvs_rbtree_destory(inst);
+        return kvs_rbtree_create(inst);
+    }
+    job->type = LAZY_RBTREE;
+    submit(job);
+    return 0;
+}
+
+int kvs_lazyfree_hash(kvs_hash_t *hash)
+{
+    if (!hash)
+        return -1;
+
+    kvs_lazy_job_t *job = (kvs_lazy_job_t *)malloc(sizeof(*job));
+    if (!job || kvs_hash_detach(hash, &job->u.hash) != 0)
+    {
+        free(job);
+        kvs_hash_destory(hash);
+        return kvs_hash_create(hash);
+    }
+    job->type = LAZY_HASH;
+    job->cursor = 0;
+    submit(job);
+    return 0;
+}
+
+void kvs_lazyfree_value(char *value, size_t size)
+{
+    if (!value)
+        return;
+
+    kvs_lazy_job_t *job = NULL;
+    if (g_enabled && size >= KVS_LAZYFREE_MIN_VALUE)
+        job = (kvs_lazy_job_t *)malloc(sizeof(*job));
+    if (!job)
+    {
+        kvs_free(value, size);
+        return;
+    }
+
+    job->type = LAZY_VALUE;
+    job->u.value.ptr = value;
+    job->u.value.size = size;
+    submit(job);
+}
+
+int kvs_lazyfree_step(int budget)
+{
+    kvs_lazy_job_t *job = t_head;
+    if (!job)
+        return 0;
+
+    if (budget > 0 && job_release(job, budget) == 0)
+    {
+        t_head = job->next;
+        if (!t_head)
+            t_tail = NULL;
+        job_done(job);
+    }
+    return t_head != NULL;
+}
+
+int64_t kvs_lazyfree_pending(void)
+{
+    return atomic_load_explicit(&g_pending, memory_order_relaxed);
+}
+
+void kvs_lazyfree_wait(void)
+{
+    while (kvs_lazyfree_step(KVS_LAZYFREE_BATCH))
+        ;
+
+    pthread_mutex_lock(&g_lock);
+    while (g_busy > 0)
+        pthread_cond_wait(&g_idle, &g_lock);
+    pthread_mutex_unlock(&g_lock);
+}
@@ -0,0 +1,158 @@
+#include "engine/kvs_lzf.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LZF_HLOG 12
+#define LZF_MAX_LIT 32
+#define LZF_MAX_OFF (1 << 13)
+#define LZF_MAX_REF ((1 << 8) + (1 << 3)) // 264
+
+static inline uint32_t lzf_hash(const uint8_t *p)
+{
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - LZF_HLOG);
+}
+
+size_t kvs_lzf_compress(const void *in, size_t in_len, void *out, size_t out_cap)
+{
+    const uint8_t *ip = (const uint8_t *)in;
+    const uint8_t *in_end = ip + in_len;
+    uint8_t *op = (uint8_t *)out;
+    uint8_t *out_end = op + out_cap;
+
+    if (in_len < 4 || out_cap < 2)
+        return 0;
+
+    // 每个 hash 槽记最近一次出现的位置 + 1，0 为空
+    uint32_t htab[1 << LZF_HLOG];
+    memset(htab, 0, sizeof(htab));
+
+    uint8_t *ctrl = op++; // 当前字面量段的控制字节
+    int lit = 0;
+
+    while (ip + 2 < in_end)
+    {
+        uint32_t h = lzf_hash(ip);
+        uint32_t pos = (uint32_t)(ip - (const uint8_t *)in);
+        const uint8_t *ref = htab[h] ? (const uint8_t *)in + htab[h] - 1 : NULL;
+        htab[h] = pos + 1;
+
+        size_t off;
+        if (ref && (off = (size_t)(ip - ref - 1)) < LZF_MAX_OFF && ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2])
+        {
+            size_t max = (size_t)(in_end - ip);
+            if (max > LZF_MAX_REF)
+                max = LZF_MAX_REF;
+            size_t len = 3;
+            while (len < max && ref[len] == ip[len])
+                len++;
+
+            // 结束字面量段；匹配最多 3 字节，之后还要留一个控制字节
+            if (op + 4 > out_end)
+                return 0;
+            if (lit)
+                *ctrl = (uint8_t)(lit - 1);
+            else
+                op--;
+
+            size_t code = len - 2;
+            if (code < 7)
+            {
+                *op++ = (uint8_t)((off >> 8) + (code << 5));
+            }
+            else
+            {
+                *op++ = (uint8_t)((off >> 8) + (7 << 5));
+                *op++ = (uint8_t)(code - 7);
+            }
+            *op++ = (uint8_t)off;
+
+            // 匹配内部的位置也登记进表
+            for (size_t i = 1; i < len && ip + i + 2 < in_end; i++)
+                htab[lzf_hash(ip + i)] = pos + (uint32_t)i + 1;
+            ip += len;
+
+            ctrl = op++;
+            lit = 0;
+            continue;
+        }
+
+        if (op >= out_end)
+            return 0;
+        *op++ = *ip++;
+        if (++lit == LZF_MAX_LIT)
+        {
+            if (op >= out_end)
+                return 0;
+            *ctrl = LZF_MAX_LIT - 1;
+            ctrl = op++;
+            lit = 0;
+        }
+    }
+
+    while (ip < in_end)
+    {
+        if (op >= out_end)
+            return 0;
+        *op++ = *ip++;
+        if (++lit == LZF_MAX_LIT)
+        {
+            if (op >= out_end)
+                return 0;
+            *ctrl = LZF_MAX_LIT - 1;
+            ctrl = op++;
+            lit = 0;
+        }
+    }
+
+    if (lit)
+        *ctrl = (uint8_t)(lit - 1);
+    else
+        op--;
+    return (size_t)(op - (uint8_t *)out);
+}
+
+size_t kvs_lzf_decompress(const void *in, size_t in_len, void *out, size_t out_cap)
+{
+    const uint8_t *ip = (const uint8_t *)in;
+    const uint8_t *in_end = ip + in_len;
+    uint8_t *op = (uint8_t *)out;
+    uint8_t *out_end = op + out_cap;
+
+    while (ip < in_end)
+    {
+        unsigned int c = *ip++;
+        if (c < LZF_MAX_LIT)
+        {
+            size_t n = c + 1;
+            if ((size_t)(out_end - op) < n || (size_t)(in_end - ip) < n)
+                return 0;
+            memcpy(op, ip, n);
+            op += n;
+            ip += n;
+            continue;
+        }
+
+        size_t len = c >> 5;
+        if (len == 7)
+        {
+            if (ip >= in_end)
+                return 0;
+            len += *ip++;
+        }
+        if (ip >= in_end)
+            return 0;
+        size_t off = ((size_t)(c & 0x1f) << 8) + *ip++ + 1;
+        len += 2;
+        if ((size_t)(op - (uint8_t *)out) < off || (size_t)(out_end - op) < len)
+            return 0;
+
+        // 距离可能小于长度，逐字节复制
+        const uint8_t *ref = op - off;
+        for (size_t i = 0; i < len; i++)
+            op[i] = ref[i];
+        op += len;
+    }
+    return (size_t)(op - (uint8_t *)out);
+}
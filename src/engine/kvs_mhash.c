@@ -0,0 +1,455 @@
+#define _GNU_SOURCE
+#include "engine/kvs_mhash.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MHASH_HEAD 4096 // 文件头占第一页，块从这里开始
+#define MHASH_MIN_CLASS 6
+
+enum
+{
+    MBLOCK_FREE = 0,
+    MBLOCK_LIVE = 0x4556494c, // "LIVE"
+    MBLOCK_TABLE = 0x4c424154, // "TABL"
+};
+
+// 块头：LIVE 块之后是 key\0value\0，TABLE 块之后是 uint64_t 桶数组
+typedef struct mblock_s
+{
+    uint32_t cls;   // 块大小为 1 << cls
+    uint32_t state; // MBLOCK_*，LIVE 总是最后写
+    uint64_t next;  // LIVE: 同桶下一个条目; FREE: 空闲链表下一块
+    uint64_t seq;
+    uint32_t hash;
+    uint32_t klen;
+    uint32_t vlen;
+    uint32_t pad;
+    char data[];
+} mblock_t;
+
+static inline mblock_t *_block(kvs_mhash_t *mh, uint64_t off)
+{
+    return (mblock_t *)(mh->base + off);
+}
+
+static inline uint64_t *_buckets(kvs_mhash_t *mh)
+{
+    return (uint64_t *)_block(mh, mh->hdr->table)->data;
+}
+
+// mhash 自己的哈希：桶下标随数据落盘，换函数就找不到已有的 key，不能跟着 kvs_hash 改
+// 逐字节累积后混合一次，低位受所有字节影响
+static uint32_t _hash(const char *key)
+{
+    uint32_t h = 5381;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++)
+        h = h * 33 + *p;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h;
+}
+
+static int _class(uint64_t size)
+{
+    int k = MHASH_MIN_CLASS;
+    while (k < KVS_MHASH_CLASSES && (1ULL << k) < size)
+        k++;
+    return k < KVS_MHASH_CLASSES ? k : -1;
+}
+
+// 文件翻倍直到尾部能再放下 need 字节；映射可能搬到新地址
+static int _grow(kvs_mhash_t *mh, uint64_t need)
+{
+    uint64_t old = mh->hdr->size;
+    uint64_t size = old;
+    while (size < mh->hdr->top + need)
+        size *= 2;
+
+    if (ftruncate(mh->fd, (off_t)size) != 0)
+        return -2;
+    void *p = mremap(mh->base, old, size, MREMAP_MAYMOVE);
+    if (p == MAP_FAILED)
+        return -2;
+
+    mh->base = (char *)p;
+    mh->hdr = (kvs_mhash_header_t *)p;
+    mh->hdr->size = size;
+    return 0;
+}
+
+// 取一个 1 << cls 大小的 FREE 块；先从空闲链表拿，没有再从尾部切
+// 切新块时先写好块头再推进 top，恢复时顺序扫描总能按块头跳到下一块
+static uint64_t _alloc(kvs_mhash_t *mh, int cls)
+{
+    kvs_mhash_header_t *hdr = mh->hdr;
+    if (hdr->free[cls])
+    {
+        uint64_t off = hdr->free[cls];
+        hdr->free[cls] = _block(mh, off)->next;
+        return off;
+    }
+
+    uint64_t size = 1ULL << cls;
+    if (hdr->top + size > hdr->size && _grow(mh, size) != 0)
+        return 0;
+    hdr = mh->hdr;
+
+    uint64_t off = hdr->top;
+    mblock_t *b = _block(mh, off);
+    b->cls = (uint32_t)cls;
+    b->state = MBLOCK_FREE;
+    __atomic_store_n(&hdr->top, off + size, __ATOMIC_RELEASE);
+    return off;
+}
+
+// 调用方已把块从桶链表里摘下
+static void _release(kvs_mhash_t *mh, uint64_t off)
+{
+    mblock_t *b = _block(mh, off);
+    __atomic_store_n(&b->state, MBLOCK_FREE, __ATOMIC_RELEASE);
+    b->next = mh->hdr->free[b->cls];
+    mh->hdr->free[b->cls] = off;
+}
+
+// 写一个完整的新条目，返回偏移，0 为失败
+static uint64_t _new_entry(kvs_mhash_t *mh, const char *key, const char *value, uint32_t h)
+{
+    size_t klen = strlen(key);
+    size_t vlen = strlen(value);
+    int cls = _class(sizeof(mblock_t) + klen + vlen + 2);
+    if (cls < 0 || klen > UINT32_MAX || vlen > UINT32_MAX)
+        return 0;
+
+    uint64_t off = _alloc(mh, cls);
+    if (!off)
+        return 0;
+
+    mblock_t *b = _block(mh, off);
+    b->next = 0;
+    b->seq = mh->hdr->seq++;
+    b->hash = h;
+    b->klen = (uint32_t)klen;
+    b->vlen = (uint32_t)vlen;
+    memcpy(b->data, key, klen + 1);
+    memcpy(b->data + klen + 1, value, vlen + 1);
+    __atomic_store_n(&b->state, MBLOCK_LIVE, __ATOMIC_RELEASE);
+    return off;
+}
+
+// 返回指向 key 所在条目的链接（桶或前一个条目的 next），不存在时 *link 为 0
+static uint64_t *_find(kvs_mhash_t *mh, const char *key, uint32_t h)
+{
+    uint64_t *link = &_buckets(mh)[h & (mh->hdr->nbuckets - 1)];
+    while (*link)
+    {
+        mblock_t *b = _block(mh, *link);
+        if (b->hash == h && strcmp(b->data, key) == 0)
+            break;
+        link = &b->next;
+    }
+    return link;
+}
+
+static uint64_t _new_table(kvs_mhash_t *mh, uint64_t nbuckets)
+{
+    int cls = _class(sizeof(mblock_t) + nbuckets * sizeof(uint64_t));
+    if (cls < 0)
+        return 0;
+    uint64_t off = _alloc(mh, cls);
+    if (!off)
+        return 0;
+
+    mblock_t *b = _block(mh, off);
+    memset(b->data, 0, nbuckets * sizeof(uint64_t));
+    b->state = MBLOCK_TABLE;
+    return off;
+}
+
+// 换成 nbuckets 个桶的新表；中途崩溃时 clean 为 0，下次打开会整表重建
+static int _resize(kvs_mhash_t *mh, uint64_t nbuckets)
+{
+    uint64_t off = _new_table(mh, nbuckets);
+    if (!off)
+        return -2;
+
+    uint64_t *nodes = (uint64_t *)_block(mh, off)->data;
+    uint64_t *old = _buckets(mh);
+    for (uint64_t i = 0; i < mh->hdr->nbuckets; i++)
+    {
+        uint64_t cur = old[i];
+        while (cur)
+        {
+            mblock_t *b = _block(mh, cur);
+            uint64_t next = b->next;
+            uint64_t idx = b->hash & (nbuckets - 1);
+            b->next = nodes[idx];
+            nodes[idx] = cur;
+            cur = next;
+        }
+    }
+
+    uint64_t prev = mh->hdr->table;
+    mh->hdr->table = off;
+    mh->hdr->nbuckets = nbuckets;
+    _release(mh, prev);
+    return 0;
+}
+
+// 非正常关闭后的恢复：顺序扫描全部块
+//   第一遍：LIVE 计数，其余（半写的、已删除的、旧桶数组）全部放回空闲链表
+//   第二遍：LIVE 条目挂到新桶数组，同一个 key 只保留序号最大的
+static int _recover(kvs_mhash_t *mh)
+{
+    kvs_mhash_header_t *hdr = mh->hdr;
+    memset(hdr->free, 0, sizeof(hdr->free));
+    hdr->count = 0;
+
+    uint64_t seq = 0;
+    uint64_t off = MHASH_HEAD;
+    while (off < hdr->top)
+    {
+        mblock_t *b = _block(mh, off);
+        uint64_t size = 1ULL << (b->cls & 63);
+        if (b->cls < MHASH_MIN_CLASS || b->cls >= KVS_MHASH_CLASSES || off + size > hdr->top)
+        {
+            hdr->top = off; // 尾部块头不完整：丢弃
+            break;
+        }
+
+        if (b->state == MBLOCK_LIVE && sizeof(mblock_t) + (uint64_t)b->klen + b->vlen + 2 <= size &&
+            b->data[b->klen] == '\0' && b->data[b->klen + 1 + b->vlen] == '\0')
+        {
+            hdr->count++;
+            if (b->seq > seq)
+                seq = b->seq;
+        }
+        else
+        {
+            _release(mh, off);
+        }
+        off += size;
+    }
+    hdr->seq = seq + 1;
+
+    uint64_t nbuckets = KVS_MHASH_INIT_BUCKETS;
+    while (nbuckets < hdr->count)
+        nbuckets *= 2;
+    uint64_t table = _new_table(mh, nbuckets);
+    if (!table)
+        return -2;
+    hdr = mh->hdr;
+    hdr->table = table;
+    hdr->nbuckets = nbuckets;
+
+    for (off = MHASH_HEAD; off < hdr->top; off += 1ULL << _block(mh, off)->cls)
+    {
+        mblock_t *b = _block(mh, off);
+        if (b->state != MBLOCK_LIVE)
+            continue;
+
+        b->hash = _hash(b->data);
+        uint64_t *link = _find(mh, b->data, b->hash);
+        if (*link)
+        {
+            hdr->count--;
+            mblock_t *other = _block(mh, *link);
+            if (other->seq > b->seq)
+            {
+                _release(mh, off);
+                continue;
+            }
+            uint64_t stale = *link;
+            b->next = other->next;
+            *link = off;
+            _release(mh, stale);
+            continue;
+        }
+        b->next = 0;
+        *link = off;
+    }
+    return 0;
+}
+
+int kvs_mhash_create(kvs_mhash_t *mh, const char *path)
+{
+    if (!mh || !path)
+        return -1;
+
+    memset(mh, 0, sizeof(*mh));
+    mh->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (mh->fd < 0)
+        return -2;
+
+    struct stat st;
+    if (fstat(mh->fd, &st) != 0)
+        goto fail;
+
+    int fresh = st.st_size == 0;
+    if (fresh && ftruncate(mh->fd, KVS_MHASH_INIT_SIZE) != 0)
+        goto fail;
+    uint64_t size = fresh ? KVS_MHASH_INIT_SIZE : (uint64_t)st.st_size;
+    if (size < MHASH_HEAD * 2)
+        goto fail;
+
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mh->fd, 0);
+    if (p == MAP_FAILED)
+        goto fail;
+    mh->base = (char *)p;
+    mh->hdr = (kvs_mhash_header_t *)p;
+    kvs_mhash_header_t *hdr = mh->hdr;
+
+    if (fresh)
+    {
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->size = size;
+        hdr->top = MHASH_HEAD;
+        hdr->seq = 1;
+        hdr->nbuckets = KVS_MHASH_INIT_BUCKETS;
+        hdr->table = _new_table(mh, KVS_MHASH_INIT_BUCKETS);
+        if (!hdr->table)
+            goto fail;
+        hdr->magic = KVS_MHASH_MAGIC;
+    }
+    else
+    {
+        if (hdr->magic != KVS_MHASH_MAGIC || hdr->top < MHASH_HEAD || hdr->top > size)
+            goto fail;
+        hdr->size = size; // 扩展文件后、写入新大小前崩溃时以实际大小为准
+        if (!hdr->clean && _recover(mh) != 0)
+            goto fail;
+    }
+
+    // 运行期间 clean 为 0：之后任何时刻崩溃，下次打开都会走恢复
+    mh->hdr->clean = 0;
+    msync(mh->base, MHASH_HEAD, MS_SYNC);
+    return 0;
+
+fail:
+    if (mh->base)
+        munmap(mh->base, mh->hdr->size);
+    close(mh->fd);
+    memset(mh, 0, sizeof(*mh));
+    mh->fd = -1;
+    return -2;
+}
+
+void kvs_mhash_destory(kvs_mhash_t *mh)
+{
+    if (!mh || !mh->base)
+        return;
+
+    uint64_t size = mh->hdr->size;
+    msync(mh->base, size, MS_SYNC);
+    mh->hdr->clean = 1; // 数据都已落盘才标记
+    msync(mh->base, MHASH_HEAD, MS_SYNC);
+
+    munmap(mh->base, size);
+    close(mh->fd);
+    memset(mh, 0, sizeof(*mh));
+    mh->fd = -1;
+}
+
+int kvs_mhash_set(kvs_mhash_t *mh, char *key, char *value)
+{
+    if (!mh || !mh->base || !key || !value)
+        return -1;
+
+    uint32_t h = _hash(key);
+    if (*_find(mh, key, h))
+        return 1; // exist
+
+    uint64_t off = _new_entry(mh, key, value, h);
+    if (!off)
+        return -2;
+
+    // 写完整个条目后，一次 8 字节的写把它挂进桶
+    uint64_t *bucket = &_buckets(mh)[h & (mh->hdr->nbuckets - 1)];
+    _block(mh, off)->next = *bucket;
+    __atomic_store_n(bucket, off, __ATOMIC_RELEASE);
+    mh->hdr->count++;
+
+    // 负载因子超过 1 时翻倍；失败不影响本次写入
+    if (mh->hdr->count > mh->hdr->nbuckets)
+        _resize(mh, mh->hdr->nbuckets * 2);
+    return 0;
+}
+
+char *kvs_mhash_get(kvs_mhash_t *mh, char *key)
+{
+    if (!mh || !mh->base || !key)
+        return NULL;
+
+    uint64_t off = *_find(mh, key, _hash(key));
+    if (!off)
+        return NULL;
+    mblock_t *b = _block(mh, off);
+    return b->data + b->klen + 1;
+}
+
+int kvs_mhash_mod(kvs_mhash_t *mh, char *key, char *value)
+{
+    if (!mh || !mh->base || !key || !value)
+        return -1;
+
+    uint32_t h = _hash(key);
+    if (!*_find(mh, key, h))
+        return 1;
+
+    uint64_t off = _new_entry(mh, key, value, h);
+    if (!off)
+        return -2;
+
+    // 写新条目可能扩展了映射，重新定位旧条目后整体替换
+    uint64_t *link = _find(mh, key, h);
+    uint64_t old = *link;
+    _block(mh, off)->next = _block(mh, old)->next;
+    __atomic_store_n(link, off, __ATOMIC_RELEASE);
+    _release(mh, old);
+    return 0;
+}
+
+int kvs_mhash_del(kvs_mhash_t *mh, char *key)
+{
+    if (!mh || !mh->base || !key)
+        return -1;
+
+    uint64_t *link = _find(mh, key, _hash(key));
+    uint64_t off = *link;
+    if (!off)
+        return 1;
+
+    __atomic_store_n(link, _block(mh, off)->next, __ATOMIC_RELEASE);
+    mh->hdr->count--;
+    _release(mh, off);
+    return 0;
+}
+
+/*
+ * @return 0: exist, 1: no exist
+ */
+int kvs_mhash_exist(kvs_mhash_t *mh, char *key)
+{
+    if (!mh || !mh->base || !key)
+        return -1;
+    return *_find(mh, key, _hash(key)) ? 0 : 1;
+}
+
+int kvs_mhash_count(kvs_mhash_t *mh)
+{
+    if (!mh || !mh->base)
+        return 0;
+    return (int)mh->hdr->count;
+}
+
+int kvs_mhash_sync(kvs_mhash_t *mh)
+{
+    if (!mh || !mh->base)
+        return -1;
+    return msync(mh->base, mh->hdr->size, MS_SYNC) == 0 ? 0 : -2;
+}
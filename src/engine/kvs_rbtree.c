@@ -1,4 +1,6 @@
 #include "engine/kvs_rbtree.h"
+#include "engine/kvs_lazyfree.h"
+#include "engine/kvs_value.h"
 
 rbtree_node *rbtree_mini(rbtree *T, rbtree_node *x)
 {
@@ -326,9 +328,9 @@ rbtree_node *rbtree_delete(rbtree *T, rbtree_node *z)
         z->key = y->key;
         y->key = tmp;
 
-        tmp = z->value;
+        kvs_value_t v = z->value;
         z->value = y->value;
-        y->value = tmp;
+        y->value = v;
     }
 
     if (y->color == BLACK)
@@ -367,7 +369,8 @@ void rbtree_traversal(rbtree *T, rbtree_node *node)
     if (node != T->nil)
     {
         rbtree_traversal(T, node->left);
-        printf("key:%s, value:%s\n", node->key, (char *)node->value);
+        char *value = kvs_value_str(&node->value);
+        printf("key:%s, value:%s\n", node->key, value ? value : "(unreadable)");
         rbtree_traversal(T, node->right);
     }
 }
@@ -379,9 +382,7 @@ int kvs_rbtree_create(kvs_rbtree_t *inst)
 {
     if (inst == NULL)
         return -1;
-    inst->nil = (rbtree_node *)kvs_malloc(sizeof(rbtree_node));
-    if (inst->nil == NULL)
-        return -2;
+    inst->nil = &inst->nil_node;
 
     inst->nil->color = BLACK;
     inst->nil->left = inst->nil;
@@ -389,7 +390,7 @@ int kvs_rbtree_create(kvs_rbtree_t *inst)
     inst->nil->parent = inst->nil;
 
     inst->nil->key = NULL;
-    inst->nil->value = NULL;
+    inst->nil->value.in.enc = KVS_ENC_NONE;
 
     inst->root = inst->nil;
 
@@ -409,67 +410,161 @@ void kvs_rbtree_destory(kvs_rbtree_t *inst)
         // 必须释放节点内存资源
         if (del && del != inst->nil)
         {
-            kvs_free(del->key);
-            kvs_free(del->value);
-            kvs_free(del);
+            kvs_free_str(del->key);
+            kvs_value_free(&del->value);
+            kvs_free(del, sizeof(rbtree_node));
         }
     }
 
-    kvs_free(inst->nil);
     inst->nil = NULL;
     inst->root = NULL;
 }
 
-int kvs_rbtree_set(kvs_rbtree_t *inst, char *key, char *value)
+// 一次下降定位 key：找到返回节点；否则返回 nil，*parent/*cmp 为新节点应挂的位置
+static rbtree_node *rbtree_locate(rbtree *T, const char *key, rbtree_node **parent, int *cmp)
 {
-    if (!inst || !key || !value)
-        return -1;
+    rbtree_node *y = T->nil;
+    rbtree_node *x = T->root;
+    int c = 0;
 
-    // 1) 先判断是否已存在（rbtree_search 不会返回 NULL）
-    rbtree_node *exist = rbtree_search(inst, key);
-    if (exist != inst->nil)
+    while (x != T->nil)
     {
-        return 1; // already exists
+        c = strcmp(key, x->key);
+        if (c == 0)
+            break;
+        y = x;
+        x = c < 0 ? x->left : x->right;
     }
 
-    // 2) 分配节点
+    *parent = y;
+    *cmp = c;
+    return x;
+}
+
+// 按 rbtree_locate 给出的位置挂上新节点并修复平衡，不再重新下降
+static int rbtree_link(rbtree *T, rbtree_node *parent, int cmp, char *key, char *value)
+{
+    // 1) 分配节点
     rbtree_node *node = (rbtree_node *)kvs_malloc(sizeof(rbtree_node));
     if (!node)
         return -2;
 
-    // 3) 分配并复制 key
-    size_t klen = strlen(key);
-    node->key = kvs_malloc(klen + 1);
+    // 2) 分配并复制 key/value
+    node->key = kvs_strdup(key);
     if (!node->key)
     {
-        kvs_free(node);
+        kvs_free(node, sizeof(rbtree_node));
         return -2;
     }
-    memcpy(node->key, key, klen + 1);
-
-    // 4) 分配并复制 value
-    size_t vlen = strlen(value);
-    node->value = kvs_malloc(vlen + 1);
-    if (!node->value)
+    node->value.in.enc = KVS_ENC_NONE;
+    if (kvs_value_init(&node->value, value) != 0)
     {
-        kvs_free(node->key);
-        kvs_free(node);
+        kvs_free_str(node->key);
+        kvs_free(node, sizeof(rbtree_node));
         return -2;
     }
-    memcpy(node->value, value, vlen + 1);
 
-    // 5) 重要：把指针域初始化为 nil，避免插入过程中意外读到野指针
-    node->left = inst->nil;
-    node->right = inst->nil;
-    node->parent = inst->nil;
+    // 3) 挂到 parent 下
+    node->left = T->nil;
+    node->right = T->nil;
+    node->parent = parent;
     node->color = RED;
+    if (parent == T->nil)
+        T->root = node;
+    else if (cmp < 0)
+        parent->left = node;
+    else
+        parent->right = node;
 
-    // 6) 插入（此时一定不存在重复 key）
-    rbtree_insert(inst, node);
-
+    rbtree_insert_fixup(T, node);
     return 0;
 }
 
+int kvs_rbtree_set(kvs_rbtree_t *inst, char *key, char *value)
+{
+    if (!inst || !key || !value)
+        return -1;
+
+    rbtree_node *parent;
+    int cmp;
+    if (rbtree_locate(inst, key, &parent, &cmp) != inst->nil)
+        return 1; // already exists
+
+    return rbtree_link(inst, parent, cmp, key, value);
+}
+
+int kvs_rbtree_upsert(kvs_rbtree_t *inst, char *key, char *value)
+{
+    if (!inst || !key || !value)
+        return -1;
+
+    rbtree_node *parent;
+    int cmp;
+    rbtree_node *node = rbtree_locate(inst, key, &parent, &cmp);
+    if (node == inst->nil)
+        return rbtree_link(inst, parent, cmp, key, value);
+
+    return kvs_value_assign(&node->value, value) < 0 ? -2 : 1;
+}
+
+int kvs_rbtree_getset(kvs_rbtree_t *inst, char *key, char *value, kvs_value_t *old)
+{
+    if (!inst || !key || !value || !old)
+        return -1;
+
+    old->in.enc = KVS_ENC_NONE;
+    rbtree_node *parent;
+    int cmp;
+    rbtree_node *node = rbtree_locate(inst, key, &parent, &cmp);
+    if (node == inst->nil)
+        return rbtree_link(inst, parent, cmp, key, value);
+
+    // 旧值要交给调用方，不能原地覆盖
+    kvs_value_t nv;
+    nv.in.enc = KVS_ENC_NONE;
+    if (kvs_value_init(&nv, value) != 0)
+        return -2;
+    *old = node->value;
+    node->value = nv;
+    return 1;
+}
+
+int kvs_rbtree_cas(kvs_rbtree_t *inst, char *key, char *expect, char *value)
+{
+    if (!inst || !key || !expect || !value)
+        return -1;
+
+    rbtree_node *node = rbtree_search(inst, key);
+    if (node == inst->nil)
+        return 1;
+    const char *cur = kvs_value_str(&node->value);
+    if (!cur)
+        return -1; // 读不出来，不能拿来比较
+    if (strcmp(cur, expect) != 0)
+        return 2;
+
+    return kvs_value_assign(&node->value, value);
+}
+
+int kvs_rbtree_incr(kvs_rbtree_t *inst, char *key, int64_t delta, int64_t *result)
+{
+    if (!inst || !key)
+        return -1;
+
+    rbtree_node *parent;
+    int cmp;
+    rbtree_node *node = rbtree_locate(inst, key, &parent, &cmp);
+    if (node != inst->nil)
+        return kvs_value_incr(&node->value, delta, result);
+
+    char buf[21];
+    kvs_value_format_int(delta, buf);
+    int ret = rbtree_link(inst, parent, cmp, key, buf);
+    if (ret == 0 && result)
+        *result = delta;
+    return ret;
+}
+
 char *kvs_rbtree_get(kvs_rbtree_t *inst, char *key)
 {
 
@@ -481,7 +576,7 @@ char *kvs_rbtree_get(kvs_rbtree_t *inst, char *key)
     if (node == inst->nil)
         return NULL;
 
-    return node->value;
+    return kvs_value_str(&node->value);
 }
 
 int kvs_rbtree_del(kvs_rbtree_t *inst, char *key)
@@ -497,10 +592,10 @@ int kvs_rbtree_del(kvs_rbtree_t *inst, char *key)
     rbtree_node *cur = rbtree_delete(inst, node);
     // free(cur);
 
-    kvs_free(cur->key);
-    kvs_free(cur->value);
+    kvs_free_str(cur->key);
+    kvs_value_lazyfree(&cur->value);
 
-    kvs_free(cur);
+    kvs_free(cur, sizeof(rbtree_node));
 
     return 0;
 }
@@ -514,16 +609,248 @@ int kvs_rbtree_mod(kvs_rbtree_t *inst, char *key, char *value)
     if (node == inst->nil)
         return 1; // no exist
 
-    size_t vlen = strlen(value);
-    char *newv = kvs_malloc(vlen + 1);
-    if (!newv)
-        return -2;
+    return kvs_value_assign(&node->value, value);
+}
 
-    memcpy(newv, value, vlen + 1);
+typedef struct
+{
+    char *key;
+    int idx;
+} rbtree_batch_key;
 
-    kvs_free(node->value);
-    node->value = newv;
-    return 0;
+// 相同 key 按原下标排，重复 key 的结果与逐个调用一致
+static int rbtree_batch_cmp(const void *a, const void *b)
+{
+    const rbtree_batch_key *x = a, *y = b;
+    int c = strcmp(x->key, y->key);
+    return c ? c : x->idx - y->idx;
+}
+
+// n 不超过 KVS_RBTREE_BATCH 时用调用方的栈空间，否则系统 malloc；失败返回 NULL
+static rbtree_batch_key *rbtree_batch_sort(char **keys, int n, rbtree_batch_key *buf)
+{
+    rbtree_batch_key *sorted = n <= KVS_RBTREE_BATCH ? buf : (rbtree_batch_key *)malloc(sizeof(*sorted) * n);
+    if (!sorted)
+        return NULL;
+    for (int i = 0; i < n; i++)
+    {
+        sorted[i].key = keys[i];
+        sorted[i].idx = i;
+    }
+    qsort(sorted, n, sizeof(*sorted), rbtree_batch_cmp);
+    return sorted;
+}
+
+// 批量查找：key 排序后依次下降，栈里保留上一次的路径及每层子树的上界（左转时收紧，NULL 为无穷大）；
+// 下一个 key 只需弹出上界不超过它的层，从仍然包含它的最深子树继续，公共前缀不再重复比较
+int kvs_rbtree_mget(kvs_rbtree_t *inst, char **keys, int n, char **values)
+{
+    if (!inst || !inst->nil || !keys || !values || n < 0)
+        return -1;
+
+    for (int i = 0; i < n; i++)
+        if (!keys[i])
+            return -1;
+
+    rbtree_batch_key buf[KVS_RBTREE_BATCH];
+    rbtree_batch_key *sorted = rbtree_batch_sort(keys, n, buf);
+    if (!sorted)
+    {
+        int found = 0;
+        for (int i = 0; i < n; i++)
+        {
+            values[i] = kvs_rbtree_get(inst, keys[i]);
+            found += values[i] != NULL;
+        }
+        return found;
+    }
+
+    // 红黑树高度不超过 2log2(n+1)，栈满时继续下降但不再入栈，只是少复用几层
+    rbtree_node *path[KVS_RBTREE_MAX_DEPTH];
+    const char *hi[KVS_RBTREE_MAX_DEPTH];
+    int depth = 0;
+    path[depth] = inst->root;
+    hi[depth++] = NULL;
+
+    int found = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const char *k = sorted[i].key;
+        while (depth > 1 && hi[depth - 1] && strcmp(k, hi[depth - 1]) >= 0)
+            depth--;
+
+        rbtree_node *x = path[depth - 1];
+        const char *bound = hi[depth - 1];
+        while (x != inst->nil)
+        {
+            int c = strcmp(k, x->key);
+            if (c == 0)
+                break;
+            if (c < 0)
+            {
+                bound = x->key;
+                x = x->left;
+            }
+            else
+            {
+                x = x->right;
+            }
+            if (x != inst->nil && depth < KVS_RBTREE_MAX_DEPTH)
+            {
+                path[depth] = x;
+                hi[depth++] = bound;
+            }
+        }
+
+        values[sorted[i].idx] = x != inst->nil ? kvs_value_str(&x->value) : NULL;
+        found += x != inst->nil;
+    }
+
+    if (sorted != buf)
+        free(sorted);
+    return found;
+}
+
+// 批量写入：按 key 顺序插入，相邻 key 的查找路径基本落在已经热的节点上
+int kvs_rbtree_mset(kvs_rbtree_t *inst, char **keys, char **values, int n, int *results)
+{
+    if (!inst || !inst->nil || !keys || !values || !results || n < 0)
+        return -1;
+
+    for (int i = 0; i < n; i++)
+        if (!keys[i])
+            return -1;
+
+    rbtree_batch_key buf[KVS_RBTREE_BATCH];
+    rbtree_batch_key *sorted = rbtree_batch_sort(keys, n, buf);
+
+    int ok = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int idx = sorted ? sorted[i].idx : i;
+        results[idx] = kvs_rbtree_set(inst, keys[idx], values[idx]);
+        ok += results[idx] == 0;
+    }
+
+    if (sorted && sorted != buf)
+        free(sorted);
+    return ok;
+}
+
+// 第一个 key 严格大于 key 的节点
+static rbtree_node *rbtree_upper_bound(rbtree *T, const char *key)
+{
+    rbtree_node *x = T->root, *best = T->nil;
+    while (x != T->nil)
+    {
+        if (strcmp(key, x->key) < 0)
+        {
+            best = x;
+            x = x->left;
+        }
+        else
+        {
+            x = x->right;
+        }
+    }
+    return best;
+}
+
+// 搬迁一个节点，并修正父节点、子节点指向它的指针
+static rbtree_node *rbtree_relocate(rbtree *T, rbtree_node *x)
+{
+    rbtree_node *n = (rbtree_node *)kvs_alloc_move(x, sizeof(rbtree_node));
+    if (n != x)
+    {
+        if (n->parent == T->nil)
+            T->root = n;
+        else if (n->parent->left == x)
+            n->parent->left = n;
+        else
+            n->parent->right = n;
+
+        if (n->left != T->nil)
+            n->left->parent = n;
+        if (n->right != T->nil)
+            n->right->parent = n;
+    }
+
+    n->key = (char *)kvs_alloc_move(n->key, strlen(n->key) + 1);
+    kvs_value_move(&n->value);
+    return n;
+}
+
+int kvs_rbtree_defrag(kvs_rbtree_t *inst, char **cursor, int budget)
+{
+    if (!inst || !inst->nil || !cursor)
+        return 0;
+
+    rbtree_node *x = *cursor ? rbtree_upper_bound(inst, *cursor) : rbtree_mini(inst, inst->root);
+    rbtree_node *last = inst->nil;
+
+    for (; x != inst->nil && budget > 0; budget--)
+    {
+        last = rbtree_relocate(inst, x);
+        x = rbtree_successor(inst, last);
+    }
+
+    if (x == inst->nil)
+    {
+        free(*cursor);
+        *cursor = NULL;
+        return 0;
+    }
+
+    // 记下最后处理的 key，下次从它的后继继续
+    size_t len = strlen(last->key) + 1;
+    char *c = (char *)realloc(*cursor, len);
+    if (!c)
+        return 1; // 沿用旧 cursor，最多重复搬一段
+    memcpy(c, last->key, len);
+    *cursor = c;
+    return 1;
+}
+
+void kvs_rbtree_foreach(kvs_rbtree_t *inst, kvs_value_fn fn, void *arg)
+{
+    if (!inst || !inst->nil || !fn)
+        return;
+
+    for (rbtree_node *x = rbtree_mini(inst, inst->root); x != inst->nil; x = rbtree_successor(inst, x))
+        fn(arg, x->key, &x->value);
+}
+
+int kvs_rbtree_values(kvs_rbtree_t *inst, char **cursor, int budget, kvs_value_fn fn, void *arg)
+{
+    if (!inst || !inst->nil || !cursor || !fn)
+        return 0;
+
+    rbtree_node *x = *cursor ? rbtree_upper_bound(inst, *cursor) : rbtree_mini(inst, inst->root);
+    rbtree_node *last = inst->nil;
+
+    for (; x != inst->nil && budget > 0; budget--)
+    {
+        fn(arg, x->key, &x->value);
+        last = x;
+        x = rbtree_successor(inst, x);
+    }
+
+    if (x == inst->nil)
+    {
+        free(*cursor);
+        *cursor = NULL;
+        return 0;
+    }
+    if (last == inst->nil)
+        return 1;
+
+    size_t len = strlen(last->key) + 1;
+    char *c = (char *)realloc(*cursor, len);
+    if (!c)
+        return 1;
+    memcpy(c, last->key, len);
+    *cursor = c;
+    return 1;
 }
 
 int kvs_rbtree_exist(kvs_rbtree_t *inst, char *key)
@@ -532,3 +859,43 @@ int kvs_rbtree_exist(kvs_rbtree_t *inst, char *key)
         return -1;
     return (rbtree_search(inst, key) == inst->nil) ? 1 : 0;
 }
+
+int kvs_rbtree_detach(kvs_rbtree_t *inst, kvs_rbtree_t *out)
+{
+    if (!inst || !out || !inst->nil)
+        return -1;
+
+    // 叶子都指向 inst 的内嵌哨兵：out->nil 沿用它的地址，inst 原地重建为空树
+    *out = *inst;
+    kvs_rbtree_create(inst);
+    return 0;
+}
+
+int kvs_rbtree_release(kvs_rbtree_t *inst, int budget)
+{
+    if (!inst || !inst->nil)
+        return 0;
+
+    // 有左孩子就右旋把它提上来，否则释放根并转到右子树；每个节点至多被旋转一次，整体 O(n)
+    rbtree_node *x = inst->root;
+    while (x != inst->nil && budget > 0)
+    {
+        if (x->left != inst->nil)
+        {
+            rbtree_node *l = x->left;
+            x->left = l->right;
+            l->right = x;
+            x = l;
+            continue;
+        }
+
+        rbtree_node *next = x->right;
+        kvs_free_str(x->key);
+        kvs_value_free(&x->value);
+        kvs_free(x, sizeof(rbtree_node));
+        x = next;
+        budget--;
+    }
+    inst->root = x;
+    return x != inst->nil;
+}
@@ -0,0 +1,295 @@
+#include <string.h>
+
+#include "engine/kvs_simd.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define KVS_SIMD_X86 1
+#endif
+
+// 向量实现有意读到字符串结尾之后（同一页内），sanitizer 无从得知，对这些函数关闭检查
+#define NOSAN __attribute__((no_sanitize_address))
+#define PAGE_SIZE_MIN 4096
+
+// ---------- 哈希：各档共用的混合函数，保证结果一致 ----------
+
+#define H_SEED 0x9e3779b97f4a7c15ull
+#define H_MUL 0xff51afd7ed558ccdull
+#define H_FIN 0xc4ceb9fe1a85ec53ull
+
+static inline uint64_t _mix(uint64_t h, uint64_t w)
+{
+    h = (h ^ w) * H_MUL;
+    return h ^ (h >> 32);
+}
+
+static inline uint32_t _final(uint64_t h, size_t len)
+{
+    h ^= (uint64_t)len;
+    h ^= h >> 33;
+    h *= H_FIN;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+// 从 key + off（8 的倍数）继续：剩余部分按 8 字节一组读入，末组补零
+static uint32_t _hash_rest(uint64_t h, const char *key, size_t off)
+{
+    const char *p = key + off;
+    size_t n = strlen(p);
+    size_t len = off + n;
+
+    for (; n >= 8; p += 8, n -= 8)
+    {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = _mix(h, w);
+    }
+    if (n)
+    {
+        uint64_t w = 0;
+        memcpy(&w, p, n);
+        h = _mix(h, w);
+    }
+    return _final(h, len);
+}
+
+// ---------- scalar ----------
+
+static uint32_t _hash_scalar(const char *key)
+{
+    return _hash_rest(H_SEED, key, 0);
+}
+
+static inline int _is_delim(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static char *_delim_scalar(const char *s)
+{
+    while (*s && !_is_delim(*s))
+        s++;
+    return (char *)s;
+}
+
+static size_t _count_delim_scalar(const char *s)
+{
+    size_t n = 0;
+    for (; *s; s++)
+        n += (size_t)_is_delim(*s);
+    return n;
+}
+
+#ifdef KVS_SIMD_X86
+
+// 从 p 起读 w 字节不会跨到下一页
+static inline int _page_safe(const void *p, size_t w)
+{
+    return ((uintptr_t)p & (PAGE_SIZE_MIN - 1)) <= PAGE_SIZE_MIN - w;
+}
+
+// ---------- SSE2 ----------
+
+static inline unsigned _delim16(__m128i v)
+{
+    __m128i d = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    d = _mm_or_si128(d, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    return (unsigned)_mm_movemask_epi8(d);
+}
+
+static inline unsigned _zero16(__m128i v)
+{
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+}
+
+static inline uint64_t _hi64(__m128i v)
+{
+    return (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v));
+}
+
+// 每次 16 字节：一条比较找结尾，没到结尾就整块混合；靠近页尾时交给 _hash_rest
+NOSAN static uint32_t _hash_sse2(const char *key)
+{
+    const __m128i idx = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    uint64_t h = H_SEED;
+    size_t off = 0;
+
+    while (_page_safe(key + off, 16))
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(key + off));
+        unsigned z = _zero16(v);
+        if (z)
+        {
+            int n = __builtin_ctz(z);
+            v = _mm_and_si128(v, _mm_cmpgt_epi8(_mm_set1_epi8((char)n), idx)); // 结尾及之后清零
+            if (n > 0)
+                h = _mix(h, (uint64_t)_mm_cvtsi128_si64(v));
+            if (n > 8)
+                h = _mix(h, _hi64(v));
+            return _final(h, off + (size_t)n);
+        }
+        h = _mix(h, (uint64_t)_mm_cvtsi128_si64(v));
+        h = _mix(h, _hi64(v));
+        off += 16;
+    }
+    return _hash_rest(h, key, off);
+}
+
+// 按 16 字节对齐读（对齐读不会跨页），第一块把 s 之前的位移掉
+NOSAN static char *_delim_sse2(const char *s)
+{
+    const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)15);
+    __m128i v = _mm_load_si128((const __m128i *)p);
+    unsigned m = (_delim16(v) | _zero16(v)) >> (s - p);
+    if (m)
+        return (char *)s + __builtin_ctz(m);
+
+    for (;;)
+    {
+        p += 16;
+        v = _mm_load_si128((const __m128i *)p);
+        m = _delim16(v) | _zero16(v);
+        if (m)
+            return (char *)p + __builtin_ctz(m);
+    }
+}
+
+NOSAN static size_t _count_delim_sse2(const char *s)
+{
+    const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)15);
+    unsigned shift = (unsigned)(s - p);
+    size_t n = 0;
+
+    for (;; p += 16, shift = 0)
+    {
+        __m128i v = _mm_load_si128((const __m128i *)p);
+        unsigned d = _delim16(v) >> shift;
+        unsigned z = _zero16(v) >> shift;
+        if (z)
+            return n + (size_t)__builtin_popcount(d & ((z & -z) - 1));
+        n += (size_t)__builtin_popcount(d);
+    }
+}
+
+// ---------- AVX2 ----------
+
+#define AVX2 __attribute__((target("avx2,popcnt")))
+
+AVX2 static inline unsigned _delim32(__m256i v)
+{
+    __m256i d = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    d = _mm256_or_si256(d, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    return (unsigned)_mm256_movemask_epi8(d);
+}
+
+AVX2 static inline unsigned _zero32(__m256i v)
+{
+    return (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+}
+
+NOSAN AVX2 static char *_delim_avx2(const char *s)
+{
+    const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)31);
+    __m256i v = _mm256_load_si256((const __m256i *)p);
+    unsigned m = (_delim32(v) | _zero32(v)) >> (s - p);
+    if (m)
+        return (char *)s + __builtin_ctz(m);
+
+    for (;;)
+    {
+        p += 32;
+        v = _mm256_load_si256((const __m256i *)p);
+        m = _delim32(v) | _zero32(v);
+        if (m)
+            return (char *)p + __builtin_ctz(m);
+    }
+}
+
+NOSAN AVX2 static size_t _count_delim_avx2(const char *s)
+{
+    const char *p = (const char *)((uintptr_t)s & ~(uintptr_t)31);
+    unsigned shift = (unsigned)(s - p);
+    size_t n = 0;
+
+    for (;; p += 32, shift = 0)
+    {
+        __m256i v = _mm256_load_si256((const __m256i *)p);
+        unsigned d = _delim32(v) >> shift;
+        unsigned z = _zero32(v) >> shift;
+        if (z)
+            return n + (size_t)__builtin_popcount(d & ((z & -z) - 1));
+        n += (size_t)__builtin_popcount(d);
+    }
+}
+
+#endif
+
+// ---------- 分派 ----------
+
+typedef struct simd_impl_s
+{
+    const char *name;
+    uint32_t (*hash)(const char *);
+    char *(*delim)(const char *);
+    size_t (*count_delim)(const char *);
+} simd_impl_t;
+
+static const simd_impl_t impls[KVS_SIMD_COUNT] = {
+    {"scalar", _hash_scalar, _delim_scalar, _count_delim_scalar},
+#ifdef KVS_SIMD_X86
+    {"sse2", _hash_sse2, _delim_sse2, _count_delim_sse2},
+    {"avx2", _hash_sse2, _delim_avx2, _count_delim_avx2}, // 哈希沿用 SSE2：常见的短 key 按 32 字节一块反而更慢
+#else
+    {"sse2", NULL, NULL, NULL},
+    {"avx2", NULL, NULL, NULL},
+#endif
+};
+
+// 选档之前（以及非 x86）使用 scalar
+uint32_t (*kvs_simd_hash)(const char *key) = _hash_scalar;
+char *(*kvs_simd_delim)(const char *s) = _delim_scalar;
+size_t (*kvs_simd_count_delim)(const char *s) = _count_delim_scalar;
+
+static kvs_simd_level_t current = KVS_SIMD_SCALAR;
+
+kvs_simd_level_t kvs_simd_best(void)
+{
+#ifdef KVS_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        return KVS_SIMD_AVX2;
+    return KVS_SIMD_SSE2; // x86-64 必有 SSE2
+#else
+    return KVS_SIMD_SCALAR;
+#endif
+}
+
+int kvs_simd_select(kvs_simd_level_t level)
+{
+    if ((int)level < 0 || level >= KVS_SIMD_COUNT || level > kvs_simd_best())
+        return -1;
+
+    const simd_impl_t *impl = &impls[level];
+    kvs_simd_hash = impl->hash;
+    kvs_simd_delim = impl->delim;
+    kvs_simd_count_delim = impl->count_delim;
+    current = level;
+    return 0;
+}
+
+kvs_simd_level_t kvs_simd_level(void)
+{
+    return current;
+}
+
+const char *kvs_simd_name(kvs_simd_level_t level)
+{
+    return (int)level >= 0 && level < KVS_SIMD_COUNT ? impls[level].name : "unknown";
+}
+
+// 在 main 之前按 CPUID 选档，引擎和测试不需要显式初始化
+__attribute__((constructor)) static void _simd_init(void)
+{
+    kvs_simd_select(kvs_simd_best());
+}
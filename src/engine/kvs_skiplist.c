@@ -0,0 +1,372 @@
+#include <string.h>
+
+#include "engine/kvs_skiplist.h"
+
+typedef _Atomic(kvs_skiplist_node_t *) link_t;
+
+static inline char *_key(kvs_skiplist_node_t *n)
+{
+    return (char *)(n->next + n->level);
+}
+
+static inline size_t _node_size(int level, size_t klen)
+{
+    return sizeof(kvs_skiplist_node_t) + sizeof(link_t) * (size_t)level + klen + 1;
+}
+
+static inline kvs_skiplist_node_t *_load(link_t *link)
+{
+    return atomic_load_explicit(link, memory_order_acquire);
+}
+
+// 塔高：每层以 1/4 的概率继续升高
+static int _random_level(kvs_skiplist_t *inst)
+{
+    uint64_t r = inst->seed;
+    r ^= r << 13;
+    r ^= r >> 7;
+    r ^= r << 17;
+    inst->seed = r;
+
+    int level = 1;
+    while ((r & 3) == 0 && level < KVS_SKIPLIST_MAX_LEVEL)
+    {
+        level++;
+        r >>= 2;
+    }
+    return level;
+}
+
+static kvs_skiplist_node_t *_node_new(const char *key, const char *value, int level)
+{
+    size_t klen = strlen(key);
+    kvs_skiplist_node_t *n = (kvs_skiplist_node_t *)kvs_malloc(_node_size(level, klen));
+    if (!n)
+        return NULL;
+
+    memset(n, 0, sizeof(*n));
+    n->level = (uint8_t)level;
+    memcpy(_key(n), key, klen + 1);
+    if (kvs_value_init(&n->value, value) != 0)
+    {
+        kvs_free(n, _node_size(level, klen));
+        return NULL;
+    }
+    return n;
+}
+
+static void _node_free(kvs_skiplist_node_t *n)
+{
+    kvs_value_lazyfree(&n->value);
+    kvs_free(n, _node_size(n->level, strlen(_key(n))));
+}
+
+// 写者查找：preds[i] 为第 i 层最后一个 key 小于 key 的位置（指向它的 next[i] 或 head[i]）
+// 只有写者修改链接，这里用 relaxed 读即可
+static kvs_skiplist_node_t *_find(kvs_skiplist_t *inst, const char *key, link_t **preds)
+{
+    int level = atomic_load_explicit(&inst->level, memory_order_relaxed);
+    link_t *link = NULL;
+
+    for (int i = level - 1; i >= 0; i--)
+    {
+        link = link ? link - 1 : &inst->head[i]; // 下降一层：同一节点的 next[i]
+        for (;;)
+        {
+            kvs_skiplist_node_t *y = atomic_load_explicit(link, memory_order_relaxed);
+            if (!y || strcmp(_key(y), key) >= 0)
+                break;
+            link = &y->next[i];
+        }
+        preds[i] = link;
+    }
+    if (level == 0)
+        return NULL;
+
+    kvs_skiplist_node_t *x = atomic_load_explicit(preds[0], memory_order_relaxed);
+    return x && strcmp(_key(x), key) == 0 ? x : NULL;
+}
+
+// 读者查找：第一个 key 不小于 key 的节点
+static kvs_skiplist_node_t *_seek(kvs_skiplist_t *inst, const char *key)
+{
+    int level = atomic_load_explicit(&inst->level, memory_order_acquire);
+    link_t *link = NULL;
+    kvs_skiplist_node_t *y = NULL;
+
+    for (int i = level - 1; i >= 0; i--)
+    {
+        link = link ? link - 1 : &inst->head[i];
+        for (;;)
+        {
+            y = _load(link);
+            if (!y || strcmp(_key(y), key) >= 0)
+                break;
+            link = &y->next[i];
+        }
+    }
+    return y;
+}
+
+static kvs_skiplist_node_t *_lookup(kvs_skiplist_t *inst, const char *key)
+{
+    kvs_skiplist_node_t *x = _seek(inst, key);
+    return x && strcmp(_key(x), key) == 0 ? x : NULL;
+}
+
+// 摘下节点前先确保待回收数组放得下，摘下后就不会因分配失败而半途而废
+static int _retire_reserve(kvs_skiplist_t *inst)
+{
+    if (inst->nretired < inst->cap_retired)
+        return 0;
+
+    int cap = inst->cap_retired ? inst->cap_retired * 2 : KVS_SKIPLIST_RETIRE_BATCH * 2;
+    kvs_skiplist_retired_t *r = (kvs_skiplist_retired_t *)kvs_malloc(sizeof(*r) * (size_t)cap);
+    if (!r)
+        return -2;
+    if (inst->retired)
+    {
+        memcpy(r, inst->retired, sizeof(*r) * (size_t)inst->nretired);
+        kvs_free(inst->retired, sizeof(*r) * (size_t)inst->cap_retired);
+    }
+    inst->retired = r;
+    inst->cap_retired = cap;
+    return 0;
+}
+
+// 节点已从所有层摘下：记下当前 epoch 并推进，之后进入读区的读者不可能再看到它
+static void _retire(kvs_skiplist_t *inst, kvs_skiplist_node_t *x)
+{
+    kvs_skiplist_retired_t *r = &inst->retired[inst->nretired++];
+    r->node = x;
+    r->epoch = atomic_fetch_add(&inst->epoch, 1);
+
+    if (inst->nretired >= inst->reclaim_at)
+        kvs_skiplist_reclaim(inst);
+}
+
+int kvs_skiplist_create(kvs_skiplist_t *inst)
+{
+    if (!inst)
+        return -1;
+
+    memset(inst, 0, sizeof(*inst));
+    atomic_store(&inst->epoch, 1); // 0 留给读者表示不在读区
+    inst->seed = 0x2545f4914f6cdd1dull ^ (uint64_t)(uintptr_t)inst;
+    inst->reclaim_at = KVS_SKIPLIST_RETIRE_BATCH;
+    return 0;
+}
+
+void kvs_skiplist_destory(kvs_skiplist_t *inst)
+{
+    if (!inst)
+        return;
+
+    kvs_skiplist_node_t *x = atomic_load_explicit(&inst->head[0], memory_order_relaxed);
+    while (x)
+    {
+        kvs_skiplist_node_t *next = atomic_load_explicit(&x->next[0], memory_order_relaxed);
+        _node_free(x);
+        x = next;
+    }
+    for (int i = 0; i < inst->nretired; i++)
+        _node_free(inst->retired[i].node);
+    if (inst->retired)
+        kvs_free(inst->retired, sizeof(kvs_skiplist_retired_t) * (size_t)inst->cap_retired);
+
+    for (int i = 0; i < KVS_SKIPLIST_MAX_LEVEL; i++)
+        atomic_store_explicit(&inst->head[i], NULL, memory_order_relaxed);
+    atomic_store(&inst->level, 0);
+    atomic_store(&inst->count, 0);
+    inst->retired = NULL;
+    inst->nretired = inst->cap_retired = 0;
+    inst->reclaim_at = KVS_SKIPLIST_RETIRE_BATCH;
+}
+
+int kvs_skiplist_set(kvs_skiplist_t *inst, char *key, char *value)
+{
+    if (!inst || !key || !value)
+        return -1;
+
+    link_t *preds[KVS_SKIPLIST_MAX_LEVEL];
+    if (_find(inst, key, preds))
+        return 1; // already exists
+
+    int cur = atomic_load_explicit(&inst->level, memory_order_relaxed);
+    int level = _random_level(inst);
+    for (int i = cur; i < level; i++)
+        preds[i] = &inst->head[i];
+
+    kvs_skiplist_node_t *n = _node_new(key, value, level);
+    if (!n)
+        return -2;
+
+    // 先填好整座塔再自底向上发布：读者要么看不到新节点，要么看到完整的节点
+    for (int i = 0; i < level; i++)
+        atomic_store_explicit(&n->next[i], atomic_load_explicit(preds[i], memory_order_relaxed), memory_order_relaxed);
+    for (int i = 0; i < level; i++)
+        atomic_store_explicit(preds[i], n, memory_order_release);
+
+    if (level > cur)
+        atomic_store_explicit(&inst->level, level, memory_order_release);
+    atomic_fetch_add_explicit(&inst->count, 1, memory_order_relaxed);
+    return 0;
+}
+
+char *kvs_skiplist_get(kvs_skiplist_t *inst, char *key)
+{
+    if (!inst || !key)
+        return NULL;
+
+    kvs_skiplist_node_t *x = _lookup(inst, key);
+    return x ? kvs_value_str(&x->value) : NULL;
+}
+
+int kvs_skiplist_del(kvs_skiplist_t *inst, char *key)
+{
+    if (!inst || !key)
+        return -1;
+
+    link_t *preds[KVS_SKIPLIST_MAX_LEVEL];
+    kvs_skiplist_node_t *x = _find(inst, key, preds);
+    if (!x)
+        return 1;
+    if (_retire_reserve(inst) != 0)
+        return -2;
+
+    // 自顶向下摘除；x 自己的 next 不动，已经走到 x 上的读者照常前进
+    for (int i = x->level - 1; i >= 0; i--)
+        atomic_store_explicit(preds[i], atomic_load_explicit(&x->next[i], memory_order_relaxed), memory_order_release);
+
+    int level = atomic_load_explicit(&inst->level, memory_order_relaxed);
+    while (level > 0 && !atomic_load_explicit(&inst->head[level - 1], memory_order_relaxed))
+        level--;
+    atomic_store_explicit(&inst->level, level, memory_order_release);
+
+    atomic_fetch_sub_explicit(&inst->count, 1, memory_order_relaxed);
+    _retire(inst, x);
+    return 0;
+}
+
+// 读者可能正在读旧值，不能原地覆盖：复制出同样高度的新节点，逐层替换
+int kvs_skiplist_mod(kvs_skiplist_t *inst, char *key, char *value)
+{
+    if (!inst || !key || !value)
+        return -1;
+
+    link_t *preds[KVS_SKIPLIST_MAX_LEVEL];
+    kvs_skiplist_node_t *x = _find(inst, key, preds);
+    if (!x)
+        return 1; // no exist
+    if (_retire_reserve(inst) != 0)
+        return -2;
+
+    kvs_skiplist_node_t *n = _node_new(_key(x), value, x->level);
+    if (!n)
+        return -2;
+
+    for (int i = 0; i < x->level; i++)
+        atomic_store_explicit(&n->next[i], atomic_load_explicit(&x->next[i], memory_order_relaxed), memory_order_relaxed);
+    for (int i = 0; i < x->level; i++)
+        atomic_store_explicit(preds[i], n, memory_order_release);
+
+    _retire(inst, x);
+    return 0;
+}
+
+int kvs_skiplist_exist(kvs_skiplist_t *inst, char *key)
+{
+    if (!inst || !key)
+        return -1;
+    return _lookup(inst, key) ? 0 : 1;
+}
+
+int kvs_skiplist_count(kvs_skiplist_t *inst)
+{
+    return inst ? atomic_load_explicit(&inst->count, memory_order_relaxed) : 0;
+}
+
+int kvs_skiplist_range(kvs_skiplist_t *inst, const char *lo, const char *hi, kvs_value_fn fn, void *arg)
+{
+    if (!inst || !fn)
+        return 0;
+
+    int n = 0;
+    kvs_skiplist_node_t *x = lo ? _seek(inst, lo) : _load(&inst->head[0]);
+    for (; x; x = _load(&x->next[0]))
+    {
+        if (hi && strcmp(_key(x), hi) > 0)
+            break;
+        fn(arg, _key(x), &x->value);
+        n++;
+    }
+    return n;
+}
+
+void kvs_skiplist_foreach(kvs_skiplist_t *inst, kvs_value_fn fn, void *arg)
+{
+    kvs_skiplist_range(inst, NULL, NULL, fn, arg);
+}
+
+int kvs_skiplist_reader_register(kvs_skiplist_t *inst)
+{
+    if (!inst)
+        return -1;
+
+    for (int i = 0; i < KVS_SKIPLIST_READERS; i++)
+    {
+        int expect = 0;
+        if (atomic_compare_exchange_strong(&inst->readers[i].used, &expect, 1))
+            return i;
+    }
+    return -1;
+}
+
+void kvs_skiplist_reader_unregister(kvs_skiplist_t *inst, int id)
+{
+    if (!inst || id < 0 || id >= KVS_SKIPLIST_READERS)
+        return;
+    atomic_store(&inst->readers[id].epoch, 0);
+    atomic_store(&inst->readers[id].used, 0);
+}
+
+// 登记 epoch 之后的 fence 与回收时扫描前的 fence 配对：
+// 写者没看到这次登记，则读者随后的读取一定能看到写者在扫描前完成的摘除
+void kvs_skiplist_read_begin(kvs_skiplist_t *inst, int id)
+{
+    atomic_store(&inst->readers[id].epoch, atomic_load(&inst->epoch));
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+void kvs_skiplist_read_end(kvs_skiplist_t *inst, int id)
+{
+    atomic_store_explicit(&inst->readers[id].epoch, 0, memory_order_release);
+}
+
+int kvs_skiplist_reclaim(kvs_skiplist_t *inst)
+{
+    if (!inst)
+        return 0;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t min = UINT64_MAX;
+    for (int i = 0; i < KVS_SKIPLIST_READERS; i++)
+    {
+        uint64_t e = atomic_load(&inst->readers[i].epoch);
+        if (e && e < min)
+            min = e;
+    }
+
+    // 读者登记的 epoch 都大于摘下时的 epoch：它们进入读区时节点已经不可达
+    int kept = 0;
+    for (int i = 0; i < inst->nretired; i++)
+    {
+        if (inst->retired[i].epoch < min)
+            _node_free(inst->retired[i].node);
+        else
+            inst->retired[kept++] = inst->retired[i];
+    }
+    inst->nretired = kept;
+    inst->reclaim_at = kept + KVS_SKIPLIST_RETIRE_BATCH;
+    return kept;
+}
@@ -0,0 +1,475 @@
+#include "engine/kvs_value.h"
+#include "engine/kvs_lazyfree.h"
+#include "engine/kvs_vlog.h"
+#include "engine/kvs_lzf.h"
+#include "allocator/kvs_alloc.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+#define SCRATCH_CHUNK (256 * 1024)
+
+__thread int kvs_value_packed_input = 0;
+__thread int kvs_value_unreadable = 0;
+static size_t g_compress_threshold = 0;
+
+// 临时区：mmap 的块串成链表，新块在表头
+typedef struct scratch_s
+{
+    struct scratch_s *next;
+    size_t size;
+    size_t used;
+} scratch_t;
+
+static __thread scratch_t *t_scratch = NULL;
+
+char *kvs_value_scratch(size_t n)
+{
+    scratch_t *c = t_scratch;
+    if (!c || c->size - c->used < n)
+    {
+        size_t size = sizeof(scratch_t) + n > SCRATCH_CHUNK ? sizeof(scratch_t) + n : SCRATCH_CHUNK;
+        void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return NULL;
+        c = (scratch_t *)p;
+        c->next = t_scratch;
+        c->size = size;
+        c->used = sizeof(scratch_t);
+        t_scratch = c;
+    }
+    char *r = (char *)c + c->used;
+    c->used += n;
+    return r;
+}
+
+void kvs_value_scratch_reset(void)
+{
+    kvs_value_unreadable = 0;
+
+    // 只留最早的一块常规大小的，其余归还
+    scratch_t *c = t_scratch;
+    while (c && (c->next || c->size != SCRATCH_CHUNK))
+    {
+        scratch_t *next = c->next;
+        munmap(c, c->size);
+        c = next;
+    }
+    if (c)
+        c->used = sizeof(scratch_t);
+    t_scratch = c;
+}
+
+void kvs_value_compress_threshold(size_t threshold)
+{
+    // 能内嵌的短 value 不压缩
+    g_compress_threshold = threshold && threshold <= KVS_VALUE_EMBED ? KVS_VALUE_EMBED + 1 : threshold;
+}
+
+int kvs_value_plain(size_t len)
+{
+    if (kvs_value_packed_input)
+        return 0;
+    if (len <= KVS_VALUE_EMBED)
+        return 1;
+    kvs_vlog_t *log = kvs_vlog_current;
+    return (!g_compress_threshold || len < g_compress_threshold) && (!log || len < log->threshold);
+}
+
+int kvs_value_parse_int(const char *s, int64_t *out)
+{
+    const char *p = s;
+    int neg = *p == '-';
+    p += neg;
+
+    if (*p < '0' || *p > '9')
+        return -1;
+    if (*p == '0')
+    {
+        // 只有 "0" 本身：拒绝 "-0"、"007"
+        if (neg || p[1])
+            return -1;
+        *out = 0;
+        return 0;
+    }
+
+    uint64_t u = 0;
+    for (int n = 0; *p; p++, n++)
+    {
+        if (*p < '0' || *p > '9' || n >= 19) // int64 最多 19 位，19 位以内不会溢出 uint64
+            return -1;
+        u = u * 10 + (uint64_t)(*p - '0');
+    }
+
+    if (neg)
+    {
+        if (u > (uint64_t)INT64_MAX + 1)
+            return -1;
+        *out = u == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)u;
+    }
+    else
+    {
+        if (u > (uint64_t)INT64_MAX)
+            return -1;
+        *out = (int64_t)u;
+    }
+    return 0;
+}
+
+int kvs_value_format_int(int64_t n, char *buf)
+{
+    char tmp[20];
+    int len = 0;
+    uint64_t u = n < 0 ? 0 - (uint64_t)n : (uint64_t)n;
+    do
+    {
+        tmp[len++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+
+    int off = 0;
+    if (n < 0)
+        buf[off++] = '-';
+    while (len)
+        buf[off++] = tmp[--len];
+    buf[off] = '\0';
+    return off;
+}
+
+static const char b64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int b64_index(unsigned char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+static size_t b64_encode(const unsigned char *in, size_t len, char *out)
+{
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len)
+            v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len)
+            v |= in[i + 2];
+        out[o++] = b64_chars[(v >> 18) & 63];
+        out[o++] = b64_chars[(v >> 12) & 63];
+        out[o++] = i + 1 < len ? b64_chars[(v >> 6) & 63] : '=';
+        out[o++] = i + 2 < len ? b64_chars[v & 63] : '=';
+    }
+    return o;
+}
+
+// @return: 解码后的字节数; <0, 不是合法的 base64（out 为 NULL 时只校验）
+static long b64_decode(const char *in, size_t len, unsigned char *out)
+{
+    if (len == 0 || len % 4)
+        return -1;
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 4)
+    {
+        int pad = in[i + 3] == '=' ? (in[i + 2] == '=' ? 2 : 1) : 0;
+        if (pad && i + 4 != len)
+            return -1;
+        uint32_t v = 0;
+        for (int k = 0; k < 4 - pad; k++)
+        {
+            int d = b64_index((unsigned char)in[i + k]);
+            if (d < 0)
+                return -1;
+            v |= (uint32_t)d << (18 - 6 * k);
+        }
+        if (out)
+        {
+            out[o] = (unsigned char)(v >> 16);
+            if (pad < 2)
+                out[o + 1] = (unsigned char)(v >> 8);
+            if (pad < 1)
+                out[o + 2] = (unsigned char)v;
+        }
+        o += 3 - (size_t)pad;
+    }
+    return (long)o;
+}
+
+// 传输形式 "原长:base64"；@return: base64 部分的起点，NULL 为格式不对
+static const char *packed_parse(const char *s, uint32_t *raw_len)
+{
+    uint64_t n = 0;
+    const char *p = s;
+    for (; *p >= '0' && *p <= '9'; p++)
+    {
+        n = n * 10 + (uint64_t)(*p - '0');
+        if (n > UINT32_MAX)
+            return NULL;
+    }
+    if (p == s || *p != ':' || n == 0)
+        return NULL;
+    *raw_len = (uint32_t)n;
+    return p + 1;
+}
+
+int kvs_value_packed_check(const char *s)
+{
+    uint32_t raw_len;
+    const char *b64 = s ? packed_parse(s, &raw_len) : NULL;
+    if (!b64)
+        return -1;
+
+    // 解码再解压一遍，损坏的数据不落地
+    size_t len = strlen(b64);
+    char *buf = kvs_value_scratch(len / 4 * 3 + 1);
+    long n = buf ? b64_decode(b64, len, (unsigned char *)buf) : -1;
+    if (n <= 0 || (uint64_t)raw_len > (uint64_t)n * 128) // 一次回溯 3 字节最多展开 264 字节，原长不可能更大
+        return -1;
+    char *out = kvs_value_scratch((size_t)raw_len + 1);
+    if (!out || kvs_lzf_decompress(buf, (size_t)n, out, raw_len) != raw_len)
+        return -1;
+    return 0;
+}
+
+// 保存 "4 字节原长 + LZF 数据"：够大且绑定了 value log 时写进日志，否则单独分配
+static int store_payload(kvs_value_t *v, const char *p, size_t len)
+{
+    kvs_vlog_t *log = kvs_vlog_current;
+    if (log && len >= log->threshold && kvs_vlog_append(log, p, len, v) == 0)
+    {
+        v->vlog.lz = 1;
+        return 0;
+    }
+
+    char *q = (char *)kvs_malloc(len);
+    if (!q)
+        return -2;
+    memcpy(q, p, len);
+    v->raw.ptr = q;
+    v->raw.cap = len;
+    v->in.enc = KVS_ENC_LZF;
+    return 0;
+}
+
+// 压缩放在临时区里做，只为结果分配一次
+// @return: <0, error; =0, 已压缩保存; =1, 不值得压缩
+static int store_compressed(kvs_value_t *v, const char *s, size_t len)
+{
+    if (len > UINT32_MAX)
+        return 1;
+    size_t cap = len - len / 8;
+    char *buf = kvs_value_scratch(sizeof(uint32_t) + cap);
+    if (!buf)
+        return 1;
+    size_t clen = kvs_lzf_compress(s, len, buf + sizeof(uint32_t), cap);
+    if (clen == 0)
+        return 1;
+
+    uint32_t raw_len = (uint32_t)len;
+    memcpy(buf, &raw_len, sizeof(raw_len));
+    return store_payload(v, buf, sizeof(uint32_t) + clen);
+}
+
+static int init_packed(kvs_value_t *v, const char *s)
+{
+    uint32_t raw_len;
+    const char *b64 = packed_parse(s, &raw_len);
+    if (!b64)
+        return -1;
+    size_t len = strlen(b64);
+    char *buf = kvs_value_scratch(sizeof(uint32_t) + len / 4 * 3);
+    if (!buf)
+        return -2;
+    long n = b64_decode(b64, len, (unsigned char *)buf + sizeof(uint32_t));
+    if (n < 0)
+        return -1;
+
+    memcpy(buf, &raw_len, sizeof(raw_len));
+    return store_payload(v, buf, sizeof(uint32_t) + (size_t)n);
+}
+
+char *kvs_value_unpack(const char *payload, size_t len)
+{
+    uint32_t raw_len;
+    char *out = NULL;
+    if (len >= sizeof(raw_len))
+    {
+        memcpy(&raw_len, payload, sizeof(raw_len));
+        out = kvs_value_scratch((size_t)raw_len + 1);
+    }
+    if (!out || kvs_lzf_decompress(payload + sizeof(raw_len), len - sizeof(raw_len), out, raw_len) != raw_len)
+    {
+        kvs_value_unreadable = 1; // 截断、损坏或临时区不够
+        return NULL;
+    }
+    out[raw_len] = '\0';
+    return out;
+}
+
+char *kvs_value_inflate(kvs_value_t *v)
+{
+    return kvs_value_unpack(v->raw.ptr, v->raw.cap);
+}
+
+char *kvs_value_packed(kvs_value_t *v)
+{
+    const char *p;
+    size_t len;
+    if (v->in.enc == KVS_ENC_LZF)
+    {
+        p = v->raw.ptr;
+        len = v->raw.cap;
+    }
+    else if (v->in.enc == KVS_ENC_VLOG && v->vlog.lz)
+    {
+        p = kvs_vlog_payload(v);
+        len = v->vlog.len;
+    }
+    else
+    {
+        return NULL;
+    }
+    if (!p || len < sizeof(uint32_t))
+        return NULL;
+
+    uint32_t raw_len;
+    memcpy(&raw_len, p, sizeof(raw_len));
+    len -= sizeof(raw_len);
+    char *out = kvs_value_scratch(21 + 1 + (len + 2) / 3 * 4 + 1);
+    if (!out)
+        return NULL;
+    int n = kvs_value_format_int(raw_len, out);
+    out[n++] = ':';
+    n += (int)b64_encode((const unsigned char *)p + sizeof(raw_len), len, out + n);
+    out[n] = '\0';
+    return out;
+}
+
+// KVS_ENC_INT 的内容已知是规范写法，直接累加
+static int64_t int_of(const char *s)
+{
+    int neg = *s == '-';
+    s += neg;
+    uint64_t u = 0;
+    while (*s)
+        u = u * 10 + (uint64_t)(*s++ - '0');
+    return neg ? (int64_t)(0 - u) : (int64_t)u;
+}
+
+int kvs_value_init(kvs_value_t *v, const char *s)
+{
+    if (kvs_value_packed_input)
+        return init_packed(v, s);
+
+    size_t need = strlen(s) + 1;
+    if (need <= KVS_VALUE_EMBED + 1)
+    {
+        int64_t n;
+        memcpy(v->in.str, s, need);
+        v->in.enc = kvs_value_parse_int(s, &n) == 0 ? KVS_ENC_INT : KVS_ENC_EMBSTR;
+        return 0;
+    }
+
+    // 超过阈值的先试压缩，压不动的照常保存
+    if (g_compress_threshold && need - 1 >= g_compress_threshold)
+    {
+        int ret = store_compressed(v, s, need - 1);
+        if (ret <= 0)
+            return ret;
+    }
+
+    // 超过阈值的写到本线程的 value log；写失败时退回普通分配
+    kvs_vlog_t *log = kvs_vlog_current;
+    if (log && need - 1 >= log->threshold && kvs_vlog_append(log, s, need - 1, v) == 0)
+        return 0;
+
+    char *p = (char *)kvs_malloc(need);
+    if (!p)
+        return -2;
+    memcpy(p, s, need);
+    v->raw.ptr = p;
+    v->raw.cap = need;
+    v->in.enc = KVS_ENC_RAW;
+    return 0;
+}
+
+int kvs_value_assign(kvs_value_t *v, const char *s)
+{
+    size_t need = strlen(s) + 1;
+
+    // 单独分配的缓冲区放得下：原地写，仍按 RAW 保存（要压缩的除外）
+    if (v->in.enc == KVS_ENC_RAW && kvs_value_fits(v->raw.cap, need) && !kvs_value_packed_input &&
+        (!g_compress_threshold || need - 1 < g_compress_threshold))
+    {
+        memmove(v->raw.ptr, s, need);
+        return 0;
+    }
+
+    kvs_value_t nv;
+    nv.in.enc = KVS_ENC_NONE;
+    if (kvs_value_init(&nv, s) != 0)
+        return -2;
+    kvs_value_lazyfree(v);
+    *v = nv;
+    return 0;
+}
+
+int kvs_value_incr(kvs_value_t *v, int64_t delta, int64_t *result)
+{
+    int64_t n;
+    if (v->in.enc == KVS_ENC_INT)
+        n = int_of(v->in.str);
+    else if (v->in.enc == KVS_ENC_NONE)
+        return -1;
+    else
+    {
+        const char *s = kvs_value_str(v);
+        if (!s)
+            return -1; // 读不出来，不能当成非整数
+        if (kvs_value_parse_int(s, &n) != 0)
+            return 1;
+    }
+
+    int64_t r;
+    if (__builtin_add_overflow(n, delta, &r))
+        return 2;
+
+    kvs_value_lazyfree(v); // RAW 时释放，之后总是内嵌
+    kvs_value_format_int(r, v->in.str);
+    v->in.enc = KVS_ENC_INT;
+    if (result)
+        *result = r;
+    return 0;
+}
+
+void kvs_value_free(kvs_value_t *v)
+{
+    if (v->in.enc == KVS_ENC_RAW || v->in.enc == KVS_ENC_LZF)
+        kvs_free(v->raw.ptr, v->raw.cap);
+    else if (v->in.enc == KVS_ENC_VLOG)
+        kvs_vlog_release(v);
+    v->in.enc = KVS_ENC_NONE;
+}
+
+void kvs_value_lazyfree(kvs_value_t *v)
+{
+    if (v->in.enc == KVS_ENC_RAW || v->in.enc == KVS_ENC_LZF)
+        kvs_lazyfree_value(v->raw.ptr, v->raw.cap);
+    else if (v->in.enc == KVS_ENC_VLOG)
+        kvs_vlog_release(v); // 只是计数，不必推迟
+    v->in.enc = KVS_ENC_NONE;
+}
+
+void kvs_value_move(kvs_value_t *v)
+{
+    if (v->in.enc == KVS_ENC_RAW || v->in.enc == KVS_ENC_LZF)
+        v->raw.ptr = (char *)kvs_alloc_move(v->raw.ptr, v->raw.cap);
+}
@@ -0,0 +1,333 @@
+#include "engine/kvs_vlog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+__thread kvs_vlog_t *kvs_vlog_current = NULL;
+
+// 按 id 找日志：释放可能发生在别的线程
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static kvs_vlog_t *_Atomic g_logs[KVS_VLOG_MAX];
+
+static void seg_path(const kvs_vlog_t *log, int slot, char *buf, size_t cap)
+{
+    snprintf(buf, cap, "%s/kvs-vlog-%d-%d", log->dir, log->id, slot);
+}
+
+// 关闭并删除段文件；live 归零的线程和封存的线程可能同时走到这里
+static void seg_drop(kvs_vlog_t *log, int slot)
+{
+    kvs_vlog_seg_t *seg = &log->segs[slot];
+    if (atomic_exchange(&seg->dropping, 1))
+        return;
+
+    char path[320];
+    seg_path(log, slot, path, sizeof(path));
+    close(atomic_load(&seg->fd));
+    unlink(path);
+    atomic_store(&seg->fd, -1);
+}
+
+static int seg_open(kvs_vlog_t *log)
+{
+    for (int i = 1; i <= KVS_VLOG_MAX_SEGS; i++)
+    {
+        int slot = (log->active + i + KVS_VLOG_MAX_SEGS) % KVS_VLOG_MAX_SEGS;
+        kvs_vlog_seg_t *seg = &log->segs[slot];
+        if (atomic_load(&seg->fd) >= 0)
+            continue;
+
+        char path[320];
+        seg_path(log, slot, path, sizeof(path));
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+            return -1;
+
+        seg->size = 0;
+        seg->gen++;
+        atomic_store(&seg->live, 0);
+        atomic_store(&seg->sealed, 0);
+        atomic_store(&seg->dropping, 0);
+        atomic_store(&seg->fd, fd);
+        return slot;
+    }
+    return -1; // 段都在用
+}
+
+static void seg_seal(kvs_vlog_t *log, int slot)
+{
+    kvs_vlog_seg_t *seg = &log->segs[slot];
+    atomic_store(&seg->sealed, 1);
+    if (atomic_load(&seg->live) == 0)
+        seg_drop(log, slot);
+}
+
+kvs_vlog_t *kvs_vlog_create(const char *dir, size_t threshold, uint64_t seg_size)
+{
+    if (!dir || strlen(dir) >= sizeof(((kvs_vlog_t *)0)->dir))
+        return NULL;
+
+    kvs_vlog_t *log = (kvs_vlog_t *)calloc(1, sizeof(kvs_vlog_t));
+    if (!log)
+        return NULL;
+    snprintf(log->dir, sizeof(log->dir), "%s", dir);
+    log->threshold = threshold > KVS_VALUE_EMBED ? threshold : KVS_VALUE_EMBED + 1;
+    log->seg_size = seg_size ? seg_size : KVS_VLOG_SEG_SIZE;
+    log->active = -1;
+    for (int i = 0; i < KVS_VLOG_MAX_SEGS; i++)
+        atomic_store(&log->segs[i].fd, -1);
+
+    pthread_mutex_lock(&g_lock);
+    log->id = -1;
+    for (int i = 0; i < KVS_VLOG_MAX; i++)
+    {
+        if (!atomic_load(&g_logs[i]))
+        {
+            log->id = i;
+            atomic_store(&g_logs[i], log);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    if (log->id < 0)
+    {
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+void kvs_vlog_destory(kvs_vlog_t *log)
+{
+    if (!log)
+        return;
+
+    pthread_mutex_lock(&g_lock);
+    atomic_store(&g_logs[log->id], NULL);
+    pthread_mutex_unlock(&g_lock);
+
+    for (int i = 0; i < KVS_VLOG_MAX_SEGS; i++)
+        if (atomic_load(&log->segs[i].fd) >= 0)
+            seg_drop(log, i);
+    if (kvs_vlog_current == log)
+        kvs_vlog_current = NULL;
+    free(log->gc_rb_cursor);
+    free(log);
+}
+
+int kvs_vlog_append(kvs_vlog_t *log, const char *s, size_t len, kvs_value_t *v)
+{
+    if (!log || !s || !v || len > UINT32_MAX)
+        return -1;
+
+    // 当前段放不下就封存，换一个新段；超过段大小的 value 独占一段
+    if (log->active < 0 || (log->segs[log->active].size > 0 && log->segs[log->active].size + len > log->seg_size))
+    {
+        if (log->active >= 0)
+            seg_seal(log, log->active);
+        log->active = seg_open(log);
+        if (log->active < 0)
+            return -2;
+    }
+
+    kvs_vlog_seg_t *seg = &log->segs[log->active];
+    int fd = atomic_load(&seg->fd);
+    for (size_t done = 0; done < len;)
+    {
+        ssize_t n = pwrite(fd, s + done, len - done, (off_t)(seg->size + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -3; // size 不变，写了一半的内容之后会被覆盖
+        done += (size_t)n;
+    }
+
+    atomic_fetch_add(&seg->live, (int64_t)len);
+    v->vlog.off = seg->size;
+    v->vlog.len = (uint32_t)len;
+    v->vlog.seg = (uint16_t)log->active;
+    v->vlog.log = (uint8_t)log->id;
+    v->vlog.lz = 0;
+    v->in.enc = KVS_ENC_VLOG;
+    seg->size += len;
+    return 0;
+}
+
+void kvs_vlog_release(kvs_value_t *v)
+{
+    kvs_vlog_t *log = atomic_load(&g_logs[v->vlog.log]);
+    if (!log)
+        return;
+
+    kvs_vlog_seg_t *seg = &log->segs[v->vlog.seg];
+    if (atomic_fetch_sub(&seg->live, (int64_t)v->vlog.len) == (int64_t)v->vlog.len && atomic_load(&seg->sealed))
+        seg_drop(log, v->vlog.seg);
+}
+
+char *kvs_vlog_payload(kvs_value_t *v)
+{
+    kvs_vlog_t *log = atomic_load(&g_logs[v->vlog.log]);
+    if (!log)
+        return NULL;
+
+    int fd = atomic_load(&log->segs[v->vlog.seg].fd);
+    char *buf = kvs_value_scratch((size_t)v->vlog.len + 1);
+    if (fd < 0 || !buf)
+        return NULL;
+
+    for (size_t done = 0; done < v->vlog.len;)
+    {
+        ssize_t n = pread(fd, buf + done, v->vlog.len - done, (off_t)(v->vlog.off + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return NULL;
+        done += (size_t)n;
+    }
+    buf[v->vlog.len] = '\0';
+    return buf;
+}
+
+char *kvs_vlog_value(kvs_value_t *v)
+{
+    char *s = kvs_vlog_payload(v);
+    if (!s)
+    {
+        kvs_value_unreadable = 1;
+        return NULL;
+    }
+    if (v->vlog.lz)
+        return kvs_value_unpack(s, v->vlog.len);
+    return s;
+}
+
+int kvs_vlog_gc_start(kvs_vlog_t *log)
+{
+    if (!log)
+        return 1;
+    if (log->gc_active)
+        return 0;
+
+    int best = -1;
+    double best_ratio = KVS_VLOG_GC_RATIO;
+    for (int i = 0; i < KVS_VLOG_MAX_SEGS; i++)
+    {
+        kvs_vlog_seg_t *seg = &log->segs[i];
+        if (atomic_load(&seg->fd) < 0 || !atomic_load(&seg->sealed) || atomic_load(&seg->dropping) || seg->size == 0)
+            continue;
+        double ratio = (double)atomic_load(&seg->live) / (double)seg->size;
+        if (ratio < best_ratio)
+        {
+            best = i;
+            best_ratio = ratio;
+        }
+    }
+    if (best < 0)
+        return 1;
+
+    log->gc_active = 1;
+    log->gc_seg = best;
+    log->gc_gen = log->segs[best].gen;
+    log->gc_phase = 0;
+    log->gc_cursor = 0;
+    log->gc_hash_cursor = 0;
+    return 0;
+}
+
+// 目标段还在（最后一个引用搬走后它会被删除，槽位还可能被新段复用）
+static int gc_target_alive(kvs_vlog_t *log)
+{
+    kvs_vlog_seg_t *seg = &log->segs[log->gc_seg];
+    return atomic_load(&seg->fd) >= 0 && !atomic_load(&seg->dropping) && seg->gen == log->gc_gen;
+}
+
+static void gc_value(void *arg, const char *key, kvs_value_t *v)
+{
+    (void)key;
+    kvs_vlog_t *log = (kvs_vlog_t *)arg;
+    if (v->in.enc != KVS_ENC_VLOG || v->vlog.log != log->id || v->vlog.seg != log->gc_seg || !gc_target_alive(log))
+        return;
+
+    // 原样搬运，压缩过的不解压
+    char *s = kvs_vlog_payload(v);
+    kvs_value_t nv;
+    if (!s || kvs_vlog_append(log, s, v->vlog.len, &nv) != 0)
+        return; // 留在原处，下一轮再试
+    nv.vlog.lz = v->vlog.lz;
+    kvs_vlog_release(v);
+    *v = nv;
+    log->gc_moved++;
+}
+
+static void gc_done(kvs_vlog_t *log)
+{
+    free(log->gc_rb_cursor);
+    log->gc_rb_cursor = NULL;
+    log->gc_active = 0;
+}
+
+int kvs_vlog_gc_step(kvs_vlog_t *log, kvs_array_t *array, kvs_rbtree_t *rbtree, kvs_hash_t *hash, int budget)
+{
+    if (!log || !log->gc_active)
+        return 0;
+
+    kvs_value_scratch_reset();
+    if (!gc_target_alive(log))
+    {
+        gc_done(log);
+        return 0;
+    }
+
+    int more = 0;
+    switch (log->gc_phase)
+    {
+    case 0:
+        more = kvs_array_values(array, &log->gc_cursor, budget, gc_value, log);
+        break;
+    case 1:
+        more = kvs_rbtree_values(rbtree, &log->gc_rb_cursor, budget, gc_value, log);
+        break;
+    case 2:
+        // hash 按桶推进，每个桶平均不到一个节点
+        for (int i = 0; i < budget; i++)
+        {
+            log->gc_hash_cursor = kvs_hash_values(hash, log->gc_hash_cursor, gc_value, log);
+            if (log->gc_hash_cursor == 0)
+                break;
+        }
+        more = log->gc_hash_cursor != 0;
+        break;
+    }
+    if (more)
+        return 1;
+
+    if (++log->gc_phase <= 2)
+        return 1;
+
+    gc_done(log);
+    return 0;
+}
+
+void kvs_vlog_stats(kvs_vlog_t *log, kvs_vlog_stats_t *st)
+{
+    memset(st, 0, sizeof(*st));
+    if (!log)
+        return;
+
+    for (int i = 0; i < KVS_VLOG_MAX_SEGS; i++)
+    {
+        kvs_vlog_seg_t *seg = &log->segs[i];
+        if (atomic_load(&seg->fd) < 0 || atomic_load(&seg->dropping))
+            continue;
+        st->disk += seg->size;
+        st->live += atomic_load(&seg->live);
+        st->segments++;
+    }
+}
@@ -0,0 +1,542 @@
+#include "network/kvs_cluster.h"
+#include "engine/kvs_vlog.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+// kvs_cluster_check 的路由结果
+enum
+{
+    ROUTE_LOCAL = 0,
+    ROUTE_MOVED,
+    ROUTE_ASK,
+    ROUTE_DOWN,
+    ROUTE_TRYAGAIN,
+};
+
+// migrate.keys 里引擎编号的最高位：重发时本地已没有这个 key，发的是 DEL，确认后不用再删
+#define MIGRATE_KEY_GONE 0x80
+
+static const char *upsert_cmd[] = {"UPSERT", "RUPSERT", "HUPSERT"};
+static const char *restore_cmd[] = {"RESTORE", "RRESTORE", "HRESTORE"};
+static const char *del_cmd[] = {"DEL", "RDEL", "HDEL"};
+
+int kvs_cluster_keyslot(const char *key)
+{
+    const char *begin = key;
+    size_t len = strlen(key);
+
+    const char *open = strchr(key, '{');
+    if (open)
+    {
+        const char *close = strchr(open + 1, '}');
+        if (close && close > open + 1)
+        {
+            begin = open + 1;
+            len = (size_t)(close - begin);
+        }
+    }
+
+    // FNV-1a，取低 14 位
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)begin[i];
+        h *= 16777619u;
+    }
+    return (int)(h & (KVS_CLUSTER_SLOTS - 1));
+}
+
+void kvs_cluster_init(kvs_cluster_t *cl, int lo, int hi)
+{
+    memset(cl, 0, sizeof(*cl));
+    cl->enabled = 1;
+    if (lo >= 0 && hi >= lo && hi < KVS_CLUSTER_SLOTS)
+        kvs_cluster_set(cl, lo, hi, KVS_SLOT_OWNED, 0);
+}
+
+void kvs_cluster_destory(kvs_cluster_t *cl)
+{
+    if (!cl)
+        return;
+    kvs_migrate_t *m = &cl->migrate;
+    free(m->rbtree_cursor);
+    kvs_buf_free(&m->out);
+    kvs_buf_free(&m->keys);
+    memset(cl, 0, sizeof(*cl));
+}
+
+int kvs_cluster_node(kvs_cluster_t *cl, const char *addr)
+{
+    const char *colon = strrchr(addr, ':');
+    if (!colon || colon == addr || atoi(colon + 1) <= 0 || strlen(addr) >= sizeof(cl->nodes[0]))
+        return -1;
+
+    for (int i = 0; i < cl->nnodes; i++)
+    {
+        if (strcmp(cl->nodes[i], addr) == 0)
+            return i;
+    }
+    if (cl->nnodes >= KVS_CLUSTER_MAX_NODES)
+        return -2;
+    snprintf(cl->nodes[cl->nnodes], sizeof(cl->nodes[0]), "%s", addr);
+    return cl->nnodes++;
+}
+
+void kvs_cluster_set(kvs_cluster_t *cl, int lo, int hi, int state, int node)
+{
+    for (int s = lo; s <= hi; s++)
+    {
+        cl->state[s] = (uint8_t)state;
+        cl->node[s] = (uint8_t)node;
+    }
+}
+
+static int reply(kvs_buf_t *out, const char *msg)
+{
+    if (kvs_buf_append(out, msg, strlen(msg)) != 0 || kvs_buf_append(out, "\r\n", 2) != 0)
+        return -2;
+    return 0;
+}
+
+static int key_exist(kvs_store_t *store, int engine, char *key)
+{
+    switch (engine)
+    {
+    case 0:
+        return kvs_array_exist(store->array, key) == 0;
+    case 1:
+        return kvs_rbtree_exist(store->rbtree, key) == 0;
+    default:
+        return kvs_hash_exist(store->hash, key) == 0;
+    }
+}
+
+// key 是否在还没确认的批次里（批次至多几百个 key，只有迁移中的 slot 才查）
+static int migrate_pending(kvs_migrate_t *m, int engine, const char *key)
+{
+    size_t off = 0;
+    while (off < m->keys.len)
+    {
+        const char *k = m->keys.data + off + 1;
+        if (((unsigned char)m->keys.data[off] & ~MIGRATE_KEY_GONE) == engine && strcmp(k, key) == 0)
+            return 1;
+        off += strlen(k) + 2;
+    }
+    return 0;
+}
+
+static int route(kvs_cluster_t *cl, kvs_store_t *store, int engine, int slot, char *key)
+{
+    switch (cl->state[slot])
+    {
+    case KVS_SLOT_OWNED:
+    case KVS_SLOT_IMPORTING:
+        return ROUTE_LOCAL;
+    case KVS_SLOT_REMOTE:
+        return ROUTE_MOVED;
+    case KVS_SLOT_MIGRATING:
+    {
+        // 没确认的批次：在途时两边都不能动；失败等重发时本地有就本地执行，
+        // 本地没有也不能 ASK，目标上可能还留着旧副本，要等重发的 DEL 确认
+        kvs_migrate_t *m = &cl->migrate;
+        int pending = m->nkeys > 0 && migrate_pending(m, engine, key);
+        if (pending && m->acks > 0)
+            return ROUTE_TRYAGAIN;
+        if (key_exist(store, engine, key))
+            return ROUTE_LOCAL;
+        return pending ? ROUTE_TRYAGAIN : ROUTE_ASK;
+    }
+    default:
+        return ROUTE_DOWN;
+    }
+}
+
+int kvs_cluster_check(kvs_cluster_t *cl, kvs_store_t *store, char **tokens, int count, kvs_buf_t *out)
+{
+    if (!cl || !cl->enabled || count < 2)
+        return 0;
+
+    int cmd = kvs_protocol_command(tokens[0]);
+    int engine, step;
+    if (cmd >= 0 && cmd <= KVS_CMD_ENGINE_LAST)
+    {
+        engine = cmd < KVS_CMD_RSET ? 0 : (cmd < KVS_CMD_HSET ? 1 : 2);
+        step = count; // 只有 tokens[1] 是 key
+    }
+    else if (cmd >= KVS_CMD_MGET)
+    {
+        engine = (cmd - KVS_CMD_MGET) / 2;
+        step = kvs_protocol_batch(tokens, count);
+    }
+    else
+    {
+        return 0;
+    }
+
+    // 批量命令的 key 都在本地时直接执行；要重定向时必须整条请求去同一个地方
+    int slot = kvs_cluster_keyslot(tokens[1]);
+    int kind = route(cl, store, engine, slot, tokens[1]);
+    for (int i = 1 + step; i < count; i += step)
+    {
+        int s = kvs_cluster_keyslot(tokens[i]);
+        int r = route(cl, store, engine, s, tokens[i]);
+        if (r == kind && (r == ROUTE_LOCAL || s == slot))
+            continue;
+        reply(out, s == slot || r == ROUTE_TRYAGAIN || kind == ROUTE_TRYAGAIN
+                       ? "ERROR TRYAGAIN keys of the request are being migrated"
+                       : "ERROR CROSSSLOT keys of the request are served by different nodes");
+        return 1;
+    }
+    if (kind == ROUTE_LOCAL)
+        return 0;
+    if (kind == ROUTE_TRYAGAIN)
+    {
+        reply(out, "ERROR TRYAGAIN keys of the request are being migrated");
+        return 1;
+    }
+
+    char line[128];
+    if (kind == ROUTE_DOWN)
+        snprintf(line, sizeof(line), "ERROR slot %d not served", slot);
+    else
+        snprintf(line, sizeof(line), "%s %d %s", kind == ROUTE_MOVED ? "MOVED" : "ASK", slot, cl->nodes[cl->node[slot]]);
+    reply(out, line);
+    return 1;
+}
+
+static int parse_slot(const char *s)
+{
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || v < 0 || v >= KVS_CLUSTER_SLOTS)
+        return -1;
+    return (int)v;
+}
+
+// 从头遍历，丢掉未确认的批次
+static void migrate_rewind(kvs_migrate_t *m)
+{
+    m->out.len = 0;
+    m->keys.len = 0;
+    m->nkeys = 0;
+    m->acks = 0;
+    m->stage = KVS_MIGRATE_ARRAY;
+    m->array_cursor = 0;
+    free(m->rbtree_cursor);
+    m->rbtree_cursor = NULL;
+    m->hash_cursor = 0;
+}
+
+// SETSLOT lo hi OWNED|NONE|NODE addr|IMPORTING addr|MIGRATING addr
+static int execute_setslot(kvs_cluster_t *cl, char **tokens, int count, kvs_buf_t *out)
+{
+    if (count < 5)
+        return reply(out, "ERROR wrong number of arguments");
+
+    int lo = parse_slot(tokens[2]);
+    int hi = parse_slot(tokens[3]);
+    if (lo < 0 || hi < lo)
+        return reply(out, "ERROR invalid slot range");
+
+    const char *what = tokens[4];
+    if (strcmp(what, "OWNED") == 0 || strcmp(what, "NONE") == 0)
+    {
+        if (count != 5)
+            return reply(out, "ERROR wrong number of arguments");
+        kvs_cluster_set(cl, lo, hi, what[0] == 'O' ? KVS_SLOT_OWNED : KVS_SLOT_NONE, 0);
+        return reply(out, "OK");
+    }
+
+    int state;
+    if (strcmp(what, "NODE") == 0)
+        state = KVS_SLOT_REMOTE;
+    else if (strcmp(what, "IMPORTING") == 0)
+        state = KVS_SLOT_IMPORTING;
+    else if (strcmp(what, "MIGRATING") == 0)
+        state = KVS_SLOT_MIGRATING;
+    else
+        return reply(out, "ERROR syntax error");
+    if (count != 6)
+        return reply(out, "ERROR wrong number of arguments");
+
+    int node = kvs_cluster_node(cl, tokens[5]);
+    if (node < 0)
+        return reply(out, node == -1 ? "ERROR invalid address" : "ERROR too many nodes");
+
+    if (state == KVS_SLOT_MIGRATING)
+    {
+        kvs_migrate_t *m = &cl->migrate;
+        if (m->active)
+            return reply(out, "ERROR migration in progress");
+        for (int s = lo; s <= hi; s++)
+        {
+            if (cl->state[s] != KVS_SLOT_OWNED)
+                return reply(out, "ERROR slot not owned");
+        }
+        migrate_rewind(m);
+        m->active = 1;
+        m->lo = lo;
+        m->hi = hi;
+        m->node = node;
+        m->retry_ms = 0;
+        m->moved = 0;
+    }
+    kvs_cluster_set(cl, lo, hi, state, node);
+    return reply(out, "OK");
+}
+
+static int execute_info(kvs_cluster_t *cl, kvs_buf_t *out)
+{
+    int n[KVS_SLOT_IMPORTING + 1] = {0};
+    for (int s = 0; s < KVS_CLUSTER_SLOTS; s++)
+        n[cl->state[s]]++;
+
+    kvs_migrate_t *m = &cl->migrate;
+    char line[256];
+    int len = snprintf(line, sizeof(line), "CLUSTER owned=%d remote=%d migrating=%d importing=%d none=%d nodes=%d",
+                       n[KVS_SLOT_OWNED], n[KVS_SLOT_REMOTE], n[KVS_SLOT_MIGRATING], n[KVS_SLOT_IMPORTING],
+                       n[KVS_SLOT_NONE], cl->nnodes);
+    if (m->active)
+        snprintf(line + len, sizeof(line) - (size_t)len, " migrate=%d-%d:%s moved=%ld", m->lo, m->hi,
+                 cl->nodes[m->node], m->moved);
+    return reply(out, line);
+}
+
+int kvs_cluster_execute(kvs_cluster_t *cl, char **tokens, int count, kvs_buf_t *out)
+{
+    if (!cl || !tokens || !out)
+        return -1;
+    if (count < 2)
+        return reply(out, "ERROR wrong number of arguments");
+
+    if (strcmp(tokens[1], "KEYSLOT") == 0)
+    {
+        if (count != 3)
+            return reply(out, "ERROR wrong number of arguments");
+        char line[16];
+        snprintf(line, sizeof(line), "%d", kvs_cluster_keyslot(tokens[2]));
+        return reply(out, line);
+    }
+    if (strcmp(tokens[1], "SETSLOT") == 0)
+        return execute_setslot(cl, tokens, count, out);
+    if (strcmp(tokens[1], "INFO") == 0)
+        return execute_info(cl, out);
+    return reply(out, "ERROR unknown subcommand");
+}
+
+typedef struct collect_ctx_s
+{
+    kvs_migrate_t *m;
+    unsigned char engine;
+    int err;
+} collect_ctx_t;
+
+// "cmd key[ value]\n" 追加到 out，key 连同引擎编号记进 keys
+static int append_cmd(kvs_migrate_t *m, const char *cmd, const char *key, const char *value)
+{
+    if (kvs_buf_append(&m->out, cmd, strlen(cmd)) != 0 || kvs_buf_append(&m->out, " ", 1) != 0 ||
+        kvs_buf_append(&m->out, key, strlen(key)) != 0)
+        return -2;
+    if (value && (kvs_buf_append(&m->out, " ", 1) != 0 || kvs_buf_append(&m->out, value, strlen(value)) != 0))
+        return -2;
+    return kvs_buf_append(&m->out, "\n", 1) != 0 ? -2 : 0;
+}
+
+static void collect_key(void *arg, const char *key, kvs_value_t *v)
+{
+    collect_ctx_t *ctx = (collect_ctx_t *)arg;
+    kvs_migrate_t *m = ctx->m;
+
+    int slot = kvs_cluster_keyslot(key);
+    if (slot < m->lo || slot > m->hi)
+        return;
+
+    // 压缩过的值原样搬运
+    const char *cmd = upsert_cmd[ctx->engine];
+    const char *value = kvs_value_packed(v);
+    if (value)
+        cmd = restore_cmd[ctx->engine];
+    else
+        value = kvs_value_str(v);
+    if (!value)
+    {
+        ctx->err = -1; // 读不出来的值不能当空串发过去
+        return;
+    }
+    if (append_cmd(m, cmd, key, value) != 0 || kvs_buf_append(&m->keys, (const char *)&ctx->engine, 1) != 0 ||
+        kvs_buf_append(&m->keys, key, strlen(key) + 1) != 0)
+    {
+        ctx->err = -2;
+        return;
+    }
+    m->nkeys++;
+}
+
+int kvs_migrate_collect(kvs_cluster_t *cl, kvs_store_t *store, int max_keys, int budget)
+{
+    kvs_migrate_t *m = &cl->migrate;
+    m->out.len = 0;
+    m->keys.len = 0;
+    m->nkeys = 0;
+    kvs_value_scratch_reset(); // 展开的值读出后马上拼进 out
+
+    // 每访问一个槽位/节点最多得到一个 key：按剩余名额分段调用，批次不会超过 max_keys
+    collect_ctx_t ctx = {m, 0, 0};
+    while (m->stage != KVS_MIGRATE_DONE && m->nkeys < max_keys && budget > 0 && !ctx.err)
+    {
+        int step = max_keys - m->nkeys < budget ? max_keys - m->nkeys : budget;
+        int more;
+        ctx.engine = (unsigned char)m->stage;
+        switch (m->stage)
+        {
+        case KVS_MIGRATE_ARRAY:
+            more = kvs_array_values(store->array, &m->array_cursor, step, collect_key, &ctx);
+            break;
+        case KVS_MIGRATE_RBTREE:
+            more = kvs_rbtree_values(store->rbtree, &m->rbtree_cursor, step, collect_key, &ctx);
+            break;
+        default:
+            m->hash_cursor = kvs_hash_values(store->hash, m->hash_cursor, collect_key, &ctx);
+            more = m->hash_cursor != 0;
+            step = 1;
+            break;
+        }
+        budget -= step;
+        if (!more)
+            m->stage++;
+    }
+    if (ctx.err)
+    {
+        migrate_rewind(m); // 出错时游标可能已越过没记下的 key
+        return ctx.err;
+    }
+    return m->nkeys;
+}
+
+int kvs_migrate_resend(kvs_cluster_t *cl, kvs_store_t *store)
+{
+    kvs_migrate_t *m = &cl->migrate;
+    m->out.len = 0;
+    kvs_value_scratch_reset();
+
+    size_t off = 0;
+    while (off < m->keys.len)
+    {
+        unsigned char *flag = (unsigned char *)m->keys.data + off;
+        int engine = *flag & ~MIGRATE_KEY_GONE;
+        char *key = (char *)flag + 1;
+        char *value;
+        if (engine == 0)
+            value = kvs_array_get(store->array, key);
+        else if (engine == 1)
+            value = kvs_rbtree_get(store->rbtree, key);
+        else
+            value = kvs_hash_get(store->hash, key);
+        if (!value && kvs_value_unreadable)
+            return -1;
+
+        *flag = (unsigned char)(value ? engine : engine | MIGRATE_KEY_GONE);
+        if (append_cmd(m, value ? upsert_cmd[engine] : del_cmd[engine], key, value) != 0)
+            return -2;
+        off += strlen(key) + 2;
+    }
+    return m->nkeys;
+}
+
+int kvs_migrate_ack(kvs_cluster_t *cl, kvs_buf_t *in)
+{
+    kvs_migrate_t *m = &cl->migrate;
+    size_t off = 0;
+    char *nl;
+    while ((nl = memchr(in->data + off, '\n', in->len - off)) != NULL)
+    {
+        char *line = in->data + off;
+        size_t llen = (size_t)(nl - line);
+        if (llen > 0 && line[llen - 1] == '\r')
+            llen--;
+        // 重发的 DEL 在目标上没有这个 key 时回复 NO EXIST，同样算确认
+        int ok = (llen == 2 && memcmp(line, "OK", 2) == 0) || (llen == 8 && memcmp(line, "NO EXIST", 8) == 0);
+        if (!ok || m->acks == 0)
+            return -1;
+        m->acks--;
+        off = (size_t)(nl - in->data) + 1;
+    }
+    kvs_buf_consume(in, off);
+    return m->acks;
+}
+
+void kvs_migrate_commit(kvs_cluster_t *cl, kvs_store_t *store, kvs_migrate_del_fn on_del, void *arg)
+{
+    kvs_migrate_t *m = &cl->migrate;
+    size_t off = 0;
+    while (off < m->keys.len)
+    {
+        int engine = (unsigned char)m->keys.data[off];
+        char *key = m->keys.data + off + 1;
+        size_t len = strlen(key);
+        off += len + 2;
+        if (engine & MIGRATE_KEY_GONE)
+            continue;
+
+        if (engine == 0)
+            kvs_array_del(store->array, key);
+        else if (engine == 1)
+            kvs_rbtree_del(store->rbtree, key);
+        else
+            kvs_hash_del(store->hash, key);
+
+        if (on_del)
+        {
+            char *tokens[2] = {(char *)del_cmd[engine], key};
+            on_del(arg, tokens, 2);
+        }
+        m->moved++;
+    }
+    m->out.len = 0;
+    m->keys.len = 0;
+    m->nkeys = 0;
+}
+
+void kvs_migrate_abort(kvs_cluster_t *cl)
+{
+    kvs_migrate_t *m = &cl->migrate;
+    m->out.len = 0;
+    m->acks = 0;
+}
+
+int kvs_migrate_connect(const char *addr)
+{
+    char host[64];
+    const char *colon = strrchr(addr, ':');
+    if (!colon || (size_t)(colon - addr) >= sizeof(host))
+        return -1;
+    memcpy(host, addr, (size_t)(colon - addr));
+    host[colon - addr] = '\0';
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((unsigned short)atoi(colon + 1));
+    if (inet_pton(AF_INET, host, &sa.sin_addr) != 1)
+        return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
@@ -0,0 +1,1507 @@
+#define _GNU_SOURCE
+#include "network/kvs_reactor.h"
+#include "network/kvs_shard.h"
+#include "network/kvs_repl.h"
+#include "network/kvs_cluster.h"
+#include "protocol/kvs_protocol.h"
+#include "engine/kvs_defrag.h"
+#include "engine/kvs_lazyfree.h"
+#include "engine/kvs_vlog.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+
+// 连接在复制、迁移中的角色
+enum
+{
+    KVS_LINK_NONE = 0,  // 普通客户端
+    KVS_LINK_WAIT_SYNC, // 主上的从：等待全量同步开始
+    KVS_LINK_SYNCING,   // 主上的从：子进程正在写全量数据，本进程不能往这条连接写
+    KVS_LINK_ONLINE,    // 主上的从：持续接收命令流
+    KVS_LINK_MASTER,    // 从上到主的连接
+    KVS_LINK_MIGRATE,   // 源端到迁移目标的连接
+};
+
+// 从与主的同步状态
+enum
+{
+    KVS_MASTER_CONNECTING = 0, // 已发 PSYNC，等待回复
+    KVS_MASTER_SYNC,           // 正在接收全量数据
+    KVS_MASTER_ONLINE,         // 接收命令流，offset 随之推进
+};
+
+typedef struct kvs_conn_s
+{
+    int fd;
+    kvs_buf_t rbuf;
+    kvs_buf_t wbuf;
+
+    int pending;       // 已转发、尚未收到回复的请求数
+    int pending_owner; // pending 请求的去向；同一去向的请求经同一条 FIFO 队列往返，可以流水线
+    int closed;        // 连接已关闭，等 pending 归零后再释放
+    int want_out;
+
+    // 跨 shard 的批量请求：拆给各属主执行，回复按 key 收齐后再按原顺序写回
+    int gather_n;       // 原请求的 key 数，0 表示没有进行中的拆分
+    int *gather_owner;  // 每个 key 的属主 shard
+    char **gather_line; // 每个 key 的回复行（不含 \r\n），未收到时为 NULL
+
+    int repl; // 复制、迁移中的角色：KVS_LINK_*
+} kvs_conn_t;
+
+// 复制状态：只在单 loop 模式下启用（引擎是全局单例，全部命令在同一线程执行）
+typedef struct kvs_repl_s
+{
+    int enabled;
+    char id[KVS_REPL_ID_LEN + 1];
+    kvs_repl_backlog_t backlog; // 第一个从连上时才创建，此前写命令没有额外开销
+    kvs_buf_t line;             // 正在传播的写命令
+
+    kvs_conn_t *replicas[KVS_REPL_MAX_REPLICAS];
+    int nreplicas;
+    pid_t child; // 全量同步子进程，0 表示没有
+
+    // 作为从
+    int is_replica;
+    kvs_conn_t *master;
+    int master_state;
+    char master_id[KVS_REPL_ID_LEN + 1]; // 主的 replid，空表示还没同步过
+    uint64_t offset;                     // 已应用到的主命令流偏移
+    uint64_t sync_offset;                // 全量数据对应的偏移，收到 +SYNCED 后生效
+    uint64_t retry_ms;
+    kvs_buf_t discard; // 执行主发来的命令得到的回复，直接丢弃
+} kvs_repl_t;
+
+typedef struct kvs_loop_s
+{
+    int id;
+    int epfd;
+    int listenfd;
+    int efd; // shard 唤醒用 eventfd，单 loop 时为 -1
+
+    const kvs_config_t *cfg;
+    kvs_shard_group_t *group;
+    int executor; // I/O 线程模式下执行线程的成员 id，否则为 -1
+
+    kvs_store_t store;
+    kvs_array_t array;
+    kvs_rbtree_t rbtree;
+    kvs_hash_t hash;
+
+    // 请求级临时内存（token 数组等），每条请求的回复入队后整体 reset
+    struct mp_pool_s *arena;
+
+    // 碎片整理：只在持有引擎的成员上进行
+    kvs_defrag_t defrag;
+    uint64_t defrag_check_ms;
+
+    // value log：配置了 vlog_dir 时每个执行命令的成员一个
+    kvs_vlog_t *vlog;
+    uint64_t vlog_check_ms;
+
+    // 回到本成员的空闲消息，供下次转发复用
+    kvs_shard_msg_t *msg_cache;
+    int msg_cached;
+
+    // 发往各 shard 但队列已满的消息，下一轮重试
+    kvs_shard_msg_t *overflow_head[KVS_MAX_SHARDS];
+    kvs_shard_msg_t *overflow_tail[KVS_MAX_SHARDS];
+    unsigned char notify[KVS_MAX_SHARDS]; // 本轮需要唤醒的 shard
+
+    kvs_repl_t repl;
+    kvs_cluster_t *cluster; // 单 loop 且开启集群模式时才分配
+    kvs_conn_t *migrate;    // 到迁移目标的连接，没有为 NULL
+    uint64_t migrate_deadline; // 在途批次的确认期限
+
+    pthread_t tid;
+} kvs_loop_t;
+
+static int set_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+        return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int listen_socket(const kvs_config_t *cfg, int reuseport)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)cfg->port);
+    if (inet_pton(AF_INET, cfg->bind_ip, &addr.sin_addr) != 1)
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1024) != 0 || set_nonblock(fd) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void conn_update_events(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    int want_out = c->wbuf.len > 0;
+    if (want_out == c->want_out)
+        return;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (want_out ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(loop->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = want_out;
+}
+
+static void gather_free(kvs_conn_t *c)
+{
+    for (int i = 0; i < c->gather_n; i++)
+        free(c->gather_line[i]);
+    free(c->gather_line);
+    free(c->gather_owner);
+    c->gather_line = NULL;
+    c->gather_owner = NULL;
+    c->gather_n = 0;
+}
+
+static void conn_free(kvs_conn_t *c)
+{
+    gather_free(c);
+    kvs_buf_free(&c->rbuf);
+    kvs_buf_free(&c->wbuf);
+    free(c);
+}
+
+// 连接关闭时从复制状态里摘掉：主上的从移出列表，从上到主的连接稍后重连
+static void repl_detach(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    kvs_repl_t *r = &loop->repl;
+    if (c->repl == KVS_LINK_MASTER)
+    {
+        printf("repl: lost connection to master %s:%d\n", loop->cfg->replicaof_ip, loop->cfg->replicaof_port);
+        r->master = NULL;
+        r->retry_ms = now_ms() + KVS_REPL_RETRY_MS;
+        return;
+    }
+
+    for (int i = 0; i < r->nreplicas; i++)
+    {
+        if (r->replicas[i] == c)
+        {
+            r->replicas[i] = r->replicas[--r->nreplicas];
+            printf("repl: replica fd=%d disconnected\n", c->fd);
+            return;
+        }
+    }
+}
+
+// 迁移中断：本批作废但保留 key 列表，稍后重连后按本地现状重发
+static void migrate_abort(kvs_loop_t *loop, const char *why)
+{
+    kvs_cluster_t *cl = loop->cluster;
+    kvs_migrate_t *m = &cl->migrate;
+    printf("cluster: migrate %d-%d to %s: %s, retry later\n", m->lo, m->hi, cl->nodes[m->node], why);
+    m->retry_ms = now_ms() + KVS_MIGRATE_RETRY_MS;
+    kvs_migrate_abort(cl);
+    loop->migrate = NULL;
+}
+
+static void conn_close(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    if (c->closed)
+        return;
+
+    if (c->repl == KVS_LINK_MIGRATE)
+    {
+        if (c == loop->migrate)
+            migrate_abort(loop, "connection lost");
+    }
+    else if (c->repl != KVS_LINK_NONE)
+    {
+        repl_detach(loop, c);
+    }
+
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    c->closed = 1;
+
+    // 还有回复在路上：由收到回复的一方释放
+    if (c->pending == 0)
+        conn_free(c);
+}
+
+// @return: <0, 连接已关闭; =0, 正常
+static int conn_flush(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    // 子进程正在往这条连接写全量数据，命令流先攒着
+    if (c->repl == KVS_LINK_SYNCING)
+        return 0;
+
+    size_t off = 0;
+    while (off < c->wbuf.len)
+    {
+        ssize_t n = send(c->fd, c->wbuf.data + off, c->wbuf.len - off, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            off += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        conn_close(loop, c);
+        return -1;
+    }
+
+    kvs_buf_consume(&c->wbuf, off);
+    conn_update_events(loop, c);
+    return 0;
+}
+
+static void migrate_fail(kvs_loop_t *loop, const char *why)
+{
+    kvs_conn_t *c = loop->migrate;
+    migrate_abort(loop, why);
+    if (c)
+        conn_close(loop, c);
+}
+
+static void loop_send(kvs_loop_t *loop, int to, kvs_shard_msg_t *msg)
+{
+    msg->next = NULL;
+
+    // 有积压时必须排在积压之后，保证同一方向上的顺序
+    if (loop->overflow_head[to] || kvs_shard_send(loop->group, loop->id, to, msg) != 0)
+    {
+        if (loop->overflow_tail[to])
+            loop->overflow_tail[to]->next = msg;
+        else
+            loop->overflow_head[to] = msg;
+        loop->overflow_tail[to] = msg;
+        return;
+    }
+    loop->notify[to] = 1;
+}
+
+static int loop_flush_overflow(kvs_loop_t *loop)
+{
+    int remain = 0;
+
+    for (int to = 0; loop->group && to < loop->group->count; to++)
+    {
+        while (loop->overflow_head[to])
+        {
+            kvs_shard_msg_t *msg = loop->overflow_head[to];
+            if (kvs_shard_send(loop->group, loop->id, to, msg) != 0)
+            {
+                remain = 1;
+                break;
+            }
+            loop->overflow_head[to] = msg->next;
+            if (!loop->overflow_head[to])
+                loop->overflow_tail[to] = NULL;
+            loop->notify[to] = 1;
+        }
+
+        if (loop->notify[to])
+        {
+            loop->notify[to] = 0;
+            kvs_shard_notify(loop->group, to);
+        }
+    }
+    return remain;
+}
+
+static kvs_shard_msg_t *msg_get(kvs_loop_t *loop)
+{
+    kvs_shard_msg_t *msg = loop->msg_cache;
+    if (msg)
+    {
+        loop->msg_cache = msg->next;
+        loop->msg_cached--;
+        return msg;
+    }
+    return (kvs_shard_msg_t *)calloc(1, sizeof(*msg));
+}
+
+static void msg_put(kvs_loop_t *loop, kvs_shard_msg_t *msg)
+{
+    if (loop->msg_cached >= KVS_MSG_CACHE || msg->args_cap > KVS_MSG_CACHE_BUF || msg->reply.cap > KVS_MSG_CACHE_BUF)
+    {
+        kvs_shard_msg_free(msg);
+        return;
+    }
+    msg->next = loop->msg_cache;
+    loop->msg_cache = msg;
+    loop->msg_cached++;
+}
+
+static int forward_request(kvs_loop_t *loop, kvs_conn_t *c, int owner, char **tokens, int count, int broadcast)
+{
+    kvs_shard_msg_t *msg = msg_get(loop);
+    if (!msg)
+        return -2;
+    if (kvs_shard_msg_request(msg, loop->id, c, tokens, count) != 0)
+    {
+        msg_put(loop, msg);
+        return -2;
+    }
+    msg->broadcast = broadcast;
+
+    c->pending++;
+    c->pending_owner = owner;
+    loop_send(loop, owner, msg);
+    return 0;
+}
+
+// 按原顺序写回收齐的回复，没有收到的 key 回复 ERROR
+static void gather_flush(kvs_conn_t *c)
+{
+    for (int i = 0; i < c->gather_n; i++)
+    {
+        const char *line = c->gather_line[i] ? c->gather_line[i] : "ERROR";
+        kvs_buf_append(&c->wbuf, line, strlen(line));
+        kvs_buf_append(&c->wbuf, "\r\n", 2);
+    }
+    gather_free(c);
+}
+
+// 子请求的回复：逐行放回属于该 shard 的 key 的位置（子请求里 key 的顺序与原请求一致）
+static void gather_reply(kvs_loop_t *loop, kvs_conn_t *c, kvs_shard_msg_t *msg)
+{
+    const char *first = msg->args + strlen(msg->args) + 1;
+    int owner = kvs_shard_owner(loop->group, first);
+
+    char *p = msg->reply.data;
+    char *end = p + msg->reply.len;
+    for (int i = 0; i < c->gather_n && p < end; i++)
+    {
+        if (c->gather_owner[i] != owner)
+            continue;
+        char *nl = memchr(p, '\n', (size_t)(end - p));
+        char *stop = nl ? nl : end;
+        size_t len = (size_t)(stop - p);
+        if (len > 0 && p[len - 1] == '\r')
+            len--;
+        c->gather_line[i] = strndup(p, len);
+        p = nl ? nl + 1 : end;
+    }
+}
+
+// 每个 shard（含本 shard，经自己到自己的队列）各执行一份，全部回来后才回复；
+// 期间该连接暂停解析，后续请求一定看到所有 shard 上的执行结果
+static void broadcast_request(kvs_loop_t *loop, kvs_conn_t *c, char **tokens, int count)
+{
+    for (int to = 0; to < loop->group->count; to++)
+        forward_request(loop, c, to, tokens, count, 1);
+
+    if (c->pending == 0)
+        kvs_buf_append(&c->wbuf, "ERROR\r\n", 7);
+    c->pending_owner = -1; // 不与任何去向相同
+}
+
+#define KVS_OWNER_SPLIT -2 // 批量请求的 key 分属多个 shard，需要拆分
+
+// 批量请求的 key 全部属于同一个 shard 时按普通请求转发，否则拆分；格式不对的留给本地执行报错
+static int batch_owner(kvs_loop_t *loop, char **tokens, int count, int stride)
+{
+    if (count < 1 + stride || (count - 1) % stride != 0)
+        return loop->id;
+
+    int owner = kvs_shard_owner(loop->group, tokens[1]);
+    for (int i = 1 + stride; i < count; i += stride)
+    {
+        if (kvs_shard_owner(loop->group, tokens[i]) != owner)
+            return KVS_OWNER_SPLIT;
+    }
+    return owner;
+}
+
+// 按属主把批量请求拆成若干子请求（本 shard 的那份也走自己到自己的队列），回复由 gather_reply 收集
+static void split_request(kvs_loop_t *loop, kvs_conn_t *c, char **tokens, int count, int stride)
+{
+    int n = (count - 1) / stride;
+    char **sub = (char **)mp_alloc(loop->arena, sizeof(char *) * (size_t)count);
+    c->gather_owner = (int *)malloc(sizeof(int) * (size_t)n);
+    c->gather_line = (char **)calloc((size_t)n, sizeof(char *));
+    if (!sub || !c->gather_owner || !c->gather_line)
+    {
+        gather_free(c);
+        for (int i = 0; i < n; i++)
+            kvs_buf_append(&c->wbuf, "ERROR\r\n", 7);
+        return;
+    }
+    c->gather_n = n;
+    for (int i = 0; i < n; i++)
+        c->gather_owner[i] = kvs_shard_owner(loop->group, tokens[1 + i * stride]);
+
+    for (int to = 0; to < loop->group->count; to++)
+    {
+        int subcount = 1;
+        sub[0] = tokens[0];
+        for (int i = 0; i < n; i++)
+        {
+            if (c->gather_owner[i] != to)
+                continue;
+            for (int j = 0; j < stride; j++)
+                sub[subcount++] = tokens[1 + i * stride + j];
+        }
+        if (subcount > 1)
+            forward_request(loop, c, to, sub, subcount, 0); // 失败的 key 最终回复 ERROR
+    }
+
+    c->pending_owner = -1; // 不与任何去向相同：收齐之前暂停解析
+    if (c->pending == 0)
+        gather_flush(c);
+}
+
+// 请求由哪个成员执行：I/O 线程模式全部交给执行线程，shard 模式按 key 分属
+static int request_owner(kvs_loop_t *loop, char **tokens, int count)
+{
+    if (!loop->group)
+        return loop->id;
+    if (loop->executor >= 0)
+        return loop->executor;
+
+    int shard = kvs_protocol_cursor_owner(tokens, count, loop->group->count);
+    if (shard >= 0)
+        return shard;
+
+    int stride = kvs_protocol_batch(tokens, count);
+    if (stride > 0)
+        return batch_owner(loop, tokens, count, stride);
+
+    const char *key = kvs_protocol_key(tokens, count);
+    return key ? kvs_shard_owner(loop->group, key) : loop->id;
+}
+
+// 写命令执行后原样传播：进积压缓冲区，并追加到每个从的发送缓冲（本轮末尾统一发送）
+static void repl_feed(kvs_loop_t *loop, char **tokens, int count)
+{
+    kvs_repl_t *r = &loop->repl;
+    r->line.len = 0;
+    if (kvs_repl_format(&r->line, tokens, count) != 0)
+        return;
+    kvs_repl_backlog_feed(&r->backlog, r->line.data, r->line.len);
+
+    // 倒序：关闭连接会把末尾的从换到当前位置
+    for (int i = r->nreplicas - 1; i >= 0; i--)
+    {
+        kvs_conn_t *c = r->replicas[i];
+        if (c->repl == KVS_LINK_WAIT_SYNC)
+            continue; // 全量数据会包含这条命令的结果
+        if (kvs_buf_append(&c->wbuf, r->line.data, r->line.len) != 0 || c->wbuf.len > KVS_REPL_OUTBUF_MAX)
+        {
+            printf("repl: replica fd=%d output buffer overflow, disconnecting\n", c->fd);
+            conn_close(loop, c);
+        }
+    }
+}
+
+// PSYNC replid offset：能部分重同步就立即补发，否则等本轮末尾 fork 全量同步
+static void repl_psync(kvs_loop_t *loop, kvs_conn_t *c, char **tokens, int count)
+{
+    kvs_repl_t *r = &loop->repl;
+    const char *err = NULL;
+
+    if (count != 3)
+        err = "ERROR wrong number of arguments";
+    else if (r->is_replica)
+        err = "ERROR replica cannot serve replicas";
+    else if (r->nreplicas >= KVS_REPL_MAX_REPLICAS)
+        err = "ERROR too many replicas";
+    else if (!r->backlog.buf && kvs_repl_backlog_create(&r->backlog, loop->cfg->repl_backlog_size) != 0)
+        err = "ERROR";
+    if (err)
+    {
+        kvs_buf_append(&c->wbuf, err, strlen(err));
+        kvs_buf_append(&c->wbuf, "\r\n", 2);
+        return;
+    }
+
+    char *end;
+    errno = 0;
+    unsigned long long offset = strtoull(tokens[2], &end, 10);
+    int partial = tokens[2][0] >= '0' && tokens[2][0] <= '9' && *end == '\0' && errno == 0 &&
+                  kvs_repl_backlog_continue(&r->backlog, r->id, tokens[1], offset, &c->wbuf) == 0;
+
+    c->repl = partial ? KVS_LINK_ONLINE : KVS_LINK_WAIT_SYNC;
+    r->replicas[r->nreplicas++] = c;
+    printf("repl: replica fd=%d %s\n", c->fd, partial ? "partial resync" : "waiting for full resync");
+}
+
+// ROLE：一行 key=value
+static void repl_role(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    kvs_repl_t *r = &loop->repl;
+    char line[256];
+    int n;
+
+    if (r->is_replica)
+    {
+        static const char *state[] = {"connecting", "sync", "online"};
+        n = snprintf(line, sizeof(line), "ROLE replica master=%s:%d link=%s replid=%s offset=%" PRIu64 "\r\n",
+                     loop->cfg->replicaof_ip, loop->cfg->replicaof_port, r->master ? state[r->master_state] : "down",
+                     r->master_id[0] ? r->master_id : "?", r->offset);
+    }
+    else
+    {
+        int online = 0;
+        for (int i = 0; i < r->nreplicas; i++)
+            online += r->replicas[i]->repl == KVS_LINK_ONLINE;
+        n = snprintf(line, sizeof(line),
+                     "ROLE master replid=%s offset=%" PRIu64 " backlog_first=%" PRIu64 " replicas=%d online=%d\r\n", r->id,
+                     r->backlog.offset, kvs_repl_backlog_first(&r->backlog), r->nreplicas, online);
+    }
+    kvs_buf_append(&c->wbuf, line, (size_t)n);
+}
+
+// 在本 loop 执行一条请求；单 loop 时复制相关的命令在这里处理，写命令执行后传播给从
+static void conn_execute(kvs_loop_t *loop, kvs_conn_t *c, char **tokens, int count)
+{
+    kvs_repl_t *r = &loop->repl;
+    if (!r->enabled)
+    {
+        kvs_protocol_execute(&loop->store, tokens, count, &c->wbuf);
+        return;
+    }
+
+    int cmd = kvs_protocol_command(tokens[0]);
+    if (cmd == KVS_CMD_CLUSTER)
+    {
+        if (loop->cluster)
+            kvs_cluster_execute(loop->cluster, tokens, count, &c->wbuf);
+        else
+            kvs_buf_append(&c->wbuf, "ERROR cluster disabled\r\n", 24);
+        return;
+    }
+    if (loop->cluster && kvs_cluster_check(loop->cluster, &loop->store, tokens, count, &c->wbuf))
+        return;
+    if (cmd == KVS_CMD_PSYNC)
+    {
+        repl_psync(loop, c, tokens, count);
+        return;
+    }
+    if (cmd == KVS_CMD_ROLE)
+    {
+        repl_role(loop, c);
+        return;
+    }
+
+    // 没有从、也不是从时不必判断读写
+    int write = (r->is_replica || r->backlog.buf) && kvs_protocol_write(tokens, count);
+    if (write && r->is_replica)
+    {
+        kvs_buf_append(&c->wbuf, "ERROR read only replica\r\n", 25);
+        return;
+    }
+
+    kvs_protocol_execute(&loop->store, tokens, count, &c->wbuf);
+    if (write)
+        repl_feed(loop, tokens, count);
+}
+
+// 从：处理主发来的数据。+ 开头的是握手/同步控制行，其余是要执行的命令（回复丢弃）
+static void repl_process_master(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    kvs_repl_t *r = &loop->repl;
+    size_t off = 0;
+
+    while (off < c->rbuf.len)
+    {
+        char *line = c->rbuf.data + off;
+        char *nl = memchr(line, '\n', c->rbuf.len - off);
+        if (!nl)
+            break;
+
+        size_t len = (size_t)(nl - line) + 1;
+        *nl = '\0';
+        int count = 0;
+        char **tokens = kvs_protocol_tokenize(loop->arena, line, &count);
+        if (!tokens)
+        {
+            kvs_protocol_join(line, nl);
+            *nl = '\n';
+            break;
+        }
+        off += len;
+
+        if (count >= 3 && strcmp(tokens[0], "+FULLRESYNC") == 0)
+        {
+            snprintf(r->master_id, sizeof(r->master_id), "%s", tokens[1]);
+            r->sync_offset = strtoull(tokens[2], NULL, 10);
+            r->master_state = KVS_MASTER_SYNC;
+            printf("repl: full resync from master, replid=%s offset=%s\n", tokens[1], tokens[2]);
+        }
+        else if (count >= 2 && strcmp(tokens[0], "+CONTINUE") == 0)
+        {
+            r->master_state = KVS_MASTER_ONLINE;
+            printf("repl: partial resync from offset %" PRIu64 "\n", r->offset);
+        }
+        else if (count >= 1 && strcmp(tokens[0], "+SYNCED") == 0)
+        {
+            r->offset = r->sync_offset;
+            r->master_state = KVS_MASTER_ONLINE;
+            printf("repl: full resync done\n");
+        }
+        else if (count >= 1 && strcmp(tokens[0], "ERROR") == 0 && r->master_state == KVS_MASTER_CONNECTING)
+        {
+            kvs_protocol_join(line, nl);
+            printf("repl: master refused: %s\n", line);
+            shutdown(c->fd, SHUT_RDWR); // 由随后的 EPOLLHUP 关闭并稍后重连
+            off = c->rbuf.len;
+            mp_reset_pool(loop->arena);
+            break;
+        }
+        else
+        {
+            if (count > 0)
+            {
+                r->discard.len = 0;
+                kvs_protocol_execute(&loop->store, tokens, count, &r->discard);
+            }
+            if (r->master_state == KVS_MASTER_ONLINE)
+                r->offset += len;
+        }
+        mp_reset_pool(loop->arena);
+    }
+
+    kvs_buf_consume(&c->rbuf, off);
+}
+
+// 迁走的 key 在本地删除时，同样把删除传播给从
+static void cluster_del_feed(void *arg, char **tokens, int count)
+{
+    kvs_loop_t *loop = (kvs_loop_t *)arg;
+    if (loop->repl.backlog.buf)
+        repl_feed(loop, tokens, count);
+}
+
+// 迁移目标的回复：收齐一批才在本地删除，下一批由 loop_cluster 发出；SETSLOT 确认后迁移完成
+static void migrate_on_reply(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    kvs_cluster_t *cl = loop->cluster;
+    kvs_migrate_t *m = &cl->migrate;
+    int waiting = m->acks;
+    int remain = kvs_migrate_ack(cl, &c->rbuf);
+    if (remain < 0)
+    {
+        migrate_fail(loop, "target refused batch");
+        return;
+    }
+    if (waiting == 0 || remain > 0)
+        return;
+
+    if (m->nkeys > 0)
+    {
+        kvs_migrate_commit(cl, &loop->store, cluster_del_feed, loop);
+        return;
+    }
+    kvs_cluster_set(cl, m->lo, m->hi, KVS_SLOT_REMOTE, m->node);
+    printf("cluster: migrated slots %d-%d to %s, %ld keys\n", m->lo, m->hi, cl->nodes[m->node], m->moved);
+    m->active = 0;
+    loop->migrate = NULL;
+    conn_close(loop, c);
+}
+
+static void conn_process(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    size_t off = 0;
+
+    if (c->repl == KVS_LINK_MASTER)
+    {
+        repl_process_master(loop, c);
+        return;
+    }
+    if (c->repl != KVS_LINK_NONE)
+    {
+        c->rbuf.len = 0; // 主上的从不再发请求，收到的一律丢弃
+        return;
+    }
+
+    while (off < c->rbuf.len)
+    {
+        char *line = c->rbuf.data + off;
+        char *nl = memchr(line, '\n', c->rbuf.len - off);
+        if (!nl)
+            break;
+
+        // 先原地切分；如果因为顺序约束暂不能处理，再用 kvs_protocol_join 恢复原文
+        *nl = '\0';
+        int count = 0;
+        char **tokens = kvs_protocol_tokenize(loop->arena, line, &count);
+        if (!tokens)
+        {
+            kvs_protocol_join(line, nl);
+            *nl = '\n';
+            break; // arena 分配失败：留到下次再处理
+        }
+        if (count == 0)
+        {
+            off = (size_t)(nl - c->rbuf.data) + 1;
+            continue;
+        }
+
+        int owner = request_owner(loop, tokens, count);
+
+        // 已有请求在别处执行、且本条去向不同：暂停解析，保证同一连接的回复顺序
+        if (c->pending && owner != c->pending_owner)
+        {
+            kvs_protocol_join(line, nl);
+            *nl = '\n';
+            break;
+        }
+        off = (size_t)(nl - c->rbuf.data) + 1;
+
+        if (owner == KVS_OWNER_SPLIT)
+        {
+            split_request(loop, c, tokens, count, kvs_protocol_batch(tokens, count));
+        }
+        else if (owner != loop->id)
+        {
+            if (forward_request(loop, c, owner, tokens, count, 0) != 0)
+                kvs_buf_append(&c->wbuf, "ERROR\r\n", 7);
+        }
+        else if (loop->group && loop->executor < 0 && kvs_protocol_broadcast(tokens, count))
+        {
+            broadcast_request(loop, c, tokens, count);
+        }
+        else
+        {
+            conn_execute(loop, c, tokens, count);
+        }
+
+        // 请求已复制进消息或回复已入队，本条的临时内存可以整体回收
+        mp_reset_pool(loop->arena);
+
+        // 成为从之后不再当普通请求解析
+        if (c->repl != KVS_LINK_NONE)
+        {
+            off = c->rbuf.len;
+            break;
+        }
+    }
+    mp_reset_pool(loop->arena);
+
+    kvs_buf_consume(&c->rbuf, off);
+}
+
+static void conn_on_read(kvs_loop_t *loop, kvs_conn_t *c)
+{
+    for (;;)
+    {
+        if (c->rbuf.cap - c->rbuf.len < KVS_READ_CHUNK)
+        {
+            if (kvs_buf_reserve(&c->rbuf, KVS_READ_CHUNK) != 0)
+            {
+                conn_close(loop, c);
+                return;
+            }
+        }
+
+        ssize_t n = recv(c->fd, c->rbuf.data + c->rbuf.len, c->rbuf.cap - c->rbuf.len, 0);
+        if (n > 0)
+        {
+            c->rbuf.len += (size_t)n;
+            if (c->rbuf.len > KVS_MAX_REQUEST)
+            {
+                conn_close(loop, c);
+                return;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        conn_close(loop, c); // 对端关闭或出错
+        return;
+    }
+
+    // 迁移连接只收回复，处理时可能关闭连接
+    if (c->repl == KVS_LINK_MIGRATE)
+    {
+        migrate_on_reply(loop, c);
+        return;
+    }
+    conn_process(loop, c);
+    conn_flush(loop, c);
+}
+
+static void loop_accept(kvs_loop_t *loop)
+{
+    for (;;)
+    {
+        int fd = accept4(loop->listenfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return; // EAGAIN 或暂时性错误
+        }
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        kvs_conn_t *c = (kvs_conn_t *)calloc(1, sizeof(*c));
+        if (!c)
+        {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            close(fd);
+            conn_free(c);
+        }
+    }
+}
+
+static void loop_on_message(kvs_loop_t *loop, kvs_shard_msg_t *msg)
+{
+    if (msg->type == KVS_SHARD_REQ)
+    {
+        // 本成员是属主：执行并原路返回；args 保留，随消息回到发起方复用
+        char **tokens = (char **)mp_alloc(loop->arena, sizeof(char *) * (size_t)(msg->argc ? msg->argc : 1));
+        if (tokens)
+        {
+            int count = kvs_shard_msg_tokens(msg, tokens, msg->argc);
+            kvs_protocol_execute(&loop->store, tokens, count, &msg->reply);
+        }
+        else
+        {
+            kvs_buf_append(&msg->reply, "ERROR\r\n", 7);
+        }
+        mp_reset_pool(loop->arena);
+
+        msg->type = KVS_SHARD_REP;
+        loop_send(loop, msg->from, msg);
+        return;
+    }
+
+    kvs_conn_t *c = (kvs_conn_t *)msg->conn;
+    c->pending--;
+
+    if (c->closed)
+    {
+        if (c->pending == 0)
+            conn_free(c);
+        msg_put(loop, msg);
+        return;
+    }
+
+    if (c->gather_n > 0)
+    {
+        gather_reply(loop, c, msg);
+        if (c->pending == 0)
+            gather_flush(c);
+    }
+    else if (!msg->broadcast || c->pending == 0)
+    {
+        kvs_buf_append(&c->wbuf, msg->reply.data, msg->reply.len);
+    }
+    msg_put(loop, msg);
+
+    conn_process(loop, c);
+    conn_flush(loop, c);
+}
+
+static void loop_on_notify(kvs_loop_t *loop)
+{
+    kvs_shard_drain_notify(loop->group, loop->id);
+
+    for (int from = 0; from < loop->group->count; from++)
+    {
+        kvs_shard_msg_t *msg;
+        while ((msg = kvs_shard_recv(loop->group, loop->id, from)) != NULL)
+            loop_on_message(loop, msg);
+    }
+}
+
+static int loop_init(kvs_loop_t *loop)
+{
+    // 未指定时使用 loop 自己的引擎实例（shard 模式）
+    if (!loop->store.array)
+    {
+        loop->store.array = &loop->array;
+        loop->store.rbtree = &loop->rbtree;
+        loop->store.hash = &loop->hash;
+    }
+    if (loop->group && loop->executor < 0)
+    {
+        loop->store.shard = loop->id;
+        loop->store.nshards = loop->group->count;
+    }
+
+    // 在本线程里创建引擎，mypool 的内存因此落在本线程的 pool 上
+    // I/O 线程不执行命令，不需要引擎
+    int is_io = loop->executor >= 0 && loop->executor != loop->id;
+    if (!is_io && kvs_store_create(&loop->store) != 0)
+        return -1;
+
+    // 本线程写入的大 value 进入本成员的日志
+    if (!is_io && loop->cfg->vlog_dir[0])
+    {
+        loop->vlog = kvs_vlog_create(loop->cfg->vlog_dir, loop->cfg->vlog_threshold, 0);
+        if (!loop->vlog)
+        {
+            fprintf(stderr, "loop %d: value log in %s failed\n", loop->id, loop->cfg->vlog_dir);
+            return -1;
+        }
+        kvs_vlog_current = loop->vlog;
+    }
+
+    loop->arena = mp_create_pool(KVS_ARENA_SIZE);
+    if (!loop->arena)
+        return -1;
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0)
+        return -1;
+
+    struct epoll_event ev;
+
+    // 执行线程不接连接
+    loop->listenfd = -1;
+    if (loop->executor != loop->id)
+    {
+        loop->listenfd = listen_socket(loop->cfg, loop->group != NULL);
+        if (loop->listenfd < 0)
+        {
+            fprintf(stderr, "loop %d: listen on %s:%d failed: %s\n", loop->id, loop->cfg->bind_ip, loop->cfg->port, strerror(errno));
+            return -1;
+        }
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = &loop->listenfd;
+        epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->listenfd, &ev);
+    }
+
+    if (loop->group)
+    {
+        loop->efd = loop->group->efds[loop->id];
+        ev.events = EPOLLIN;
+        ev.data.ptr = &loop->efd;
+        epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->efd, &ev);
+    }
+
+    // 单 loop：可以作为主接受从，配置了 replicaof 时作为从
+    if (!loop->group)
+    {
+        loop->repl.enabled = 1;
+        kvs_repl_new_id(loop->repl.id);
+        loop->repl.is_replica = loop->cfg->replicaof_port > 0;
+
+        if (loop->cfg->cluster)
+        {
+            loop->cluster = (kvs_cluster_t *)malloc(sizeof(kvs_cluster_t));
+            if (!loop->cluster)
+                return -1;
+            kvs_cluster_init(loop->cluster, loop->cfg->cluster_slot_lo, loop->cfg->cluster_slot_hi);
+        }
+    }
+    return 0;
+}
+
+// 每轮事件循环末尾调用：推进碎片整理或按间隔检查是否需要开始
+// @return: 建议的 epoll 超时（ms），-1 表示无需定时唤醒
+static int loop_defrag(kvs_loop_t *loop)
+{
+    int is_io = loop->executor >= 0 && loop->executor != loop->id;
+    if (!loop->cfg->defrag || is_io)
+        return -1;
+
+    kvs_store_t *s = &loop->store;
+    if (loop->defrag.active)
+    {
+        // 每次只搬少量条目，请求处理不会被长时间阻塞
+        if (kvs_defrag_step(&loop->defrag, s->array, s->rbtree, s->hash, KVS_DEFRAG_BUDGET))
+            return 1;
+        loop->defrag_check_ms = now_ms() + KVS_DEFRAG_CHECK_MS;
+        return KVS_DEFRAG_CHECK_MS;
+    }
+
+    uint64_t now = now_ms();
+    if (now < loop->defrag_check_ms)
+        return (int)(loop->defrag_check_ms - now);
+    loop->defrag_check_ms = now + KVS_DEFRAG_CHECK_MS;
+
+    if (kvs_defrag_needed(&loop->defrag, loop->cfg->defrag_threshold, KVS_DEFRAG_MIN_WASTE) &&
+        kvs_defrag_start(&loop->defrag) == 0)
+        return 1;
+    return KVS_DEFRAG_CHECK_MS;
+}
+
+// 每轮事件循环末尾调用：推进 value log 回收或按间隔检查是否有可回收的段
+// @return: 建议的 epoll 超时（ms），-1 表示无需定时唤醒
+static int loop_vlog(kvs_loop_t *loop)
+{
+    if (!loop->vlog)
+        return -1;
+
+    kvs_store_t *s = &loop->store;
+    if (loop->vlog->gc_active)
+    {
+        if (kvs_vlog_gc_step(loop->vlog, s->array, s->rbtree, s->hash, KVS_VLOG_GC_BUDGET))
+            return 1;
+        loop->vlog_check_ms = now_ms() + KVS_VLOG_GC_CHECK_MS;
+        return KVS_VLOG_GC_CHECK_MS;
+    }
+
+    uint64_t now = now_ms();
+    if (now < loop->vlog_check_ms)
+        return (int)(loop->vlog_check_ms - now);
+    loop->vlog_check_ms = now + KVS_VLOG_GC_CHECK_MS;
+
+    if (kvs_vlog_gc_start(loop->vlog) == 0)
+        return 1;
+    return KVS_VLOG_GC_CHECK_MS;
+}
+
+// mypool 下本线程排队的惰性释放任务，每轮事件循环放一批
+// @return: 建议的 epoll 超时（ms），-1 表示无需定时唤醒
+static int loop_lazyfree(void)
+{
+    return kvs_lazyfree_step(KVS_LAZYFREE_BUDGET) ? 0 : -1;
+}
+
+// 从：非阻塞连接主，连上后 conn_flush 发出 PSYNC
+static void repl_connect(kvs_loop_t *loop)
+{
+    kvs_repl_t *r = &loop->repl;
+    r->retry_ms = now_ms() + KVS_REPL_RETRY_MS;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)loop->cfg->replicaof_port);
+    if (inet_pton(AF_INET, loop->cfg->replicaof_ip, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "repl: invalid master address %s\n", loop->cfg->replicaof_ip);
+        return;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        return;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    kvs_conn_t *c = (kvs_conn_t *)calloc(1, sizeof(*c));
+    if (!c)
+    {
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+    c->repl = KVS_LINK_MASTER;
+
+    char line[KVS_REPL_ID_LEN + 32];
+    int n = r->master_id[0] ? snprintf(line, sizeof(line), "PSYNC %s %" PRIu64 "\n", r->master_id, r->offset)
+                            : snprintf(line, sizeof(line), "PSYNC ? -1\n");
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = c;
+    if (kvs_buf_append(&c->wbuf, line, (size_t)n) != 0 || epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        close(fd);
+        conn_free(c);
+        return;
+    }
+    c->want_out = 1;
+
+    r->master = c;
+    r->master_state = KVS_MASTER_CONNECTING;
+}
+
+// 主：fork 子进程，把当前数据一次写给所有等待全量同步的从；之后的写命令攒在各自的发送缓冲里
+static void repl_start_sync(kvs_loop_t *loop)
+{
+    kvs_repl_t *r = &loop->repl;
+    int fds[KVS_REPL_MAX_REPLICAS];
+    kvs_conn_t *conns[KVS_REPL_MAX_REPLICAS];
+    int n = 0;
+
+    for (int i = r->nreplicas - 1; i >= 0; i--)
+    {
+        kvs_conn_t *c = r->replicas[i];
+        if (c->repl != KVS_LINK_WAIT_SYNC)
+            continue;
+        // PSYNC 之前的回复还没发完：全量数据必须排在它们后面
+        if (c->wbuf.len > 0 && (conn_flush(loop, c) < 0 || c->wbuf.len > 0))
+            continue;
+        fds[n] = c->fd;
+        conns[n++] = c;
+    }
+    if (n == 0)
+        return;
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int ok = kvs_repl_snapshot(&loop->store, r->id, r->backlog.offset, fds, n);
+        _exit(ok == n ? 0 : 1);
+    }
+    if (pid < 0)
+    {
+        fprintf(stderr, "repl: fork failed: %s\n", strerror(errno));
+        return;
+    }
+
+    for (int i = 0; i < n; i++)
+        conns[i]->repl = KVS_LINK_SYNCING;
+    r->child = pid;
+    printf("repl: full resync of %d replica(s) at offset %" PRIu64 " by child %d\n", n, r->backlog.offset, (int)pid);
+}
+
+// 每轮事件循环末尾调用：从断线重连；主回收全量同步子进程、开始新的全量同步、发送命令流
+// @return: 建议的 epoll 超时（ms），-1 表示无需定时唤醒
+static int loop_repl(kvs_loop_t *loop)
+{
+    kvs_repl_t *r = &loop->repl;
+    if (!r->enabled)
+        return -1;
+
+    int timeout = -1;
+    if (r->is_replica && !r->master)
+    {
+        uint64_t now = now_ms();
+        if (now >= r->retry_ms)
+            repl_connect(loop);
+        if (!r->master)
+            timeout = (int)(r->retry_ms > now ? r->retry_ms - now : 1);
+    }
+
+    if (r->child > 0)
+    {
+        int status;
+        pid_t pid = waitpid(r->child, &status, WNOHANG);
+        if (pid == r->child || (pid < 0 && errno == ECHILD))
+        {
+            int ok = pid == r->child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            printf("repl: full resync child %d %s\n", (int)r->child, ok ? "done" : "failed");
+            r->child = 0;
+            for (int i = 0; i < r->nreplicas; i++)
+            {
+                if (r->replicas[i]->repl == KVS_LINK_SYNCING)
+                    r->replicas[i]->repl = KVS_LINK_ONLINE; // 写失败的从已被子进程 shutdown，随后会断开
+            }
+        }
+    }
+    if (r->child == 0 && r->nreplicas > 0)
+        repl_start_sync(loop);
+    if (r->child > 0)
+        timeout = 10; // 等子进程结束
+
+    for (int i = r->nreplicas - 1; i >= 0; i--)
+    {
+        kvs_conn_t *c = r->replicas[i];
+        if (c->repl == KVS_LINK_ONLINE && c->wbuf.len > 0)
+            conn_flush(loop, c);
+    }
+    return timeout;
+}
+
+// 非阻塞连接迁移目标，连接加入 epoll，连上后 conn_flush 发出排队的命令
+static int migrate_connect(kvs_loop_t *loop)
+{
+    kvs_cluster_t *cl = loop->cluster;
+    int fd = kvs_migrate_connect(cl->nodes[cl->migrate.node]);
+    if (fd < 0)
+        return -1;
+
+    kvs_conn_t *c = (kvs_conn_t *)calloc(1, sizeof(*c));
+    if (!c)
+    {
+        close(fd);
+        return -1;
+    }
+    c->fd = fd;
+    c->repl = KVS_LINK_MIGRATE;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+    {
+        close(fd);
+        conn_free(c);
+        return -1;
+    }
+    loop->migrate = c;
+    return 0;
+}
+
+// 每轮事件循环末尾调用：上一批确认后发下一批（失败的批次先重发），遍历完把 slot 交给目标
+// 只把命令放进连接的发送缓冲，回复由 migrate_on_reply 计数，不在这里等
+// @return: 建议的 epoll 超时（ms），-1 表示无需定时唤醒
+static int loop_cluster(kvs_loop_t *loop)
+{
+    kvs_cluster_t *cl = loop->cluster;
+    if (!cl || !cl->migrate.active)
+        return -1;
+
+    kvs_migrate_t *m = &cl->migrate;
+    uint64_t now = now_ms();
+    if (m->acks > 0)
+    {
+        if (now < loop->migrate_deadline)
+            return (int)(loop->migrate_deadline - now);
+        migrate_fail(loop, "target timed out");
+        return KVS_MIGRATE_RETRY_MS;
+    }
+    if (!loop->migrate)
+    {
+        if (now < m->retry_ms)
+            return (int)(m->retry_ms - now);
+        if (migrate_connect(loop) != 0)
+        {
+            migrate_fail(loop, "connect failed");
+            return KVS_MIGRATE_RETRY_MS;
+        }
+    }
+
+    int n = m->nkeys > 0 ? kvs_migrate_resend(cl, &loop->store)
+                         : kvs_migrate_collect(cl, &loop->store, KVS_MIGRATE_BATCH, KVS_MIGRATE_SCAN);
+    if (n == 0 && m->stage != KVS_MIGRATE_DONE)
+        return 0; // 本轮只扫到空槽位，下一轮继续
+    if (n == 0)
+    {
+        char line[64];
+        int len = snprintf(line, sizeof(line), "CLUSTER SETSLOT %d %d OWNED\n", m->lo, m->hi);
+        n = kvs_buf_append(&m->out, line, (size_t)len) == 0 ? 1 : -2;
+    }
+    if (n < 0 || kvs_buf_append(&loop->migrate->wbuf, m->out.data, m->out.len) != 0)
+    {
+        migrate_fail(loop, n == -1 ? "value unreadable" : "out of memory");
+        return KVS_MIGRATE_RETRY_MS;
+    }
+
+    m->acks = n;
+    loop->migrate_deadline = now + KVS_MIGRATE_TIMEOUT_MS;
+    conn_flush(loop, loop->migrate); // 还没连上时 send 返回 EAGAIN，之后由 EPOLLOUT 接着发
+    return KVS_MIGRATE_TIMEOUT_MS;
+}
+
+static void loop_run(kvs_loop_t *loop)
+{
+    struct epoll_event events[KVS_MAX_EVENTS];
+    int timeout = 0; // 第一轮不阻塞：从要立即发起到主的连接
+
+    for (;;)
+    {
+        int n = epoll_wait(loop->epfd, events, KVS_MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < n; i++)
+        {
+            void *ptr = events[i].data.ptr;
+
+            if (ptr == &loop->listenfd)
+            {
+                loop_accept(loop);
+                continue;
+            }
+            if (ptr == &loop->efd)
+            {
+                loop_on_notify(loop);
+                continue;
+            }
+
+            kvs_conn_t *c = (kvs_conn_t *)ptr;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                conn_close(loop, c);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && conn_flush(loop, c) < 0)
+                continue;
+            if (events[i].events & EPOLLIN)
+                conn_on_read(loop, c);
+        }
+
+        // 队列满的消息没发完就不能阻塞等待
+        timeout = (loop->group && loop_flush_overflow(loop)) ? 1 : -1;
+
+        int defrag_timeout = loop_defrag(loop);
+        if (defrag_timeout >= 0 && (timeout < 0 || defrag_timeout < timeout))
+            timeout = defrag_timeout;
+
+        int vlog_timeout = loop_vlog(loop);
+        if (vlog_timeout >= 0 && (timeout < 0 || vlog_timeout < timeout))
+            timeout = vlog_timeout;
+
+        int lazy_timeout = loop_lazyfree();
+        if (lazy_timeout >= 0 && (timeout < 0 || lazy_timeout < timeout))
+            timeout = lazy_timeout;
+
+        int repl_timeout = loop_repl(loop);
+        if (repl_timeout >= 0 && (timeout < 0 || repl_timeout < timeout))
+            timeout = repl_timeout;
+
+        int cluster_timeout = loop_cluster(loop);
+        if (cluster_timeout >= 0 && (timeout < 0 || cluster_timeout < timeout))
+            timeout = cluster_timeout;
+    }
+}
+
+static void *loop_thread(void *arg)
+{
+    kvs_loop_t *loop = (kvs_loop_t *)arg;
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu > 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(loop->id % ncpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    if (loop_init(loop) != 0)
+    {
+        fprintf(stderr, "loop %d init failed\n", loop->id);
+        exit(1);
+    }
+    loop_run(loop);
+    return NULL;
+}
+
+// 起 count 个 loop 线程组成一组；executor>=0 时该成员只执行命令，并使用全局单例引擎
+static int start_group(const kvs_config_t *cfg, int count, int executor)
+{
+    kvs_shard_group_t *group = (kvs_shard_group_t *)calloc(1, sizeof(*group));
+    kvs_loop_t *loops = (kvs_loop_t *)calloc(count, sizeof(kvs_loop_t));
+    if (!group || !loops || kvs_shard_group_create(group, count) != 0)
+    {
+        free(group);
+        free(loops);
+        return -2;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        loops[i].id = i;
+        loops[i].cfg = cfg;
+        loops[i].group = group;
+        loops[i].executor = executor;
+        if (i == executor)
+        {
+            loops[i].store.array = &global_array;
+            loops[i].store.rbtree = &global_rbtree;
+            loops[i].store.hash = &global_hash;
+        }
+        if (pthread_create(&loops[i].tid, NULL, loop_thread, &loops[i]) != 0)
+            return -3;
+    }
+
+    for (int i = 0; i < count; i++)
+        pthread_join(loops[i].tid, NULL);
+
+    kvs_shard_group_destory(group);
+    free(group);
+    free(loops);
+    return 0;
+}
+
+int kvs_reactor_start(const kvs_config_t *cfg)
+{
+    if (!cfg)
+        return -1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if ((cfg->shards > 1 || cfg->io_threads > 0) && cfg->replicaof_port > 0)
+        printf("reactor: replication requires shards 1 and io_threads 0, replicaof ignored\n");
+    if ((cfg->shards > 1 || cfg->io_threads > 0) && cfg->cluster)
+        printf("reactor: cluster requires shards 1 and io_threads 0, cluster ignored\n");
+
+    if (cfg->shards > 1)
+    {
+        int count = cfg->shards > KVS_MAX_SHARDS ? KVS_MAX_SHARDS : cfg->shards;
+        if (cfg->io_threads > 0)
+            printf("reactor: io_threads is ignored in shard mode\n");
+
+        printf("reactor: %d shards listening on %s:%d\n", count, cfg->bind_ip, cfg->port);
+        return start_group(cfg, count, -1);
+    }
+
+    if (cfg->io_threads > 0)
+    {
+        // 最后一个成员是执行线程
+        int count = cfg->io_threads + 1 > KVS_MAX_SHARDS ? KVS_MAX_SHARDS : cfg->io_threads + 1;
+
+        printf("reactor: %d io threads + 1 executor listening on %s:%d\n", count - 1, cfg->bind_ip, cfg->port);
+        return start_group(cfg, count, count - 1);
+    }
+
+    kvs_loop_t *loop = (kvs_loop_t *)calloc(1, sizeof(*loop));
+    if (!loop)
+        return -2;
+    loop->cfg = cfg;
+    loop->efd = -1;
+    loop->executor = -1;
+
+    // 单 loop 直接使用全局单例
+    loop->store.array = &global_array;
+    loop->store.rbtree = &global_rbtree;
+    loop->store.hash = &global_hash;
+
+    if (loop_init(loop) != 0)
+        return -1;
+
+    printf("reactor: listening on %s:%d\n", cfg->bind_ip, cfg->port);
+    loop_run(loop);
+    return 0;
+}
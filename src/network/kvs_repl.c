@@ -0,0 +1,260 @@
+#include "network/kvs_repl.h"
+#include "engine/kvs_vlog.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+
+int kvs_repl_backlog_create(kvs_repl_backlog_t *backlog, size_t size)
+{
+    if (!backlog || size == 0)
+        return -1;
+
+    memset(backlog, 0, sizeof(*backlog));
+    backlog->buf = (char *)malloc(size);
+    if (!backlog->buf)
+        return -2;
+    backlog->size = size;
+    return 0;
+}
+
+void kvs_repl_backlog_destory(kvs_repl_backlog_t *backlog)
+{
+    if (!backlog)
+        return;
+    free(backlog->buf);
+    memset(backlog, 0, sizeof(*backlog));
+}
+
+void kvs_repl_backlog_feed(kvs_repl_backlog_t *backlog, const char *data, size_t len)
+{
+    backlog->offset += len;
+
+    // 比整个缓冲区还长：只留最后 size 字节
+    if (len > backlog->size)
+    {
+        data += len - backlog->size;
+        len = backlog->size;
+    }
+
+    while (len > 0)
+    {
+        size_t n = backlog->size - backlog->head;
+        if (n > len)
+            n = len;
+        memcpy(backlog->buf + backlog->head, data, n);
+        backlog->head = (backlog->head + n) % backlog->size;
+        backlog->len = backlog->len + n > backlog->size ? backlog->size : backlog->len + n;
+        data += n;
+        len -= n;
+    }
+}
+
+uint64_t kvs_repl_backlog_first(kvs_repl_backlog_t *backlog)
+{
+    return backlog->offset - backlog->len;
+}
+
+int kvs_repl_backlog_continue(kvs_repl_backlog_t *backlog, const char *id, const char *want_id, uint64_t offset,
+                              kvs_buf_t *out)
+{
+    if (!backlog || !backlog->buf || !id || !want_id || strcmp(id, want_id) != 0)
+        return -1;
+    if (offset < kvs_repl_backlog_first(backlog) || offset > backlog->offset)
+        return -1;
+
+    size_t missing = (size_t)(backlog->offset - offset);
+    char line[KVS_REPL_ID_LEN + 32];
+    int n = snprintf(line, sizeof(line), "+CONTINUE %s\r\n", id);
+    if (kvs_buf_reserve(out, (size_t)n + missing) != 0)
+        return -2;
+    kvs_buf_append(out, line, (size_t)n);
+
+    // head 往回 missing 字节即为 offset 所在位置
+    size_t pos = (backlog->head + backlog->size - missing) % backlog->size;
+    size_t first = backlog->size - pos < missing ? backlog->size - pos : missing;
+    kvs_buf_append(out, backlog->buf + pos, first);
+    kvs_buf_append(out, backlog->buf, missing - first);
+    return 0;
+}
+
+void kvs_repl_new_id(char id[KVS_REPL_ID_LEN + 1])
+{
+    static const char hex[] = "0123456789abcdef";
+    unsigned char raw[KVS_REPL_ID_LEN / 2];
+
+    if (getrandom(raw, sizeof(raw), 0) != (ssize_t)sizeof(raw))
+    {
+        // 取不到随机数时退回时间 + pid，只要求与上次启动不同
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        srand((unsigned)(ts.tv_nsec ^ ts.tv_sec ^ getpid()));
+        for (size_t i = 0; i < sizeof(raw); i++)
+            raw[i] = (unsigned char)rand();
+    }
+
+    for (size_t i = 0; i < sizeof(raw); i++)
+    {
+        id[i * 2] = hex[raw[i] >> 4];
+        id[i * 2 + 1] = hex[raw[i] & 0xf];
+    }
+    id[KVS_REPL_ID_LEN] = '\0';
+}
+
+int kvs_repl_format(kvs_buf_t *out, char **tokens, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (i > 0 && kvs_buf_append(out, " ", 1) != 0)
+            return -2;
+        if (kvs_buf_append(out, tokens[i], strlen(tokens[i])) != 0)
+            return -2;
+    }
+    return kvs_buf_append(out, "\n", 1);
+}
+
+// 全量同步的写端：攒满一块后依次写给每个还活着的 fd
+typedef struct snapshot_writer_s
+{
+    char buf[KVS_REPL_CHUNK];
+    size_t len;
+    const int *fds;
+    int nfds;
+    int alive[KVS_REPL_MAX_REPLICAS];
+    const char *cmd;     // 当前引擎的写入命令
+    const char *restore; // 压缩过的值用的写入命令
+} snapshot_writer_t;
+
+static int write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w > 0)
+        {
+            p += w;
+            n -= (size_t)w;
+            continue;
+        }
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+            if (poll(&pfd, 1, KVS_REPL_TIMEOUT_MS) > 0)
+                continue;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+static void snapshot_write(snapshot_writer_t *w, const char *p, size_t n)
+{
+    for (int i = 0; i < w->nfds; i++)
+    {
+        if (w->alive[i] && write_all(w->fds[i], p, n) != 0)
+        {
+            w->alive[i] = 0;
+            shutdown(w->fds[i], SHUT_RDWR);
+        }
+    }
+}
+
+static void snapshot_flush(snapshot_writer_t *w)
+{
+    snapshot_write(w, w->buf, w->len);
+    w->len = 0;
+}
+
+static void snapshot_put(snapshot_writer_t *w, const char *p, size_t n)
+{
+    if (w->len + n > sizeof(w->buf))
+        snapshot_flush(w);
+    if (n > sizeof(w->buf))
+    {
+        snapshot_write(w, p, n); // 超过一块的大 value 直接写
+        return;
+    }
+    memcpy(w->buf + w->len, p, n);
+    w->len += n;
+}
+
+static void snapshot_entry(void *arg, const char *key, kvs_value_t *v)
+{
+    snapshot_writer_t *w = (snapshot_writer_t *)arg;
+
+    // 压缩过的值原样发送，对端收到后不必再压缩
+    const char *cmd = w->cmd;
+    char *value = kvs_value_packed(v);
+    if (value)
+        cmd = w->restore;
+    else
+        value = kvs_value_str(v);
+    if (!value)
+    {
+        // 读不出来的值不能当空串同步过去：整个快照作废，从稍后重新全量同步
+        for (int i = 0; i < w->nfds; i++)
+        {
+            if (w->alive[i])
+                shutdown(w->fds[i], SHUT_RDWR);
+            w->alive[i] = 0;
+        }
+        return;
+    }
+
+    snapshot_put(w, cmd, strlen(cmd));
+    snapshot_put(w, " ", 1);
+    snapshot_put(w, key, strlen(key));
+    snapshot_put(w, " ", 1);
+    snapshot_put(w, value, strlen(value));
+    snapshot_put(w, "\n", 1);
+    kvs_value_scratch_reset(); // value log 的临时区是 mmap 的，子进程里也可以用
+}
+
+int kvs_repl_snapshot(kvs_store_t *store, const char *id, uint64_t offset, const int *fds, int nfds)
+{
+    if (!store || !id || !fds || nfds <= 0 || nfds > KVS_REPL_MAX_REPLICAS)
+        return 0;
+
+    // 64KB 的缓冲区放在栈上：子进程不碰分配器（fork 时别的线程可能正持有 malloc 的锁）
+    snapshot_writer_t w;
+    w.len = 0;
+    w.fds = fds;
+    w.nfds = nfds;
+    for (int i = 0; i < nfds; i++)
+        w.alive[i] = 1;
+
+    char line[KVS_REPL_ID_LEN + 64];
+    int n = snprintf(line, sizeof(line), "+FULLRESYNC %s %" PRIu64 "\r\nFLUSH SYNC\n", id, offset);
+    snapshot_put(&w, line, (size_t)n);
+
+    w.cmd = "UPSERT";
+    w.restore = "RESTORE";
+    kvs_array_foreach(store->array, snapshot_entry, &w);
+    w.cmd = "RUPSERT";
+    w.restore = "RRESTORE";
+    kvs_rbtree_foreach(store->rbtree, snapshot_entry, &w);
+    w.cmd = "HUPSERT";
+    w.restore = "HRESTORE";
+    unsigned long cursor = 0;
+    do
+    {
+        cursor = kvs_hash_values(store->hash, cursor, snapshot_entry, &w);
+    } while (cursor != 0);
+
+    snapshot_put(&w, "+SYNCED\n", 8);
+    snapshot_flush(&w);
+
+    int ok = 0;
+    for (int i = 0; i < nfds; i++)
+        ok += w.alive[i];
+    return ok;
+}
@@ -0,0 +1,66 @@
+#include "network/kvs_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+int kvs_ring_create(kvs_ring_t *ring, size_t size)
+{
+    if (!ring || size == 0)
+        return -1;
+
+    size_t cap = 1;
+    while (cap < size)
+        cap <<= 1;
+
+    // 队列节点跨线程使用，直接用系统 malloc，不走 kvs_malloc（mypool 是线程私有的）
+    ring->slots = (void **)calloc(cap, sizeof(void *));
+    if (!ring->slots)
+        return -2;
+
+    ring->mask = cap - 1;
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    return 0;
+}
+
+void kvs_ring_destory(kvs_ring_t *ring)
+{
+    if (!ring)
+        return;
+    free(ring->slots);
+    ring->slots = NULL;
+    ring->mask = 0;
+}
+
+int kvs_ring_push(kvs_ring_t *ring, void *item)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail > ring->mask)
+        return 1; // full
+
+    ring->slots[head & ring->mask] = item;
+    // release：保证 slot 写入对消费者可见后再发布 head
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 0;
+}
+
+void *kvs_ring_pop(kvs_ring_t *ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (tail == head)
+        return NULL; // empty
+
+    void *item = ring->slots[tail & ring->mask];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return item;
+}
+
+int kvs_ring_empty(kvs_ring_t *ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return tail == head;
+}
@@ -0,0 +1,170 @@
+#include "network/kvs_shard.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+int kvs_shard_group_create(kvs_shard_group_t *group, int count)
+{
+    if (!group || count <= 0 || count > KVS_MAX_SHARDS)
+        return -1;
+
+    memset(group, 0, sizeof(*group));
+
+    group->rings = (kvs_ring_t *)aligned_alloc(KVS_CACHELINE, sizeof(kvs_ring_t) * count * count);
+    group->efds = (int *)malloc(sizeof(int) * count);
+    if (!group->rings || !group->efds)
+    {
+        free(group->rings);
+        free(group->efds);
+        return -2;
+    }
+
+    for (int i = 0; i < count * count; i++)
+    {
+        if (kvs_ring_create(&group->rings[i], KVS_SHARD_RING_SIZE) != 0)
+        {
+            while (i-- > 0)
+                kvs_ring_destory(&group->rings[i]);
+            free(group->rings);
+            free(group->efds);
+            return -2;
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        group->efds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (group->efds[i] < 0)
+        {
+            while (i-- > 0)
+                close(group->efds[i]);
+            for (int j = 0; j < count * count; j++)
+                kvs_ring_destory(&group->rings[j]);
+            free(group->rings);
+            free(group->efds);
+            return -3;
+        }
+    }
+
+    group->count = count;
+    return 0;
+}
+
+void kvs_shard_group_destory(kvs_shard_group_t *group)
+{
+    if (!group || !group->rings)
+        return;
+
+    for (int i = 0; i < group->count * group->count; i++)
+    {
+        kvs_shard_msg_t *msg;
+        while ((msg = kvs_ring_pop(&group->rings[i])) != NULL)
+            kvs_shard_msg_free(msg);
+        kvs_ring_destory(&group->rings[i]);
+    }
+    for (int i = 0; i < group->count; i++)
+        close(group->efds[i]);
+
+    free(group->rings);
+    free(group->efds);
+    group->rings = NULL;
+    group->efds = NULL;
+    group->count = 0;
+}
+
+// FNV-1a：与 kvs_hash 的桶函数无关，只用于决定 key 的属主 shard
+int kvs_shard_owner(kvs_shard_group_t *group, const char *key)
+{
+    if (!group || group->count <= 1 || !key)
+        return 0;
+
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return (int)(h % (uint32_t)group->count);
+}
+
+int kvs_shard_send(kvs_shard_group_t *group, int from, int to, kvs_shard_msg_t *msg)
+{
+    return kvs_ring_push(&group->rings[from * group->count + to], msg);
+}
+
+kvs_shard_msg_t *kvs_shard_recv(kvs_shard_group_t *group, int self, int from)
+{
+    return (kvs_shard_msg_t *)kvs_ring_pop(&group->rings[from * group->count + self]);
+}
+
+void kvs_shard_notify(kvs_shard_group_t *group, int to)
+{
+    uint64_t one = 1;
+    ssize_t n = write(group->efds[to], &one, sizeof(one));
+    (void)n; // EAGAIN 说明计数器已非零，对方必然会被唤醒
+}
+
+void kvs_shard_drain_notify(kvs_shard_group_t *group, int self)
+{
+    uint64_t cnt;
+    ssize_t n = read(group->efds[self], &cnt, sizeof(cnt));
+    (void)n;
+}
+
+int kvs_shard_msg_request(kvs_shard_msg_t *msg, int from, void *conn, char **tokens, int count)
+{
+    size_t len = 0;
+    for (int i = 0; i < count; i++)
+        len += strlen(tokens[i]) + 1;
+
+    if (len > msg->args_cap || !msg->args)
+    {
+        size_t cap = len < 64 ? 64 : len;
+        char *args = (char *)realloc(msg->args, cap);
+        if (!args)
+            return -2;
+        msg->args = args;
+        msg->args_cap = cap;
+    }
+
+    char *p = msg->args;
+    for (int i = 0; i < count; i++)
+    {
+        size_t n = strlen(tokens[i]) + 1;
+        memcpy(p, tokens[i], n);
+        p += n;
+    }
+
+    msg->type = KVS_SHARD_REQ;
+    msg->from = from;
+    msg->conn = conn;
+    msg->argc = count;
+    msg->reply.len = 0;
+    msg->broadcast = 0;
+    msg->next = NULL;
+    return 0;
+}
+
+int kvs_shard_msg_tokens(kvs_shard_msg_t *msg, char **tokens, int max)
+{
+    char *p = msg->args;
+    int count = msg->argc < max ? msg->argc : max;
+
+    for (int i = 0; i < count; i++)
+    {
+        tokens[i] = p;
+        p += strlen(p) + 1;
+    }
+    return count;
+}
+
+void kvs_shard_msg_free(kvs_shard_msg_t *msg)
+{
+    if (!msg)
+        return;
+    free(msg->args);
+    kvs_buf_free(&msg->reply);
+    free(msg);
+}
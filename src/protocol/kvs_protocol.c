@@ -0,0 +1,914 @@
+#include "protocol/kvs_protocol.h"
+#include "stats/kvs_stats.h"
+#include "engine/kvs_lazyfree.h"
+#include "engine/kvs_simd.h"
+#include "engine/kvs_vlog.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KVS_ENGINE_ARRAY 0
+#define KVS_ENGINE_RBTREE 1
+#define KVS_ENGINE_HASH 2
+
+#define KVS_OP_SET 0
+#define KVS_OP_GET 1
+#define KVS_OP_DEL 2
+#define KVS_OP_MOD 3
+#define KVS_OP_EXIST 4
+#define KVS_OP_UPSERT 5
+#define KVS_OP_GETSET 6
+#define KVS_OP_CAS 7
+#define KVS_OP_INCR 8
+#define KVS_OP_DECR 9
+#define KVS_OP_INCRBY 10
+#define KVS_OP_RESTORE 11
+
+#define KVS_OPS_PER_ENGINE 12
+#define KVS_ENGINE_COUNT 3
+
+static const char *command[] = {
+    "SET", "GET", "DEL", "MOD", "EXIST", "UPSERT", "GETSET", "CAS", "INCR", "DECR", "INCRBY", "RESTORE",
+    "RSET", "RGET", "RDEL", "RMOD", "REXIST", "RUPSERT", "RGETSET", "RCAS", "RINCR", "RDECR", "RINCRBY", "RRESTORE",
+    "HSET", "HGET", "HDEL", "HMOD", "HEXIST", "HUPSERT", "HGETSET", "HCAS", "HINCR", "HDECR", "HINCRBY", "HRESTORE",
+    "STATS", "MEMORY", "FLUSH", "SCAN", "PSYNC", "ROLE", "CLUSTER",
+    "MGET", "MSET", "RMGET", "RMSET", "HMGET", "HMSET"};
+
+static const char *engine_name[] = {"array", "rbtree", "hash"};
+
+// 每个 op 需要的参数个数（含命令本身）
+static const int op_argc[] = {3, 2, 2, 3, 2, 3, 3, 4, 2, 2, 3, 3};
+
+int kvs_buf_reserve(kvs_buf_t *buf, size_t extra)
+{
+    if (!buf)
+        return -1;
+
+    if (buf->len + extra > buf->cap)
+    {
+        size_t cap = buf->cap ? buf->cap : 256;
+        while (cap < buf->len + extra)
+            cap <<= 1;
+
+        char *p = realloc(buf->data, cap);
+        if (!p)
+            return -2;
+        buf->data = p;
+        buf->cap = cap;
+    }
+    return 0;
+}
+
+int kvs_buf_append(kvs_buf_t *buf, const char *data, size_t len)
+{
+    if (kvs_buf_reserve(buf, len) != 0)
+        return -2;
+
+    if (len)
+        memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+void kvs_buf_consume(kvs_buf_t *buf, size_t n)
+{
+    if (!buf)
+        return;
+    if (n >= buf->len)
+    {
+        buf->len = 0;
+        return;
+    }
+    memmove(buf->data, buf->data + n, buf->len - n);
+    buf->len -= n;
+}
+
+void kvs_buf_free(kvs_buf_t *buf)
+{
+    if (!buf)
+        return;
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+int kvs_store_create(kvs_store_t *store)
+{
+    if (!store || !store->array || !store->rbtree || !store->hash)
+        return -1;
+
+    if (kvs_array_create(store->array) != 0)
+        return -1;
+    if (kvs_rbtree_create(store->rbtree) != 0)
+    {
+        kvs_array_destory(store->array);
+        return -1;
+    }
+    if (kvs_hash_create(store->hash) != 0)
+    {
+        kvs_rbtree_destory(store->rbtree);
+        kvs_array_destory(store->array);
+        return -1;
+    }
+    return 0;
+}
+
+void kvs_store_destory(kvs_store_t *store)
+{
+    if (!store)
+        return;
+    kvs_array_destory(store->array);
+    kvs_rbtree_destory(store->rbtree);
+    kvs_hash_destory(store->hash);
+}
+
+int kvs_store_flush(kvs_store_t *store, int lazy)
+{
+    if (!store)
+        return -1;
+
+    if (lazy)
+    {
+        if (kvs_lazyfree_array(store->array) != 0 || kvs_lazyfree_rbtree(store->rbtree) != 0 ||
+            kvs_lazyfree_hash(store->hash) != 0)
+            return -2;
+        return 0;
+    }
+
+    kvs_store_destory(store);
+    return kvs_store_create(store);
+}
+
+int kvs_protocol_split(char *line, char **tokens, int max)
+{
+    if (!line || !tokens || max <= 0)
+        return 0;
+
+    int count = 0;
+    char *p = line;
+
+    while (*p && count < max)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\r')
+            *p++ = '\0';
+        if (*p == '\0')
+            break;
+
+        tokens[count++] = p;
+        p = kvs_simd_delim(p);
+    }
+
+    return count;
+}
+
+char **kvs_protocol_tokenize(struct mp_pool_s *arena, char *line, int *count)
+{
+    if (!arena || !line || !count)
+        return NULL;
+
+    // 分隔符个数 + 1 是 token 数的上界
+    int max = 1 + (int)kvs_simd_count_delim(line);
+
+    char **tokens = (char **)mp_alloc(arena, sizeof(char *) * (size_t)max);
+    if (!tokens)
+        return NULL;
+
+    *count = kvs_protocol_split(line, tokens, max);
+    return tokens;
+}
+
+void kvs_protocol_join(char *begin, char *end)
+{
+    for (char *p = begin; p < end; p++)
+    {
+        if (*p == '\0')
+            *p = ' ';
+    }
+}
+
+int kvs_protocol_command(const char *name)
+{
+    if (!name)
+        return -1;
+
+    for (int cmd = KVS_CMD_START; cmd < KVS_CMD_COUNT; cmd++)
+    {
+        if (strcmp(name, command[cmd]) == 0)
+            return cmd;
+    }
+    return -1;
+}
+
+const char *kvs_protocol_key(char **tokens, int count)
+{
+    if (count < 2)
+        return NULL;
+    int cmd = kvs_protocol_command(tokens[0]);
+    if (cmd < 0 || cmd > KVS_CMD_ENGINE_LAST)
+        return NULL;
+    return tokens[1];
+}
+
+int kvs_protocol_broadcast(char **tokens, int count)
+{
+    if (count < 1)
+        return 0;
+    return kvs_protocol_command(tokens[0]) == KVS_CMD_FLUSH;
+}
+
+int kvs_protocol_batch(char **tokens, int count)
+{
+    if (count < 1)
+        return 0;
+    int cmd = kvs_protocol_command(tokens[0]);
+    if (cmd < KVS_CMD_MGET)
+        return 0;
+    return (cmd - KVS_CMD_MGET) % 2 ? 2 : 1;
+}
+
+int kvs_protocol_write(char **tokens, int count)
+{
+    if (count < 1)
+        return 0;
+    int cmd = kvs_protocol_command(tokens[0]);
+    if (cmd < 0)
+        return 0;
+    if (cmd > KVS_CMD_ENGINE_LAST)
+        return cmd == KVS_CMD_FLUSH || (cmd >= KVS_CMD_MGET && (cmd - KVS_CMD_MGET) % 2);
+
+    switch (cmd % KVS_OPS_PER_ENGINE)
+    {
+    case KVS_OP_GET:
+    case KVS_OP_EXIST:
+        return 0;
+    }
+    return 1;
+}
+
+#define KVS_SCAN_COUNT 10 // SCAN 未指定 COUNT 时每次大约返回的 key 数
+
+// 解析十进制的 SCAN 游标；@return: <0, 不是合法游标
+static int parse_cursor(const char *s, unsigned long *out)
+{
+    if (!s || *s < '0' || *s > '9')
+        return -1;
+    char *end;
+    errno = 0;
+    *out = strtoul(s, &end, 10);
+    return (*end || errno) ? -1 : 0;
+}
+
+int kvs_protocol_cursor_owner(char **tokens, int count, int nshards)
+{
+    unsigned long cursor;
+    if (count < 2 || nshards <= 1 || kvs_protocol_command(tokens[0]) != KVS_CMD_SCAN)
+        return -1;
+    if (parse_cursor(tokens[1], &cursor) != 0)
+        return -1;
+    return (int)(cursor % (unsigned long)nshards);
+}
+
+// glob：* 任意串，? 任意字符，[abc] [a-z] [^a]，\ 转义
+static int glob_match(const char *p, const char *s)
+{
+    const char *star = NULL, *retry = NULL;
+
+    while (*s)
+    {
+        int ok = 0;
+        const char *next = p + 1;
+
+        switch (*p)
+        {
+        case '*':
+            star = p++;
+            retry = s;
+            continue;
+        case '?':
+            ok = 1;
+            break;
+        case '[':
+        {
+            const char *q = p + 1;
+            int neg = (*q == '^' || *q == '!');
+            if (neg)
+                q++;
+            int hit = 0;
+            // 第一个 ] 当作普通字符
+            do
+            {
+                if (*q == '\\' && q[1])
+                    q++;
+                if (q[1] == '-' && q[2] && q[2] != ']')
+                {
+                    if ((unsigned char)*s >= (unsigned char)*q && (unsigned char)*s <= (unsigned char)q[2])
+                        hit = 1;
+                    q += 3;
+                }
+                else
+                {
+                    if (*q == *s)
+                        hit = 1;
+                    q++;
+                }
+            } while (*q && *q != ']');
+            if (*q != ']')
+                return 0; // 缺少 ]：模式非法
+            ok = hit != neg;
+            next = q + 1;
+            break;
+        }
+        case '\\':
+            if (p[1])
+                next = ++p + 1;
+            /* fall through */
+        default:
+            ok = (*p == *s);
+            break;
+        }
+
+        if (ok)
+        {
+            p = next;
+            s++;
+        }
+        else if (star)
+        {
+            // 回到最近的 *，让它多吞一个字符
+            p = star + 1;
+            s = ++retry;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    while (*p == '*')
+        p++;
+    return *p == '\0';
+}
+
+static int engine_set(kvs_store_t *store, int engine, char *key, char *value)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_set(store->array, key, value);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_set(store->rbtree, key, value);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_set(store->hash, key, value);
+    }
+    return -1;
+}
+
+static char *engine_get(kvs_store_t *store, int engine, char *key)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_get(store->array, key);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_get(store->rbtree, key);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_get(store->hash, key);
+    }
+    return NULL;
+}
+
+static int engine_del(kvs_store_t *store, int engine, char *key)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_del(store->array, key);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_del(store->rbtree, key);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_del(store->hash, key);
+    }
+    return -1;
+}
+
+static int engine_mod(kvs_store_t *store, int engine, char *key, char *value)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_mod(store->array, key, value);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_mod(store->rbtree, key, value);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_mod(store->hash, key, value);
+    }
+    return -1;
+}
+
+static int engine_exist(kvs_store_t *store, int engine, char *key)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_exist(store->array, key);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_exist(store->rbtree, key);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_exist(store->hash, key);
+    }
+    return -1;
+}
+
+static int engine_upsert(kvs_store_t *store, int engine, char *key, char *value)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_upsert(store->array, key, value);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_upsert(store->rbtree, key, value);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_upsert(store->hash, key, value);
+    }
+    return -1;
+}
+
+static int engine_getset(kvs_store_t *store, int engine, char *key, char *value, kvs_value_t *old)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_getset(store->array, key, value, old);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_getset(store->rbtree, key, value, old);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_getset(store->hash, key, value, old);
+    }
+    return -1;
+}
+
+static int engine_cas(kvs_store_t *store, int engine, char *key, char *expect, char *value)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_cas(store->array, key, expect, value);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_cas(store->rbtree, key, expect, value);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_cas(store->hash, key, expect, value);
+    }
+    return -1;
+}
+
+static int engine_incr(kvs_store_t *store, int engine, char *key, int64_t delta, int64_t *result)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        return kvs_array_incr(store->array, key, delta, result);
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_incr(store->rbtree, key, delta, result);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_incr(store->hash, key, delta, result);
+    }
+    return -1;
+}
+
+#define KVS_BATCH_CHUNK 64 // 批量命令每次交给引擎的 key 数，临时数组放在栈上
+
+static int engine_mget(kvs_store_t *store, int engine, char **keys, int n, char **values)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        // 线性查找，没有可以合并的访问
+        for (int i = 0; i < n; i++)
+            values[i] = kvs_array_get(store->array, keys[i]);
+        return 0;
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_mget(store->rbtree, keys, n, values);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_mget(store->hash, keys, n, values);
+    }
+    return -1;
+}
+
+static int engine_mset(kvs_store_t *store, int engine, char **keys, char **values, int n, int *results)
+{
+    switch (engine)
+    {
+    case KVS_ENGINE_ARRAY:
+        for (int i = 0; i < n; i++)
+            results[i] = kvs_array_set(store->array, keys[i], values[i]);
+        return 0;
+    case KVS_ENGINE_RBTREE:
+        return kvs_rbtree_mset(store->rbtree, keys, values, n, results);
+    case KVS_ENGINE_HASH:
+        return kvs_hash_mset(store->hash, keys, values, n, results);
+    }
+    return -1;
+}
+
+static int reply(kvs_buf_t *out, const char *msg)
+{
+    if (kvs_buf_append(out, msg, strlen(msg)) != 0)
+        return -2;
+    return kvs_buf_append(out, "\r\n", 2);
+}
+
+// 直方图槽位即命令编号；引擎的直方图在查询时由它的各个命令合并得到，记录路径只写一次
+static int append_summary(kvs_buf_t *out, const char *kind, const char *name, int first_slot, int nslots)
+{
+    kvs_hist_t hist;
+    kvs_hist_summary_t sum;
+    char line[256];
+
+    memset(&hist, 0, sizeof(hist));
+    for (int slot = first_slot; slot < first_slot + nslots; slot++)
+        kvs_stats_merge(slot, &hist);
+    if (hist.count == 0)
+        return 0;
+    kvs_stats_summary(&hist, &sum);
+
+    int n = snprintf(line, sizeof(line),
+                     " %s.%s count=%" PRIu64 " p50=%" PRIu64 " p99=%" PRIu64 " p999=%" PRIu64 " max=%" PRIu64,
+                     kind, name, sum.count, sum.p50, sum.p99, sum.p999, sum.max);
+    return kvs_buf_append(out, line, (size_t)n);
+}
+
+// STATS：一行输出所有非空直方图，单位 ns；STATS RESET：清零
+static int execute_stats(char **tokens, int count, kvs_buf_t *out)
+{
+    if (count == 2 && strcmp(tokens[1], "RESET") == 0)
+    {
+        kvs_stats_reset();
+        return reply(out, "OK");
+    }
+    if (count != 1)
+        return reply(out, "ERROR wrong number of arguments");
+
+    if (kvs_buf_append(out, "STATS", 5) != 0)
+        return -2;
+    for (int cmd = KVS_CMD_START; cmd <= KVS_CMD_ENGINE_LAST; cmd++)
+    {
+        if (append_summary(out, "cmd", command[cmd], cmd, 1) != 0)
+            return -2;
+    }
+    for (int cmd = KVS_CMD_MGET; cmd < KVS_CMD_COUNT; cmd++)
+    {
+        if (append_summary(out, "cmd", command[cmd], cmd, 1) != 0)
+            return -2;
+    }
+    for (int engine = 0; engine < KVS_ENGINE_COUNT; engine++)
+    {
+        if (append_summary(out, "engine", engine_name[engine], engine * KVS_OPS_PER_ENGINE, KVS_OPS_PER_ENGINE) != 0)
+            return -2;
+    }
+    return kvs_buf_append(out, "\r\n", 2);
+}
+
+// MEMORY：一行输出分配器统计；live.N 为申请大小 <=N 字节的存活对象数，只列非零级
+static int execute_memory(int count, kvs_buf_t *out)
+{
+    if (count != 1)
+        return reply(out, "ERROR wrong number of arguments");
+
+    kvs_alloc_stats_t st;
+    kvs_alloc_stats(&st);
+    long rss = kvs_alloc_rss();
+
+    char line[512];
+    int n = snprintf(line, sizeof(line),
+                     "MEMORY allocator=%s requested=%" PRId64 " reserved=%" PRId64 " fragmentation=%.3f"
+                     " rss=%ld rss_ratio=%.3f mallocs=%" PRIu64 " frees=%" PRIu64
+                     " pool_nodes=%" PRIu64 " pool_large=%" PRIu64 " pool_abandoned=%" PRId64
+                     " lazyfree_pending=%" PRId64,
+                     kvs_alloc_name(), st.requested, st.reserved, st.fragmentation,
+                     rss, st.requested > 0 ? (double)rss / (double)st.requested : 0.0,
+                     st.malloc_calls, st.free_calls, st.pool_nodes, st.pool_large, st.pool_abandoned,
+                     kvs_lazyfree_pending());
+    if (kvs_buf_append(out, line, (size_t)n) != 0)
+        return -2;
+
+    // 本线程绑定了 value log 时附上它的占用
+    if (kvs_vlog_current)
+    {
+        kvs_vlog_stats_t vs;
+        kvs_vlog_stats(kvs_vlog_current, &vs);
+        n = snprintf(line, sizeof(line), " vlog_disk=%" PRIu64 " vlog_live=%" PRId64 " vlog_segments=%d",
+                     vs.disk, vs.live, vs.segments);
+        if (kvs_buf_append(out, line, (size_t)n) != 0)
+            return -2;
+    }
+
+    for (int cls = 0; cls < KVS_ALLOC_CLASSES; cls++)
+    {
+        if (st.live[cls] == 0)
+            continue;
+        n = snprintf(line, sizeof(line), " live.%zu=%" PRId64, kvs_alloc_class_size(cls), st.live[cls]);
+        if (kvs_buf_append(out, line, (size_t)n) != 0)
+            return -2;
+    }
+    return kvs_buf_append(out, "\r\n", 2);
+}
+
+// FLUSH [SYNC|ASYNC]：不指定时按 lazyfree 配置
+static int execute_flush(kvs_store_t *store, char **tokens, int count, kvs_buf_t *out)
+{
+    int lazy = kvs_lazyfree_enabled();
+    if (count == 2 && strcmp(tokens[1], "ASYNC") == 0)
+        lazy = 1;
+    else if (count == 2 && strcmp(tokens[1], "SYNC") == 0)
+        lazy = 0;
+    else if (count != 1)
+        return reply(out, "ERROR wrong number of arguments");
+
+    return reply(out, kvs_store_flush(store, lazy) == 0 ? "OK" : "ERROR");
+}
+
+typedef struct scan_ctx_s
+{
+    const char *pattern;
+    kvs_buf_t keys;
+    long found;
+    int err;
+} scan_ctx_t;
+
+static void scan_collect(void *arg, const char *key, const char *value)
+{
+    scan_ctx_t *ctx = (scan_ctx_t *)arg;
+    (void)value;
+
+    if (ctx->pattern && !glob_match(ctx->pattern, key))
+        return;
+    if (kvs_buf_append(&ctx->keys, " ", 1) != 0 || kvs_buf_append(&ctx->keys, key, strlen(key)) != 0)
+        ctx->err = 1;
+    ctx->found++;
+}
+
+// SCAN cursor [MATCH glob] [COUNT n]：COUNT 只是提示，每次最多访问 n*10 个桶
+// 分 shard 时游标 = 桶游标 * nshards + shard，本 shard 走完后游标指向下一个 shard 的开头
+static int execute_scan(kvs_store_t *store, char **tokens, int count, kvs_buf_t *out)
+{
+    if (count < 2 || count % 2 != 0)
+        return reply(out, "ERROR wrong number of arguments");
+
+    unsigned long cursor;
+    if (parse_cursor(tokens[1], &cursor) != 0)
+        return reply(out, "ERROR invalid cursor");
+
+    scan_ctx_t ctx = {NULL, {0}, 0, 0};
+    long hint = KVS_SCAN_COUNT;
+    for (int i = 2; i < count; i += 2)
+    {
+        if (strcmp(tokens[i], "MATCH") == 0)
+        {
+            ctx.pattern = strcmp(tokens[i + 1], "*") == 0 ? NULL : tokens[i + 1];
+        }
+        else if (strcmp(tokens[i], "COUNT") == 0)
+        {
+            char *end;
+            hint = strtol(tokens[i + 1], &end, 10);
+            if (*end || hint <= 0 || hint > 1000000)
+                return reply(out, "ERROR invalid count");
+        }
+        else
+        {
+            return reply(out, "ERROR syntax error");
+        }
+    }
+
+    unsigned long n = store->nshards > 1 ? (unsigned long)store->nshards : 1;
+    unsigned long shard = cursor % n;
+    unsigned long v = cursor / n;
+
+    // 空桶也算工作量：连续空桶很多时提前返回，客户端拿着游标接着扫
+    long budget = hint * 10;
+    do
+    {
+        v = kvs_hash_scan(store->hash, v, scan_collect, &ctx);
+    } while (v != 0 && ctx.found < hint && --budget > 0);
+
+    unsigned long next;
+    if (v != 0)
+        next = v * n + shard;
+    else
+        next = shard + 1 < n ? shard + 1 : 0;
+
+    char head[48];
+    int len = snprintf(head, sizeof(head), "SCAN %lu", next);
+    int ret = -2;
+    if (!ctx.err && kvs_buf_append(out, head, (size_t)len) == 0 &&
+        kvs_buf_append(out, ctx.keys.data, ctx.keys.len) == 0)
+        ret = kvs_buf_append(out, "\r\n", 2);
+    kvs_buf_free(&ctx.keys);
+    return ret;
+}
+
+// MGET 某块有值读不出来时，逐个重查为 NULL 的 key，区分读不出来和不存在
+static int batch_unreadable(kvs_store_t *store, int engine, char *key)
+{
+    kvs_value_unreadable = 0;
+    engine_get(store, engine, key);
+    return kvs_value_unreadable;
+}
+
+// MGET/MSET：按块交给引擎的批量接口，每个 key 一行回复；直方图记录整条命令的引擎耗时
+static int execute_batch(kvs_store_t *store, int cmd, char **tokens, int count, kvs_buf_t *out)
+{
+    int engine = (cmd - KVS_CMD_MGET) / 2;
+    int stride = kvs_protocol_batch(tokens, count);
+    if (count < 1 + stride || (count - 1) % stride != 0)
+        return reply(out, "ERROR wrong number of arguments");
+
+    char *keys[KVS_BATCH_CHUNK];
+    char *values[KVS_BATCH_CHUNK];
+    int results[KVS_BATCH_CHUNK];
+    uint64_t elapsed = 0;
+
+    int n = (count - 1) / stride;
+    for (int base = 0; base < n; base += KVS_BATCH_CHUNK)
+    {
+        int m = n - base < KVS_BATCH_CHUNK ? n - base : KVS_BATCH_CHUNK;
+        for (int i = 0; i < m; i++)
+        {
+            keys[i] = tokens[1 + (base + i) * stride];
+            if (stride == 2)
+                values[i] = tokens[2 + (base + i) * stride];
+        }
+
+        kvs_value_unreadable = 0;
+        uint64_t start = kvs_stats_enabled ? kvs_stats_now() : 0;
+        int ret = stride == 2 ? engine_mset(store, engine, keys, values, m, results)
+                              : engine_mget(store, engine, keys, m, values);
+        if (kvs_stats_enabled)
+            elapsed += kvs_stats_now() - start;
+        int damaged = kvs_value_unreadable;
+
+        for (int i = 0; i < m; i++)
+        {
+            const char *line;
+            if (ret < 0)
+                line = "ERROR";
+            else if (stride == 2)
+                line = results[i] < 0 ? "ERROR" : (results[i] == 0 ? "OK" : "EXIST");
+            else if (values[i])
+                line = values[i];
+            else
+                line = damaged && batch_unreadable(store, engine, keys[i]) ? "ERROR value unreadable" : "NO EXIST";
+            if (reply(out, line) != 0)
+                return -2;
+        }
+    }
+
+    if (kvs_stats_enabled)
+        kvs_stats_record(cmd, elapsed);
+    return 0;
+}
+
+int kvs_protocol_execute(kvs_store_t *store, char **tokens, int count, kvs_buf_t *out)
+{
+    if (!store || !tokens || !out)
+        return -1;
+
+    if (count <= 0)
+        return reply(out, "ERROR");
+
+    // 上一条命令从 value log 读出的值已写进回复
+    kvs_value_scratch_reset();
+
+    int cmd = kvs_protocol_command(tokens[0]);
+    if (cmd < 0)
+        return reply(out, "ERROR unknown command");
+
+    if (cmd == KVS_CMD_STATS)
+        return execute_stats(tokens, count, out);
+    if (cmd == KVS_CMD_MEMORY)
+        return execute_memory(count, out);
+    if (cmd == KVS_CMD_FLUSH)
+        return execute_flush(store, tokens, count, out);
+    if (cmd == KVS_CMD_SCAN)
+        return execute_scan(store, tokens, count, out);
+    if (cmd == KVS_CMD_PSYNC || cmd == KVS_CMD_ROLE)
+        return reply(out, "ERROR replication requires shards 1 and io_threads 0"); // 单 loop 时网络层已处理
+    if (cmd == KVS_CMD_CLUSTER)
+        return reply(out, "ERROR cluster requires shards 1 and io_threads 0");
+    if (cmd >= KVS_CMD_MGET)
+        return execute_batch(store, cmd, tokens, count, out);
+
+    int engine = cmd / KVS_OPS_PER_ENGINE;
+    int op = cmd % KVS_OPS_PER_ENGINE;
+
+    if (count != op_argc[op])
+        return reply(out, "ERROR wrong number of arguments");
+
+    char *key = tokens[1];
+    char *value = count > 2 ? tokens[2] : NULL;
+    char *result = NULL;
+    kvs_value_t old = {0}; // GETSET 摘下的旧值
+    int64_t delta = 0, number = 0;
+    int ret = 0;
+
+    if (op == KVS_OP_INCR)
+        delta = 1;
+    else if (op == KVS_OP_DECR)
+        delta = -1;
+    else if (op == KVS_OP_INCRBY && kvs_value_parse_int(tokens[2], &delta) != 0)
+        return reply(out, "ERROR not an integer");
+    else if (op == KVS_OP_RESTORE && kvs_value_packed_check(value) != 0)
+        return reply(out, "ERROR invalid payload");
+
+    // 只计引擎调用本身，不含解析和回复
+    uint64_t start = kvs_stats_enabled ? kvs_stats_now() : 0;
+
+    switch (op)
+    {
+    case KVS_OP_SET:
+        ret = engine_set(store, engine, key, value);
+        break;
+    case KVS_OP_GET:
+        result = engine_get(store, engine, key);
+        break;
+    case KVS_OP_DEL:
+        ret = engine_del(store, engine, key);
+        break;
+    case KVS_OP_MOD:
+        ret = engine_mod(store, engine, key, value);
+        break;
+    case KVS_OP_EXIST:
+        ret = engine_exist(store, engine, key);
+        break;
+    case KVS_OP_UPSERT:
+        ret = engine_upsert(store, engine, key, value);
+        break;
+    case KVS_OP_RESTORE:
+        // 值是压缩数据的传输形式，原样保存
+        kvs_value_packed_input = 1;
+        ret = engine_upsert(store, engine, key, value);
+        kvs_value_packed_input = 0;
+        break;
+    case KVS_OP_GETSET:
+        ret = engine_getset(store, engine, key, value, &old);
+        result = kvs_value_str(&old);
+        break;
+    case KVS_OP_CAS:
+        ret = engine_cas(store, engine, key, tokens[2], tokens[3]);
+        break;
+    case KVS_OP_INCR:
+    case KVS_OP_DECR:
+    case KVS_OP_INCRBY:
+        ret = engine_incr(store, engine, key, delta, &number);
+        break;
+    }
+
+    if (kvs_stats_enabled)
+        kvs_stats_record(cmd, kvs_stats_now() - start);
+
+    // 值在 value log 里读不出来或解压失败：不能当成空串、不存在或非整数回复
+    if (kvs_value_unreadable)
+    {
+        kvs_value_lazyfree(&old);
+        return reply(out, "ERROR value unreadable");
+    }
+
+    switch (op)
+    {
+    case KVS_OP_SET:
+        return reply(out, ret < 0 ? "ERROR" : (ret == 0 ? "OK" : "EXIST"));
+    case KVS_OP_GET:
+        return reply(out, result ? result : "NO EXIST");
+    case KVS_OP_DEL:
+    case KVS_OP_MOD:
+        return reply(out, ret < 0 ? "ERROR" : (ret == 0 ? "OK" : "NO EXIST"));
+    case KVS_OP_EXIST:
+        return reply(out, ret < 0 ? "ERROR" : (ret == 0 ? "EXIST" : "NO EXIST"));
+    case KVS_OP_UPSERT:
+    case KVS_OP_RESTORE:
+        return reply(out, ret < 0 ? "ERROR" : "OK");
+    case KVS_OP_GETSET:
+    {
+        // 旧值已从引擎摘下，回复后释放
+        int r = reply(out, ret < 0 ? "ERROR" : (result ? result : "NO EXIST"));
+        kvs_value_lazyfree(&old);
+        return r;
+    }
+    case KVS_OP_CAS:
+        return reply(out, ret < 0 ? "ERROR" : (ret == 0 ? "OK" : (ret == 1 ? "NO EXIST" : "MISMATCH")));
+    case KVS_OP_INCR:
+    case KVS_OP_DECR:
+    case KVS_OP_INCRBY:
+    {
+        if (ret != 0)
+            return reply(out, ret < 0 ? "ERROR" : (ret == 1 ? "ERROR not an integer" : "ERROR overflow"));
+        char num[21];
+        kvs_value_format_int(number, num);
+        return reply(out, num);
+    }
+    }
+
+    return reply(out, "ERROR");
+}
@@ -0,0 +1,90 @@
+#include "proxy/kvs_chash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a 之后再做一次 murmur3 的 fmix32：相近的短串（"node-1" "node-2"）也能在环上散开
+uint32_t kvs_chash_hash(const char *data, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)data[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static int point_cmp(const void *a, const void *b)
+{
+    const kvs_chash_point_t *x = (const kvs_chash_point_t *)a;
+    const kvs_chash_point_t *y = (const kvs_chash_point_t *)b;
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return x->node - y->node; // 撞车时按节点下标，结果与输入顺序无关
+}
+
+int kvs_chash_create(kvs_chash_t *ring, const char **names, int nnodes, int vnodes)
+{
+    if (!ring || !names || nnodes <= 0 || nnodes > KVS_CHASH_MAX_NODES || vnodes <= 0)
+        return -1;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->points = (kvs_chash_point_t *)malloc(sizeof(kvs_chash_point_t) * (size_t)nnodes * (size_t)vnodes);
+    if (!ring->points)
+        return -2;
+
+    char buf[256];
+    for (int i = 0; i < nnodes; i++)
+    {
+        for (int v = 0; v < vnodes; v++)
+        {
+            int n = snprintf(buf, sizeof(buf), "%s#%d", names[i], v);
+            if (n < 0 || n >= (int)sizeof(buf))
+            {
+                kvs_chash_destory(ring);
+                return -1;
+            }
+            ring->points[ring->npoints].hash = kvs_chash_hash(buf, (size_t)n);
+            ring->points[ring->npoints].node = i;
+            ring->npoints++;
+        }
+    }
+    qsort(ring->points, (size_t)ring->npoints, sizeof(kvs_chash_point_t), point_cmp);
+    ring->nnodes = nnodes;
+    return 0;
+}
+
+void kvs_chash_destory(kvs_chash_t *ring)
+{
+    if (!ring)
+        return;
+    free(ring->points);
+    memset(ring, 0, sizeof(*ring));
+}
+
+int kvs_chash_owner(const kvs_chash_t *ring, const char *key)
+{
+    if (!ring || ring->npoints == 0 || !key)
+        return 0;
+
+    uint32_t h = kvs_chash_hash(key, strlen(key));
+
+    // 第一个 hash >= h 的虚拟节点，越过末尾则回到环首
+    int lo = 0, hi = ring->npoints;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (ring->points[mid].hash < h)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return ring->points[lo == ring->npoints ? 0 : lo].node;
+}
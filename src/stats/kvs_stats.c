@@ -0,0 +1,197 @@
+#include "stats/kvs_stats.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+int kvs_stats_enabled = 0;
+
+static double ns_per_tick = 1.0;
+
+// 每个线程一份，只有所属线程写；读者汇总时容忍读到正在更新的计数
+typedef struct kvs_stats_thread_s
+{
+    _Atomic uint64_t gen; // 与 g_gen 不一致说明已被 reset，数据作废
+    _Atomic uint64_t count[KVS_STATS_SLOTS];
+    _Atomic uint64_t max[KVS_STATS_SLOTS];
+    _Atomic uint64_t buckets[KVS_STATS_SLOTS][KVS_HIST_BUCKETS];
+    struct kvs_stats_thread_s *next;
+} kvs_stats_thread_t;
+
+static _Atomic uint64_t g_gen = 0;
+static kvs_stats_thread_t *g_threads = NULL;
+static pthread_mutex_t g_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread kvs_stats_thread_t *local_stats = NULL;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void kvs_stats_init(int enabled)
+{
+    kvs_stats_enabled = enabled;
+
+#if defined(__x86_64__) || defined(__i386__)
+    // 用 20ms 的单调时钟标定 TSC 频率（现代 CPU 的 TSC 为恒定频率）
+    uint64_t ns0 = monotonic_ns();
+    uint64_t t0 = kvs_stats_now();
+    struct timespec req = {0, 20 * 1000 * 1000};
+    nanosleep(&req, NULL);
+    uint64_t ns1 = monotonic_ns();
+    uint64_t t1 = kvs_stats_now();
+
+    if (t1 > t0)
+        ns_per_tick = (double)(ns1 - ns0) / (double)(t1 - t0);
+#endif
+}
+
+static inline int hist_index(uint64_t v)
+{
+    if (v < KVS_HIST_SUB_COUNT)
+        return (int)v;
+
+    int msb = 63 - __builtin_clzll(v);
+    if (msb > KVS_HIST_MAX_BITS)
+        return KVS_HIST_BUCKETS - 1;
+
+    int shift = msb - KVS_HIST_SUB_BITS;
+    int sub = (int)((v >> shift) & (KVS_HIST_SUB_COUNT - 1));
+    return (msb - KVS_HIST_SUB_BITS + 1) * KVS_HIST_SUB_COUNT + sub;
+}
+
+// 桶的代表值：取桶区间中点
+static uint64_t hist_value(int idx)
+{
+    if (idx < KVS_HIST_SUB_COUNT)
+        return (uint64_t)idx;
+
+    int msb = idx / KVS_HIST_SUB_COUNT + KVS_HIST_SUB_BITS - 1;
+    int sub = idx % KVS_HIST_SUB_COUNT;
+    int shift = msb - KVS_HIST_SUB_BITS;
+    uint64_t low = ((uint64_t)(KVS_HIST_SUB_COUNT + sub)) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+static kvs_stats_thread_t *stats_register(void)
+{
+    kvs_stats_thread_t *t = (kvs_stats_thread_t *)calloc(1, sizeof(*t));
+    if (!t)
+        return NULL;
+    atomic_store_explicit(&t->gen, atomic_load(&g_gen), memory_order_relaxed);
+
+    pthread_mutex_lock(&g_threads_lock);
+    t->next = g_threads;
+    g_threads = t;
+    pthread_mutex_unlock(&g_threads_lock);
+
+    local_stats = t;
+    return t;
+}
+
+static inline void counter_inc(_Atomic uint64_t *c)
+{
+    // 单写者：load + store 即可，不需要 lock 前缀
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void kvs_stats_record(int slot, uint64_t ticks)
+{
+    if (slot < 0 || slot >= KVS_STATS_SLOTS)
+        return;
+
+    kvs_stats_thread_t *t = local_stats;
+    if (!t && !(t = stats_register()))
+        return;
+
+    uint64_t gen = atomic_load_explicit(&g_gen, memory_order_acquire);
+    if (atomic_load_explicit(&t->gen, memory_order_relaxed) != gen)
+    {
+        memset((void *)t->count, 0, sizeof(t->count));
+        memset((void *)t->max, 0, sizeof(t->max));
+        memset((void *)t->buckets, 0, sizeof(t->buckets));
+        atomic_store_explicit(&t->gen, gen, memory_order_release);
+    }
+
+    counter_inc(&t->count[slot]);
+    counter_inc(&t->buckets[slot][hist_index(ticks)]);
+    if (ticks > atomic_load_explicit(&t->max[slot], memory_order_relaxed))
+        atomic_store_explicit(&t->max[slot], ticks, memory_order_relaxed);
+}
+
+void kvs_stats_merge(int slot, kvs_hist_t *out)
+{
+    if (!out || slot < 0 || slot >= KVS_STATS_SLOTS)
+        return;
+
+    uint64_t gen = atomic_load_explicit(&g_gen, memory_order_acquire);
+
+    pthread_mutex_lock(&g_threads_lock);
+    for (kvs_stats_thread_t *t = g_threads; t; t = t->next)
+    {
+        if (atomic_load_explicit(&t->gen, memory_order_acquire) != gen)
+            continue; // reset 之后还没记录过
+
+        out->count += atomic_load_explicit(&t->count[slot], memory_order_relaxed);
+        uint64_t m = atomic_load_explicit(&t->max[slot], memory_order_relaxed);
+        if (m > out->max)
+            out->max = m;
+        for (int i = 0; i < KVS_HIST_BUCKETS; i++)
+            out->buckets[i] += atomic_load_explicit(&t->buckets[slot][i], memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&g_threads_lock);
+}
+
+void kvs_stats_reset(void)
+{
+    atomic_fetch_add_explicit(&g_gen, 1, memory_order_release);
+}
+
+void kvs_hist_add(kvs_hist_t *hist, uint64_t ticks)
+{
+    hist->count++;
+    hist->buckets[hist_index(ticks)]++;
+    if (ticks > hist->max)
+        hist->max = ticks;
+}
+
+uint64_t kvs_hist_percentile(const kvs_hist_t *hist, double p)
+{
+    if (!hist || hist->count == 0)
+        return 0;
+
+    // 汇总时各计数不是同一时刻的快照，以桶内总数为准
+    uint64_t total = 0;
+    for (int i = 0; i < KVS_HIST_BUCKETS; i++)
+        total += hist->buckets[i];
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)total + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < KVS_HIST_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t v = hist_value(i);
+            return v < hist->max ? v : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+void kvs_stats_summary(const kvs_hist_t *hist, kvs_hist_summary_t *out)
+{
+    out->count = hist->count;
+    out->p50 = (uint64_t)(kvs_hist_percentile(hist, 50.0) * ns_per_tick);
+    out->p99 = (uint64_t)(kvs_hist_percentile(hist, 99.0) * ns_per_tick);
+    out->p999 = (uint64_t)(kvs_hist_percentile(hist, 99.9) * ns_per_tick);
+    out->max = (uint64_t)(hist->max * ns_per_tick);
+}
@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator/kvs_alloc.h"
+
+static void test_pool_reset(void)
+{
+    printf("[TEST] alloc: pool_reset...\n");
+
+    struct mp_pool_s *pool = mp_create_pool(1024);
+    assert(pool != NULL);
+
+    void *a = mp_alloc(pool, 100);
+    void *big = mp_alloc(pool, 8192); // 走 large
+    assert(a && big);
+    memset(big, 0xab, 8192);
+
+    // 超出首个 node，触发新 node
+    for (int i = 0; i < 64; i++)
+        assert(mp_alloc(pool, 200) != NULL);
+
+    mp_reset_pool(pool);
+    assert(pool->large == NULL);
+    assert(mp_alloc(pool, 100) == a); // 从头复用
+
+    mp_destory_pool(pool);
+}
+
+static void test_huge_pool(void)
+{
+    printf("[TEST] alloc: huge_pool...\n");
+
+    kvs_hugepage_mode_t mode = kvs_alloc_set_hugepages(1);
+    assert(mode == KVS_HUGEPAGE_HUGETLB || mode == KVS_HUGEPAGE_THP);
+
+    struct mp_pool_s *pool = mp_create_huge_pool(4096);
+    assert(pool != NULL && pool->huge);
+
+    // 连续切出的 node 落在同一段区域里，地址紧挨着
+    unsigned char *prev = NULL;
+    size_t far = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        unsigned char *p = mp_alloc(pool, 1000);
+        assert(p != NULL);
+        memset(p, i & 0xff, 1000);
+        if (prev && (size_t)(p > prev ? p - prev : prev - p) > 8192)
+            far++;
+        prev = p;
+    }
+    assert(far == 0);
+
+    mp_destory_pool(pool); // node 不单独释放
+    assert(kvs_alloc_set_hugepages(0) == KVS_HUGEPAGE_OFF);
+}
+
+static void test_mypool_huge(void)
+{
+    printf("[TEST] alloc: mypool_huge...\n");
+
+    kvs_alloc_set_hugepages(1);
+    kvs_set_allocator(KVS_ALLOC_MYPOOL);
+
+    char *s[1000];
+    for (int i = 0; i < 1000; i++)
+    {
+        s[i] = kvs_malloc(32);
+        assert(s[i] != NULL);
+        snprintf(s[i], 32, "value-%d", i);
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        char want[32];
+        snprintf(want, sizeof(want), "value-%d", i);
+        assert(strcmp(s[i], want) == 0);
+        kvs_free(s[i], 32);
+    }
+
+    void *large = kvs_malloc(100000);
+    assert(large != NULL);
+    memset(large, 1, 100000);
+    kvs_free(large, 100000);
+}
+
+static void test_stats_system(void)
+{
+    printf("[TEST] alloc: stats_system...\n");
+
+    kvs_set_allocator(KVS_ALLOC_SYSTEM);
+
+    kvs_alloc_stats_t before, after;
+    kvs_alloc_stats(&before);
+
+    void *p[100];
+    for (int i = 0; i < 100; i++)
+        p[i] = kvs_malloc(24); // 归入 <=32 这一级
+
+    kvs_alloc_stats(&after);
+    assert(after.requested - before.requested == 100 * 24);
+    assert(after.reserved - before.reserved >= 100 * 24);
+    assert(after.live[2] - before.live[2] == 100);
+    assert(kvs_alloc_class_size(2) == 32);
+    assert(after.malloc_calls - before.malloc_calls == 100);
+    assert(after.fragmentation >= 1.0);
+
+    for (int i = 0; i < 100; i++)
+        kvs_free(p[i], 24);
+
+    kvs_alloc_stats(&after);
+    assert(after.requested == before.requested);
+    assert(after.reserved == before.reserved);
+    assert(after.live[2] == before.live[2]);
+}
+
+static void test_stats_mypool(void)
+{
+    printf("[TEST] alloc: stats_mypool...\n");
+
+    kvs_alloc_set_hugepages(0);
+    kvs_set_allocator(KVS_ALLOC_MYPOOL);
+
+    kvs_alloc_stats_t before, after;
+    kvs_alloc_stats(&before);
+
+    // 小块释放后不回收，记为 abandoned；大块释放后 reserved 回落
+    void *small = kvs_malloc(100);
+    void *large = kvs_malloc(50000);
+    assert(small && large);
+
+    kvs_alloc_stats(&after);
+    assert(after.pool_nodes >= 1);
+    assert(after.pool_large >= before.pool_large);
+    assert(after.reserved - before.reserved >= 50000);
+
+    kvs_free(small, 100);
+    kvs_free(large, 50000);
+
+    kvs_alloc_stats(&after);
+    assert(after.pool_abandoned - before.pool_abandoned == 100);
+    assert(after.requested == before.requested);
+    assert(after.reserved - before.reserved < 50000);
+    assert(strcmp(kvs_alloc_name(), "mypool") == 0);
+}
+
+int main(void)
+{
+    test_pool_reset();
+    test_huge_pool();
+    test_mypool_huge();
+    test_stats_system();
+    test_stats_mypool();
+
+    printf("[OK] all kvs_alloc unit tests passed.\n");
+    return 0;
+}
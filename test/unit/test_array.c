@@ -151,6 +151,122 @@ static void test_hole_reuse_when_full(void)
     kvs_array_destory(&a);
 }
 
+static void test_upsert_getset_cas(void)
+{
+    printf("[TEST] array: upsert/getset/cas...\n");
+
+    kvs_array_t a = {0};
+    assert(kvs_array_create(&a) == 0);
+
+    assert(kvs_array_upsert(&a, "k", "v1") == 0);
+    assert(kvs_array_upsert(&a, "k", "v2") == 1);
+    assert(strcmp(kvs_array_get(&a, "k"), "v2") == 0);
+    assert(a.total == 1);
+
+    kvs_value_t old;
+    assert(kvs_array_getset(&a, "k", "v3", &old) == 1);
+    assert(strcmp(kvs_value_str(&old), "v2") == 0);
+    kvs_value_free(&old);
+    assert(kvs_array_getset(&a, "n", "x", &old) == 0);
+    assert(kvs_value_str(&old) == NULL);
+
+    assert(kvs_array_cas(&a, "k", "nope", "v4") == 2);
+    assert(kvs_array_cas(&a, "k", "v3", "v4") == 0);
+    assert(strcmp(kvs_array_get(&a, "k"), "v4") == 0);
+    assert(kvs_array_cas(&a, "missing", "v", "w") == 1);
+
+    /* 不存在时写入第一个空洞，不追加 */
+    assert(kvs_array_set(&a, "t", "tail") == 0);
+    assert(kvs_array_del(&a, "k") == 0);
+    assert(kvs_array_upsert(&a, "k2", "v") == 0);
+    assert(a.table[0].key && strcmp(a.table[0].key, "k2") == 0);
+    assert(a.total == 3);
+
+    /* 等长覆盖不调用分配器 */
+    kvs_alloc_counters_t c0, c1;
+    char *buf = kvs_array_get(&a, "k2");
+    kvs_alloc_counters(&c0);
+    assert(kvs_array_mod(&a, "k2", "w") == 0);
+    assert(kvs_array_cas(&a, "k2", "w", "z") == 0);
+    kvs_alloc_counters(&c1);
+    assert(c1.malloc_calls == c0.malloc_calls && c1.free_calls == c0.free_calls);
+    assert(kvs_array_get(&a, "k2") == buf && strcmp(buf, "z") == 0);
+
+    assert(kvs_array_upsert(NULL, "k", "v") < 0);
+    assert(kvs_array_cas(&a, "k", NULL, "v") < 0);
+
+    kvs_array_destory(&a);
+}
+
+static void test_incr(void)
+{
+    printf("[TEST] array: incr...\n");
+
+    kvs_array_t a = {0};
+    assert(kvs_array_create(&a) == 0);
+
+    int64_t r = 0;
+    assert(kvs_array_incr(&a, "n", -3, &r) == 0 && r == -3);
+    assert(a.total == 1);
+
+    /* 整数内嵌在槽位里，加减不调用分配器 */
+    kvs_alloc_counters_t c0, c1;
+    kvs_alloc_counters(&c0);
+    for (int i = 0; i < 100; i++)
+        assert(kvs_array_incr(&a, "n", 1, &r) == 0);
+    kvs_alloc_counters(&c1);
+    assert(c1.malloc_calls == c0.malloc_calls && c1.free_calls == c0.free_calls);
+    assert(r == 97 && strcmp(kvs_array_get(&a, "n"), "97") == 0);
+
+    assert(kvs_array_set(&a, "s", "1.5") == 0);
+    assert(kvs_array_incr(&a, "s", 1, &r) == 1);
+    assert(kvs_array_mod(&a, "n", "-9223372036854775808") == 0);
+    assert(kvs_array_incr(&a, "n", -1, &r) == 2);
+    assert(strcmp(kvs_array_get(&a, "n"), "-9223372036854775808") == 0);
+    assert(kvs_array_incr(NULL, "n", 1, &r) < 0);
+
+    kvs_array_destory(&a);
+}
+
+static void test_defrag(void)
+{
+    printf("[TEST] array: defrag...\n");
+
+    kvs_set_allocator(KVS_ALLOC_MYPOOL);
+
+    kvs_array_t a = {0};
+    char key[32], value[32];
+    assert(kvs_array_create(&a) == 0);
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "v%d", i);
+        assert(kvs_array_set(&a, key, value) == 0);
+    }
+
+    assert(kvs_alloc_defrag_begin() == 0);
+    int cursor = 0, steps = 0;
+    while (kvs_array_defrag(&a, &cursor, 100))
+    {
+        snprintf(key, sizeof(key), "k%d", steps * 7);
+        assert(kvs_array_mod(&a, key, "changed") == 0);
+        steps++;
+    }
+    kvs_alloc_defrag_end();
+    assert(steps >= 9);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "v%d", i);
+        const char *want = (i % 7 == 0 && i / 7 < steps) ? "changed" : value;
+        assert(strcmp(kvs_array_get(&a, key), want) == 0);
+    }
+
+    kvs_array_destory(&a);
+    kvs_set_allocator(KVS_ALLOC_SYSTEM);
+}
+
 int main(void)
 {
     test_create_destroy();
@@ -158,6 +274,9 @@ int main(void)
     test_mod_del_basic();
     test_capacity_limit_1024_1025();
     test_hole_reuse_when_full();
+    test_upsert_getset_cas();
+    test_incr();
+    test_defrag();
 
     printf("[OK] all kvs_array unit tests passed.\n");
     return 0;
@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "proxy/kvs_chash.h"
+
+#define NKEYS 100000
+
+static const char *names[] = {"127.0.0.1:2001", "127.0.0.1:2002", "127.0.0.1:2003", "127.0.0.1:2004"};
+
+static void test_basic(void)
+{
+    printf("[TEST] chash: basic...\n");
+
+    kvs_chash_t ring;
+    assert(kvs_chash_create(&ring, names, 0, 10) < 0);
+    assert(kvs_chash_create(&ring, names, 1, 0) < 0);
+
+    assert(kvs_chash_create(&ring, names, 1, 10) == 0);
+    assert(ring.npoints == 10 && ring.nnodes == 1);
+    assert(kvs_chash_owner(&ring, "a") == 0 && kvs_chash_owner(&ring, "") == 0);
+    kvs_chash_destory(&ring);
+
+    assert(kvs_chash_create(&ring, names, 4, KVS_CHASH_VNODES) == 0);
+    for (int i = 1; i < ring.npoints; i++)
+        assert(ring.points[i - 1].hash <= ring.points[i].hash);
+
+    // 同一个 key 总是落到同一个节点，且与查询顺序无关
+    int a = kvs_chash_owner(&ring, "user:1000");
+    assert(a >= 0 && a < 4);
+    assert(kvs_chash_owner(&ring, "user:1000") == a);
+    kvs_chash_destory(&ring);
+    assert(ring.points == NULL);
+}
+
+static void test_balance(void)
+{
+    printf("[TEST] chash: balance...\n");
+
+    kvs_chash_t ring;
+    assert(kvs_chash_create(&ring, names, 4, KVS_CHASH_VNODES) == 0);
+
+    int hits[4] = {0};
+    char key[32];
+    for (int i = 0; i < NKEYS; i++)
+    {
+        snprintf(key, sizeof(key), "key:%d", i);
+        hits[kvs_chash_owner(&ring, key)]++;
+    }
+    // 160 个虚拟节点时每个节点应在 1/4 的 ±20% 以内
+    for (int i = 0; i < 4; i++)
+        assert(hits[i] > NKEYS / 4 * 8 / 10 && hits[i] < NKEYS / 4 * 12 / 10);
+
+    kvs_chash_destory(&ring);
+}
+
+static void test_stable(void)
+{
+    printf("[TEST] chash: add node...\n");
+
+    kvs_chash_t three, four;
+    assert(kvs_chash_create(&three, names, 3, KVS_CHASH_VNODES) == 0);
+    assert(kvs_chash_create(&four, names, 4, KVS_CHASH_VNODES) == 0);
+
+    // 加一个节点：换属主的 key 只能是搬到新节点的，约占 1/4
+    int moved = 0;
+    char key[32];
+    for (int i = 0; i < NKEYS; i++)
+    {
+        snprintf(key, sizeof(key), "key:%d", i);
+        int before = kvs_chash_owner(&three, key);
+        int after = kvs_chash_owner(&four, key);
+        if (before != after)
+        {
+            assert(after == 3);
+            moved++;
+        }
+    }
+    assert(moved > NKEYS / 4 * 7 / 10 && moved < NKEYS / 4 * 13 / 10);
+
+    kvs_chash_destory(&three);
+    kvs_chash_destory(&four);
+}
+
+int main(void)
+{
+    test_basic();
+    test_balance();
+    test_stable();
+
+    printf("[OK] all kvs_chash unit tests passed.\n");
+    return 0;
+}
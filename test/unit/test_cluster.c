@@ -0,0 +1,290 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "network/kvs_cluster.h"
+
+static kvs_array_t arr_a, arr_b;
+static kvs_rbtree_t tree_a, tree_b;
+static kvs_hash_t hash_a, hash_b;
+
+static kvs_cluster_t cl;
+
+// 执行以 \0 结尾的一行请求，返回回复（静态缓冲区）
+static const char *check(kvs_store_t *store, const char *req)
+{
+    static char line[256];
+    static kvs_buf_t out;
+    char *tokens[KVS_MAX_TOKENS];
+
+    snprintf(line, sizeof(line), "%s", req);
+    int count = kvs_protocol_split(line, tokens, KVS_MAX_TOKENS);
+    out.len = 0;
+    if (kvs_cluster_check(&cl, store, tokens, count, &out) == 0)
+        return "LOCAL";
+    assert(out.len >= 2 && memcmp(out.data + out.len - 2, "\r\n", 2) == 0);
+    kvs_buf_append(&out, "", 1);
+    out.data[out.len - 3] = '\0';
+    return out.data;
+}
+
+static const char *cluster_cmd(const char *req)
+{
+    static char line[256];
+    static kvs_buf_t out;
+    char *tokens[KVS_MAX_TOKENS];
+
+    snprintf(line, sizeof(line), "%s", req);
+    int count = kvs_protocol_split(line, tokens, KVS_MAX_TOKENS);
+    out.len = 0;
+    assert(kvs_cluster_execute(&cl, tokens, count, &out) == 0);
+    kvs_buf_append(&out, "", 1);
+    out.data[out.len - 3] = '\0';
+    return out.data;
+}
+
+static void test_keyslot(void)
+{
+    printf("[TEST] cluster: keyslot...\n");
+
+    char key[32];
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(key, sizeof(key), "key:%d", i);
+        int s = kvs_cluster_keyslot(key);
+        assert(s >= 0 && s < KVS_CLUSTER_SLOTS);
+    }
+
+    // 同一个 tag 落在同一个 slot；空 tag 与不完整的括号按整个 key 计算
+    assert(kvs_cluster_keyslot("{user:1}.name") == kvs_cluster_keyslot("{user:1}.age"));
+    assert(kvs_cluster_keyslot("a{user:1}") == kvs_cluster_keyslot("user:1"));
+    assert(kvs_cluster_keyslot("{}x") != kvs_cluster_keyslot("{}y"));
+    assert(kvs_cluster_keyslot("{x") != kvs_cluster_keyslot("{y"));
+}
+
+static void test_route(void)
+{
+    printf("[TEST] cluster: route...\n");
+
+    kvs_store_t store = {&arr_a, &tree_a, &hash_a, 0, 1};
+    assert(kvs_store_create(&store) == 0);
+
+    kvs_cluster_init(&cl, 0, KVS_CLUSTER_SLOTS - 1);
+    int slot = kvs_cluster_keyslot("k1");
+    char req[128];
+
+    assert(strcmp(check(&store, "HGET k1"), "LOCAL") == 0);
+    assert(strcmp(check(&store, "STATS"), "LOCAL") == 0);
+
+    snprintf(req, sizeof(req), "CLUSTER SETSLOT %d %d NODE 127.0.0.1:2001", slot, slot);
+    assert(strcmp(cluster_cmd(req), "OK") == 0);
+    char expect[128];
+    snprintf(expect, sizeof(expect), "MOVED %d 127.0.0.1:2001", slot);
+    assert(strcmp(check(&store, "HGET k1"), expect) == 0);
+
+    // 迁移中：还在本地的 key 本地执行，不在的回复 ASK
+    snprintf(req, sizeof(req), "CLUSTER SETSLOT %d %d OWNED", slot, slot);
+    assert(strcmp(cluster_cmd(req), "OK") == 0);
+    snprintf(req, sizeof(req), "CLUSTER SETSLOT %d %d MIGRATING 127.0.0.1:2002", slot, slot);
+    assert(strcmp(cluster_cmd(req), "OK") == 0);
+    assert(strcmp(cluster_cmd(req), "ERROR migration in progress") == 0);
+    assert(kvs_hash_set(&hash_a, "k1", "v") == 0);
+    assert(strcmp(check(&store, "HGET k1"), "LOCAL") == 0);
+    assert(strcmp(check(&store, "GET k1"), "LOCAL") != 0); // array 里没有
+    snprintf(expect, sizeof(expect), "ASK %d 127.0.0.1:2002", slot);
+    assert(strcmp(check(&store, "GET k1"), expect) == 0);
+    cl.migrate.active = 0;
+
+    // 批量：全部本地才执行；跨 slot 要重定向时报错
+    assert(strcmp(check(&store, "HMGET k1 k2 k3"), "LOCAL") == 0);
+    snprintf(req, sizeof(req), "CLUSTER SETSLOT %d %d NONE", slot, slot);
+    assert(strcmp(cluster_cmd(req), "OK") == 0);
+    snprintf(expect, sizeof(expect), "ERROR slot %d not served", slot);
+    assert(strcmp(check(&store, "HMSET k1 a {k1}x b"), expect) == 0);
+    assert(strncmp(check(&store, "HMGET k2 k1"), "ERROR CROSSSLOT", 15) == 0);
+
+    assert(strcmp(cluster_cmd("CLUSTER SETSLOT 5 3 OWNED"), "ERROR invalid slot range") == 0);
+    assert(strcmp(cluster_cmd("CLUSTER SETSLOT 0 16384 OWNED"), "ERROR invalid slot range") == 0);
+    assert(strcmp(cluster_cmd("CLUSTER SETSLOT 0 1 NODE nowhere"), "ERROR invalid address") == 0);
+    assert(strcmp(cluster_cmd("CLUSTER SETSLOT 0 1 NODE 127.0.0.1:2001"), "OK") == 0);
+    assert(strcmp(cluster_cmd("CLUSTER SETSLOT 0 1 MIGRATING 127.0.0.1:2002"), "ERROR slot not owned") == 0);
+    snprintf(req, sizeof(req), "%d", slot);
+    assert(strcmp(cluster_cmd("CLUSTER KEYSLOT {k1}x"), req) == 0);
+    assert(strncmp(cluster_cmd("CLUSTER INFO"), "CLUSTER owned=", 14) == 0);
+
+    kvs_cluster_destory(&cl);
+    kvs_store_destory(&store);
+}
+
+static void count_del(void *arg, char **tokens, int count)
+{
+    assert(count == 2 && (strcmp(tokens[0], "DEL") == 0 || strcmp(tokens[0], "RDEL") == 0 ||
+                          strcmp(tokens[0], "HDEL") == 0));
+    (*(int *)arg)++;
+}
+
+static void test_migrate(void)
+{
+    printf("[TEST] cluster: migrate...\n");
+
+    kvs_store_t a = {&arr_a, &tree_a, &hash_a, 0, 1};
+    kvs_store_t b = {&arr_b, &tree_b, &hash_b, 0, 1};
+    assert(kvs_store_create(&a) == 0);
+    assert(kvs_store_create(&b) == 0);
+
+    char key[32], val[64];
+    for (int i = 0; i < 600; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(val, sizeof(val), i % 3 ? "value-%d-long-enough-to-be-allocated" : "%d", i);
+        if (i < 300)
+            assert(kvs_array_set(&arr_a, key, val) == 0);
+        assert(kvs_rbtree_set(&tree_a, key, val) == 0);
+        assert(kvs_hash_set(&hash_a, key, val) == 0);
+    }
+
+    // 迁走前一半 slot
+    int hi = KVS_CLUSTER_SLOTS / 2 - 1;
+    kvs_cluster_init(&cl, 0, KVS_CLUSTER_SLOTS - 1);
+    assert(strcmp(cluster_cmd("CLUSTER SETSLOT 0 8191 MIGRATING 127.0.0.1:2002"), "OK") == 0);
+
+    // 每批在 b 上执行，回复收齐后在 a 上删除
+    int batches = 0, dels = 0;
+    char *tokens[KVS_MAX_TOKENS];
+    kvs_buf_t reply = {0};
+    char gone[32] = "", req[64];
+    int gone_engine = -1;
+    for (;;)
+    {
+        int n = kvs_migrate_collect(&cl, &a, 64, 256);
+        assert(n >= 0 && n <= 64 + 8); // hash 一次取整个桶
+        if (n == 0 && cl.migrate.stage == KVS_MIGRATE_DONE)
+            break;
+        if (n == 0)
+            continue;
+        batches++;
+
+        // 在途：批次里的 key 两边都不能动
+        const char *first = cl.migrate.keys.data + 1;
+        int engine = cl.migrate.keys.data[0];
+        snprintf(req, sizeof(req), "%sGET %s", engine == 0 ? "" : engine == 1 ? "R" : "H", first);
+        cl.migrate.acks = n;
+        assert(strncmp(check(&a, req), "ERROR TRYAGAIN", 14) == 0);
+
+        reply.len = 0;
+        assert(kvs_buf_append(&cl.migrate.out, "", 1) == 0);
+        int lines = 0;
+        for (char *line = cl.migrate.out.data, *nl; (nl = strchr(line, '\n')) != NULL; line = nl + 1)
+        {
+            *nl = '\0';
+            int count = kvs_protocol_split(line, tokens, KVS_MAX_TOKENS);
+            assert(kvs_protocol_execute(&b, tokens, count, &reply) == 0);
+            lines++;
+        }
+        assert(lines == n);
+
+        // 第一批模拟回复丢失：b 上已写入，本地删掉其中一个 key 后重发，b 上的旧副本也要删掉
+        if (batches == 1)
+        {
+            kvs_migrate_abort(&cl);
+            assert(strcmp(check(&a, req), "LOCAL") == 0); // 等重发时本地照常执行
+            snprintf(gone, sizeof(gone), "%s", first);
+            gone_engine = engine;
+            assert(engine == 0 ? kvs_array_del(&arr_a, gone) == 0
+                               : engine == 1 ? kvs_rbtree_del(&tree_a, gone) == 0 : kvs_hash_del(&hash_a, gone) == 0);
+            assert(strncmp(check(&a, req), "ERROR TRYAGAIN", 14) == 0); // 不能 ASK 到旧副本
+
+            assert(kvs_migrate_resend(&cl, &a) == n);
+            snprintf(req, sizeof(req), "%s %s\n", engine == 0 ? "DEL" : engine == 1 ? "RDEL" : "HDEL", gone);
+            assert(strncmp(cl.migrate.out.data, req, strlen(req)) == 0);
+
+            reply.len = 0;
+            assert(kvs_buf_append(&cl.migrate.out, "", 1) == 0);
+            for (char *line = cl.migrate.out.data, *nl; (nl = strchr(line, '\n')) != NULL; line = nl + 1)
+            {
+                *nl = '\0';
+                int count = kvs_protocol_split(line, tokens, KVS_MAX_TOKENS);
+                assert(kvs_protocol_execute(&b, tokens, count, &reply) == 0);
+            }
+            cl.migrate.acks = n;
+        }
+        assert(kvs_migrate_ack(&cl, &reply) == 0 && reply.len == 0);
+        kvs_migrate_commit(&cl, &a, count_del, &dels);
+    }
+    assert(batches > 1 && cl.migrate.moved == dels);
+
+    // 迁走的 slot：key 都到了 b 上、a 上没有；迁移途中被删掉的那个两边都没有
+    int moved = 0;
+    for (int i = 0; i < 600; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(val, sizeof(val), i % 3 ? "value-%d-long-enough-to-be-allocated" : "%d", i);
+        int away = kvs_cluster_keyslot(key) <= hi;
+        for (int e = i < 300 ? 0 : 1; e < 3; e++)
+        {
+            char *va = e == 0 ? kvs_array_get(&arr_a, key) : e == 1 ? kvs_rbtree_get(&tree_a, key) : kvs_hash_get(&hash_a, key);
+            char *vb = e == 0 ? kvs_array_get(&arr_b, key) : e == 1 ? kvs_rbtree_get(&tree_b, key) : kvs_hash_get(&hash_b, key);
+            if (e == gone_engine && strcmp(key, gone) == 0)
+            {
+                assert(va == NULL && vb == NULL);
+                continue;
+            }
+            assert(away ? va == NULL && vb && strcmp(vb, val) == 0 : va != NULL && vb == NULL);
+            moved += away;
+        }
+    }
+    assert(moved == dels);
+
+    kvs_buf_free(&reply);
+    kvs_cluster_destory(&cl);
+    kvs_store_destory(&a);
+    kvs_store_destory(&b);
+}
+
+static void test_ack(void)
+{
+    printf("[TEST] cluster: ack...\n");
+
+    kvs_cluster_init(&cl, 0, KVS_CLUSTER_SLOTS - 1);
+    kvs_buf_t in = {0};
+
+    // 一行分两次到达也能识别；DEL 的 NO EXIST 也算确认
+    cl.migrate.acks = 3;
+    assert(kvs_buf_append(&in, "OK\r\nO", 5) == 0);
+    assert(kvs_migrate_ack(&cl, &in) == 2 && in.len == 1);
+    assert(kvs_buf_append(&in, "K\r\nNO EXIST\r\n", 13) == 0);
+    assert(kvs_migrate_ack(&cl, &in) == 0 && in.len == 0);
+
+    // 别的回复、多出来的回复
+    cl.migrate.acks = 2;
+    assert(kvs_buf_append(&in, "OK\r\nMOVED 1 x:1\r\n", 17) == 0);
+    assert(kvs_migrate_ack(&cl, &in) < 0);
+    in.len = 0;
+    cl.migrate.acks = 0;
+    assert(kvs_buf_append(&in, "OK\r\n", 4) == 0);
+    assert(kvs_migrate_ack(&cl, &in) < 0);
+
+    // 连接不等连上就返回
+    assert(kvs_migrate_connect("nowhere") < 0);
+    assert(kvs_migrate_connect("300.0.0.1:1") < 0);
+    int fd = kvs_migrate_connect("127.0.0.1:1");
+    assert(fd >= 0 && (fcntl(fd, F_GETFL) & O_NONBLOCK));
+    close(fd);
+
+    kvs_buf_free(&in);
+    kvs_cluster_destory(&cl);
+}
+
+int main(void)
+{
+    test_keyslot();
+    test_route();
+    test_migrate();
+    test_ack();
+
+    printf("[OK] all kvs_cluster unit tests passed.\n");
+    return 0;
+}
@@ -38,9 +38,9 @@ static void test_basic_api(void)
     kvs_hash_t h = {0};
 
     EXPECT_EQ_INT(kvs_hash_create(&h), 0);
-    EXPECT_TRUE(h.nodes != NULL);
+    EXPECT_TRUE(h.nodes == NULL && h.lp == NULL); // 从不占内存的紧凑编码开始
     EXPECT_EQ_INT(h.count, 0);
-    EXPECT_EQ_INT(h.max_slots, MAX_TABLE_SIZE);
+    EXPECT_EQ_INT(h.max_slots, 0);
 
     // set/get
     EXPECT_EQ_INT(kvs_hash_set(&h, "k1", "v1"), 0);
@@ -77,44 +77,423 @@ static void test_basic_api(void)
     EXPECT_EQ_INT(h.max_slots, 0);
 }
 
+// 在 1024 个桶里找一个至少挂了 3 个 key 的桶，返回链表上的前三个（头插：head 最后插入）
+static void find_collisions(char keys[3][16])
+{
+    kvs_hash_t probe = {0};
+    char key[16];
+    EXPECT_EQ_INT(kvs_hash_create(&probe), 0);
+    for (int i = 0; i < MAX_TABLE_SIZE; i++) // 不超过桶数，不会扩表
+    {
+        snprintf(key, sizeof(key), "c%d", i);
+        EXPECT_EQ_INT(kvs_hash_set(&probe, key, "v"), 0);
+    }
+
+    int found = 0;
+    for (int b = 0; b < probe.max_slots && !found; b++)
+    {
+        hashnode_t *n = probe.nodes[b];
+        if (n && n->next && n->next->next)
+        {
+            // 按插入顺序返回：tail, middle, head
+            snprintf(keys[0], 16, "%s", n->next->next->key);
+            snprintf(keys[1], 16, "%s", n->next->key);
+            snprintf(keys[2], 16, "%s", n->key);
+            found = 1;
+        }
+    }
+    EXPECT_TRUE(found);
+    kvs_hash_destory(&probe);
+}
+
 static void test_collision_and_delete_positions(void)
 {
     printf("[TEST] hash: collision_delete_positions...\n");
 
     kvs_hash_t h = {0};
     EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+    EXPECT_EQ_INT(kvs_hash_convert(&h), 0);
+    EXPECT_EQ_INT(h.max_slots, MAX_TABLE_SIZE);
 
-    // 这三个 key 在 sum-hash 下总和相同 -> 必然同桶：
-    // "abc"(97+98+99) == "acb"(97+99+98) == "bac"(98+97+99)
-    EXPECT_EQ_INT(kvs_hash_set(&h, "abc", "v_abc"), 0);
-    EXPECT_EQ_INT(kvs_hash_set(&h, "acb", "v_acb"), 0);
-    EXPECT_EQ_INT(kvs_hash_set(&h, "bac", "v_bac"), 0);
-    EXPECT_EQ_INT(kvs_hash_count(&h), 3);
+    // 三个同桶的 key，按原插入顺序插入，链表为 c(head) -> b(middle) -> a(tail)
+    char keys[3][16];
+    find_collisions(keys);
+    char *a = keys[0], *b = keys[1], *c = keys[2];
 
-    EXPECT_STREQ(kvs_hash_get(&h, "abc"), "v_abc");
-    EXPECT_STREQ(kvs_hash_get(&h, "acb"), "v_acb");
-    EXPECT_STREQ(kvs_hash_get(&h, "bac"), "v_bac");
+    EXPECT_EQ_INT(kvs_hash_set(&h, a, "v_a"), 0);
+    EXPECT_EQ_INT(kvs_hash_set(&h, b, "v_b"), 0);
+    EXPECT_EQ_INT(kvs_hash_set(&h, c, "v_c"), 0);
+    EXPECT_EQ_INT(kvs_hash_count(&h), 3);
 
-    // 删除 middle（取决于插入顺序，你是头插：最后插入的是 head）
-    // 插入顺序 abc -> acb -> bac，因此链表：bac(head) -> acb(middle) -> abc(tail)
+    EXPECT_STREQ(kvs_hash_get(&h, a), "v_a");
+    EXPECT_STREQ(kvs_hash_get(&h, b), "v_b");
+    EXPECT_STREQ(kvs_hash_get(&h, c), "v_c");
 
     // delete middle
-    EXPECT_EQ_INT(kvs_hash_del(&h, "acb"), 0);
+    EXPECT_EQ_INT(kvs_hash_del(&h, b), 0);
     EXPECT_EQ_INT(kvs_hash_count(&h), 2);
-    EXPECT_TRUE(kvs_hash_get(&h, "acb") == NULL);
-    EXPECT_STREQ(kvs_hash_get(&h, "abc"), "v_abc");
-    EXPECT_STREQ(kvs_hash_get(&h, "bac"), "v_bac");
+    EXPECT_TRUE(kvs_hash_get(&h, b) == NULL);
+    EXPECT_STREQ(kvs_hash_get(&h, a), "v_a");
+    EXPECT_STREQ(kvs_hash_get(&h, c), "v_c");
 
     // delete tail
-    EXPECT_EQ_INT(kvs_hash_del(&h, "abc"), 0);
+    EXPECT_EQ_INT(kvs_hash_del(&h, a), 0);
     EXPECT_EQ_INT(kvs_hash_count(&h), 1);
-    EXPECT_TRUE(kvs_hash_get(&h, "abc") == NULL);
-    EXPECT_STREQ(kvs_hash_get(&h, "bac"), "v_bac");
+    EXPECT_TRUE(kvs_hash_get(&h, a) == NULL);
+    EXPECT_STREQ(kvs_hash_get(&h, c), "v_c");
 
     // delete head
-    EXPECT_EQ_INT(kvs_hash_del(&h, "bac"), 0);
+    EXPECT_EQ_INT(kvs_hash_del(&h, c), 0);
     EXPECT_EQ_INT(kvs_hash_count(&h), 0);
-    EXPECT_TRUE(kvs_hash_get(&h, "bac") == NULL);
+    EXPECT_TRUE(kvs_hash_get(&h, c) == NULL);
+
+    kvs_hash_destory(&h);
+}
+
+static void test_resize(void)
+{
+    printf("[TEST] hash: resize...\n");
+
+    kvs_hash_t h = {0};
+    char key[32];
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+
+    for (int i = 0; i < 5000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        EXPECT_EQ_INT(kvs_hash_set(&h, key, "v"), 0);
+    }
+    EXPECT_EQ_INT(h.max_slots, 8192); // 负载因子不超过 1
+    for (int i = 0; i < 5000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        EXPECT_EQ_INT(kvs_hash_exist(&h, key), 0);
+    }
+
+    for (int i = 0; i < 4990; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        EXPECT_EQ_INT(kvs_hash_del(&h, key), 0);
+    }
+    EXPECT_EQ_INT(h.max_slots, MAX_TABLE_SIZE); // 缩回初始大小，不再更小
+    EXPECT_STREQ(kvs_hash_get(&h, "key-4999"), "v");
+
+    kvs_hash_destory(&h);
+}
+
+static void test_upsert_getset_cas(void)
+{
+    printf("[TEST] hash: upsert/getset/cas...\n");
+
+    kvs_hash_t h = {0};
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+
+    EXPECT_EQ_INT(kvs_hash_upsert(&h, "k", "v1"), 0);
+    EXPECT_EQ_INT(kvs_hash_upsert(&h, "k", "v2"), 1);
+    EXPECT_STREQ(kvs_hash_get(&h, "k"), "v2");
+    EXPECT_EQ_INT(kvs_hash_count(&h), 1);
+
+    kvs_value_t old;
+    EXPECT_EQ_INT(kvs_hash_getset(&h, "k", "v3", &old), 1);
+    EXPECT_STREQ(kvs_value_str(&old), "v2");
+    kvs_value_free(&old);
+    EXPECT_EQ_INT(kvs_hash_getset(&h, "n", "x", &old), 0);
+    EXPECT_TRUE(kvs_value_str(&old) == NULL);
+    EXPECT_EQ_INT(kvs_hash_count(&h), 2);
+
+    EXPECT_EQ_INT(kvs_hash_cas(&h, "k", "v2", "v4"), 2);
+    EXPECT_EQ_INT(kvs_hash_cas(&h, "k", "v3", "v4"), 0);
+    EXPECT_STREQ(kvs_hash_get(&h, "k"), "v4");
+    EXPECT_EQ_INT(kvs_hash_cas(&h, "none", "v", "w"), 1);
+    EXPECT_EQ_INT(kvs_hash_upsert(&h, NULL, "v"), -1);
+
+    kvs_hash_destory(&h);
+}
+
+static void test_mod_in_place(void)
+{
+    printf("[TEST] hash: mod in place...\n");
+
+    kvs_hash_t h = {0};
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+    EXPECT_EQ_INT(kvs_hash_convert(&h), 0);
+    kvs_alloc_stats_t st0, st1;
+    kvs_alloc_thread_stats(&st0);
+
+    EXPECT_EQ_INT(kvs_hash_set(&h, "counter", "1000"), 0);
+    char *buf = kvs_hash_get(&h, "counter");
+
+    // 等长或更短：不调用分配器，缓冲区不变
+    kvs_alloc_counters_t c0, c1;
+    kvs_alloc_counters(&c0);
+    char val[16];
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(val, sizeof(val), "%d", 1000 + i % 9000);
+        EXPECT_EQ_INT(kvs_hash_mod(&h, "counter", val), 0);
+        EXPECT_EQ_INT(kvs_hash_upsert(&h, "counter", val), 1);
+    }
+    EXPECT_EQ_INT(kvs_hash_cas(&h, "counter", val, "7"), 0);
+    kvs_alloc_counters(&c1);
+    EXPECT_TRUE(c1.malloc_calls == c0.malloc_calls && c1.free_calls == c0.free_calls);
+    EXPECT_TRUE(kvs_hash_get(&h, "counter") == buf);
+    EXPECT_STREQ(buf, "7");
+
+    // 变长：重新分配
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "counter", "a-much-longer-value-than-before"), 0);
+    EXPECT_STREQ(kvs_hash_get(&h, "counter"), "a-much-longer-value-than-before");
+
+    // 大 value 缩得很小：重新分配，不长期占着原来的容量
+    char big[1024];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "counter", big), 0);
+    buf = kvs_hash_get(&h, "counter");
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "counter", "s"), 0);
+    EXPECT_TRUE(kvs_hash_get(&h, "counter") != buf);
+
+    // 按容量释放：删除后申请字节数回到原处
+    EXPECT_EQ_INT(kvs_hash_del(&h, "counter"), 0);
+    kvs_alloc_thread_stats(&st1);
+    EXPECT_TRUE(st1.requested == st0.requested);
+
+    kvs_hash_destory(&h);
+}
+
+static void test_value_encoding(void)
+{
+    printf("[TEST] hash: value encoding...\n");
+
+    // 只认规范写法：与 format 的输出一一对应
+    int64_t n = 0;
+    EXPECT_EQ_INT(kvs_value_parse_int("0", &n), 0);
+    EXPECT_EQ_INT(kvs_value_parse_int("-42", &n), 0);
+    EXPECT_TRUE(n == -42);
+    EXPECT_EQ_INT(kvs_value_parse_int("9223372036854775807", &n), 0);
+    EXPECT_TRUE(n == INT64_MAX);
+    EXPECT_EQ_INT(kvs_value_parse_int("-9223372036854775808", &n), 0);
+    EXPECT_TRUE(n == INT64_MIN);
+    const char *bad[] = {"", "-", "-0", "007", "+1", "1a", " 1", "9223372036854775808", "-9223372036854775809",
+                         "12345678901234567890"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        EXPECT_TRUE(kvs_value_parse_int(bad[i], &n) < 0);
+
+    char buf[21];
+    EXPECT_EQ_INT(kvs_value_format_int(INT64_MIN, buf), 20);
+    EXPECT_STREQ(buf, "-9223372036854775808");
+    EXPECT_EQ_INT(kvs_value_format_int(0, buf), 1);
+    EXPECT_STREQ(buf, "0");
+
+    kvs_value_t v = {0};
+    EXPECT_TRUE(kvs_value_str(&v) == NULL);
+    EXPECT_EQ_INT(kvs_value_init(&v, "-17"), 0);
+    EXPECT_EQ_INT(v.in.enc, KVS_ENC_INT);
+    EXPECT_EQ_INT(kvs_value_assign(&v, "hello"), 0);
+    EXPECT_EQ_INT(v.in.enc, KVS_ENC_EMBSTR);
+    EXPECT_EQ_INT(kvs_value_assign(&v, "0123456789012345678901"), 0); // 22 字节仍内嵌
+    EXPECT_EQ_INT(v.in.enc, KVS_ENC_EMBSTR);
+    EXPECT_EQ_INT(kvs_value_assign(&v, "01234567890123456789012"), 0);
+    EXPECT_EQ_INT(v.in.enc, KVS_ENC_RAW);
+    EXPECT_STREQ(kvs_value_str(&v), "01234567890123456789012");
+    kvs_value_free(&v);
+    EXPECT_EQ_INT(v.in.enc, KVS_ENC_NONE);
+
+    // 短值不单独分配：写入只有节点和 key 两次 malloc
+    kvs_hash_t h = {0};
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+    EXPECT_EQ_INT(kvs_hash_convert(&h), 0);
+    kvs_alloc_counters_t c0, c1;
+    kvs_alloc_counters(&c0);
+    EXPECT_EQ_INT(kvs_hash_set(&h, "int", "123456789"), 0);
+    EXPECT_EQ_INT(kvs_hash_set(&h, "str", "short string"), 0);
+    kvs_alloc_counters(&c1);
+    EXPECT_TRUE(c1.malloc_calls - c0.malloc_calls == 4);
+    EXPECT_STREQ(kvs_hash_get(&h, "int"), "123456789");
+    EXPECT_STREQ(kvs_hash_get(&h, "str"), "short string");
+    kvs_hash_destory(&h);
+}
+
+static void test_incr(void)
+{
+    printf("[TEST] hash: incr...\n");
+
+    kvs_hash_t h = {0};
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+    EXPECT_EQ_INT(kvs_hash_convert(&h), 0);
+    kvs_alloc_stats_t st0, st1;
+    kvs_alloc_thread_stats(&st0);
+
+    int64_t r = 0;
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "n", 5, &r), 0); // 不存在：以 delta 插入
+    EXPECT_TRUE(r == 5);
+    char *buf = kvs_hash_get(&h, "n");
+
+    // 原地加减，不调用分配器
+    kvs_alloc_counters_t c0, c1;
+    kvs_alloc_counters(&c0);
+    for (int i = 0; i < 1000; i++)
+        EXPECT_EQ_INT(kvs_hash_incr(&h, "n", 1, NULL), 0);
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "n", -2000, &r), 0);
+    kvs_alloc_counters(&c1);
+    EXPECT_TRUE(c1.malloc_calls == c0.malloc_calls && c1.free_calls == c0.free_calls);
+    EXPECT_TRUE(r == -995);
+    EXPECT_TRUE(kvs_hash_get(&h, "n") == buf);
+    EXPECT_STREQ(buf, "-995");
+
+    // 用 SET/MOD 写入的数字同样可以 INCR
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "n", "41"), 0);
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "n", 1, &r), 0);
+    EXPECT_STREQ(kvs_hash_get(&h, "n"), "42");
+
+    // 单独分配的缓冲区里原地写成的数字：INCR 后转为内嵌，释放原缓冲区
+    EXPECT_EQ_INT(kvs_hash_set(&h, "raw", "a-value-too-long-to-be-embedded"), 0);
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "raw", "99"), 0);
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "raw", 1, &r), 0);
+    EXPECT_STREQ(kvs_hash_get(&h, "raw"), "100");
+
+    // 不是整数、溢出：值不变
+    EXPECT_EQ_INT(kvs_hash_set(&h, "s", "abc"), 0);
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "s", 1, &r), 1);
+    EXPECT_STREQ(kvs_hash_get(&h, "s"), "abc");
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "n", "9223372036854775807"), 0);
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "n", 1, &r), 2);
+    EXPECT_STREQ(kvs_hash_get(&h, "n"), "9223372036854775807");
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "n", INT64_MIN, &r), 0);
+    EXPECT_TRUE(r == -1);
+    EXPECT_EQ_INT(kvs_hash_incr(NULL, "n", 1, &r), -1);
+
+    EXPECT_EQ_INT(kvs_hash_del(&h, "n"), 0);
+    EXPECT_EQ_INT(kvs_hash_del(&h, "raw"), 0);
+    EXPECT_EQ_INT(kvs_hash_del(&h, "s"), 0);
+    kvs_alloc_thread_stats(&st1);
+    EXPECT_TRUE(st1.requested == st0.requested);
+
+    kvs_hash_destory(&h);
+}
+
+static void test_batch(void)
+{
+    printf("[TEST] hash: batch...\n");
+
+    kvs_hash_t h = {0};
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+
+    // 跨越分组且中途扩表：预先算好的 hash 在扩表后仍要落到正确的桶
+    enum { N = 1500 };
+    static char kbuf[N][16], vbuf[N][16];
+    char *keys[N], *vals[N];
+    int results[N];
+    for (int i = 0; i < N; i++)
+    {
+        snprintf(kbuf[i], sizeof(kbuf[i]), "bk-%d", i);
+        snprintf(vbuf[i], sizeof(vbuf[i]), "bv-%d", i);
+        keys[i] = kbuf[i];
+        vals[i] = vbuf[i];
+    }
+    keys[N - 1] = keys[3]; // 重复 key：第二次为已存在
+    EXPECT_EQ_INT(kvs_hash_mset(&h, keys, vals, N, results), N - 1);
+    EXPECT_EQ_INT(results[3], 0);
+    EXPECT_EQ_INT(results[N - 1], 1);
+    EXPECT_EQ_INT(kvs_hash_count(&h), N - 1);
+    EXPECT_TRUE(h.max_slots > MAX_TABLE_SIZE);
+
+    for (int i = 0; i < N - 1; i++)
+        EXPECT_STREQ(kvs_hash_get(&h, keys[i]), vals[i]);
+
+    // 一半不存在
+    char *mvals[N];
+    for (int i = 0; i < N; i += 2)
+        snprintf(kbuf[i], sizeof(kbuf[i]), "none-%d", i);
+    EXPECT_EQ_INT(kvs_hash_mget(&h, keys, N - 1, mvals), (N - 1) / 2);
+    for (int i = 0; i < N - 1; i++)
+    {
+        if (i % 2 == 0)
+            EXPECT_TRUE(mvals[i] == NULL);
+        else
+            EXPECT_STREQ(mvals[i], vals[i]);
+    }
+
+    EXPECT_EQ_INT(kvs_hash_mget(&h, keys, 0, mvals), 0);
+    EXPECT_EQ_INT(kvs_hash_mget(NULL, keys, 1, mvals), -1);
+    EXPECT_EQ_INT(kvs_hash_mset(&h, keys, vals, -1, results), -1);
+
+    kvs_hash_destory(&h);
+}
+
+// 每个 key 被 SCAN 到的次数
+static int seen[20000];
+
+static void scan_count(void *arg, const char *key, const char *value)
+{
+    (void)arg;
+    (void)value;
+    int i;
+    if (sscanf(key, "key-%d", &i) == 1)
+        seen[i]++;
+}
+
+static void test_scan(void)
+{
+    printf("[TEST] hash: scan...\n");
+
+    kvs_hash_t h = {0};
+    char key[32];
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+    EXPECT_TRUE(kvs_hash_scan(&h, 0, scan_count, NULL) == 0); // 紧凑编码一次访问完
+    EXPECT_EQ_INT(kvs_hash_convert(&h), 0);
+    EXPECT_TRUE(kvs_hash_scan(&h, 0, scan_count, NULL) != 0); // 空表也按桶推进
+
+    for (int i = 0; i < 3000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        EXPECT_EQ_INT(kvs_hash_set(&h, key, "v"), 0);
+    }
+
+    // 扫描中途先扩表再缩表：一直存在的 key 至少访问一次
+    memset(seen, 0, sizeof(seen));
+    unsigned long cursor = 0;
+    int calls = 0, grown = 0, shrunk = 0;
+    do
+    {
+        cursor = kvs_hash_scan(&h, cursor, scan_count, NULL);
+        calls++;
+        if (calls == 500)
+        {
+            for (int i = 3000; i < 20000; i++)
+            {
+                snprintf(key, sizeof(key), "key-%d", i);
+                kvs_hash_set(&h, key, "v");
+            }
+            grown = h.max_slots;
+        }
+        if (calls == 5000)
+        {
+            for (int i = 1000; i < 20000; i++)
+            {
+                snprintf(key, sizeof(key), "key-%d", i);
+                kvs_hash_del(&h, key);
+            }
+            shrunk = h.max_slots;
+        }
+    } while (cursor != 0);
+
+    EXPECT_TRUE(grown > 4096);
+    EXPECT_TRUE(shrunk < grown);
+    for (int i = 0; i < 1000; i++)
+        EXPECT_TRUE(seen[i] >= 1);
+
+    // 表不变时每个 key 恰好访问一次，桶数次调用后回到 0
+    memset(seen, 0, sizeof(seen));
+    cursor = 0;
+    calls = 0;
+    do
+    {
+        cursor = kvs_hash_scan(&h, cursor, scan_count, NULL);
+        calls++;
+    } while (cursor != 0);
+    EXPECT_EQ_INT(calls, h.max_slots);
+    for (int i = 0; i < 1000; i++)
+        EXPECT_EQ_INT(seen[i], 1);
 
     kvs_hash_destory(&h);
 }
@@ -147,11 +526,228 @@ static void test_invalid_args(void)
     kvs_hash_destory(&h);
 }
 
+static void test_defrag(void)
+{
+    printf("[TEST] hash: defrag...\n");
+
+    kvs_set_allocator(KVS_ALLOC_MYPOOL);
+
+    kvs_hash_t h = {0};
+    char key[32], value[64];
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+
+    for (int i = 0; i < 6000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        snprintf(value, sizeof(value), "value-%d-xxxxxxxxxxxxxxxx", i);
+        EXPECT_EQ_INT(kvs_hash_set(&h, key, value), 0);
+    }
+    // 删掉 2/3：mypool 的小块不回收，碎片率上升
+    for (int i = 0; i < 6000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        if (i % 3 != 0)
+            EXPECT_EQ_INT(kvs_hash_del(&h, key), 0);
+    }
+
+    kvs_alloc_stats_t before, after;
+    kvs_alloc_thread_stats(&before);
+
+    // 分批搬迁，批次之间照常写入/删除
+    EXPECT_EQ_INT(kvs_alloc_defrag_begin(), 0);
+    int cursor = 0, steps = 0, extra = 0;
+    while (kvs_hash_defrag(&h, &cursor, 50))
+    {
+        snprintf(key, sizeof(key), "new-%d", extra++);
+        EXPECT_EQ_INT(kvs_hash_set(&h, key, "fresh"), 0);
+        snprintf(key, sizeof(key), "key-%d", steps * 3);
+        kvs_hash_del(&h, key); // 可能已被删过
+        steps++;
+    }
+    EXPECT_TRUE(steps > 1);
+    kvs_alloc_defrag_end();
+
+    kvs_alloc_thread_stats(&after);
+    EXPECT_TRUE(after.reserved < before.reserved);
+
+    for (int i = 0; i < 6000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        snprintf(value, sizeof(value), "value-%d-xxxxxxxxxxxxxxxx", i);
+        if (i % 3 == 0 && i / 3 >= steps)
+            EXPECT_STREQ(kvs_hash_get(&h, key), value);
+        else
+            EXPECT_TRUE(kvs_hash_get(&h, key) == NULL);
+    }
+    for (int i = 0; i < extra; i++)
+    {
+        snprintf(key, sizeof(key), "new-%d", i);
+        EXPECT_STREQ(kvs_hash_get(&h, key), "fresh");
+    }
+
+    kvs_hash_destory(&h);
+    kvs_set_allocator(KVS_ALLOC_SYSTEM);
+}
+
+static int walked;
+
+static void walk_value(void *arg, const char *key, kvs_value_t *v)
+{
+    (void)arg;
+    char want[32];
+    snprintf(want, sizeof(want), "val-%s", key);
+    EXPECT_STREQ(kvs_value_str(v), want);
+    EXPECT_TRUE(kvs_value_packed(v) == NULL);
+    walked++;
+}
+
+// 在 h 里写入 n 个 key，返回申请的字节数
+static int64_t fill(kvs_hash_t *h, int n)
+{
+    kvs_alloc_stats_t st0, st1;
+    kvs_alloc_thread_stats(&st0);
+    char key[32], val[32];
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(val, sizeof(val), "val-k%d", i);
+        EXPECT_EQ_INT(kvs_hash_set(h, key, val), 0);
+    }
+    kvs_alloc_thread_stats(&st1);
+    return st1.requested - st0.requested;
+}
+
+static void test_compact(void)
+{
+    printf("[TEST] hash: compact encoding...\n");
+
+    // 几十个 key：紧凑编码比哈希表省一个数量级
+    kvs_hash_t h = {0}, t = {0};
+    EXPECT_EQ_INT(kvs_hash_create(&h), 0);
+    EXPECT_EQ_INT(kvs_hash_create(&t), 0);
+    int64_t compact = fill(&h, 40);
+    EXPECT_EQ_INT(kvs_hash_convert(&t), 0);
+    int64_t table = fill(&t, 40) + (int64_t)sizeof(hashnode_t *) * MAX_TABLE_SIZE; // 加上桶数组
+    EXPECT_TRUE(h.nodes == NULL && h.lp != NULL);
+    EXPECT_TRUE(compact * 10 < table);
+    kvs_hash_destory(&t);
+
+    // 各种操作在紧凑编码里完成
+    EXPECT_STREQ(kvs_hash_get(&h, "k7"), "val-k7");
+    EXPECT_EQ_INT(kvs_hash_set(&h, "k7", "x"), 1);
+    EXPECT_EQ_INT(kvs_hash_exist(&h, "k39"), 0);
+    EXPECT_EQ_INT(kvs_hash_exist(&h, "k40"), 1);
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "k7", "a-longer-value-for-k7"), 0);
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "k8", "s"), 0);
+    EXPECT_STREQ(kvs_hash_get(&h, "k7"), "a-longer-value-for-k7");
+    EXPECT_STREQ(kvs_hash_get(&h, "k8"), "s");
+    EXPECT_STREQ(kvs_hash_get(&h, "k9"), "val-k9"); // 后面的条目挪动后仍完整
+    EXPECT_EQ_INT(kvs_hash_upsert(&h, "k8", "val-k8"), 1);
+    EXPECT_EQ_INT(kvs_hash_upsert(&h, "new", "1"), 0);
+
+    kvs_value_t old;
+    EXPECT_EQ_INT(kvs_hash_getset(&h, "k7", "val-k7", &old), 1);
+    EXPECT_STREQ(kvs_value_str(&old), "a-longer-value-for-k7");
+    kvs_value_free(&old);
+    EXPECT_EQ_INT(kvs_hash_cas(&h, "new", "2", "3"), 2);
+    EXPECT_EQ_INT(kvs_hash_cas(&h, "new", "1", "9"), 0);
+
+    int64_t r = 0;
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "new", 1, &r), 0);
+    EXPECT_TRUE(r == 10);
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "k1", 1, &r), 1);
+    EXPECT_EQ_INT(kvs_hash_incr(&h, "ctr", -5, &r), 0);
+    EXPECT_STREQ(kvs_hash_get(&h, "ctr"), "-5");
+    EXPECT_EQ_INT(kvs_hash_del(&h, "new"), 0);
+    EXPECT_EQ_INT(kvs_hash_del(&h, "ctr"), 0);
+    EXPECT_EQ_INT(kvs_hash_del(&h, "ctr"), 1);
+
+    char *keys[] = {"k0", "nope", "k39"};
+    char *vals[3];
+    EXPECT_EQ_INT(kvs_hash_mget(&h, keys, 3, vals), 2);
+    EXPECT_STREQ(vals[2], "val-k39");
+    EXPECT_TRUE(vals[1] == NULL);
+
+    walked = 0;
+    EXPECT_TRUE(kvs_hash_values(&h, 0, walk_value, NULL) == 0);
+    EXPECT_EQ_INT(walked, 40);
+    EXPECT_TRUE(h.nodes == NULL && kvs_hash_count(&h) == 40);
+
+    // 超过任一上限时整体转为哈希表，内容不变
+    char big[KVS_HASH_COMPACT_LEN + 2];
+    memset(big, 'b', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "k3", big), 0);
+    EXPECT_TRUE(h.nodes != NULL && h.lp == NULL && h.max_slots == MAX_TABLE_SIZE);
+    EXPECT_STREQ(kvs_hash_get(&h, "k3"), big);
+    EXPECT_EQ_INT(kvs_hash_mod(&h, "k3", "val-k3"), 0);
+    walked = 0;
+    for (unsigned long c = kvs_hash_values(&h, 0, walk_value, NULL); c; c = kvs_hash_values(&h, c, walk_value, NULL))
+        ;
+    EXPECT_EQ_INT(walked, 40);
+    kvs_hash_destory(&h);
+
+    kvs_hash_t f = {0};
+    EXPECT_EQ_INT(kvs_hash_create(&f), 0);
+    fill(&f, KVS_HASH_COMPACT_COUNT);
+    EXPECT_TRUE(f.nodes == NULL);
+    EXPECT_EQ_INT(kvs_hash_set(&f, "one-more", "v"), 0);
+    EXPECT_TRUE(f.nodes != NULL && kvs_hash_count(&f) == KVS_HASH_COMPACT_COUNT + 1);
+    EXPECT_STREQ(kvs_hash_get(&f, "k100"), "val-k100");
+    kvs_hash_destory(&f);
+
+    EXPECT_EQ_INT(kvs_hash_create(&f), 0);
+    EXPECT_EQ_INT(kvs_hash_set(&f, "a", "1"), 0);
+    EXPECT_EQ_INT(kvs_hash_set(&f, big, "long key"), 0);
+    EXPECT_TRUE(f.nodes != NULL);
+    EXPECT_STREQ(kvs_hash_get(&f, "a"), "1");
+    kvs_hash_destory(&f);
+
+    // 会被压缩的值不进紧凑编码
+    EXPECT_EQ_INT(kvs_hash_create(&f), 0);
+    kvs_value_compress_threshold(32);
+    EXPECT_EQ_INT(kvs_hash_set(&f, "a", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"), 0);
+    kvs_value_compress_threshold(0);
+    EXPECT_TRUE(f.nodes != NULL);
+    kvs_hash_destory(&f);
+
+    // 删空后不占内存；整表摘下与释放
+    kvs_alloc_stats_t st0, st1;
+    kvs_alloc_thread_stats(&st0);
+    EXPECT_EQ_INT(kvs_hash_create(&f), 0);
+    fill(&f, 20);
+    for (int i = 0; i < 20; i++)
+    {
+        char key[32];
+        snprintf(key, sizeof(key), "k%d", i);
+        EXPECT_EQ_INT(kvs_hash_del(&f, key), 0);
+    }
+    EXPECT_TRUE(f.lp == NULL && kvs_hash_count(&f) == 0);
+    fill(&f, 20);
+    kvs_hash_t out = {0};
+    int cursor = 0;
+    EXPECT_EQ_INT(kvs_hash_detach(&f, &out), 0);
+    EXPECT_TRUE(f.lp == NULL && kvs_hash_count(&f) == 0 && kvs_hash_count(&out) == 20);
+    EXPECT_EQ_INT(kvs_hash_release(&out, &cursor, 1), 0);
+    kvs_alloc_thread_stats(&st1);
+    EXPECT_TRUE(st1.requested == st0.requested);
+    kvs_hash_destory(&f);
+}
+
 int main(void)
 {
     test_basic_api();
     test_collision_and_delete_positions();
+    test_resize();
+    test_upsert_getset_cas();
+    test_mod_in_place();
+    test_value_encoding();
+    test_incr();
+    test_batch();
+    test_scan();
     test_invalid_args();
+    test_defrag();
+    test_compact();
 
     printf("[OK] all kvs_hash unit tests passed.\n");
     return 0;
@@ -0,0 +1,297 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine/kvs_hash.h"
+#include "engine/kvs_intkey.h"
+
+#define N 20000
+
+static uint64_t rnd_state = 88172645463325252ull;
+
+static uint64_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 7;
+    rnd_state ^= rnd_state << 17;
+    return rnd_state;
+}
+
+// 红黑树性质：根黑、红节点没有红孩子、每条路径黑高相同、父指针一致、中序有序；返回黑高
+static int check_node(kvs_itree_link_t *n, kvs_itree_link_t *parent, int *count)
+{
+    if (!n)
+        return 1;
+    assert(kvs_itree_parent(n) == parent);
+    int red = !(n->parent_color & 1);
+    if (red)
+    {
+        assert(!n->left || (n->left->parent_color & 1));
+        assert(!n->right || (n->right->parent_color & 1));
+    }
+    if (n->left)
+        assert(((kvs_u64tree_node_t *)n->left)->key < ((kvs_u64tree_node_t *)n)->key);
+    if (n->right)
+        assert(((kvs_u64tree_node_t *)n->right)->key > ((kvs_u64tree_node_t *)n)->key);
+    int l = check_node(n->left, n, count);
+    int r = check_node(n->right, n, count);
+    assert(l == r);
+    (*count)++;
+    return l + !red;
+}
+
+static void check_tree(kvs_u64tree_t *t)
+{
+    int count = 0;
+    assert(!t->root || (t->root->parent_color & 1));
+    check_node(t->root, NULL, &count);
+    assert(count == t->count);
+}
+
+static void test_hash_basic(void)
+{
+    printf("[TEST] intkey: hash basic...\n");
+
+    kvs_u64hash_t h = {0};
+    assert(kvs_u64hash_create(&h) == 0);
+    assert(h.slots == NULL);
+    assert(kvs_u64hash_get(&h, 1) == NULL);
+    assert(kvs_u64hash_del(&h, 1) == 1);
+
+    assert(kvs_u64hash_set(&h, 0, "zero") == 0);
+    assert(kvs_u64hash_set(&h, UINT64_MAX, "max") == 0);
+    assert(kvs_u64hash_set(&h, 0, "again") == 1);
+    assert(strcmp(kvs_u64hash_get(&h, 0), "zero") == 0);
+    assert(strcmp(kvs_u64hash_get(&h, UINT64_MAX), "max") == 0);
+    assert(kvs_u64hash_exist(&h, 0) == 0 && kvs_u64hash_exist(&h, 2) == 1);
+
+    assert(kvs_u64hash_mod(&h, 0, "changed") == 0);
+    assert(kvs_u64hash_mod(&h, 2, "x") == 1);
+    assert(strcmp(kvs_u64hash_get(&h, 0), "changed") == 0);
+    assert(kvs_u64hash_upsert(&h, 2, "two") == 0);
+    assert(kvs_u64hash_upsert(&h, 2, "TWO") == 1);
+    assert(strcmp(kvs_u64hash_get(&h, 2), "TWO") == 0);
+
+    int64_t r;
+    assert(kvs_u64hash_incr(&h, 3, 5, &r) == 0 && r == 5);
+    assert(kvs_u64hash_incr(&h, 3, -7, &r) == 0 && r == -2);
+    assert(strcmp(kvs_u64hash_get(&h, 3), "-2") == 0);
+    assert(kvs_u64hash_incr(&h, 2, 1, &r) == 1);
+
+    assert(kvs_u64hash_count(&h) == 4);
+    assert(kvs_u64hash_del(&h, 0) == 0 && kvs_u64hash_get(&h, 0) == NULL);
+    assert(kvs_u64hash_count(&h) == 3);
+    assert(kvs_u64hash_set(&h, 1, NULL) == -1);
+
+    kvs_u64hash_destory(&h);
+    assert(h.slots == NULL && kvs_u64hash_count(&h) == 0);
+}
+
+static void count_fn(void *arg, uint64_t key, kvs_value_t *v)
+{
+    (void)key;
+    (void)v;
+    (*(int *)arg)++;
+}
+
+// 随机增删与参照数组比对：覆盖扩容、缩表和删除后移填补
+static void test_hash_random(void)
+{
+    printf("[TEST] intkey: hash random...\n");
+
+    static int present[N];
+    memset(present, 0, sizeof(present));
+    kvs_u64hash_t h = {0};
+    assert(kvs_u64hash_create(&h) == 0);
+
+    // key 取 i * 1024：低位全相同，依赖乘法散列打散
+    char buf[32];
+    int live = 0;
+    for (int round = 0; round < 8 * N; round++)
+    {
+        int i = (int)(rnd() % N);
+        uint64_t key = (uint64_t)i << 10;
+        snprintf(buf, sizeof(buf), "v%d", i);
+        if (rnd() % 3)
+        {
+            assert(kvs_u64hash_set(&h, key, buf) == (present[i] ? 1 : 0));
+            if (!present[i])
+                live++;
+            present[i] = 1;
+        }
+        else
+        {
+            assert(kvs_u64hash_del(&h, key) == (present[i] ? 0 : 1));
+            if (present[i])
+                live--;
+            present[i] = 0;
+        }
+    }
+    assert(kvs_u64hash_count(&h) == live);
+    for (int i = 0; i < N; i++)
+    {
+        char *v = kvs_u64hash_get(&h, (uint64_t)i << 10);
+        snprintf(buf, sizeof(buf), "v%d", i);
+        assert(present[i] ? v && strcmp(v, buf) == 0 : v == NULL);
+    }
+    int seen = 0;
+    kvs_u64hash_foreach(&h, count_fn, &seen);
+    assert(seen == live);
+
+    // 删到只剩一个：表缩回最小
+    uint32_t grown = h.bits;
+    assert(grown > KVS_INTHASH_MIN_BITS);
+    for (int i = 1; i < N; i++)
+        kvs_u64hash_del(&h, (uint64_t)i << 10);
+    kvs_u64hash_upsert(&h, 0, "last");
+    assert(kvs_u64hash_count(&h) == 1 && h.bits == KVS_INTHASH_MIN_BITS);
+    assert(strcmp(kvs_u64hash_get(&h, 0), "last") == 0);
+
+    kvs_u64hash_destory(&h);
+    kvs_value_scratch_reset();
+}
+
+typedef struct walk_s
+{
+    uint64_t last;
+    int n;
+} walk_t;
+
+static void walk_fn(void *arg, uint64_t key, kvs_value_t *v)
+{
+    walk_t *w = arg;
+    assert(w->n == 0 || key > w->last);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long)key);
+    assert(strcmp(kvs_value_str(v), buf) == 0);
+    w->last = key;
+    w->n++;
+}
+
+static void test_tree(void)
+{
+    printf("[TEST] intkey: tree...\n");
+
+    static int present[N];
+    memset(present, 0, sizeof(present));
+    kvs_u64tree_t t = {0};
+    assert(kvs_u64tree_create(&t) == 0);
+    assert(kvs_u64tree_get(&t, 1) == NULL && kvs_u64tree_del(&t, 1) == 1);
+
+    char buf[32];
+    int live = 0;
+    for (int round = 0; round < 8 * N; round++)
+    {
+        int i = (int)(rnd() % N);
+        snprintf(buf, sizeof(buf), "%d", i);
+        if (rnd() % 3)
+        {
+            assert(kvs_u64tree_set(&t, (uint64_t)i, buf) == (present[i] ? 1 : 0));
+            if (!present[i])
+                live++;
+            present[i] = 1;
+        }
+        else
+        {
+            assert(kvs_u64tree_del(&t, (uint64_t)i) == (present[i] ? 0 : 1));
+            if (present[i])
+                live--;
+            present[i] = 0;
+        }
+        if (round % 4096 == 0)
+            check_tree(&t);
+    }
+    check_tree(&t);
+    assert(kvs_u64tree_count(&t) == live);
+
+    // 中序遍历与区间遍历
+    walk_t w = {0, 0};
+    kvs_u64tree_foreach(&t, walk_fn, &w);
+    assert(w.n == live);
+
+    int expect = 0;
+    for (int i = 1000; i <= 2000; i++)
+        expect += present[i];
+    w = (walk_t){0, 0};
+    kvs_u64tree_range(&t, 1000, 2000, walk_fn, &w);
+    assert(w.n == expect);
+    w = (walk_t){0, 0};
+    kvs_u64tree_range(&t, N, UINT64_MAX, walk_fn, &w);
+    assert(w.n == 0);
+
+    // 其余接口
+    assert(kvs_u64tree_upsert(&t, N + 1, "x") == 0);
+    assert(kvs_u64tree_upsert(&t, N + 1, "y") == 1);
+    assert(kvs_u64tree_mod(&t, N + 1, "z") == 0 && strcmp(kvs_u64tree_get(&t, N + 1), "z") == 0);
+    assert(kvs_u64tree_mod(&t, N + 2, "z") == 1);
+    int64_t r;
+    assert(kvs_u64tree_incr(&t, N + 2, 10, &r) == 0 && r == 10);
+    assert(kvs_u64tree_incr(&t, N + 2, 1, &r) == 0 && strcmp(kvs_u64tree_get(&t, N + 2), "11") == 0);
+    assert(kvs_u64tree_incr(&t, N + 1, 1, &r) == 1);
+    assert(kvs_u64tree_exist(&t, N + 2) == 0 && kvs_u64tree_exist(&t, N + 3) == 1);
+    check_tree(&t);
+
+    // 顺序插入与全部删除
+    kvs_u64tree_destory(&t);
+    assert(t.root == NULL && kvs_u64tree_count(&t) == 0);
+    for (uint64_t k = 0; k < N; k++)
+    {
+        snprintf(buf, sizeof(buf), "%llu", (unsigned long long)k);
+        assert(kvs_u64tree_set(&t, k, buf) == 0);
+    }
+    check_tree(&t);
+    for (uint64_t k = 0; k < N; k += 2)
+        assert(kvs_u64tree_del(&t, k) == 0);
+    check_tree(&t);
+    for (uint64_t k = 1; k < N; k += 2)
+        assert(kvs_u64tree_del(&t, k) == 0);
+    assert(t.root == NULL && kvs_u64tree_count(&t) == 0);
+
+    kvs_u64tree_destory(&t);
+    kvs_value_scratch_reset();
+}
+
+// 整数 key 内嵌：同样的数据，占用比字符串 key 的哈希表少
+static void test_memory(void)
+{
+    printf("[TEST] intkey: memory...\n");
+
+    char key[32];
+    int n = 10000;
+    kvs_alloc_stats_t st0, st1;
+
+    kvs_alloc_thread_stats(&st0);
+    kvs_hash_t h = {0};
+    assert(kvs_hash_create(&h) == 0);
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(key, sizeof(key), "%d", i);
+        assert(kvs_hash_set(&h, key, "v") == 0);
+    }
+    kvs_alloc_thread_stats(&st1);
+    int64_t str_bytes = st1.requested - st0.requested;
+
+    kvs_alloc_thread_stats(&st0);
+    kvs_u64hash_t u = {0};
+    assert(kvs_u64hash_create(&u) == 0);
+    for (int i = 0; i < n; i++)
+        assert(kvs_u64hash_set(&u, (uint64_t)i, "v") == 0);
+    kvs_alloc_thread_stats(&st1);
+    int64_t int_bytes = st1.requested - st0.requested;
+
+    assert(int_bytes < str_bytes);
+    kvs_hash_destory(&h);
+    kvs_u64hash_destory(&u);
+}
+
+int main(void)
+{
+    test_hash_basic();
+    test_hash_random();
+    test_tree();
+    test_memory();
+
+    printf("[OK] all kvs_intkey unit tests passed.\n");
+    return 0;
+}
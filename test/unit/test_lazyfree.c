@@ -0,0 +1,177 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "engine/kvs_lazyfree.h"
+
+static int64_t requested(void)
+{
+    kvs_alloc_stats_t st;
+    kvs_alloc_stats(&st);
+    return st.requested;
+}
+
+static void test_detach_release(void)
+{
+    printf("[TEST] lazyfree: detach_release...\n");
+
+    kvs_set_allocator(KVS_ALLOC_SYSTEM);
+    int64_t base = requested();
+
+    kvs_array_t arr = {0};
+    kvs_rbtree_t tree;
+    kvs_hash_t hash = {0};
+    assert(kvs_array_create(&arr) == 0);
+    assert(kvs_rbtree_create(&tree) == 0);
+    assert(kvs_hash_create(&hash) == 0);
+
+    char key[32], val[32];
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(val, sizeof(val), "v%d", i);
+        assert(kvs_array_set(&arr, key, val) == 0);
+        assert(kvs_rbtree_set(&tree, key, val) == 0);
+        assert(kvs_hash_set(&hash, key, val) == 0);
+    }
+    assert(kvs_array_del(&arr, "k10") == 0); // 中间留一个空洞
+
+    kvs_array_t arr_old;
+    kvs_rbtree_t tree_old;
+    kvs_hash_t hash_old;
+    assert(kvs_array_detach(&arr, &arr_old) == 0);
+    assert(kvs_rbtree_detach(&tree, &tree_old) == 0);
+    assert(kvs_hash_detach(&hash, &hash_old) == 0);
+
+    // 摘下后原实例为空且可继续使用
+    assert(kvs_array_get(&arr, "k1") == NULL);
+    assert(kvs_rbtree_get(&tree, "k1") == NULL);
+    assert(kvs_hash_get(&hash, "k1") == NULL);
+    assert(kvs_hash_count(&hash) == 0);
+    assert(kvs_rbtree_set(&tree, "k1", "new") == 0);
+
+    // 小步释放，直到全部放完
+    int steps = 0, cursor = 0;
+    while (kvs_array_release(&arr_old, 7) | kvs_rbtree_release(&tree_old, 7) | kvs_hash_release(&hash_old, &cursor, 7))
+        steps++;
+    assert(steps >= 1000 / 7);
+    assert(strcmp(kvs_rbtree_get(&tree, "k1"), "new") == 0);
+
+    kvs_array_destory(&arr);
+    kvs_rbtree_destory(&tree);
+    kvs_hash_destory(&hash);
+    assert(requested() == base);
+}
+
+static void test_background(void)
+{
+    printf("[TEST] lazyfree: background...\n");
+
+    kvs_set_allocator(KVS_ALLOC_SYSTEM);
+    int64_t base = requested();
+
+    kvs_hash_t hash = {0};
+    kvs_rbtree_t tree;
+    assert(kvs_hash_create(&hash) == 0);
+    assert(kvs_rbtree_create(&tree) == 0);
+
+    char key[32];
+    for (int i = 0; i < 20000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        assert(kvs_hash_set(&hash, key, "value") == 0);
+        assert(kvs_rbtree_set(&tree, key, "value") == 0);
+    }
+
+    assert(kvs_lazyfree_hash(&hash) == 0);
+    assert(kvs_lazyfree_rbtree(&tree) == 0);
+    assert(kvs_hash_count(&hash) == 0);
+    assert(kvs_rbtree_exist(&tree, "key-1") == 1);
+    assert(kvs_lazyfree_step(KVS_LAZYFREE_BATCH) == 0); // 不占用本线程的队列
+
+    kvs_lazyfree_wait();
+    assert(kvs_lazyfree_pending() == 0);
+
+    kvs_hash_destory(&hash);
+    kvs_rbtree_destory(&tree);
+    assert(requested() == base);
+}
+
+static void test_value(void)
+{
+    printf("[TEST] lazyfree: value...\n");
+
+    kvs_set_allocator(KVS_ALLOC_SYSTEM);
+    kvs_lazyfree_enable(1);
+    int64_t base = requested();
+
+    static char big[KVS_LAZYFREE_MIN_VALUE + 1];
+    memset(big, 'x', sizeof(big) - 1);
+
+    kvs_hash_t hash = {0};
+    assert(kvs_hash_create(&hash) == 0);
+    assert(kvs_hash_set(&hash, "big", big) == 0);
+    assert(kvs_hash_set(&hash, "small", "v") == 0);
+    assert(kvs_hash_mod(&hash, "big", "v") == 0); // 旧的大 value 交给后台
+    assert(kvs_hash_del(&hash, "small") == 0);    // 小 value 直接释放
+    assert(strcmp(kvs_hash_get(&hash, "big"), "v") == 0);
+
+    kvs_lazyfree_wait();
+    kvs_hash_destory(&hash);
+    assert(requested() == base);
+    kvs_lazyfree_enable(0);
+}
+
+static void test_mypool(void)
+{
+    printf("[TEST] lazyfree: mypool...\n");
+
+    kvs_set_allocator(KVS_ALLOC_MYPOOL);
+
+    kvs_rbtree_t tree;
+    kvs_array_t arr = {0};
+    assert(kvs_rbtree_create(&tree) == 0);
+    assert(kvs_array_create(&arr) == 0);
+
+    char key[32];
+    for (int i = 0; i < 5000; i++)
+    {
+        snprintf(key, sizeof(key), "key-%d", i);
+        assert(kvs_rbtree_set(&tree, key, "value") == 0);
+        if (i < 1000)
+            assert(kvs_array_set(&arr, key, "value") == 0);
+    }
+
+    kvs_alloc_stats_t before, after;
+    kvs_alloc_thread_stats(&before);
+
+    // pool 线程私有：任务留在本线程，由调用方分批推进
+    assert(kvs_lazyfree_rbtree(&tree) == 0);
+    assert(kvs_lazyfree_array(&arr) == 0);
+    assert(kvs_lazyfree_pending() == 2);
+    kvs_alloc_thread_stats(&after);
+    assert(after.requested >= before.requested); // 只多了新建的空表
+
+    int steps = 0;
+    while (kvs_lazyfree_step(100))
+        steps++;
+    assert(steps >= 5000 / 100);
+    assert(kvs_lazyfree_pending() == 0);
+
+    kvs_alloc_thread_stats(&after);
+    assert(after.requested < before.requested);
+
+    kvs_rbtree_destory(&tree);
+    kvs_array_destory(&arr);
+}
+
+int main(void)
+{
+    test_detach_release();
+    test_background();
+    test_value();
+    test_mypool();
+
+    printf("[OK] all kvs_lazyfree unit tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "engine/kvs_lzf.h"
+#include "engine/kvs_vlog.h"
+
+// 类似线上的 JSON：字段名重复，数值变化
+static size_t json(char *buf, size_t cap, int n)
+{
+    size_t len = 0;
+    len += (size_t)snprintf(buf + len, cap - len, "{\"items\":[");
+    for (int i = 0; i < n && len + 128 < cap; i++)
+        len += (size_t)snprintf(buf + len, cap - len, "%s{\"id\":%d,\"name\":\"user-%d\",\"active\":%s,\"score\":%d}",
+                                i ? "," : "", i, i * 7, i % 2 ? "true" : "false", (i * 37) % 1000);
+    len += (size_t)snprintf(buf + len, cap - len, "]}");
+    return len;
+}
+
+static void roundtrip(const char *in, size_t len, size_t *clen)
+{
+    size_t cap = len + len / 16 + 64;
+    char *c = malloc(cap);
+    char *d = malloc(len + 1);
+    assert(c && d);
+    *clen = kvs_lzf_compress(in, len, c, cap);
+    if (len >= 4)
+        assert(*clen > 0);
+    if (*clen)
+    {
+        assert(kvs_lzf_decompress(c, *clen, d, len) == len);
+        assert(memcmp(in, d, len) == 0);
+        // 输出缓冲少一个字节：报错而不是越界
+        if (len > 0)
+            assert(kvs_lzf_decompress(c, *clen, d, len - 1) == 0);
+    }
+    free(c);
+    free(d);
+}
+
+static void test_codec(void)
+{
+    printf("[TEST] lzf: codec...\n");
+
+    static char buf[1 << 18];
+    size_t clen;
+
+    size_t len = json(buf, sizeof(buf), 2000);
+    roundtrip(buf, len, &clen);
+    assert(clen * 3 < len);
+
+    // 长重复串：匹配长度超过一个控制字节能表示的范围
+    memset(buf, 'a', 100000);
+    roundtrip(buf, 100000, &clen);
+    assert(clen < 2000);
+
+    // 随机数据压不动：输出给得刚好不够时返回 0
+    srand(1);
+    for (size_t i = 0; i < 65536; i++)
+        buf[i] = (char)rand();
+    roundtrip(buf, 65536, &clen);
+    char out[65536];
+    assert(kvs_lzf_compress(buf, 65536, out, 65536 - 65536 / 8) == 0);
+
+    // 各种短长度与字面量段边界
+    for (size_t n = 0; n < 100; n++)
+        roundtrip(buf, n, &clen);
+
+    // 损坏的数据：回溯越过开头、截断
+    const unsigned char bad1[] = {0x00, 'a', 0x20, 0x05};
+    assert(kvs_lzf_decompress(bad1, sizeof(bad1), out, sizeof(out)) == 0);
+    const unsigned char bad2[] = {0x05, 'a', 'b'};
+    assert(kvs_lzf_decompress(bad2, sizeof(bad2), out, sizeof(out)) == 0);
+    const unsigned char bad3[] = {0x00, 'a', 0xe0};
+    assert(kvs_lzf_decompress(bad3, sizeof(bad3), out, sizeof(out)) == 0);
+}
+
+static void test_value(void)
+{
+    printf("[TEST] lzf: value...\n");
+
+    static char big[1 << 16];
+    json(big, sizeof(big), 300);
+    char small[] = "a-short-value-below-the-threshold";
+
+    kvs_value_compress_threshold(256);
+
+    kvs_value_t v = {0};
+    assert(kvs_value_init(&v, big) == 0 && v.in.enc == KVS_ENC_LZF);
+    assert(v.raw.cap * 3 < strlen(big));
+    assert(strcmp(kvs_value_str(&v), big) == 0);
+
+    // 压不动的照原样存
+    kvs_value_t r = {0};
+    char noise[512];
+    srand(2);
+    for (size_t i = 0; i < sizeof(noise) - 1; i++)
+        noise[i] = (char)('!' + rand() % 90);
+    noise[sizeof(noise) - 1] = '\0';
+    assert(kvs_value_init(&r, noise) == 0 && r.in.enc == KVS_ENC_RAW);
+    assert(kvs_value_packed(&r) == NULL);
+    kvs_value_free(&r);
+
+    // 传输形式：原样还原为同样的压缩数据，不经过解压
+    char *packed = kvs_value_packed(&v);
+    assert(packed && kvs_value_packed_check(packed) == 0);
+    char *copy = strdup(packed);
+    kvs_value_t w = {0};
+    kvs_value_compress_threshold(0); // 接收方不压缩也保留压缩形式
+    kvs_value_packed_input = 1;
+    assert(kvs_value_init(&w, copy) == 0);
+    kvs_value_packed_input = 0;
+    assert(w.in.enc == KVS_ENC_LZF && w.raw.cap == v.raw.cap && memcmp(w.raw.ptr, v.raw.ptr, v.raw.cap) == 0);
+    assert(strcmp(kvs_value_str(&w), big) == 0);
+    free(copy);
+
+    const char *bad[] = {"", "12", ":QUJD", "0:QUJD", "5:QUJ", "5:QU=D", "99999999999:QUJD", "5:QU*D"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        assert(kvs_value_packed_check(bad[i]) < 0);
+
+    // 覆盖、引擎里读写
+    kvs_value_compress_threshold(256);
+    assert(kvs_value_assign(&w, small) == 0 && w.in.enc == KVS_ENC_RAW);
+    assert(kvs_value_assign(&w, big) == 0 && w.in.enc == KVS_ENC_LZF);
+    kvs_value_free(&w);
+    kvs_value_free(&v);
+
+    kvs_hash_t h = {0};
+    assert(kvs_hash_create(&h) == 0);
+    assert(kvs_hash_set(&h, "doc", big) == 0);
+    assert(strcmp(kvs_hash_get(&h, "doc"), big) == 0);
+    big[10] = 'X';
+    assert(kvs_hash_mod(&h, "doc", big) == 0);
+    assert(strcmp(kvs_hash_get(&h, "doc"), big) == 0);
+    kvs_hash_destory(&h);
+
+    kvs_value_compress_threshold(0);
+    kvs_value_scratch_reset();
+}
+
+// 把 arg 指向的值换进引擎
+static void swap_value(void *arg, const char *key, kvs_value_t *v)
+{
+    (void)key;
+    kvs_value_t t = *v;
+    *v = *(kvs_value_t *)arg;
+    *(kvs_value_t *)arg = t;
+}
+
+static void test_damaged(void)
+{
+    printf("[TEST] lzf: damaged payload...\n");
+
+    static char big[1 << 14];
+    size_t len = json(big, sizeof(big), 200);
+    kvs_value_compress_threshold(256);
+    kvs_value_t v = {0};
+    assert(kvs_value_init(&v, big) == 0 && v.in.enc == KVS_ENC_LZF);
+    kvs_value_compress_threshold(0);
+
+    // 完整的 payload 能解出原值
+    kvs_value_scratch_reset();
+    char *s = kvs_value_unpack(v.raw.ptr, v.raw.cap);
+    assert(s && strlen(s) == len && !kvs_value_unreadable);
+
+    // 截断：不足 4 字节的原长、少了尾部数据
+    assert(kvs_value_unpack(v.raw.ptr, 3) == NULL && kvs_value_unreadable);
+    kvs_value_scratch_reset();
+    assert(kvs_value_unpack(v.raw.ptr, v.raw.cap - 8) == NULL && kvs_value_unreadable);
+    kvs_value_scratch_reset();
+
+    // 原长对不上：报错，不是空串
+    uint32_t raw_len = (uint32_t)len + 1;
+    memcpy(v.raw.ptr, &raw_len, sizeof(raw_len));
+    assert(kvs_value_str(&v) == NULL && kvs_value_unreadable);
+
+    // 比较和自增报错，不当成空串或非整数
+    int64_t n;
+    assert(kvs_value_incr(&v, 1, &n) < 0 && v.in.enc == KVS_ENC_LZF);
+    kvs_hash_t h = {0};
+    assert(kvs_hash_create(&h) == 0);
+    assert(kvs_hash_convert(&h) == 0);
+    assert(kvs_hash_set(&h, "doc", "x") == 0);
+    unsigned long cursor = 0;
+    do
+    {
+        cursor = kvs_hash_values(&h, cursor, swap_value, &v);
+    } while (cursor != 0);
+    assert(kvs_hash_get(&h, "doc") == NULL);
+    assert(kvs_hash_cas(&h, "doc", "", "y") < 0);
+    assert(kvs_hash_incr(&h, "doc", 1, &n) < 0);
+    kvs_hash_destory(&h);
+
+    kvs_value_free(&v);
+    kvs_value_scratch_reset();
+}
+
+static void test_vlog(void)
+{
+    printf("[TEST] lzf: vlog...\n");
+
+    char dir[64];
+    snprintf(dir, sizeof(dir), "/tmp/test_lzf.%d", (int)getpid());
+    assert(mkdir(dir, 0700) == 0);
+
+    // 压缩后仍超过阈值的写入日志，日志里存的是压缩数据
+    static char big[1 << 16];
+    size_t len = json(big, sizeof(big), 1000);
+    kvs_vlog_t *log = kvs_vlog_create(dir, 1024, 0);
+    assert(log);
+    kvs_vlog_current = log;
+    kvs_value_compress_threshold(256);
+
+    kvs_value_t v = {0};
+    assert(kvs_value_init(&v, big) == 0 && v.in.enc == KVS_ENC_VLOG && v.vlog.lz);
+    assert(v.vlog.len * 3 < len);
+    assert(strcmp(kvs_value_str(&v), big) == 0);
+
+    char *packed = kvs_value_packed(&v);
+    assert(packed && kvs_value_packed_check(packed) == 0);
+    char *copy = strdup(packed);
+    kvs_value_t w = {0};
+    kvs_value_packed_input = 1;
+    assert(kvs_value_init(&w, copy) == 0 && w.in.enc == KVS_ENC_VLOG && w.vlog.lz && w.vlog.len == v.vlog.len);
+    kvs_value_packed_input = 0;
+    assert(strcmp(kvs_value_str(&w), big) == 0);
+    free(copy);
+
+    kvs_value_free(&v);
+    kvs_value_free(&w);
+    kvs_vlog_stats_t st;
+    kvs_vlog_stats(log, &st);
+    assert(st.live == 0);
+    kvs_vlog_destory(log);
+    kvs_value_compress_threshold(0);
+    kvs_value_scratch_reset();
+    assert(rmdir(dir) == 0);
+}
+
+int main(void)
+{
+    test_codec();
+    test_value();
+    test_damaged();
+    test_vlog();
+
+    printf("[OK] all kvs_lzf unit tests passed.\n");
+    return 0;
+}
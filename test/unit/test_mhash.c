@@ -0,0 +1,192 @@
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "engine/kvs_mhash.h"
+
+#define NKEYS 1000
+
+static char path[64];
+
+static void val(char *buf, size_t cap, int round, int i)
+{
+    // 长度随轮次变化，新旧条目落在不同大小的块里
+    int n = snprintf(buf, cap, "v%d-%d-", round, i);
+    int pad = round % 50;
+    memset(buf + n, 'x', (size_t)pad);
+    buf[n + pad] = '\0';
+}
+
+static void test_basic(void)
+{
+    printf("[TEST] mhash: basic...\n");
+
+    unlink(path);
+    kvs_mhash_t mh;
+    assert(kvs_mhash_create(&mh, path) == 0);
+
+    assert(kvs_mhash_set(&mh, "a", "1") == 0);
+    assert(kvs_mhash_set(&mh, "a", "2") == 1);
+    assert(strcmp(kvs_mhash_get(&mh, "a"), "1") == 0);
+    assert(kvs_mhash_exist(&mh, "a") == 0 && kvs_mhash_exist(&mh, "b") == 1);
+    assert(kvs_mhash_mod(&mh, "a", "a-much-longer-value-than-before") == 0);
+    assert(strcmp(kvs_mhash_get(&mh, "a"), "a-much-longer-value-than-before") == 0);
+    assert(kvs_mhash_mod(&mh, "b", "x") == 1);
+    assert(kvs_mhash_del(&mh, "a") == 0 && kvs_mhash_del(&mh, "a") == 1);
+    assert(kvs_mhash_get(&mh, "a") == NULL && kvs_mhash_count(&mh) == 0);
+
+    // 多次扩表、扩文件
+    char key[32], v[128];
+    for (int i = 0; i < 50000; i++)
+    {
+        snprintf(key, sizeof(key), "key:%d", i);
+        val(v, sizeof(v), i, i);
+        assert(kvs_mhash_set(&mh, key, v) == 0);
+    }
+    assert(kvs_mhash_count(&mh) == 50000 && mh.hdr->nbuckets >= 50000);
+    for (int i = 0; i < 50000; i += 2)
+    {
+        snprintf(key, sizeof(key), "key:%d", i);
+        assert(kvs_mhash_del(&mh, key) == 0);
+    }
+    assert(kvs_mhash_sync(&mh) == 0);
+    kvs_mhash_destory(&mh);
+
+    // 正常关闭后重新打开：不做恢复，直接可用
+    assert(kvs_mhash_create(&mh, path) == 0);
+    assert(kvs_mhash_count(&mh) == 25000);
+    for (int i = 0; i < 50000; i++)
+    {
+        snprintf(key, sizeof(key), "key:%d", i);
+        val(v, sizeof(v), i, i);
+        if (i % 2)
+            assert(strcmp(kvs_mhash_get(&mh, key), v) == 0);
+        else
+            assert(kvs_mhash_get(&mh, key) == NULL);
+    }
+
+    // 删掉的块被复用，文件不再增长
+    uint64_t size = mh.hdr->size;
+    for (int i = 0; i < 50000; i += 2)
+    {
+        snprintf(key, sizeof(key), "key:%d", i);
+        val(v, sizeof(v), i, i);
+        assert(kvs_mhash_set(&mh, key, v) == 0);
+    }
+    assert(mh.hdr->size == size);
+    kvs_mhash_destory(&mh);
+
+    // 不是本引擎的文件
+    FILE *fp = fopen(path, "r+");
+    assert(fp && fwrite("garbage!", 1, 8, fp) == 8);
+    fclose(fp);
+    assert(kvs_mhash_create(&mh, path) < 0);
+    unlink(path);
+}
+
+// 子进程不停地改写 / 删除重建，父进程随机时刻 SIGKILL；重新打开后每个 key 都应是最后确认的值，
+// 只有崩溃时正在写的那个 key 可以是新值
+static void test_crash(void)
+{
+    printf("[TEST] mhash: crash recovery...\n");
+
+    // acked[i]: key i 最后完成的轮次，负数表示该轮删除后还没重建；acked[NKEYS] 为正在写的 key
+    volatile int *acked = mmap(NULL, sizeof(int) * (NKEYS + 1), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(acked != MAP_FAILED);
+
+    char key[32], v[128];
+    for (int trial = 0; trial < 5; trial++)
+    {
+        unlink(path);
+        memset((void *)acked, 0, sizeof(int) * (NKEYS + 1));
+        acked[NKEYS] = -1;
+
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0)
+        {
+            kvs_mhash_t mh;
+            if (kvs_mhash_create(&mh, path) != 0)
+                _exit(1);
+            for (int round = 1;; round++)
+            {
+                for (int i = 0; i < NKEYS; i++)
+                {
+                    snprintf(key, sizeof(key), "k%d", i);
+                    val(v, sizeof(v), round, i);
+                    acked[NKEYS] = i;
+                    if (round == 1)
+                    {
+                        kvs_mhash_set(&mh, key, v);
+                    }
+                    else if (round % 4 == 0)
+                    {
+                        kvs_mhash_del(&mh, key);
+                        acked[i] = -round;
+                        kvs_mhash_set(&mh, key, v);
+                    }
+                    else
+                    {
+                        kvs_mhash_mod(&mh, key, v);
+                    }
+                    acked[i] = round;
+                }
+            }
+        }
+
+        usleep(20000 + trial * 15000);
+        kill(pid, SIGKILL);
+        int status;
+        waitpid(pid, &status, 0);
+        assert(WIFSIGNALED(status));
+
+        kvs_mhash_t mh;
+        assert(kvs_mhash_create(&mh, path) == 0);
+        int present = 0;
+        int inflight = acked[NKEYS];
+        for (int i = 0; i < NKEYS; i++)
+        {
+            snprintf(key, sizeof(key), "k%d", i);
+            char *got = kvs_mhash_get(&mh, key);
+            present += got != NULL;
+
+            int round = acked[i] < 0 ? -acked[i] : acked[i];
+            char next[128];
+            val(v, sizeof(v), round, i);
+            val(next, sizeof(next), round + 1, i);
+            if (i == inflight)
+                assert(!got || strcmp(got, v) == 0 || strcmp(got, next) == 0);
+            else if (acked[i] > 0)
+                assert(got && strcmp(got, v) == 0);
+            else if (acked[i] < 0)
+                assert(!got);
+        }
+        assert(kvs_mhash_count(&mh) == present);
+
+        // 恢复后可以照常写
+        assert(kvs_mhash_set(&mh, "after", "crash") == 0);
+        kvs_mhash_destory(&mh);
+        assert(kvs_mhash_create(&mh, path) == 0);
+        assert(strcmp(kvs_mhash_get(&mh, "after"), "crash") == 0);
+        kvs_mhash_destory(&mh);
+    }
+
+    munmap((void *)acked, sizeof(int) * (NKEYS + 1));
+    unlink(path);
+}
+
+int main(void)
+{
+    snprintf(path, sizeof(path), "/tmp/test_mhash.%d", (int)getpid());
+
+    test_basic();
+    test_crash();
+
+    printf("[OK] all kvs_mhash unit tests passed.\n");
+    return 0;
+}
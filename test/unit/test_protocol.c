@@ -0,0 +1,452 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "protocol/kvs_protocol.h"
+#include "engine/kvs_lazyfree.h"
+#include "engine/kvs_vlog.h"
+
+#define EXPECT_TRUE(x) do { \
+    if (!(x)) { \
+        fprintf(stderr, "[FAIL] %s:%d: EXPECT_TRUE(%s)\n", __FILE__, __LINE__, #x); \
+        assert(x); \
+    } \
+} while (0)
+
+#define EXPECT_EQ_INT(a,b) do { \
+    int _va = (a); \
+    int _vb = (b); \
+    if (_va != _vb) { \
+        fprintf(stderr, "[FAIL] %s:%d: EXPECT_EQ_INT(%s=%d, %s=%d)\n", \
+                __FILE__, __LINE__, #a, _va, #b, _vb); \
+        assert(_va == _vb); \
+    } \
+} while (0)
+
+static kvs_array_t arr;
+static kvs_rbtree_t tree;
+static kvs_hash_t hash;
+static kvs_store_t store = {&arr, &tree, &hash, 0, 1};
+
+// 执行一行请求，返回回复（去掉 \r\n）
+static const char *run(const char *req)
+{
+    static char reply[1024];
+    char line[1024];
+    char *tokens[KVS_MAX_TOKENS];
+    kvs_buf_t out = {0};
+
+    snprintf(line, sizeof(line), "%s", req);
+    int count = kvs_protocol_split(line, tokens, KVS_MAX_TOKENS);
+    kvs_protocol_execute(&store, tokens, count, &out);
+
+    EXPECT_TRUE(out.len >= 2);
+    EXPECT_TRUE(memcmp(out.data + out.len - 2, "\r\n", 2) == 0);
+    snprintf(reply, sizeof(reply), "%.*s", (int)out.len - 2, out.data);
+    kvs_buf_free(&out);
+    return reply;
+}
+
+static void test_split(void)
+{
+    printf("[TEST] protocol: split...\n");
+
+    char line[] = "  SET\tk1   v1 \r";
+    char *tokens[KVS_MAX_TOKENS];
+    EXPECT_EQ_INT(kvs_protocol_split(line, tokens, KVS_MAX_TOKENS), 3);
+    EXPECT_TRUE(strcmp(tokens[0], "SET") == 0);
+    EXPECT_TRUE(strcmp(tokens[1], "k1") == 0);
+    EXPECT_TRUE(strcmp(tokens[2], "v1") == 0);
+
+    char empty[] = "   ";
+    EXPECT_EQ_INT(kvs_protocol_split(empty, tokens, KVS_MAX_TOKENS), 0);
+
+    char many[] = "a b c d";
+    EXPECT_EQ_INT(kvs_protocol_split(many, tokens, 2), 2);
+
+    EXPECT_EQ_INT(kvs_protocol_command("HSET"), KVS_CMD_HSET);
+    EXPECT_EQ_INT(kvs_protocol_command("NOPE"), -1);
+}
+
+static void test_tokenize(void)
+{
+    printf("[TEST] protocol: tokenize on arena...\n");
+
+    struct mp_pool_s *arena = mp_create_pool(1024);
+    EXPECT_TRUE(arena != NULL);
+
+    // 超过 KVS_MAX_TOKENS 的请求也能完整切分；大于 pool 小块上限时走 large
+    static char big[KVS_MAX_TOKENS * 8 * 4];
+    int n = 0, pos = 0;
+    for (; n < KVS_MAX_TOKENS * 4; n++)
+        pos += snprintf(big + pos, sizeof(big) - pos, "%s%d", n ? " " : "", n);
+
+    int count = 0;
+    char **tokens = kvs_protocol_tokenize(arena, big, &count);
+    EXPECT_TRUE(tokens != NULL);
+    EXPECT_EQ_INT(count, n);
+    EXPECT_TRUE(strcmp(tokens[n - 1], "511") == 0);
+
+    // reset 之后小块从头复用
+    mp_reset_pool(arena);
+    char line1[] = "GET k1";
+    char **t1 = kvs_protocol_tokenize(arena, line1, &count);
+    EXPECT_EQ_INT(count, 2);
+    mp_reset_pool(arena);
+    char line2[] = "GET k2";
+    char **t2 = kvs_protocol_tokenize(arena, line2, &count);
+    EXPECT_TRUE(t1 == t2);
+    EXPECT_TRUE(strcmp(t2[1], "k2") == 0);
+
+    mp_destory_pool(arena);
+}
+
+static void test_engines(void)
+{
+    printf("[TEST] protocol: engines...\n");
+
+    const char *prefix[] = {"", "R", "H"};
+    char req[128];
+
+    for (int e = 0; e < 3; e++)
+    {
+        snprintf(req, sizeof(req), "%sSET k1 v1", prefix[e]);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        EXPECT_TRUE(strcmp(run(req), "EXIST") == 0);
+
+        snprintf(req, sizeof(req), "%sGET k1", prefix[e]);
+        EXPECT_TRUE(strcmp(run(req), "v1") == 0);
+
+        snprintf(req, sizeof(req), "%sMOD k1 v2", prefix[e]);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        snprintf(req, sizeof(req), "%sGET k1", prefix[e]);
+        EXPECT_TRUE(strcmp(run(req), "v2") == 0);
+
+        snprintf(req, sizeof(req), "%sEXIST k1", prefix[e]);
+        EXPECT_TRUE(strcmp(run(req), "EXIST") == 0);
+
+        snprintf(req, sizeof(req), "%sDEL k1", prefix[e]);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        EXPECT_TRUE(strcmp(run(req), "NO EXIST") == 0);
+
+        snprintf(req, sizeof(req), "%sMOD k1 v3", prefix[e]);
+        EXPECT_TRUE(strcmp(run(req), "NO EXIST") == 0);
+        snprintf(req, sizeof(req), "%sGET k1", prefix[e]);
+        EXPECT_TRUE(strcmp(run(req), "NO EXIST") == 0);
+    }
+
+    // 三个引擎互相独立
+    EXPECT_TRUE(strcmp(run("HSET same h"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("RSET same r"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("GET same"), "NO EXIST") == 0);
+    EXPECT_TRUE(strcmp(run("HGET same"), "h") == 0);
+    EXPECT_TRUE(strcmp(run("RGET same"), "r") == 0);
+}
+
+static void test_errors(void)
+{
+    printf("[TEST] protocol: errors...\n");
+
+    EXPECT_TRUE(strncmp(run("FOO k"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("SET k"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("GET"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("HGET a b"), "ERROR", 5) == 0);
+
+    kvs_buf_t out = {0};
+    EXPECT_EQ_INT(kvs_protocol_execute(NULL, NULL, 0, &out), -1);
+}
+
+static void test_memory(void)
+{
+    printf("[TEST] protocol: memory...\n");
+
+    EXPECT_TRUE(strcmp(run("HSET memkey memvalue"), "OK") == 0);
+    const char *r = run("MEMORY");
+    EXPECT_TRUE(strncmp(r, "MEMORY allocator=system ", 24) == 0);
+    EXPECT_TRUE(strstr(r, " requested=") != NULL);
+    EXPECT_TRUE(strstr(r, " fragmentation=") != NULL);
+    EXPECT_TRUE(strstr(r, " live.64=") != NULL); // hashnode_t（value 内嵌其中）
+    EXPECT_TRUE(strncmp(run("MEMORY x"), "ERROR", 5) == 0);
+}
+
+static void test_flush(void)
+{
+    printf("[TEST] protocol: flush...\n");
+
+    EXPECT_TRUE(strcmp(run("SET fa 1"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("RSET fb 2"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("HSET fc 3"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("FLUSH"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("GET fa"), "NO EXIST") == 0);
+    EXPECT_TRUE(strcmp(run("RGET fb"), "NO EXIST") == 0);
+    EXPECT_TRUE(strcmp(run("HGET fc"), "NO EXIST") == 0);
+
+    // ASYNC：立即为空，内存由后台线程释放
+    EXPECT_TRUE(strcmp(run("HSET fc 3"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("FLUSH ASYNC"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("HEXIST fc"), "NO EXIST") == 0);
+    EXPECT_TRUE(strcmp(run("HSET fc 4"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("HGET fc"), "4") == 0);
+    kvs_lazyfree_wait();
+
+    EXPECT_TRUE(strcmp(run("FLUSH SYNC"), "OK") == 0);
+    EXPECT_TRUE(strncmp(run("FLUSH NOW"), "ERROR", 5) == 0);
+
+    char *tokens[] = {"FLUSH"};
+    char *get[] = {"GET", "k"};
+    EXPECT_EQ_INT(kvs_protocol_broadcast(tokens, 1), 1);
+    EXPECT_EQ_INT(kvs_protocol_broadcast(get, 2), 0);
+    EXPECT_TRUE(kvs_protocol_key(tokens, 1) == NULL);
+}
+
+static void test_scan(void)
+{
+    printf("[TEST] protocol: scan...\n");
+
+    EXPECT_TRUE(strcmp(run("FLUSH SYNC"), "OK") == 0);
+    char req[64];
+    for (int i = 0; i < 2 * KVS_HASH_COMPACT_COUNT; i++) // 超过紧凑编码的上限，按桶推进
+    {
+        snprintf(req, sizeof(req), "HSET %s%d v", i % 2 ? "user:" : "item:", i);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+    }
+
+    // 跟着游标走到 0，MATCH 只留下 user:*
+    char cursor[32] = "0";
+    int found = 0, calls = 0;
+    do
+    {
+        snprintf(req, sizeof(req), "SCAN %s MATCH user:* COUNT 5", cursor);
+        char r[1024];
+        snprintf(r, sizeof(r), "%s", run(req));
+        EXPECT_TRUE(strncmp(r, "SCAN ", 5) == 0);
+
+        char *save = NULL;
+        strtok_r(r, " ", &save);
+        snprintf(cursor, sizeof(cursor), "%s", strtok_r(NULL, " ", &save));
+        for (char *k = strtok_r(NULL, " ", &save); k; k = strtok_r(NULL, " ", &save))
+        {
+            EXPECT_TRUE(strncmp(k, "user:", 5) == 0);
+            found++;
+        }
+        calls++;
+    } while (strcmp(cursor, "0") != 0);
+    EXPECT_EQ_INT(found, KVS_HASH_COMPACT_COUNT);
+    EXPECT_TRUE(calls > 1);
+
+    EXPECT_TRUE(strcmp(run("SCAN 0 MATCH nomatch COUNT 100000"), "SCAN 0") == 0);
+    EXPECT_TRUE(strncmp(run("SCAN"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("SCAN x"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("SCAN 0 COUNT 0"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("SCAN 0 LIMIT 1"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("SCAN 0 MATCH"), "ERROR", 5) == 0);
+
+    // glob：? [] 转义
+    EXPECT_TRUE(strcmp(run("HSET a*b v"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("SCAN 0 MATCH a\\*? COUNT 100000"), "SCAN 0 a*b") == 0);
+    EXPECT_TRUE(strcmp(run("SCAN 0 MATCH item:[0-1]? COUNT 100000"), "SCAN 0") != 0);
+    EXPECT_TRUE(strcmp(run("SCAN 0 MATCH item:4[^02468] COUNT 100000"), "SCAN 0") == 0);
+    EXPECT_TRUE(strcmp(run("SCAN 0 MATCH *:4[!1-9] COUNT 100000"), "SCAN 0 item:40") == 0);
+
+    // 分 shard 时游标末位是 shard 编号，扫完本 shard 指向下一个 shard
+    char *tokens[] = {"SCAN", "9"};
+    EXPECT_EQ_INT(kvs_protocol_cursor_owner(tokens, 2, 4), 1);
+    EXPECT_EQ_INT(kvs_protocol_cursor_owner(tokens, 2, 1), -1);
+    store.shard = 1;
+    store.nshards = 4;
+    EXPECT_TRUE(strcmp(run("SCAN 1 MATCH nomatch COUNT 100000"), "SCAN 2") == 0);
+    store.shard = 0;
+    store.nshards = 1;
+}
+
+static void test_upsert(void)
+{
+    printf("[TEST] protocol: upsert/getset/cas...\n");
+
+    const char *prefix[] = {"", "R", "H"};
+    char req[64];
+    for (int i = 0; i < 3; i++)
+    {
+        const char *p = prefix[i];
+        snprintf(req, sizeof(req), "%sUPSERT uk a", p);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        snprintf(req, sizeof(req), "%sUPSERT uk b", p);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        snprintf(req, sizeof(req), "%sGETSET uk c", p);
+        EXPECT_TRUE(strcmp(run(req), "b") == 0);
+        snprintf(req, sizeof(req), "%sGETSET uk2 c", p);
+        EXPECT_TRUE(strcmp(run(req), "NO EXIST") == 0);
+        snprintf(req, sizeof(req), "%sCAS uk b d", p);
+        EXPECT_TRUE(strcmp(run(req), "MISMATCH") == 0);
+        snprintf(req, sizeof(req), "%sCAS uk c d", p);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        snprintf(req, sizeof(req), "%sCAS uk3 c d", p);
+        EXPECT_TRUE(strcmp(run(req), "NO EXIST") == 0);
+        snprintf(req, sizeof(req), "%sGET uk", p);
+        EXPECT_TRUE(strcmp(run(req), "d") == 0);
+        snprintf(req, sizeof(req), "%sCAS uk d", p);
+        EXPECT_TRUE(strncmp(run(req), "ERROR", 5) == 0);
+    }
+
+    char *cas[] = {"HCAS", "k", "a", "b"};
+    EXPECT_TRUE(strcmp(kvs_protocol_key(cas, 4), "k") == 0);
+}
+
+static void test_incr(void)
+{
+    printf("[TEST] protocol: incr/decr/incrby...\n");
+
+    const char *prefix[] = {"", "R", "H"};
+    char req[64];
+    for (int i = 0; i < 3; i++)
+    {
+        const char *p = prefix[i];
+        snprintf(req, sizeof(req), "%sINCR ctr", p);
+        EXPECT_TRUE(strcmp(run(req), "1") == 0);
+        snprintf(req, sizeof(req), "%sINCRBY ctr 41", p);
+        EXPECT_TRUE(strcmp(run(req), "42") == 0);
+        snprintf(req, sizeof(req), "%sDECR ctr", p);
+        EXPECT_TRUE(strcmp(run(req), "41") == 0);
+        snprintf(req, sizeof(req), "%sGET ctr", p);
+        EXPECT_TRUE(strcmp(run(req), "41") == 0);
+        snprintf(req, sizeof(req), "%sINCRBY ctr -100", p);
+        EXPECT_TRUE(strcmp(run(req), "-59") == 0);
+        snprintf(req, sizeof(req), "%sINCRBY ctr 1x", p);
+        EXPECT_TRUE(strcmp(run(req), "ERROR not an integer") == 0);
+        snprintf(req, sizeof(req), "%sUPSERT ctr word", p);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        snprintf(req, sizeof(req), "%sINCR ctr", p);
+        EXPECT_TRUE(strcmp(run(req), "ERROR not an integer") == 0);
+        snprintf(req, sizeof(req), "%sUPSERT ctr 9223372036854775807", p);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        snprintf(req, sizeof(req), "%sINCR ctr", p);
+        EXPECT_TRUE(strcmp(run(req), "ERROR overflow") == 0);
+        snprintf(req, sizeof(req), "%sINCR ctr extra", p);
+        EXPECT_TRUE(strcmp(run(req), "ERROR wrong number of arguments") == 0);
+    }
+}
+
+static void test_batch(void)
+{
+    printf("[TEST] protocol: batch...\n");
+
+    EXPECT_TRUE(strcmp(run("HMSET b1 x b2 y b1 z"), "OK\r\nOK\r\nEXIST") == 0);
+    EXPECT_TRUE(strcmp(run("HMGET b2 nope b1"), "y\r\nNO EXIST\r\nx") == 0);
+    EXPECT_TRUE(strcmp(run("RMSET r2 b r1 a"), "OK\r\nOK") == 0);
+    EXPECT_TRUE(strcmp(run("RMGET r2 r1 r3"), "b\r\na\r\nNO EXIST") == 0);
+    EXPECT_TRUE(strcmp(run("MSET a1 1"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("MGET a1 a2"), "1\r\nNO EXIST") == 0);
+    EXPECT_TRUE(strcmp(run("GET a1"), "1") == 0);
+
+    EXPECT_TRUE(strncmp(run("MGET"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("HMSET k"), "ERROR", 5) == 0);
+    EXPECT_TRUE(strncmp(run("RMSET k v k2"), "ERROR", 5) == 0);
+
+    char *mget[] = {"HMGET", "a", "b"};
+    char *mset[] = {"MSET", "a", "1"};
+    char *get[] = {"GET", "k"};
+    EXPECT_EQ_INT(kvs_protocol_batch(mget, 3), 1);
+    EXPECT_EQ_INT(kvs_protocol_batch(mset, 3), 2);
+    EXPECT_EQ_INT(kvs_protocol_batch(get, 2), 0);
+    EXPECT_TRUE(kvs_protocol_key(mget, 3) == NULL);
+}
+
+static void test_restore(void)
+{
+    printf("[TEST] protocol: restore...\n");
+
+    char val[201];
+    memset(val, 'z', 200);
+    val[200] = '\0';
+
+    kvs_value_compress_threshold(32);
+    kvs_value_t v = {0};
+    EXPECT_EQ_INT(kvs_value_init(&v, val), 0);
+    EXPECT_TRUE(v.in.enc == KVS_ENC_LZF);
+    char packed[256];
+    snprintf(packed, sizeof(packed), "%s", kvs_value_packed(&v));
+    kvs_value_free(&v);
+    kvs_value_compress_threshold(0);
+
+    // 压缩形式直接落地，读出原值
+    const char *prefix[] = {"", "R", "H"};
+    char req[512];
+    for (int i = 0; i < 3; i++)
+    {
+        const char *p = prefix[i];
+        snprintf(req, sizeof(req), "%sRESTORE rk %s", p, packed);
+        EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+        snprintf(req, sizeof(req), "%sGET rk", p);
+        EXPECT_TRUE(strcmp(run(req), val) == 0);
+        snprintf(req, sizeof(req), "%sRESTORE rk 200:AAAA", p);
+        EXPECT_TRUE(strcmp(run(req), "ERROR invalid payload") == 0);
+        snprintf(req, sizeof(req), "%sRESTORE rk", p);
+        EXPECT_TRUE(strcmp(run(req), "ERROR wrong number of arguments") == 0);
+        snprintf(req, sizeof(req), "%sGET rk", p);
+        EXPECT_TRUE(strcmp(run(req), val) == 0);
+    }
+}
+
+static void test_unreadable(void)
+{
+    printf("[TEST] protocol: unreadable value...\n");
+
+    char dir[64];
+    snprintf(dir, sizeof(dir), "/tmp/test_protocol.%d", (int)getpid());
+    EXPECT_EQ_INT(mkdir(dir, 0700), 0);
+    kvs_vlog_t *log = kvs_vlog_create(dir, 100, 0);
+    EXPECT_TRUE(log != NULL);
+    kvs_vlog_current = log;
+
+    char val[201];
+    memset(val, 'v', 200);
+    val[200] = '\0';
+    char req[512];
+    snprintf(req, sizeof(req), "RSET u1 %s", val);
+    EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+    snprintf(req, sizeof(req), "RSET u2 %s", val);
+    EXPECT_TRUE(strcmp(run(req), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("RGET u1"), val) == 0);
+
+    // 段文件被截断后读不出来：报错，不当成空串、不存在或非整数
+    EXPECT_EQ_INT(ftruncate(log->segs[log->active].fd, 0), 0);
+    EXPECT_TRUE(strcmp(run("RGET u1"), "ERROR value unreadable") == 0);
+    EXPECT_TRUE(strcmp(run("RMGET u1 nope u2"), "ERROR value unreadable\r\nNO EXIST\r\nERROR value unreadable") == 0);
+    EXPECT_TRUE(strcmp(run("RCAS u1 x y"), "ERROR value unreadable") == 0);
+    EXPECT_TRUE(strcmp(run("RINCR u1"), "ERROR value unreadable") == 0);
+    EXPECT_TRUE(strcmp(run("REXIST u1"), "EXIST") == 0);
+    EXPECT_TRUE(strcmp(run("RGETSET u1 fresh"), "ERROR value unreadable") == 0);
+    EXPECT_TRUE(strcmp(run("RGET u1"), "fresh") == 0);
+
+    EXPECT_TRUE(strcmp(run("RDEL u1"), "OK") == 0);
+    EXPECT_TRUE(strcmp(run("RDEL u2"), "OK") == 0);
+    kvs_lazyfree_wait();
+    kvs_vlog_current = NULL;
+    kvs_vlog_destory(log);
+    EXPECT_EQ_INT(rmdir(dir), 0);
+}
+
+int main(void)
+{
+    EXPECT_EQ_INT(kvs_store_create(&store), 0);
+
+    test_split();
+    test_tokenize();
+    test_engines();
+    test_errors();
+    test_memory();
+    test_flush();
+    test_scan();
+    test_upsert();
+    test_incr();
+    test_batch();
+    test_restore();
+    test_unreadable();
+
+    kvs_store_destory(&store);
+
+    printf("[OK] all kvs_protocol unit tests passed.\n");
+    return 0;
+}
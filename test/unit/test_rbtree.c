@@ -165,6 +165,201 @@ static void test_mass_insert_modify_delete(void) {
     kvs_rbtree_destory(&t);
 }
 
+// 检查父子指针一致、中序有序，返回节点数
+static int check_links(kvs_rbtree_t *t, rbtree_node *x, const char **prev) {
+    if (x == t->nil) return 0;
+    if (x->left != t->nil) EXPECT_TRUE(x->left->parent == x);
+    if (x->right != t->nil) EXPECT_TRUE(x->right->parent == x);
+    int n = check_links(t, x->left, prev);
+    if (*prev) EXPECT_TRUE(strcmp(*prev, x->key) < 0);
+    *prev = x->key;
+    return n + 1 + check_links(t, x->right, prev);
+}
+
+static void test_defrag(void) {
+    kvs_set_allocator(KVS_ALLOC_MYPOOL);
+
+    kvs_rbtree_t t;
+    memset(&t, 0, sizeof(t));
+    EXPECT_EQ_INT(kvs_rbtree_create(&t), 0);
+
+    char key[32], val[32];
+    for (int i = 0; i < 4000; i++) {
+        snprintf(key, sizeof(key), "key-%05d", i);
+        snprintf(val, sizeof(val), "val-%d", i);
+        EXPECT_EQ_INT(kvs_rbtree_set(&t, key, val), 0);
+    }
+
+    // 分批搬迁，批次之间插入/删除会旋转树，cursor 按 key 续上
+    EXPECT_EQ_INT(kvs_alloc_defrag_begin(), 0);
+    char *cursor = NULL;
+    int steps = 0;
+    while (kvs_rbtree_defrag(&t, &cursor, 64)) {
+        snprintf(key, sizeof(key), "key-%05d", steps * 2);
+        EXPECT_EQ_INT(kvs_rbtree_del(&t, key), 0);
+        snprintf(key, sizeof(key), "add-%05d", steps);
+        EXPECT_EQ_INT(kvs_rbtree_set(&t, key, "added"), 0);
+        steps++;
+    }
+    kvs_alloc_defrag_end();
+    EXPECT_TRUE(cursor == NULL);
+    EXPECT_TRUE(steps > 10);
+
+    const char *prev = NULL;
+    EXPECT_EQ_INT(check_links(&t, t.root, &prev), 4000);
+    for (int i = 0; i < 4000; i++) {
+        snprintf(key, sizeof(key), "key-%05d", i);
+        snprintf(val, sizeof(val), "val-%d", i);
+        if (i % 2 == 0 && i / 2 < steps)
+            EXPECT_TRUE(kvs_rbtree_get(&t, key) == NULL);
+        else
+            EXPECT_EQ_STR(kvs_rbtree_get(&t, key), val);
+    }
+
+    kvs_rbtree_destory(&t);
+    kvs_set_allocator(KVS_ALLOC_SYSTEM);
+}
+
+static void test_upsert_getset_cas(void) {
+    kvs_rbtree_t t;
+    memset(&t, 0, sizeof(t));
+    EXPECT_EQ_INT(kvs_rbtree_create(&t), 0);
+
+    char key[32], val[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key-%04d", (i * 7) % 1000);
+        snprintf(val, sizeof(val), "v%d", i);
+        EXPECT_EQ_INT(kvs_rbtree_upsert(&t, key, val), 0);
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        snprintf(key, sizeof(key), "key-%04d", i);
+        EXPECT_EQ_INT(kvs_rbtree_upsert(&t, key, "again"), 1);
+        EXPECT_EQ_STR(kvs_rbtree_get(&t, key), "again");
+    }
+    const char *prev = NULL;
+    EXPECT_EQ_INT(check_links(&t, t.root, &prev), 1000);
+
+    kvs_value_t old;
+    EXPECT_EQ_INT(kvs_rbtree_getset(&t, "key-0000", "g", &old), 1);
+    EXPECT_EQ_STR(kvs_value_str(&old), "again");
+    kvs_value_free(&old);
+    EXPECT_EQ_INT(kvs_rbtree_getset(&t, "new", "g", &old), 0);
+    EXPECT_TRUE(kvs_value_str(&old) == NULL);
+
+    EXPECT_EQ_INT(kvs_rbtree_cas(&t, "key-0000", "x", "y"), 2);
+    EXPECT_EQ_INT(kvs_rbtree_cas(&t, "key-0000", "g", "y"), 0);
+    EXPECT_EQ_STR(kvs_rbtree_get(&t, "key-0000"), "y");
+    EXPECT_EQ_INT(kvs_rbtree_cas(&t, "none", "g", "y"), 1);
+
+    // 等长覆盖不调用分配器；删除时 key/value 互换的节点也按各自容量释放
+    kvs_alloc_counters_t c0, c1;
+    kvs_alloc_counters(&c0);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key-%04d", i);
+        EXPECT_EQ_INT(kvs_rbtree_mod(&t, key, "m"), 0);
+    }
+    kvs_alloc_counters(&c1);
+    EXPECT_TRUE(c1.malloc_calls == c0.malloc_calls && c1.free_calls == c0.free_calls);
+    EXPECT_EQ_INT(kvs_rbtree_mod(&t, "key-0500", "grown-past-the-embedded-limit"), 0);
+    for (int i = 0; i < 1000; i += 2) {
+        snprintf(key, sizeof(key), "key-%04d", i);
+        EXPECT_EQ_INT(kvs_rbtree_del(&t, key), 0);
+    }
+    EXPECT_EQ_STR(kvs_rbtree_get(&t, "key-0501"), "m");
+    EXPECT_EQ_INT(kvs_rbtree_upsert(NULL, "k", "v"), -1);
+
+    kvs_rbtree_destory(&t);
+}
+
+static void test_incr(void) {
+    kvs_rbtree_t t;
+    memset(&t, 0, sizeof(t));
+    EXPECT_EQ_INT(kvs_rbtree_create(&t), 0);
+
+    char key[32];
+    int64_t r = 0;
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "c-%03d", i % 50);
+        EXPECT_EQ_INT(kvs_rbtree_incr(&t, key, i, &r), 0);
+    }
+    // 每个计数器累加了 i, i+50, ..., i+450
+    EXPECT_EQ_STR(kvs_rbtree_get(&t, "c-000"), "2250");
+    EXPECT_EQ_STR(kvs_rbtree_get(&t, "c-049"), "2740");
+
+    // 删除时与后继互换的 value 是内嵌的，整体交换
+    kvs_alloc_counters_t c0, c1;
+    kvs_alloc_counters(&c0);
+    EXPECT_EQ_INT(kvs_rbtree_incr(&t, "c-010", -2350, &r), 0);
+    kvs_alloc_counters(&c1);
+    EXPECT_TRUE(c1.malloc_calls == c0.malloc_calls && c1.free_calls == c0.free_calls);
+    EXPECT_EQ_STR(kvs_rbtree_get(&t, "c-010"), "0");
+    for (int i = 0; i < 50; i += 2) {
+        snprintf(key, sizeof(key), "c-%03d", i);
+        EXPECT_EQ_INT(kvs_rbtree_del(&t, key), 0);
+    }
+    EXPECT_EQ_STR(kvs_rbtree_get(&t, "c-011"), "2360");
+
+    EXPECT_EQ_INT(kvs_rbtree_set(&t, "s", "x"), 0);
+    EXPECT_EQ_INT(kvs_rbtree_incr(&t, "s", 1, &r), 1);
+    EXPECT_EQ_INT(kvs_rbtree_incr(NULL, "s", 1, &r), -1);
+
+    kvs_rbtree_destory(&t);
+}
+
+static void test_batch(void) {
+    kvs_rbtree_t t;
+    memset(&t, 0, sizeof(t));
+    EXPECT_EQ_INT(kvs_rbtree_create(&t), 0);
+
+    // 乱序 + 重复 key：重复的第二个结果为已存在，与逐个 set 一致
+    char *keys[] = {"m", "c", "x", "a", "c", "q"};
+    char *vals[] = {"vm", "vc", "vx", "va", "vc2", "vq"};
+    int results[6];
+    EXPECT_EQ_INT(kvs_rbtree_mset(&t, keys, vals, 6, results), 5);
+    EXPECT_EQ_INT(results[1], 0);
+    EXPECT_EQ_INT(results[4], 1);
+    EXPECT_EQ_STR(kvs_rbtree_get(&t, "c"), "vc");
+
+    char key[32], val[32];
+    for (int i = 0; i < 3000; i++) {
+        snprintf(key, sizeof(key), "key-%05d", i * 2);
+        snprintf(val, sizeof(val), "val-%d", i * 2);
+        EXPECT_EQ_INT(kvs_rbtree_set(&t, key, val), 0);
+    }
+
+    // 超过栈上排序空间，且一半不存在（落在已有 key 之间），检验路径复用后的结果
+    enum { N = 200 };
+    char buf[N][32];
+    char *mkeys[N], *mvals[N];
+    for (int i = 0; i < N; i++) {
+        snprintf(buf[i], sizeof(buf[i]), "key-%05d", (i * 37) % 6000);
+        mkeys[i] = buf[i];
+    }
+    mkeys[N - 1] = mkeys[0]; // 重复
+    int found = kvs_rbtree_mget(&t, mkeys, N, mvals);
+    int expect = 0;
+    for (int i = 0; i < N; i++) {
+        char *v = kvs_rbtree_get(&t, mkeys[i]);
+        expect += v != NULL;
+        EXPECT_TRUE(mvals[i] == v);
+    }
+    EXPECT_EQ_INT(found, expect);
+    EXPECT_TRUE(found > 0 && found < N);
+
+    // 越过两端的 key
+    char *edge[] = {"zzz", "0", "key-00000", "key-05998", "key-05999"};
+    char *evals[5];
+    EXPECT_EQ_INT(kvs_rbtree_mget(&t, edge, 5, evals), 2);
+    EXPECT_TRUE(evals[0] == NULL && evals[1] == NULL && evals[4] == NULL);
+    EXPECT_EQ_STR(evals[2], "val-0");
+    EXPECT_EQ_STR(evals[3], "val-5998");
+
+    EXPECT_EQ_INT(kvs_rbtree_mget(&t, edge, 0, evals), 0);
+    EXPECT_EQ_INT(kvs_rbtree_mget(NULL, edge, 5, evals), -1);
+
+    kvs_rbtree_destory(&t);
+}
+
 int main(void) {
     printf("[TEST] rbtree: basic_api...\n");
     test_basic_api();
@@ -174,6 +369,22 @@ int main(void) {
     test_mass_insert_modify_delete();
     printf("[PASS] mass_insert_modify_delete\n");
 
+    printf("[TEST] rbtree: upsert_getset_cas...\n");
+    test_upsert_getset_cas();
+    printf("[PASS] upsert_getset_cas\n");
+
+    printf("[TEST] rbtree: incr...\n");
+    test_incr();
+    printf("[PASS] incr\n");
+
+    printf("[TEST] rbtree: batch...\n");
+    test_batch();
+    printf("[PASS] batch\n");
+
+    printf("[TEST] rbtree: defrag...\n");
+    test_defrag();
+    printf("[PASS] defrag\n");
+
     printf("[ALL PASS]\n");
     return 0;
 }
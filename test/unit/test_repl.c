@@ -0,0 +1,199 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "network/kvs_repl.h"
+
+static const char *ID = "0123456789abcdef0123456789abcdef01234567";
+
+static void test_backlog(void)
+{
+    printf("[TEST] repl: backlog...\n");
+
+    kvs_repl_backlog_t b;
+    assert(kvs_repl_backlog_create(&b, 16) == 0);
+    assert(b.offset == 0 && kvs_repl_backlog_first(&b) == 0);
+
+    kvs_repl_backlog_feed(&b, "0123456789", 10);
+    kvs_repl_backlog_feed(&b, "abcdefghij", 10); // 绕回：只留最后 16 字节
+    assert(b.offset == 20 && kvs_repl_backlog_first(&b) == 4);
+
+    kvs_buf_t out = {0};
+    assert(kvs_repl_backlog_continue(&b, ID, "other", 10, &out) < 0);
+    assert(kvs_repl_backlog_continue(&b, ID, ID, 3, &out) < 0);  // 已被覆盖
+    assert(kvs_repl_backlog_continue(&b, ID, ID, 21, &out) < 0); // 超前
+    assert(out.len == 0);
+
+    const char *head = "+CONTINUE 0123456789abcdef0123456789abcdef01234567\r\n";
+    size_t hlen = strlen(head);
+    assert(kvs_repl_backlog_continue(&b, ID, ID, 4, &out) == 0);
+    assert(out.len == hlen + 16);
+    assert(memcmp(out.data, head, hlen) == 0);
+    assert(memcmp(out.data + hlen, "456789abcdefghij", 16) == 0);
+
+    out.len = 0;
+    assert(kvs_repl_backlog_continue(&b, ID, ID, 20, &out) == 0); // 什么都不缺
+    assert(out.len == hlen);
+
+    // 一次写入超过整个缓冲区
+    kvs_repl_backlog_feed(&b, "ABCDEFGHIJKLMNOPQRSTUVWXYZ", 26);
+    assert(b.offset == 46 && kvs_repl_backlog_first(&b) == 30);
+    out.len = 0;
+    assert(kvs_repl_backlog_continue(&b, ID, ID, 40, &out) == 0);
+    assert(memcmp(out.data + hlen, "UVWXYZ", 6) == 0 && out.len == hlen + 6);
+
+    kvs_buf_free(&out);
+    kvs_repl_backlog_destory(&b);
+}
+
+static void test_id_format(void)
+{
+    printf("[TEST] repl: id/format...\n");
+
+    char a[KVS_REPL_ID_LEN + 1], b[KVS_REPL_ID_LEN + 1];
+    kvs_repl_new_id(a);
+    kvs_repl_new_id(b);
+    assert(strlen(a) == KVS_REPL_ID_LEN && strspn(a, "0123456789abcdef") == KVS_REPL_ID_LEN);
+    assert(strcmp(a, b) != 0);
+
+    char *tokens[] = {"HSET", "k", "v"};
+    kvs_buf_t out = {0};
+    assert(kvs_repl_format(&out, tokens, 3) == 0);
+    assert(out.len == 9 && memcmp(out.data, "HSET k v\n", 9) == 0);
+    kvs_buf_free(&out);
+}
+
+static kvs_array_t arr_a, arr_b;
+static kvs_rbtree_t tree_a, tree_b;
+static kvs_hash_t hash_a, hash_b;
+
+// 按从的做法回放全量数据：控制行之外逐行执行
+static void replay(kvs_store_t *store, char *data, uint64_t *offset)
+{
+    char *tokens[KVS_MAX_TOKENS];
+    kvs_buf_t out = {0};
+    int synced = 0;
+
+    for (char *line = data; *line; )
+    {
+        char *nl = strchr(line, '\n');
+        assert(nl);
+        *nl = '\0';
+        int count = kvs_protocol_split(line, tokens, KVS_MAX_TOKENS);
+        if (strcmp(tokens[0], "+FULLRESYNC") == 0)
+        {
+            assert(count == 3 && strcmp(tokens[1], ID) == 0);
+            *offset = strtoull(tokens[2], NULL, 10);
+        }
+        else if (strcmp(tokens[0], "+SYNCED") == 0)
+        {
+            synced = 1;
+        }
+        else
+        {
+            assert(!synced);
+            out.len = 0;
+            assert(kvs_protocol_execute(store, tokens, count, &out) == 0);
+        }
+        line = nl + 1;
+    }
+    assert(synced);
+    kvs_buf_free(&out);
+}
+
+static void test_snapshot(void)
+{
+    printf("[TEST] repl: snapshot...\n");
+
+    kvs_store_t a = {&arr_a, &tree_a, &hash_a, 0, 1};
+    kvs_store_t b = {&arr_b, &tree_b, &hash_b, 0, 1};
+    assert(kvs_store_create(&a) == 0);
+    assert(kvs_store_create(&b) == 0);
+
+    char key[32], val[64];
+    for (int i = 0; i < 300; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(val, sizeof(val), i % 3 ? "value-%d-long-enough-to-be-allocated" : "%d", i);
+        assert(kvs_array_set(&arr_a, key, val) == 0);
+        assert(kvs_rbtree_set(&tree_a, key, val) == 0);
+        assert(kvs_hash_set(&hash_a, key, val) == 0);
+    }
+    assert(kvs_array_del(&arr_a, "k7") == 0); // 空洞不输出
+    assert(kvs_hash_set(&hash_b, "stale", "x") == 0);
+
+    // 压缩过的 value 以压缩形式传输
+    char doc[2048];
+    for (size_t i = 0; i < sizeof(doc) - 1; i++)
+        doc[i] = "{\"id\":1,\"tag\":\"x\"}"[i % 18];
+    doc[sizeof(doc) - 1] = '\0';
+    kvs_value_compress_threshold(256);
+    assert(kvs_array_set(&arr_a, "doc", doc) == 0);
+    assert(kvs_rbtree_set(&tree_a, "doc", doc) == 0);
+    assert(kvs_hash_set(&hash_a, "doc", doc) == 0);
+    kvs_value_compress_threshold(0);
+
+    int sv[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+    int bufsize = 1 << 20;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+    assert(kvs_repl_snapshot(&a, ID, 42, sv, 1) == 1);
+    close(sv[0]);
+
+    kvs_buf_t in = {0};
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(sv[1], chunk, sizeof(chunk))) > 0)
+        assert(kvs_buf_append(&in, chunk, (size_t)n) == 0);
+    close(sv[1]);
+    assert(kvs_buf_append(&in, "", 1) == 0);
+
+    assert(strstr(in.data, "\nRESTORE doc ") && strstr(in.data, "\nRRESTORE doc ") && strstr(in.data, "\nHRESTORE doc "));
+    assert(strstr(in.data, doc) == NULL);
+
+    uint64_t offset = 0;
+    replay(&b, in.data, &offset);
+    assert(offset == 42);
+
+    assert(kvs_hash_get(&hash_b, "stale") == NULL); // FLUSH SYNC 先清空
+    assert(kvs_array_get(&arr_b, "k7") == NULL);
+    assert(kvs_hash_count(&hash_b) == 301);
+    assert(strcmp(kvs_array_get(&arr_b, "doc"), doc) == 0);
+    assert(strcmp(kvs_rbtree_get(&tree_b, "doc"), doc) == 0);
+    assert(strcmp(kvs_hash_get(&hash_b, "doc"), doc) == 0);
+    for (int i = 0; i < 300; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        if (i != 7)
+            assert(strcmp(kvs_array_get(&arr_b, key), kvs_array_get(&arr_a, key)) == 0);
+        assert(strcmp(kvs_rbtree_get(&tree_b, key), kvs_rbtree_get(&tree_a, key)) == 0);
+        assert(strcmp(kvs_hash_get(&hash_b, key), kvs_hash_get(&hash_a, key)) == 0);
+    }
+
+    // 对端已关闭：写失败，返回 0
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    close(sv[1]);
+    assert(kvs_repl_snapshot(&a, ID, 0, sv, 1) == 0);
+    close(sv[0]);
+
+    kvs_buf_free(&in);
+    kvs_store_destory(&a);
+    kvs_store_destory(&b);
+}
+
+int main(void)
+{
+    test_backlog();
+    test_id_format();
+    test_snapshot();
+
+    printf("[OK] all kvs_repl unit tests passed.\n");
+    return 0;
+}
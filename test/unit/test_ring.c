@@ -0,0 +1,81 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "network/kvs_ring.h"
+
+#define STRESS_COUNT 1000000
+
+static void test_push_pop_basic(void)
+{
+    printf("[TEST] ring: push_pop_basic...\n");
+
+    kvs_ring_t r;
+    assert(kvs_ring_create(&r, 3) == 0); // 向上取整为 4
+    assert(r.mask == 3);
+    assert(kvs_ring_empty(&r));
+    assert(kvs_ring_pop(&r) == NULL);
+
+    for (uintptr_t i = 1; i <= 4; i++)
+        assert(kvs_ring_push(&r, (void *)i) == 0);
+    assert(kvs_ring_push(&r, (void *)5) == 1); // full
+
+    for (uintptr_t i = 1; i <= 4; i++)
+        assert(kvs_ring_pop(&r) == (void *)i); // FIFO
+    assert(kvs_ring_pop(&r) == NULL);
+
+    // 回绕
+    for (uintptr_t i = 1; i <= 10; i++)
+    {
+        assert(kvs_ring_push(&r, (void *)i) == 0);
+        assert(kvs_ring_pop(&r) == (void *)i);
+    }
+
+    kvs_ring_destory(&r);
+}
+
+static void *producer(void *arg)
+{
+    kvs_ring_t *r = (kvs_ring_t *)arg;
+    for (uintptr_t i = 1; i <= STRESS_COUNT; i++)
+    {
+        while (kvs_ring_push(r, (void *)i) != 0)
+            ;
+    }
+    return NULL;
+}
+
+static void test_spsc_threads(void)
+{
+    printf("[TEST] ring: spsc_threads...\n");
+
+    kvs_ring_t r;
+    assert(kvs_ring_create(&r, 1024) == 0);
+
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, producer, &r) == 0);
+
+    uintptr_t expect = 1;
+    while (expect <= STRESS_COUNT)
+    {
+        void *p = kvs_ring_pop(&r);
+        if (!p)
+            continue;
+        assert((uintptr_t)p == expect); // 不丢、不乱序
+        expect++;
+    }
+
+    pthread_join(tid, NULL);
+    assert(kvs_ring_empty(&r));
+    kvs_ring_destory(&r);
+}
+
+int main(void)
+{
+    test_push_pop_basic();
+    test_spsc_threads();
+
+    printf("[OK] all kvs_ring unit tests passed.\n");
+    return 0;
+}
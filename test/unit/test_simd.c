@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "engine/kvs_simd.h"
+
+#define PAGE 4096
+
+static char *ref_delim(const char *s)
+{
+    while (*s && *s != ' ' && *s != '\t' && *s != '\r')
+        s++;
+    return (char *)s;
+}
+
+static size_t ref_count(const char *s)
+{
+    size_t n = 0;
+    for (; *s; s++)
+        n += *s == ' ' || *s == '\t' || *s == '\r';
+    return n;
+}
+
+// 在当前档位下检查 s：哈希与 scalar 档一致，分隔符与参照实现一致
+static void check(const char *s, uint32_t scalar_hash)
+{
+    assert(kvs_simd_hash(s) == scalar_hash);
+    assert(kvs_simd_delim(s) == ref_delim(s));
+    assert(kvs_simd_count_delim(s) == ref_count(s));
+}
+
+// 各种长度、各种起始对齐，与参照实现逐一比对
+static void test_kernels(void)
+{
+    printf("[TEST] simd: kernels...\n");
+
+    static char buf[512];
+    srand(7);
+    for (int len = 0; len < 300; len++)
+    {
+        for (int off = 0; off < 64; off += 7)
+        {
+            char *s = buf + off;
+            for (int i = 0; i < len; i++)
+            {
+                int r = rand() % 16;
+                s[i] = r == 0 ? ' ' : r == 1 ? '\t' : r == 2 ? '\r' : (char)('a' + rand() % 3);
+            }
+            s[len] = '\0';
+
+            kvs_simd_select(KVS_SIMD_SCALAR);
+            uint32_t h = kvs_simd_hash(s);
+            for (int level = 0; level <= (int)kvs_simd_best(); level++)
+            {
+                assert(kvs_simd_select((kvs_simd_level_t)level) == 0);
+                check(s, h);
+            }
+        }
+    }
+    kvs_simd_select(kvs_simd_best());
+}
+
+// 字符串紧贴在一个不可访问的页前面：向量实现不能越界读
+static void test_page_end(void)
+{
+    printf("[TEST] simd: page end...\n");
+
+    char *map = mmap(NULL, 2 * PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(map != MAP_FAILED);
+    assert(mprotect(map + PAGE, PAGE, PROT_NONE) == 0);
+
+    for (int len = 0; len < 100; len++)
+    {
+        char *s = map + PAGE - len - 1;
+        memset(s, 'k', (size_t)len);
+        s[len] = '\0';
+        if (len > 3)
+            s[len / 2] = ' ';
+
+        kvs_simd_select(KVS_SIMD_SCALAR);
+        uint32_t h = kvs_simd_hash(s);
+        for (int level = 0; level <= (int)kvs_simd_best(); level++)
+        {
+            assert(kvs_simd_select((kvs_simd_level_t)level) == 0);
+            check(s, h);
+        }
+    }
+    kvs_simd_select(kvs_simd_best());
+    munmap(map, 2 * PAGE);
+}
+
+// 哈希取低位分桶：顺序编号的 key 应均匀分布
+static void test_distribution(void)
+{
+    printf("[TEST] simd: distribution...\n");
+
+    enum { KEYS = 1 << 16, BUCKETS = 1 << 12 };
+    static int count[BUCKETS];
+    char key[32];
+    for (int i = 0; i < KEYS; i++)
+    {
+        snprintf(key, sizeof(key), "user:%08d", i);
+        count[kvs_simd_hash(key) & (BUCKETS - 1)]++;
+    }
+    int max = 0;
+    for (int i = 0; i < BUCKETS; i++)
+        max = count[i] > max ? count[i] : max;
+    assert(max < 3 * KEYS / BUCKETS); // 平均 16
+}
+
+static void test_select(void)
+{
+    printf("[TEST] simd: select...\n");
+
+    kvs_simd_level_t best = kvs_simd_best();
+    assert(kvs_simd_level() == best); // 启动时已按 CPUID 选好
+    assert(kvs_simd_select(KVS_SIMD_COUNT) < 0);
+    assert(kvs_simd_select((kvs_simd_level_t)-1) < 0);
+    assert(kvs_simd_select(KVS_SIMD_SCALAR) == 0 && kvs_simd_level() == KVS_SIMD_SCALAR);
+    assert(strcmp(kvs_simd_name(KVS_SIMD_AVX2), "avx2") == 0);
+    assert(kvs_simd_select(best) == 0);
+    printf("       best: %s\n", kvs_simd_name(best));
+}
+
+int main(void)
+{
+    test_select();
+    test_kernels();
+    test_page_end();
+    test_distribution();
+
+    printf("[OK] all kvs_simd unit tests passed.\n");
+    return 0;
+}
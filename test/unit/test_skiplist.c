@@ -0,0 +1,341 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine/kvs_skiplist.h"
+
+#define N 5000
+
+static char *node_key(kvs_skiplist_node_t *n)
+{
+    return (char *)(n->next + n->level);
+}
+
+// 结构检查：每层有序，高层是低层的子集，层数与计数一致
+static void check_list(kvs_skiplist_t *sl)
+{
+    int level = atomic_load(&sl->level);
+    for (int i = level; i < KVS_SKIPLIST_MAX_LEVEL; i++)
+        assert(atomic_load(&sl->head[i]) == NULL);
+    assert(level == 0 || atomic_load(&sl->head[level - 1]) != NULL);
+
+    int count = 0;
+    for (kvs_skiplist_node_t *x = atomic_load(&sl->head[0]); x; x = atomic_load(&x->next[0]))
+    {
+        kvs_skiplist_node_t *y = atomic_load(&x->next[0]);
+        assert(!y || strcmp(node_key(x), node_key(y)) < 0);
+        assert(x->level >= 1 && x->level <= level);
+        count++;
+    }
+    assert(count == kvs_skiplist_count(sl));
+
+    for (int i = 1; i < level; i++)
+    {
+        kvs_skiplist_node_t *lower = atomic_load(&sl->head[i - 1]);
+        for (kvs_skiplist_node_t *x = atomic_load(&sl->head[i]); x; x = atomic_load(&x->next[i]))
+        {
+            while (lower != x)
+            {
+                assert(lower);
+                lower = atomic_load(&lower->next[i - 1]);
+            }
+            assert(x->level > i);
+        }
+    }
+}
+
+static void test_basic(void)
+{
+    printf("[TEST] skiplist: basic...\n");
+
+    kvs_skiplist_t sl;
+    assert(kvs_skiplist_create(&sl) == 0);
+    assert(kvs_skiplist_get(&sl, "a") == NULL);
+    assert(kvs_skiplist_del(&sl, "a") == 1);
+    assert(kvs_skiplist_exist(&sl, "a") == 1);
+
+    assert(kvs_skiplist_set(&sl, "b", "2") == 0);
+    assert(kvs_skiplist_set(&sl, "a", "1") == 0);
+    assert(kvs_skiplist_set(&sl, "c", "3") == 0);
+    assert(kvs_skiplist_set(&sl, "a", "x") == 1);
+    assert(strcmp(kvs_skiplist_get(&sl, "a"), "1") == 0);
+    assert(kvs_skiplist_exist(&sl, "c") == 0);
+
+    assert(kvs_skiplist_mod(&sl, "b", "two") == 0);
+    assert(kvs_skiplist_mod(&sl, "d", "x") == 1);
+    assert(strcmp(kvs_skiplist_get(&sl, "b"), "two") == 0);
+    assert(kvs_skiplist_count(&sl) == 3);
+
+    assert(kvs_skiplist_del(&sl, "a") == 0);
+    assert(kvs_skiplist_get(&sl, "a") == NULL && kvs_skiplist_count(&sl) == 2);
+
+    assert(kvs_skiplist_set(&sl, NULL, "x") == -1);
+    assert(kvs_skiplist_set(&sl, "x", NULL) == -1);
+    assert(kvs_skiplist_mod(&sl, "b", NULL) == -1);
+    assert(kvs_skiplist_del(NULL, "b") == -1);
+    check_list(&sl);
+
+    kvs_skiplist_destory(&sl);
+    assert(kvs_skiplist_count(&sl) == 0 && atomic_load(&sl.head[0]) == NULL);
+}
+
+typedef struct walk_s
+{
+    char last[32];
+    int n;
+} walk_t;
+
+static void walk_fn(void *arg, const char *key, kvs_value_t *v)
+{
+    walk_t *w = arg;
+    assert(w->n == 0 || strcmp(w->last, key) < 0);
+    assert(strcmp(kvs_value_str(v), key) == 0);
+    snprintf(w->last, sizeof(w->last), "%s", key);
+    w->n++;
+}
+
+// 随机增删改与参照数组比对，检查结构与区间遍历；最后全部释放，不留内存
+static void test_random(void)
+{
+    printf("[TEST] skiplist: random...\n");
+
+    static int present[N];
+    kvs_alloc_stats_t st0, st1;
+    kvs_alloc_thread_stats(&st0);
+
+    kvs_skiplist_t sl;
+    assert(kvs_skiplist_create(&sl) == 0);
+    srand(3);
+    char key[32];
+    int live = 0;
+    for (int round = 0; round < 20 * N; round++)
+    {
+        int i = rand() % N;
+        snprintf(key, sizeof(key), "k%05d", i);
+        int op = rand() % 4;
+        if (op < 2)
+        {
+            assert(kvs_skiplist_set(&sl, key, key) == (present[i] ? 1 : 0));
+            live += !present[i];
+            present[i] = 1;
+        }
+        else if (op == 2)
+        {
+            assert(kvs_skiplist_mod(&sl, key, key) == (present[i] ? 0 : 1));
+        }
+        else
+        {
+            assert(kvs_skiplist_del(&sl, key) == (present[i] ? 0 : 1));
+            live -= present[i];
+            present[i] = 0;
+        }
+        if (round % 10000 == 0)
+            check_list(&sl);
+    }
+    check_list(&sl);
+    assert(kvs_skiplist_count(&sl) == live);
+    for (int i = 0; i < N; i++)
+    {
+        snprintf(key, sizeof(key), "k%05d", i);
+        char *v = kvs_skiplist_get(&sl, key);
+        assert(present[i] ? v && strcmp(v, key) == 0 : v == NULL);
+    }
+
+    // 区间遍历：闭区间、边界不存在、空区间
+    walk_t w = {"", 0};
+    kvs_skiplist_foreach(&sl, walk_fn, &w);
+    assert(w.n == live);
+
+    int expect = 0;
+    for (int i = 1000; i <= 2000; i++)
+        expect += present[i];
+    w = (walk_t){"", 0};
+    assert(kvs_skiplist_range(&sl, "k01000", "k02000", walk_fn, &w) == expect && w.n == expect);
+    w = (walk_t){"", 0};
+    assert(kvs_skiplist_range(&sl, "k01000x", "k00999", walk_fn, &w) == 0);
+    assert(kvs_skiplist_range(&sl, "z", NULL, walk_fn, &w) == 0);
+
+    // 没有读者时待回收的节点全部能释放
+    assert(kvs_skiplist_reclaim(&sl) == 0);
+    kvs_skiplist_destory(&sl);
+    kvs_alloc_thread_stats(&st1);
+    assert(st1.requested == st0.requested);
+}
+
+// 读者在读区内时，写者摘下的节点不会被释放
+static void test_reclaim(void)
+{
+    printf("[TEST] skiplist: reclaim...\n");
+
+    kvs_skiplist_t sl;
+    assert(kvs_skiplist_create(&sl) == 0);
+    assert(kvs_skiplist_set(&sl, "a", "old") == 0);
+
+    int id = kvs_skiplist_reader_register(&sl);
+    assert(id >= 0);
+    kvs_skiplist_read_begin(&sl, id);
+    char *v = kvs_skiplist_get(&sl, "a");
+
+    assert(kvs_skiplist_mod(&sl, "a", "new") == 0);
+    assert(kvs_skiplist_set(&sl, "b", "b") == 0 && kvs_skiplist_del(&sl, "b") == 0);
+    assert(kvs_skiplist_reclaim(&sl) == 2);
+    assert(strcmp(v, "old") == 0); // 读区内拿到的旧值仍然有效
+    assert(strcmp(kvs_skiplist_get(&sl, "a"), "new") == 0);
+    kvs_skiplist_read_end(&sl, id);
+    assert(kvs_skiplist_reclaim(&sl) == 0);
+
+    // 在摘下之后进入读区的读者不阻挡回收
+    assert(kvs_skiplist_mod(&sl, "a", "newer") == 0);
+    kvs_skiplist_read_begin(&sl, id);
+    assert(kvs_skiplist_reclaim(&sl) == 0);
+    kvs_skiplist_read_end(&sl, id);
+
+    // 槽位用完
+    int ids[KVS_SKIPLIST_READERS];
+    ids[0] = id;
+    for (int i = 1; i < KVS_SKIPLIST_READERS; i++)
+        assert((ids[i] = kvs_skiplist_reader_register(&sl)) >= 0);
+    assert(kvs_skiplist_reader_register(&sl) < 0);
+    kvs_skiplist_reader_unregister(&sl, ids[5]);
+    assert(kvs_skiplist_reader_register(&sl) == ids[5]);
+    for (int i = 0; i < KVS_SKIPLIST_READERS; i++)
+        kvs_skiplist_reader_unregister(&sl, ids[i]);
+
+    kvs_skiplist_destory(&sl);
+}
+
+// ---------- 并发：一个写者，多个读者 ----------
+
+#define READERS 4
+#define KEYS 1000
+
+typedef struct reader_arg_s
+{
+    kvs_skiplist_t *sl;
+    atomic_int *stop;
+    long reads;
+} reader_arg_t;
+
+typedef struct check_s
+{
+    char last[32];
+    int n;
+} check_t;
+
+// 值总是 "<key>:<版本>"，与 key 对得上；遍历严格递增
+static void check_value(const char *key, const char *v)
+{
+    size_t klen = strlen(key);
+    assert(strncmp(v, key, klen) == 0 && v[klen] == ':');
+}
+
+static void range_fn(void *arg, const char *key, kvs_value_t *v)
+{
+    check_t *c = arg;
+    assert(c->n == 0 || strcmp(c->last, key) < 0);
+    check_value(key, kvs_value_str(v));
+    snprintf(c->last, sizeof(c->last), "%s", key);
+    c->n++;
+}
+
+static void *reader_main(void *p)
+{
+    reader_arg_t *a = p;
+    int id = kvs_skiplist_reader_register(a->sl);
+    assert(id >= 0);
+
+    unsigned seed = (unsigned)id * 7919u + 1;
+    char key[32], hi[32];
+    while (!atomic_load(a->stop))
+    {
+        kvs_skiplist_read_begin(a->sl, id);
+        int i = rand_r(&seed) % KEYS;
+        snprintf(key, sizeof(key), "key:%05d", i);
+        char *v = kvs_skiplist_get(a->sl, key);
+        if (v)
+            check_value(key, v);
+        if (i % 8 == 0)
+        {
+            snprintf(hi, sizeof(hi), "key:%05d", i + 50);
+            check_t c = {"", 0};
+            kvs_skiplist_range(a->sl, key, hi, range_fn, &c);
+            assert(c.n <= 51);
+        }
+        kvs_skiplist_read_end(a->sl, id);
+        a->reads++;
+    }
+    kvs_skiplist_reader_unregister(a->sl, id);
+    return NULL;
+}
+
+static void test_concurrent(void)
+{
+    printf("[TEST] skiplist: concurrent readers...\n");
+
+    kvs_skiplist_t *sl = malloc(sizeof(*sl));
+    assert(sl && kvs_skiplist_create(sl) == 0);
+    atomic_int stop = 0;
+
+    char key[32], value[64];
+    for (int i = 0; i < KEYS; i += 2)
+    {
+        snprintf(key, sizeof(key), "key:%05d", i);
+        snprintf(value, sizeof(value), "%s:0", key);
+        assert(kvs_skiplist_set(sl, key, value) == 0);
+    }
+
+    pthread_t tids[READERS];
+    reader_arg_t args[READERS];
+    for (int i = 0; i < READERS; i++)
+    {
+        args[i] = (reader_arg_t){sl, &stop, 0};
+        assert(pthread_create(&tids[i], NULL, reader_main, &args[i]) == 0);
+    }
+
+    // 写者：增删改混合，值越来越长，逼出不同的编码和分配
+    srand(11);
+    for (int round = 0; round < 200000; round++)
+    {
+        int i = rand() % KEYS;
+        snprintf(key, sizeof(key), "key:%05d", i);
+        snprintf(value, sizeof(value), "%s:%d%.*s", key, round, round % 24, "xxxxxxxxxxxxxxxxxxxxxxxx");
+        switch (rand() % 3)
+        {
+        case 0:
+            assert(kvs_skiplist_set(sl, key, value) >= 0);
+            break;
+        case 1:
+            assert(kvs_skiplist_mod(sl, key, value) >= 0);
+            break;
+        default:
+            assert(kvs_skiplist_del(sl, key) >= 0);
+            break;
+        }
+    }
+
+    atomic_store(&stop, 1);
+    long reads = 0;
+    for (int i = 0; i < READERS; i++)
+    {
+        pthread_join(tids[i], NULL);
+        reads += args[i].reads;
+    }
+    assert(reads > 0);
+    check_list(sl);
+    assert(kvs_skiplist_reclaim(sl) == 0);
+    kvs_skiplist_destory(sl);
+    free(sl);
+}
+
+int main(void)
+{
+    test_basic();
+    test_random();
+    test_reclaim();
+    test_concurrent();
+
+    printf("[OK] all kvs_skiplist unit tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stats/kvs_stats.h"
+#include "protocol/kvs_protocol.h"
+
+static void test_hist_percentile(void)
+{
+    printf("[TEST] stats: hist_percentile...\n");
+
+    static kvs_hist_t h;
+    memset(&h, 0, sizeof(h));
+    assert(kvs_hist_percentile(&h, 50.0) == 0);
+
+    // 1..10000 均匀分布
+    for (uint64_t v = 1; v <= 10000; v++)
+        kvs_hist_add(&h, v);
+
+    assert(h.count == 10000);
+    assert(h.max == 10000);
+
+    // 对数-线性桶，允许 ~6.25% 误差
+    uint64_t p50 = kvs_hist_percentile(&h, 50.0);
+    uint64_t p99 = kvs_hist_percentile(&h, 99.0);
+    assert(p50 >= 4700 && p50 <= 5300);
+    assert(p99 >= 9300 && p99 <= 10000);
+    assert(kvs_hist_percentile(&h, 100.0) <= 10000);
+
+    // 小值精确
+    memset(&h, 0, sizeof(h));
+    for (int i = 0; i < 100; i++)
+        kvs_hist_add(&h, 7);
+    assert(kvs_hist_percentile(&h, 50.0) == 7);
+    assert(kvs_hist_percentile(&h, 99.9) == 7);
+
+    // 超大值不越界
+    kvs_hist_add(&h, ~0ull);
+    assert(h.max == ~0ull);
+}
+
+static void test_record_merge_reset(void)
+{
+    printf("[TEST] stats: record_merge_reset...\n");
+
+    static kvs_hist_t h;
+    memset(&h, 0, sizeof(h));
+
+    for (int i = 0; i < 1000; i++)
+        kvs_stats_record(3, 100);
+    kvs_stats_record(3, 5000);
+    kvs_stats_record(KVS_STATS_SLOTS, 1); // 越界槽位忽略
+
+    kvs_stats_merge(3, &h);
+    assert(h.count == 1001);
+    assert(h.max == 5000);
+    assert(kvs_hist_percentile(&h, 50.0) >= 96 && kvs_hist_percentile(&h, 50.0) <= 104);
+
+    memset(&h, 0, sizeof(h));
+    kvs_stats_merge(4, &h);
+    assert(h.count == 0);
+
+    kvs_stats_reset();
+    kvs_stats_merge(3, &h);
+    assert(h.count == 0);
+
+    kvs_stats_record(3, 10);
+    kvs_stats_merge(3, &h);
+    assert(h.count == 1);
+    assert(h.max == 10);
+}
+
+static void test_stats_command(void)
+{
+    printf("[TEST] stats: command...\n");
+
+    kvs_array_t arr = {0};
+    kvs_rbtree_t tree = {0};
+    kvs_hash_t hash = {0};
+    kvs_store_t store = {&arr, &tree, &hash, 0, 1};
+    assert(kvs_store_create(&store) == 0);
+
+    char line[64];
+    char *tokens[KVS_MAX_TOKENS];
+    kvs_buf_t out = {0};
+
+    kvs_stats_reset();
+    snprintf(line, sizeof(line), "HSET k v");
+    kvs_protocol_execute(&store, tokens, kvs_protocol_split(line, tokens, KVS_MAX_TOKENS), &out);
+    snprintf(line, sizeof(line), "HGET k");
+    kvs_protocol_execute(&store, tokens, kvs_protocol_split(line, tokens, KVS_MAX_TOKENS), &out);
+
+    out.len = 0;
+    snprintf(line, sizeof(line), "STATS");
+    kvs_protocol_execute(&store, tokens, kvs_protocol_split(line, tokens, KVS_MAX_TOKENS), &out);
+    assert(kvs_buf_append(&out, "", 1) == 0);
+    assert(strncmp(out.data, "STATS", 5) == 0);
+    assert(strstr(out.data, "cmd.HSET count=1 ") != NULL);
+    assert(strstr(out.data, "cmd.HGET count=1 ") != NULL);
+    assert(strstr(out.data, "engine.hash count=2 ") != NULL);
+    assert(strstr(out.data, "engine.array") == NULL);
+
+    out.len = 0;
+    snprintf(line, sizeof(line), "STATS RESET");
+    kvs_protocol_execute(&store, tokens, kvs_protocol_split(line, tokens, KVS_MAX_TOKENS), &out);
+    assert(out.len == 4 && memcmp(out.data, "OK\r\n", 4) == 0);
+
+    out.len = 0;
+    snprintf(line, sizeof(line), "STATS");
+    kvs_protocol_execute(&store, tokens, kvs_protocol_split(line, tokens, KVS_MAX_TOKENS), &out);
+    assert(out.len == 7 && memcmp(out.data, "STATS\r\n", 7) == 0);
+
+    // STATS 不带 key，不会被按 key 转发
+    snprintf(line, sizeof(line), "STATS RESET");
+    assert(kvs_protocol_key(tokens, kvs_protocol_split(line, tokens, KVS_MAX_TOKENS)) == NULL);
+
+    kvs_buf_free(&out);
+    kvs_store_destory(&store);
+}
+
+int main(void)
+{
+    kvs_stats_init(1);
+
+    test_hist_percentile();
+    test_record_merge_reset();
+    test_stats_command();
+
+    printf("[OK] all kvs_stats unit tests passed.\n");
+    return 0;
+}
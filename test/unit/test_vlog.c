@@ -0,0 +1,252 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "engine/kvs_vlog.h"
+
+#define NKEYS 120
+#define VLEN 200
+
+static char dir[64];
+
+static void val(char *buf, int i, int round)
+{
+    int n = snprintf(buf, VLEN + 1, "v%d-%d-", i, round);
+    memset(buf + n, 'a' + i % 26, (size_t)(VLEN - n));
+    buf[VLEN] = '\0';
+}
+
+static void test_basic(void)
+{
+    printf("[TEST] vlog: basic...\n");
+
+    kvs_vlog_t *log = kvs_vlog_create(dir, 100, 4096);
+    assert(log);
+    kvs_vlog_current = log;
+
+    // 超过阈值的写入日志，短的照旧
+    char big[VLEN + 1];
+    val(big, 1, 0);
+    kvs_value_t v;
+    assert(kvs_value_init(&v, big) == 0 && v.in.enc == KVS_ENC_VLOG);
+    assert(strcmp(kvs_value_str(&v), big) == 0);
+    kvs_value_t small;
+    assert(kvs_value_init(&small, "a-value-of-about-fifty-bytes-stays-in-memory") == 0);
+    assert(small.in.enc == KVS_ENC_RAW);
+    kvs_value_free(&small);
+
+    kvs_vlog_stats_t st;
+    kvs_vlog_stats(log, &st);
+    assert(st.live == VLEN && st.disk == VLEN && st.segments == 1);
+    kvs_value_free(&v);
+    kvs_vlog_stats(log, &st);
+    assert(st.live == 0 && st.segments == 1); // 正在追加的段不删除
+
+    // 写满的段封存；引用全部释放后段文件被删除
+    kvs_hash_t hash = {0};
+    assert(kvs_hash_create(&hash) == 0);
+    char key[32];
+    for (int i = 0; i < NKEYS; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        val(big, i, 0);
+        assert(kvs_hash_set(&hash, key, big) == 0);
+    }
+    kvs_vlog_stats(log, &st);
+    assert(st.live == NKEYS * VLEN && st.segments > 3);
+
+    for (int i = 0; i < NKEYS; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        val(big, i, 0);
+        assert(strcmp(kvs_hash_get(&hash, key), big) == 0);
+        val(big, i, 1);
+        assert(kvs_hash_mod(&hash, key, big) == 0);
+    }
+    kvs_vlog_stats(log, &st);
+    assert(st.live == NKEYS * VLEN && st.disk < 3 * NKEYS * VLEN);
+
+    for (int i = 0; i < NKEYS; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        assert(kvs_hash_del(&hash, key) == 0);
+    }
+    kvs_vlog_stats(log, &st);
+    assert(st.live == 0 && st.segments == 1);
+
+    kvs_hash_destory(&hash);
+    kvs_vlog_destory(log);
+    assert(kvs_vlog_current == NULL);
+}
+
+static void test_gc(void)
+{
+    printf("[TEST] vlog: gc...\n");
+
+    kvs_vlog_t *log = kvs_vlog_create(dir, 100, 4096);
+    assert(log);
+    kvs_vlog_current = log;
+
+    kvs_array_t array = {0};
+    kvs_rbtree_t rbtree = {0};
+    kvs_hash_t hash = {0};
+    assert(kvs_array_create(&array) == 0 && kvs_rbtree_create(&rbtree) == 0 && kvs_hash_create(&hash) == 0);
+
+    char key[32], big[VLEN + 1];
+    for (int i = 0; i < NKEYS; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        val(big, i, 0);
+        assert(kvs_array_set(&array, key, big) == 0);
+        assert(kvs_rbtree_set(&rbtree, key, big) == 0);
+        assert(kvs_hash_set(&hash, key, big) == 0);
+    }
+
+    // 每个段里删掉 3/4，留下的分散在所有段里
+    for (int i = 0; i < NKEYS; i++)
+    {
+        if (i % 4 == 0)
+            continue;
+        snprintf(key, sizeof(key), "k%d", i);
+        assert(kvs_array_del(&array, key) == 0);
+        assert(kvs_rbtree_del(&rbtree, key) == 0);
+        assert(kvs_hash_del(&hash, key) == 0);
+    }
+    kvs_vlog_stats_t before, after;
+    kvs_vlog_stats(log, &before);
+    assert(before.live == 3 * (NKEYS / 4) * VLEN);
+
+    int rounds = 0;
+    while (kvs_vlog_gc_start(log) == 0)
+    {
+        while (kvs_vlog_gc_step(log, &array, &rbtree, &hash, 8))
+            ;
+        rounds++;
+        assert(rounds < 100);
+    }
+    assert(rounds > 0 && log->gc_moved > 0);
+
+    // 有效数据不变，磁盘占用下降，剩下的封存段都过半有效
+    kvs_vlog_stats(log, &after);
+    assert(after.live == before.live && after.disk < before.disk && after.segments < before.segments);
+    for (int i = 0; i < KVS_VLOG_MAX_SEGS; i++)
+    {
+        kvs_vlog_seg_t *seg = &log->segs[i];
+        if (seg->fd >= 0 && seg->sealed)
+            assert((double)seg->live >= KVS_VLOG_GC_RATIO * (double)seg->size);
+    }
+
+    for (int i = 0; i < NKEYS; i += 4)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        val(big, i, 0);
+        assert(strcmp(kvs_array_get(&array, key), big) == 0);
+        assert(strcmp(kvs_rbtree_get(&rbtree, key), big) == 0);
+        assert(strcmp(kvs_hash_get(&hash, key), big) == 0);
+    }
+
+    kvs_array_destory(&array);
+    kvs_rbtree_destory(&rbtree);
+    kvs_hash_destory(&hash);
+    kvs_vlog_stats(log, &after);
+    assert(after.live == 0);
+    kvs_vlog_destory(log);
+}
+
+static void test_scratch(void)
+{
+    printf("[TEST] vlog: scratch...\n");
+
+    kvs_vlog_t *log = kvs_vlog_create(dir, 100, 0);
+    assert(log);
+    kvs_vlog_current = log;
+
+    // 比一块临时区还大的 value
+    size_t len = 1 << 20;
+    char *huge = (char *)malloc(len + 1);
+    assert(huge);
+    memset(huge, 'h', len);
+    huge[len] = '\0';
+
+    kvs_value_t a, b;
+    char small[VLEN + 1];
+    val(small, 7, 0);
+    assert(kvs_value_init(&a, huge) == 0 && kvs_value_init(&b, small) == 0);
+    assert(a.in.enc == KVS_ENC_VLOG && b.in.enc == KVS_ENC_VLOG);
+
+    // reset 之前读出的值都有效；reset 之后临时区复用
+    kvs_value_scratch_reset();
+    char *sb = kvs_value_str(&b);
+    char *sa = kvs_value_str(&a);
+    assert(strcmp(sa, huge) == 0 && strcmp(sb, small) == 0);
+    kvs_value_scratch_reset();
+    assert(kvs_value_str(&b) == sb);
+
+    kvs_value_free(&a);
+    kvs_value_free(&b);
+    free(huge);
+    kvs_vlog_destory(log);
+
+    // 日志写不进去时退回普通分配
+    log = kvs_vlog_create("/nonexistent-kvs-dir", 100, 0);
+    assert(log);
+    kvs_vlog_current = log;
+    assert(kvs_value_init(&a, small) == 0 && a.in.enc == KVS_ENC_RAW);
+    kvs_value_free(&a);
+    kvs_vlog_destory(log);
+}
+
+static void test_damaged(void)
+{
+    printf("[TEST] vlog: damaged segment...\n");
+
+    kvs_vlog_t *log = kvs_vlog_create(dir, 100, 0);
+    assert(log);
+    kvs_vlog_current = log;
+
+    char big[VLEN + 1];
+    val(big, 3, 0);
+    kvs_value_t v;
+    assert(kvs_value_init(&v, big) == 0 && v.in.enc == KVS_ENC_VLOG);
+
+    // 段文件被截断：读不出来时返回 NULL 并置位，不能当成空串
+    assert(ftruncate(log->segs[v.vlog.seg].fd, 0) == 0);
+    kvs_value_scratch_reset();
+    assert(!kvs_value_unreadable);
+    assert(kvs_value_str(&v) == NULL && kvs_value_unreadable);
+
+    // 比较和自增报错，不改动原值
+    kvs_rbtree_t tree = {0};
+    assert(kvs_rbtree_create(&tree) == 0);
+    assert(kvs_rbtree_set(&tree, "k", big) == 0);
+    assert(ftruncate(log->segs[log->active].fd, 0) == 0);
+    assert(kvs_rbtree_get(&tree, "k") == NULL && kvs_rbtree_exist(&tree, "k") == 0);
+    assert(kvs_rbtree_cas(&tree, "k", "", "x") < 0);
+    int64_t n;
+    assert(kvs_rbtree_incr(&tree, "k", 1, &n) < 0);
+    kvs_value_scratch_reset();
+    assert(!kvs_value_unreadable);
+
+    kvs_rbtree_destory(&tree);
+    kvs_value_free(&v);
+    kvs_vlog_destory(log);
+    kvs_vlog_current = NULL;
+}
+
+int main(void)
+{
+    snprintf(dir, sizeof(dir), "/tmp/test_vlog.%d", (int)getpid());
+    assert(mkdir(dir, 0700) == 0);
+
+    test_basic();
+    test_gc();
+    test_scratch();
+    test_damaged();
+
+    assert(rmdir(dir) == 0); // 段文件都已删除
+    printf("[OK] all kvs_vlog unit tests passed.\n");
+    return 0;
+}